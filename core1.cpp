@@ -12,7 +12,9 @@
 
 #include "pico/stdlib.h"
 
+#include "project.h"
 #include "./ipc/ipc.h"
+#include "./ipc/telemetry.h"
 #include "./sys/nvm.h"
 #include "./pilznet/pilznet.h"
 #include "./ipc/mlogger.h"
@@ -25,9 +27,122 @@ static pilznet pnet;
 static ds1820 probe;
 static inter_core_t ipcCore1Data;
 
+#define PROBE_PERIOD_MS     2500        // how often the temperature gets read
+
 // global
 bool wakeCore1 = false;
 
+/*********************************************************
+ * publishNetStatus()
+ *********************************************************
+ * tell whoever cares how the network is doing
+ ********************************************************/
+static void publishNetStatus(void)
+{
+    tp_net_status_t ns;
+    ns.wifiConnected = pnet.isConnected();
+    ns.clockReady = pnet.isClockValid();
+    ns.ipAddress = pnet.getIP();
+
+    telemetry::getInstance()->publish<TP_NET_STATUS>(ns);
+}
+
+/*********************************************************
+ * configChanged()
+ *********************************************************
+ * telemetry callback; core 0 changed something in nvm.
+ * Nothing here acts on it yet, network changes still
+ * wait for a reload command
+ ********************************************************/
+static void configChanged(topic_t t, void* ctx)
+{
+    tp_config_t cfg;
+    if (telemetry::getInstance()->read<TP_CONFIG>(cfg))
+    {
+        DBG_WRITE(logger::getInstance(), FMT("%s::config changed, 0x%02x\n", __FUNCTION__, cfg.what));
+    }
+}
+
+/*********************************************************
+ * serviceRequest()
+ *********************************************************
+ * take one command from core 0, do it, and answer it.
+ * Results go into the shared data before the answer
+ * goes back, so they're there when core 0 sees it
+ ********************************************************/
+static void serviceRequest(logger* log, nvm* data)
+{
+    ipc_request_t req;
+    if (!getRequest(req))
+    {
+        return;
+    }
+
+    DBG_WRITE(log, FMT("%s::#%d %s\n", __FUNCTION__, req.id, cmd2text(req.cmd).c_str()));
+
+    uint16_t updates = US_NONE;
+    bool ok = pnet.isConnected();
+
+    switch (req.cmd)
+    {
+        // these return right away (assuming we are connected)
+        case IS_GET_IP:
+        {
+            if (ok)
+            {
+                ipcCore1Data.ipAddress = pnet.getIP();
+                updates = US_IP_ADDR;
+            }
+        }  break;
+
+        case IS_GET_MAC:
+        {
+            if (ok)
+            {
+                ipcCore1Data.macAddress = pnet.getMac();
+                updates = US_MAC_ADDR;
+            }
+        }  break;
+
+        // scan of all available networks.  This will block
+        // for several seconds
+        case IS_DO_SCAN:
+        {
+            if (ok)
+            {
+                ipcCore1Data.scanResult = pnet.scan();
+                updates = US_SCAN_DATA;
+            }
+        }  break;
+
+        // config in nvm changed; connect if we aren't, then
+        // set the clock with whatever the timezone is now
+        case IS_RELOAD_CONFIG:
+        {
+            if (!pnet.isConnected())
+            {
+                pnet.connect(data->getSSID(), data->getPwd());
+                ipcCore1Data.ipAddress = pnet.getIP();
+                updates = US_IP_ADDR;
+            }
+        }  // fall through
+
+        case IS_NTP_SYNC:
+        {
+            ok = pnet.doNTP(data->getTZ());
+            publishNetStatus();
+        }  break;
+
+        default:
+        {
+            ok = false;
+        }
+    }
+
+    updateSharedData(updates, ipcCore1Data);
+    postResponse(req, ok);
+}
+
 /*********************************************************
  * core1Main()
  *********************************************************
@@ -42,15 +157,16 @@ void core1Main(void)
     // and non-vol data storage handlers
     logger* log = logger::getInstance();
     nvm* data = nvm::getInstance();
+    telemetry* bus = telemetry::getInstance();
 
-    log->dbgWrite("Into core 1's shit now\n");
+    DBG_WRITE(log, "Into core 1's shit now\n");
     
     // Let core 0 know it's OK to pause this core
     ipcCore1Data.core1Ready = true;
     updateSharedData(US_CORE1_READY, ipcCore1Data);
 
     // Weeeee're here!
-    log->dbgWrite(stringFormat("%s::Starting\n", __FUNCTION__));
+    DBG_WRITE(log, FMT("%s::Starting\n", __FUNCTION__));
 
     uint32_t ms = to_ms_since_boot(get_absolute_time());
     uint32_t lastMs = ms;
@@ -64,21 +180,22 @@ void core1Main(void)
     // go get the current TOD and date from the interwebz
     pnet.doNTP(data->getTZ());
 
-    ipcCore1Data.wifiConnected = pnet.isConnected();
-    ipcCore1Data.clockReady = pnet.isClockValid();
+    publishNetStatus();
+    bus->subscribe(TP_CONFIG, configChanged);
 
     // log the IP address.  Also spit it out the USB serial interface
     // for fallback 
-    log->dbgWrite(stringFormat("%s()::%s\n", __FUNCTION__, pnet.getIP().c_str()));
-    printf("%s()::%s\n", __FUNCTION__, pnet.getIP().c_str());
+    std::string ip = pilznet::ip2text(pnet.getIP());
+    DBG_WRITE(log, FMT("%s()::%s\n", __FUNCTION__, ip.c_str()));
+    printf("%s()::%s\n", __FUNCTION__, ip.c_str());
     
     // init temperature sensor PIO state machine
-    uint32_t sm = probe.init((PIO)pio0, 15);
+    uint32_t sm = probe.init((PIO)pio0, PIN_PIO);
 
     // do the first inter-core process update
-    updateSharedData(US_WIFI_CONNECTED | US_CLOCK_READY, ipcCore1Data);
+    updateSharedData(US_NONE, ipcCore1Data);
 
-    // main loop.  Nominally, each task will hit once every 5ms, but some of them
+    // main loop.  Nominally, each task will hit once every 3ms, but some of them
     // will block, so who knows?
     while (true)
     { 
@@ -86,107 +203,72 @@ void core1Main(void)
         
         switch (tick)
         {   
-            // core 0 asked for our IP address, this will return right
-            // away (assuming we are connected)
+            // take one command off the queue from core 0.  
+            // Some of these block for seconds
             case 0:
             {
-                if (ipcCore1Data.cmd == IS_GET_IP)
-                {
-                    log->dbgWrite(stringFormat("%s::Get IP Address\n", __FUNCTION__));
-
-                    updates = US_NEW_CMD;
-                    ipcCore1Data.cmd = IS_NO_CMD;
-
-                    if (pnet.isConnected())
-                    {
-                        ipcCore1Data.ack = IS_GET_IP;
-                        ipcCore1Data.ipAddress = pnet.getIP();
-                        updates |= US_IP_ADDR | US_ACK_CMD;
-                    }
-                    
-                    updateSharedData(updates, ipcCore1Data);
-                }
+                serviceRequest(log, data);
             }  break;
             
-            // core 0 asked for our MAC address, this will return right
-            // away (assuming we are connected)
-            case 1:
-            {
-                if (ipcCore1Data.cmd == IS_GET_MAC)
-                {
-                    log->dbgWrite(stringFormat("%s::Get MAC address\n", __FUNCTION__));
-
-                    updates = US_NEW_CMD;
-                    ipcCore1Data.cmd = IS_NO_CMD;
-
-                    if (pnet.isConnected())
-                    {
-                        ipcCore1Data.ack = IS_GET_MAC;
-                        ipcCore1Data.macAddress = pnet.getMac();
-                        updates |= US_MAC_ADDR | US_ACK_CMD;
-                    }
-                    
-                    updateSharedData(updates, ipcCore1Data);
-                }
-            }  break;
-            
-            // Core 0 asked for a scan of all available networks.  This will
-            // block for several seconds
-            case 2:
-            {
-                if (ipcCore1Data.cmd == IS_DO_SCAN)
-                {
-                    log->dbgWrite(stringFormat("%s::Starting net scan\n", __FUNCTION__));
-
-                    updates = US_NEW_CMD;
-                    ipcCore1Data.cmd = IS_NO_CMD;
-
-                    if (pnet.isConnected())
-                    {
-                        ipcCore1Data.ack = IS_DO_SCAN;
-                        ipcCore1Data.scanResult = pnet.scan();
-                        updates |= US_SCAN_DATA | US_ACK_CMD;
-                    }
-                    
-                    updateSharedData(updates, ipcCore1Data);
-                }
-            }  break;
-            
-            // Read the temperature probe and push to core 0; probe read update
-            // rate is actually quite a bit less often than once every 5ms.  This 
+            // Read the temperature probe and publish it; probe read update
+            // rate is actually quite a bit less often than once every 3ms.  This 
             // will block for about 25ms
-            case 3:
+            case 1:
             {
-                static uint16_t count = 0;
+                static absolute_time_t nextRead = nil_time;
 
-                if (!(count % 500))
+                if (time_reached(nextRead))
                 {
-                    ipcCore1Data.temperatue = probe.getTemperature();
-                    ++ipcCore1Data.tempCount;
+                    static tp_temperature_t temp = { 0, 0, 0 };
 
-                    updateSharedData(US_NEW_TMP_DATA, ipcCore1Data);
+                    temp.centiF = probe.getTemperature();
+                    temp.readUs = time_us_32();
+                    ++temp.count;
+
+                    bus->publish<TP_TEMPERATURE>(temp);
+                    nextRead = make_timeout_time_ms(PROBE_PERIOD_MS);
                 }
-                ++count;
             }  break;
             
             // update the network handler - this is for the udp
             // server
-            case 4:
+            case 2:
             {
+                pnet.setScanView(ipcCore1Data.scanView);
                 pnet.update();
-                updateSharedData(IS_NO_CMD, ipcCore1Data);
+
+                // pass brightness changes along to core 0,
+                // it owns the display and nvm
+                if (pnet.getBrightCount() != ipcCore1Data.brightCount)
+                {
+                    ipcCore1Data.brightness = pnet.getBrightness();
+                    ipcCore1Data.brightCount = pnet.getBrightCount();
+                    updates = US_BRIGHTNESS;
+                }
+
+                updateSharedData(updates, ipcCore1Data);
             }  break;
         }
 
-        // tight part of service loop, wait for next ms tick
-        while(ms == lastMs)
+        // move both cores' log lines into the log buffer,
+        // and some of it out USB if debugging
+        log->drain();
+        log->echo();
+
+        // sleep until the next ms tick.  A command from core 0
+        // or a topic we subscribed to rings the doorbell, take
+        // it straight away
+        bus->poll();
+        while (sleepUntil(from_us_since_boot((uint64_t)(lastMs + 1) * 1000)))
         {
-            ms = to_ms_since_boot(get_absolute_time());
+            serviceRequest(log, data);
+            bus->poll();
         }
+        ms = to_ms_since_boot(get_absolute_time());
 
         lastMs = ms;
         
         ++tick;
-        tick %= 5;
+        tick %= 3;
     }
 }
\ No newline at end of file
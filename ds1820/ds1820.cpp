@@ -69,9 +69,9 @@ uint32_t ds1820::init(PIO p, int pin)
  *  None
  * 
  * Returns:
- *  Current temperature in degrees F
+ *  Current temperature in hundredths of a degree F
  *************************************************/
-float ds1820::getTemperature() const
+temp_t ds1820::getTemperature() const
 {
     // send the request
     writeBytes(first);
@@ -91,17 +91,12 @@ float ds1820::getTemperature() const
         return (BAD_TEMPERATURE_VALUE);
     }
 
-    // convert to floating point temperature
+    // 1/16 degrees C, straight to hundredths of a degree F
     int t1 = data[0];
     int t2 = data[1];
     int16_t temp1 = (t2 << 8 | t1);
-    float currentTemperature = (float)temp1 / 16;
 
-    // convert from F to C
-    currentTemperature *= 1.8;
-    currentTemperature += 32.0;
-
-    return (currentTemperature);
+    return (tempFromRaw(temp1));
 }
 
 /**************************************************
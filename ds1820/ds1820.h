@@ -16,9 +16,12 @@
 #ifndef DS_1820_
 #define DS_1820_
 
+#include <vector>
+
 #include "ds1820.pio.h"
+#include "../utils/temperature.h"
 
-#define BAD_TEMPERATURE_VALUE   -2000
+#define BAD_TEMPERATURE_VALUE   TEMP_F(-2000)
 
 class ds1820
 {
@@ -27,7 +30,7 @@ public:
     ~ds1820() {}
 
     uint32_t init(PIO p, int pin);
-    float getTemperature() const;
+    temp_t getTemperature() const;
 
 private:
     uint32_t sm;
@@ -6,10 +6,150 @@
  * 
  *******************************************************/
 
+#include "hardware/irq.h"
+#include "hardware/clocks.h"
+#include "hardware/sync.h"
+
 #include "hub75.h"
+#include "hub75.pio.h"
+
+#define PIO_CLK_DIV         4                   // 125MHz / 4 = 31.25MHz PIO clock, ~10MHz pixel clock
+#define BCM_BASE_CYCLES     (uint32_t)8         // PIO clocks the LSB plane is lit, ~0.25us.  Plane n is lit (8 << n)
+#define SHIFT_CYCLES        (uint32_t)(3 * LED_COLS + 3)    // data SM clocks to shift in one row
+#define LATCH_CYCLES        (uint32_t)12        // row SM clocks blanked for address + latch
+#define ON_TIME_BITS        12                  // bits for the on-time in the row control word
+#define OFF_TIME_BITS       13                  // and for the blanked time after it
+#define ON_TIME_MASK        (uint32_t)((1 << ON_TIME_BITS) - 1)
+#define GAMMA               2.2
+#define REFRESH_PERIOD_MS   1000                // how often the measured refresh rate is updated
+#define ALL_ROWS            (uint32_t)(((uint64_t)1 << LED_ROWS) - 1)
+#define ROW_PAIRS(d)        (uint32_t)(((d) | ((d) >> SCAN_ROWS)) & ((1 << SCAN_ROWS) - 1))
+
+// The row SM's out pins run from A0 up to A3; this puts each
+// address bit in the right spot of the control word.  A3 (D)
+// is only wired up on panels with more than 8 row addresses
+#define ROW_ADDR_BITS(r)    (uint32_t)((((r) & 0x01) ? (1 << (LED_A0 - LED_A0)) : 0) | \
+                                       (((r) & 0x02) ? (1 << (LED_A1 - LED_A0)) : 0) | \
+                                       (((r) & 0x04) ? (1 << (LED_A2 - LED_A0)) : 0) | \
+                                       (((r) & 0x08) ? (1 << (LED_A3 - LED_A0)) : 0))
+#define ROW_ADDR_PINS       (LED_A3 - LED_A0 + 1)
+#define ROW_PIN_MASK        (uint32_t)((1 << LED_A0) | (1 << LED_A1) | (1 << LED_A2) | (1 << LED_LATCH) | (1 << LED_OE) | \
+                                       ((SCAN_ROWS > 8) ? (1 << LED_A3) : 0))
+
+// the member functions are all templated on the geometry
+#define HUB75_TEMPLATE      template <uint8_t Rows, uint8_t Cols, uint8_t Chain, uint8_t Scan, uint8_t Depth>
+#define HUB75               hub75<Rows, Cols, Chain, Scan, Depth>
+
+// column bit for one color of one half, in GPIO order
+#define SCAN_BIT(pin)       (uint8_t)(1 << ((pin) - LED_R0))
+#define HALF_SHIFT          (LED_R1 - LED_R0)   // lower half bits sit above the upper half
+#define HALF_MASK           (uint8_t)(SCAN_BIT(LED_R0) | SCAN_BIT(LED_G0) | SCAN_BIT(LED_B0))
+
+static_assert(LED_OE == LED_LATCH + 1, "LATCH and OE are side-set together, must be adjacent");
+static_assert(LED_B1 - LED_R0 == 5, "RGB data pins must be consecutive");
+static_assert(LED_A3 > LED_A2 && LED_A2 > LED_A1 && LED_A1 > LED_A0, "address pins have to go up from A0");
+static_assert(ROW_ADDR_PINS + ON_TIME_BITS + OFF_TIME_BITS == 32, "row control word is address, on-time, blanked time");
+static_assert((BCM_BASE_CYCLES << 7) <= ON_TIME_MASK, "MSB plane on-time doesn't fit the control word");
+static_assert(MAX_COLOR == 15, "gamma table below has one entry per color value");
+
+// counted by the DMA ISR, once per frame
+static volatile uint32_t frameCount = 0;
+static uint frameIrqChan = 0;
+
+static void isrFrameDone();
+
+// colors for each readout_color_t
+static const uint8_t readoutPalette[RC_COUNT][3] = {
+    { PXL_GRN },
+    { PXL_RED },
+    { PXL_BLU },
+    { PXL_YEL }
+};
+
+/*********************************************
+ * gamma table
+ ******************************************** 
+ * LEDs are linear, eyes aren't.  Color values
+ * are COLOR_DEPTH bits and get mapped through
+ * value ^ GAMMA onto SCAN_PLANES bits when
+ * they're packed.  The compiler works the table
+ * out; std::pow() isn't constexpr (not in C++17
+ * either) so it's exp(GAMMA * ln(x)) the long
+ * way round, with x in (0, 1]
+ ********************************************/ 
+#define LN_2                0.69314718055994531
+
+static constexpr double square(double v)
+{
+    return (v * v);
+}
+
+// 2 * atanh(z) series, good enough for x in [0.5, 1]
+static constexpr double lnSeries(double z2, double term, int n)
+{
+    return ((n > 41) ? 0.0 : (term / n) + lnSeries(z2, term * z2, n + 2));
+}
+
+static constexpr double lnZ(double z)
+{
+    return (2.0 * lnSeries(z * z, z, 1));
+}
+
+static constexpr double gammaLn(double x)
+{
+    return ((x < 0.5) ? gammaLn(x * 2.0) - LN_2 : lnZ((x - 1.0) / (x + 1.0)));
+}
+
+// Taylor series, halving until y is small
+static constexpr double expSeries(double y, double term, int n)
+{
+    return ((n > 20) ? term : term + expSeries(y, term * y / n, n + 1));
+}
+
+static constexpr double gammaExp(double y)
+{
+    return ((y < -0.5) ? square(gammaExp(y / 2.0)) : expSeries(y, 1.0, 1));
+}
+
+// anything that isn't off lights at least the LSB plane
+static constexpr double atLeastOne(double v)
+{
+    return ((v < 1.0) ? 1.0 : v);
+}
+
+#define GAMMA_ENTRY(v)      (uint8_t)((v) ? atLeastOne(((1 << Planes) - 1) * \
+                                gammaExp(GAMMA * gammaLn((double)(v) / MAX_COLOR)) + 0.5) : 0)
+
+// one table for each number of planes
+template <uint8_t Planes>
+struct gamma_t
+{
+    static constexpr uint8_t level[MAX_COLOR + 1] = {
+        GAMMA_ENTRY(0),  GAMMA_ENTRY(1),  GAMMA_ENTRY(2),  GAMMA_ENTRY(3),
+        GAMMA_ENTRY(4),  GAMMA_ENTRY(5),  GAMMA_ENTRY(6),  GAMMA_ENTRY(7),
+        GAMMA_ENTRY(8),  GAMMA_ENTRY(9),  GAMMA_ENTRY(10), GAMMA_ENTRY(11),
+        GAMMA_ENTRY(12), GAMMA_ENTRY(13), GAMMA_ENTRY(14), GAMMA_ENTRY(15)
+    };
 
+    static_assert(level[MAX_COLOR] == (1 << Planes) - 1, "full on has to stay full on");
+};
 
-#define SETUP_LED_OUTPUT(x)     { gpio_init(x); gpio_set_dir(x, GPIO_OUT); gpio_put(x, false); }
+template <uint8_t Planes>
+constexpr uint8_t gamma_t<Planes>::level[MAX_COLOR + 1];
+
+/*********************************************
+ * planeBits()
+ ******************************************** 
+ * R G B bits of one bit plane of a pixel, in
+ * upper-half position, after gamma correction
+ ********************************************/ 
+template <uint8_t Planes>
+static inline uint8_t planeBits(pixel& pxl, uint8_t plane)
+{
+    return (uint8_t)((((gamma_t<Planes>::level[pxl.getRed()] >> plane) & 0x01) ? SCAN_BIT(LED_R0) : 0) |
+                     (((gamma_t<Planes>::level[pxl.getGrn()] >> plane) & 0x01) ? SCAN_BIT(LED_G0) : 0) |
+                     (((gamma_t<Planes>::level[pxl.getBlu()] >> plane) & 0x01) ? SCAN_BIT(LED_B0) : 0));
+}
 
 void pixel::makePixel(uint8_t r, uint8_t g, uint8_t b)
 {
@@ -29,8 +169,8 @@ pixel_buff_t pixel::pixelToBuf()
 {
     pixel_buff_t pxl = 0;
     pxl |= (((uint16_t)(red)) & RED_MASK);
-    pxl |= ((((uint16_t)(grn)) >> COLOR_DEPTH) & GRN_MASK);
-    pxl |= ((((uint16_t)(blu)) >> (COLOR_DEPTH * 2)) & BLU_MASK);
+    pxl |= ((((uint16_t)(grn)) << COLOR_DEPTH) & GRN_MASK);
+    pxl |= ((((uint16_t)(blu)) << (COLOR_DEPTH * 2)) & BLU_MASK);
     
     return (pxl);
 }
@@ -42,114 +182,864 @@ void pixel::setRGB(uint8_t r, uint8_t g, uint8_t b)
     blu = b & DEPTH_MASK;
 }
 
-void hub75::init()
+HUB75_TEMPLATE
+void HUB75::init()
 {
-    SETUP_LED_OUTPUT(LED_R0);
-    SETUP_LED_OUTPUT(LED_G0);
-    SETUP_LED_OUTPUT(LED_B0);
-    SETUP_LED_OUTPUT(LED_R1);
-    SETUP_LED_OUTPUT(LED_G1);
-    SETUP_LED_OUTPUT(LED_B1);
-
-    SETUP_LED_OUTPUT(LED_CLK);
-    SETUP_LED_OUTPUT(LED_LATCH);
-    SETUP_LED_OUTPUT(LED_OE)
-
     log = logger::getInstance();
     data = nvm::getInstance();
+    drawCore = get_core_num();
+    wrongCore = 0;
+
+    for (uint16_t row = 0; row < SCAN_ROWS; ++row)
+    {
+        for (uint8_t plane = 0; plane < SCAN_PLANES; ++plane)
+        {
+            canvas.rows[row][plane].colCount = LED_COLS - 1;
+        }
+    }
 
     this->clear();
-    currentCol = 0;
-    currentRow = 0;
+    buildReadoutCache();
+    publishUs = 0;
+    rowsRepacked = 0;
+    lastRowsRepacked = 0;
+    rowsPerSec = 0;
 
-    pixel pxl;
-    pxl.makePixel(0,0,0);
-    std::memset(frameBuffer, pxl.pixelToBuf(), FRAME_BUFFER_SIZE / sizeof(pixel_buff_t));
+    // scan starts on frame 0, drawing goes to frame 1.  The
+    // two that haven't been filled yet are behind on every row
+    std::memcpy(&frames[0], &canvas, sizeof(scan_frame_t));
+    scanFrame = &frames[0];
+    drawFrame = 1;
+    dirtyRows = 0;
+    for (uint8_t ii = 0; ii < SCAN_FRAMES; ++ii)
+    {
+        staleRows[ii] = ii ? ROW_PAIRS(ALL_ROWS) : 0;
+    }
+
+    // row control words only change with brightness
+    setBrightness(data->getBrightness());
+    rowCtrlPtr = rowCtrl;
+
+    view.rows = LED_ROWS;
+    view.cols = LED_COLS;
+    view.scan = SCAN_ROWS;
+    view.planes = SCAN_PLANES;
+    view.addrPins = ROW_ADDR_PINS;
+    view.onBits = ON_TIME_BITS;
+    view.addrBit[0] = LED_A0 - LED_A0;
+    view.addrBit[1] = LED_A1 - LED_A0;
+    view.addrBit[2] = LED_A2 - LED_A0;
+    view.addrBit[3] = LED_A3 - LED_A0;
+    view.pioHz = clock_get_hz(clk_sys) / PIO_CLK_DIV;
+    view.shiftCycles = SHIFT_CYCLES;
+    view.latchCycles = LATCH_CYCLES;
+    view.frame = reinterpret_cast<const void* const volatile*>(&scanFrame);
+    view.rowCtrl = rowCtrl;
+
+    refreshHz = 0;
+    lastFrameCount = 0;
+    refreshTime = make_timeout_time_ms(REFRESH_PERIOD_MS);
+
+    benchReadout();
+
+    initPIO();
+    initDMA();
+
+    DBG_WRITE(log, FMT("hub75::%s() - PIO1 SMs %d/%d, DMA %d/%d/%d/%d\n", __FUNCTION__,
+            dataSm, rowSm, dataChan, dataCtrlChan, rowChan, rowCtrlChan));
+
+    for (uint8_t depth = 1; depth <= SCAN_PLANES; ++depth)
+    {
+        DBG_WRITE(log, FMT("hub75::%s() - %d bit color refreshes at %dHz\n", __FUNCTION__,
+                depth, calcRefreshHz(depth)));
+    }
 }
 
-void hub75::clear()
+/*********************************************
+ * calcRefreshHz()
+ ******************************************** 
+ * what the refresh rate works out to for a
+ * given color depth.  Each bit plane of each
+ * row costs its on-time (or the time to shift
+ * the next one in, if that's longer) plus the
+ * blanked latch time
+ ********************************************/ 
+HUB75_TEMPLATE
+uint32_t HUB75::calcRefreshHz(uint8_t depth)
+{
+    uint32_t rowCycles = 0;
+
+    for (uint8_t plane = 0; plane < depth; ++plane)
+    {
+        uint32_t onCycles = (BCM_BASE_CYCLES << plane) + 1;
+        rowCycles += (onCycles > SHIFT_CYCLES ? onCycles : SHIFT_CYCLES) + LATCH_CYCLES;
+    }
+
+    return ((clock_get_hz(clk_sys) / PIO_CLK_DIV) / (rowCycles * SCAN_ROWS));
+}
+
+/*********************************************
+ * setBrightness()
+ ******************************************** 
+ * build the row control words: address, then
+ * how long the row is lit and how long it stays
+ * blanked after.  The two always add up to the
+ * plane's full weight, so refresh rate doesn't
+ * move with brightness; the DMA just keeps 
+ * feeding these to the row SM
+ ********************************************/ 
+HUB75_TEMPLATE
+void HUB75::setBrightness(uint8_t pct)
+{
+    if (pct < BRIGHTNESS_MIN)       pct = BRIGHTNESS_MIN;
+    if (pct > BRIGHTNESS_MAX)       pct = BRIGHTNESS_MAX;
+
+    brightness = pct;
+
+    for (uint8_t plane = 0; plane < SCAN_PLANES; ++plane)
+    {
+        uint32_t weight = BCM_BASE_CYCLES << plane;
+        uint32_t onCycles = (weight * pct) / BRIGHTNESS_MAX;
+
+        // the lit loop always runs at least once
+        if (!onCycles)
+        {
+            onCycles = 1;
+        }
+
+        uint32_t timing = ((onCycles - 1) << ROW_ADDR_PINS) | 
+                          ((weight - onCycles) << (ROW_ADDR_PINS + ON_TIME_BITS));
+
+        // each word is a single store, the scan can keep
+        // running while these change
+        for (uint16_t row = 0; row < SCAN_ROWS; ++row)
+        {
+            rowCtrl[(row * SCAN_PLANES) + plane] = ROW_ADDR_BITS(row) | timing;
+        }
+    }
+}
+
+/*********************************************
+ * updateRefresh()
+ ******************************************** 
+ * once a second, work out the achieved refresh
+ * rate from the frames counted by the DMA ISR
+ ********************************************/ 
+HUB75_TEMPLATE
+void HUB75::updateRefresh()
+{
+    if (time_reached(refreshTime))
+    {
+        uint32_t frames = frameCount;
+        refreshHz = ((frames - lastFrameCount) * 1000) / REFRESH_PERIOD_MS;
+        lastFrameCount = frames;
+
+        rowsPerSec = ((rowsRepacked - lastRowsRepacked) * 1000) / REFRESH_PERIOD_MS;
+        lastRowsRepacked = rowsRepacked;
+        refreshTime = make_timeout_time_ms(REFRESH_PERIOD_MS);
+    }
+}
+
+/*********************************************
+ * initPIO()
+ ******************************************** 
+ * load both programs into PIO1 (PIO0 is mostly
+ * full with the temperature probe) and set up
+ * the pins.  The SMs start in sync and sit
+ * waiting for data
+ ********************************************/ 
+HUB75_TEMPLATE
+void HUB75::initPIO()
+{
+    pio = pio1;
+
+    uint dataOffset = pio_add_program(pio, &hub75_data_program);
+    uint rowOffset = pio_add_program(pio, &hub75_row_program);
+    dataSm = pio_claim_unused_sm(pio, true);
+    rowSm = pio_claim_unused_sm(pio, true);
+
+    // data SM: RGB on the out pins, clock on side-set
+    for (uint pin = LED_R0; pin <= LED_B1; ++pin)
+    {
+        pio_gpio_init(pio, pin);
+    }
+    pio_gpio_init(pio, LED_CLK);
+    pio_sm_set_consecutive_pindirs(pio, dataSm, LED_R0, LED_B1 - LED_R0 + 1, true);
+    pio_sm_set_consecutive_pindirs(pio, dataSm, LED_CLK, 1, true);
+
+    pio_sm_config c = hub75_data_program_get_default_config(dataOffset);
+    sm_config_set_out_pins(&c, LED_R0, LED_B1 - LED_R0 + 1);
+    sm_config_set_sideset_pins(&c, LED_CLK);
+    sm_config_set_out_shift(&c, true, true, 32);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv_int_frac(&c, PIO_CLK_DIV, 0);
+    pio_sm_init(pio, dataSm, dataOffset, &c);
+
+    // row SM: address on the out pins, latch and OE on side-set.
+    // The out pin range spans A0 to A3; the pins in between
+    // aren't handed to the PIO so they don't get touched.
+    // Start out blanked
+    pio_gpio_init(pio, LED_A0);
+    pio_gpio_init(pio, LED_A1);
+    pio_gpio_init(pio, LED_A2);
+    if (SCAN_ROWS > 8)
+    {
+        pio_gpio_init(pio, LED_A3);
+    }
+    pio_gpio_init(pio, LED_LATCH);
+    pio_gpio_init(pio, LED_OE);
+    pio_sm_set_pins_with_mask(pio, rowSm, (1 << LED_OE), ROW_PIN_MASK);
+    pio_sm_set_pindirs_with_mask(pio, rowSm, ROW_PIN_MASK, ROW_PIN_MASK);
+
+    c = hub75_row_program_get_default_config(rowOffset);
+    sm_config_set_out_pins(&c, LED_A0, ROW_ADDR_PINS);
+    sm_config_set_sideset_pins(&c, LED_LATCH);
+    sm_config_set_out_shift(&c, true, true, 32);
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_TX);
+    sm_config_set_clkdiv_int_frac(&c, PIO_CLK_DIV, 0);
+    pio_sm_init(pio, rowSm, rowOffset, &c);
+
+    pio_enable_sm_mask_in_sync(pio, (1 << dataSm) | (1 << rowSm));
+}
+
+/*********************************************
+ * initDMA()
+ ******************************************** 
+ * Two pairs of channels, one pair per SM.  The
+ * first of each pair streams a frame into the
+ * SM's TX FIFO, then chains to the second, which
+ * writes the frame's address back into the first
+ * one's read-address trigger.  That restarts it,
+ * so the scan runs forever with no CPU.
+ ********************************************/ 
+HUB75_TEMPLATE
+void HUB75::initDMA()
+{
+    dataChan = dma_claim_unused_channel(true);
+    dataCtrlChan = dma_claim_unused_channel(true);
+    rowChan = dma_claim_unused_channel(true);
+    rowCtrlChan = dma_claim_unused_channel(true);
+
+    // pixel data into the data SM
+    dma_channel_config c = dma_channel_get_default_config(dataChan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, dataSm, true));
+    channel_config_set_chain_to(&c, dataCtrlChan);
+    dma_channel_configure(dataChan, &c, &pio->txf[dataSm], NULL,
+            sizeof(scan_frame_t) / sizeof(uint32_t), false);
+
+    // restart the data channel on whatever frame is current
+    c = dma_channel_get_default_config(dataCtrlChan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    dma_channel_configure(dataCtrlChan, &c, &dma_hw->ch[dataChan].al3_read_addr_trig, &scanFrame, 1, false);
+
+    // row control words into the row SM
+    c = dma_channel_get_default_config(rowChan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, rowSm, true));
+    channel_config_set_chain_to(&c, rowCtrlChan);
+    dma_channel_configure(rowChan, &c, &pio->txf[rowSm], NULL, SCAN_ROWS * SCAN_PLANES, false);
+
+    // and restart it
+    c = dma_channel_get_default_config(rowCtrlChan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    dma_channel_configure(rowCtrlChan, &c, &dma_hw->ch[rowChan].al3_read_addr_trig, &rowCtrlPtr, 1, false);
+
+    // the data control channel finishes once per frame, count
+    // those for the refresh rate
+    frameIrqChan = dataCtrlChan;
+    dma_channel_set_irq0_enabled(dataCtrlChan, true);
+    irq_add_shared_handler(DMA_IRQ_0, isrFrameDone, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+
+    // kick both control channels and away it goes
+    dma_start_channel_mask((1 << dataCtrlChan) | (1 << rowCtrlChan));
+}
+
+HUB75_TEMPLATE
+void HUB75::clear()
 {
-    std::memset(frameBuffer, 0, FRAME_BUFFER_SIZE);
     pixel pxl;
-    //pxl.makePixel(PXL_WHT);
-    pxl.makePixel(PXL_RED);
+    pxl.makePixel(PXL_BLK);
     this->fillColor(pxl);
 }
 
-void hub75::fillColor(pixel& pxl)
+/*********************************************
+ * fillColor()
+ ******************************************** 
+ * every pixel the same color, so each plane is
+ * one byte repeated across the row
+ ********************************************/ 
+HUB75_TEMPLATE
+void HUB75::fillColor(pixel& pxl)
+{
+    if (!onDrawCore())
+    {
+        return;
+    }
+
+    for (uint8_t plane = 0; plane < SCAN_PLANES; ++plane)
+    {
+        uint8_t bits = planeBits<SCAN_PLANES>(pxl, plane);
+        bits |= (bits << HALF_SHIFT);
+
+        for (uint16_t row = 0; row < SCAN_ROWS; ++row)
+        {
+            std::memset(canvas.rows[row][plane].cols, bits, LED_COLS);
+        }
+    }
+
+    dirtyRows = ALL_ROWS;
+}
+
+/*********************************************
+ * setPixel()
+ ******************************************** 
+ * set one pixel; it gets split into planes
+ * right here.  Rows 0-7 are the upper half of
+ * each row pair, 8-15 the lower.  Off-panel
+ * coordinates are ignored
+ ********************************************/ 
+HUB75_TEMPLATE
+void HUB75::setPixel(uint16_t x, uint16_t y, pixel& pxl)
+{
+    if (x >= LED_COLS || y >= LED_ROWS || !onDrawCore())
+    {
+        return;
+    }
+
+    dirtyRows |= (1 << y);
+
+    uint8_t shift = 0;
+    if (y >= SCAN_ROWS)
+    {
+        y -= SCAN_ROWS;
+        shift = HALF_SHIFT;
+    }
+
+    for (uint8_t plane = 0; plane < SCAN_PLANES; ++plane)
+    {
+        uint8_t& col = canvas.rows[y][plane].cols[x];
+        col = (uint8_t)((col & ~(HALF_MASK << shift)) | (planeBits<SCAN_PLANES>(pxl, plane) << shift));
+    }
+}
+
+HUB75_TEMPLATE
+void HUB75::setPixel(uint16_t x, uint16_t y, pixel_buff_t p)
+{
+    pixel pxl;
+    pxl.pixelFromBuff(p);
+    this->setPixel(x, y, pxl);
+}
+
+/*********************************************
+ * blitColumn()
+ ******************************************** 
+ * draw one column.  rows has a bit set for each
+ * display row to light (bit 0 is the top), and
+ * planes is the color, split into planes in
+ * upper-half position.  Unset rows are left as
+ * they are
+ ********************************************/ 
+HUB75_TEMPLATE
+void HUB75::blitColumn(int16_t x, uint32_t rows, const uint8_t* planes)
+{
+    rows &= ALL_ROWS;
+    if (x < 0 || x >= LED_COLS || !rows || !onDrawCore())
+    {
+        return;
+    }
+
+    dirtyRows |= rows;
+
+    for (uint16_t row = 0; row < SCAN_ROWS; ++row)
+    {
+        bool upper = rows & (1 << row);
+        bool lower = rows & (1 << (row + SCAN_ROWS));
+        if (!upper && !lower)
+        {
+            continue;
+        }
+
+        uint8_t keep = (uint8_t)~((upper ? HALF_MASK : 0) | (lower ? (HALF_MASK << HALF_SHIFT) : 0));
+
+        for (uint8_t plane = 0; plane < SCAN_PLANES; ++plane)
+        {
+            uint8_t bits = (uint8_t)((upper ? planes[plane] : 0) | (lower ? (planes[plane] << HALF_SHIFT) : 0));
+            uint8_t& col = canvas.rows[row][plane].cols[x];
+            col = (uint8_t)((col & keep) | bits);
+        }
+    }
+}
+
+/*********************************************
+ * glyphSpan()
+ ******************************************** 
+ * find a character's glyph and trim the blank
+ * columns off either side.  Returns a pointer
+ * to the first column that has something in it
+ * and sets width to the number of columns.  A
+ * blank glyph (space) gets the font's space
+ * width
+ ********************************************/ 
+HUB75_TEMPLATE
+const uint8_t* HUB75::glyphSpan(char c, const bm_font_t& font, uint8_t& width)
+{
+    if (c < BM_FONT_FIRST || c > BM_FONT_LAST)
+    {
+        c = BM_FONT_MISSING;
+    }
+
+    const uint8_t* g = font.glyphs + ((c - BM_FONT_FIRST) * font.width);
+
+    uint8_t first = 0;
+    uint8_t last = font.width;
+    while (first < last && !g[first])       ++first;
+    while (last > first && !g[last - 1])    --last;
+
+    if (first == last)
+    {
+        width = font.spaceWidth;
+        return (NULL);
+    }
+
+    width = last - first;
+    return (g + first);
+}
+
+/*********************************************
+ * drawChar()
+ ******************************************** 
+ * one glyph, a column at a time.  Each column
+ * byte shifted down to y is the mask of rows 
+ * to light
+ ********************************************/ 
+HUB75_TEMPLATE
+int16_t HUB75::drawChar(int16_t x, int16_t y, char c, pixel& pxl, const bm_font_t& font)
+{
+    uint8_t width = 0;
+    const uint8_t* g = glyphSpan(c, font, width);
+
+    if (g && y < LED_ROWS && y > -font.height)
+    {
+        uint8_t planes[SCAN_PLANES];
+        for (uint8_t plane = 0; plane < SCAN_PLANES; ++plane)
+        {
+            planes[plane] = planeBits<SCAN_PLANES>(pxl, plane);
+        }
+
+        for (uint8_t ii = 0; ii < width; ++ii)
+        {
+            uint32_t rows = (y >= 0) ? ((uint32_t)g[ii] << y) : ((uint32_t)g[ii] >> -y);
+            blitColumn(x + ii, rows, planes);
+        }
+    }
+
+    // one blank column between glyphs
+    return (x + width + 1);
+}
+
+/*********************************************
+ * drawString()
+ ******************************************** 
+ * stops early once it runs off the right edge
+ ********************************************/ 
+HUB75_TEMPLATE
+int16_t HUB75::drawString(int16_t x, int16_t y, const std::string& s, pixel& pxl, const bm_font_t& font)
 {
-    std::memset(shadowBuffer, pxl.pixelToBuf(), FRAME_BUFFER_SIZE / sizeof(pixel_buff_t));
+    std::string::const_iterator cit = s.begin();
+    while (cit != s.end() && x < LED_COLS)
+    {
+        x = drawChar(x, y, *cit, pxl, font);
+        ++cit;
+    }
+
+    return (x);
 }
 
-#define DLAY   100
+/*********************************************
+ * stringWidth()
+ ******************************************** 
+ * columns a string takes up, not counting the
+ * gap after the last glyph
+ ********************************************/ 
+HUB75_TEMPLATE
+int16_t HUB75::stringWidth(const std::string& s, const bm_font_t& font)
+{
+    int16_t width = 0;
+
+    std::string::const_iterator cit = s.begin();
+    while (cit != s.end())
+    {
+        uint8_t w = 0;
+        glyphSpan(*cit, font, w);
+        width += w + 1;
+        ++cit;
+    }
+
+    return (width ? width - 1 : 0);
+}
 
-void hub75::update()
+/*********************************************
+ * buildReadoutCache()
+ ******************************************** 
+ * split every readout glyph into planes, in
+ * every readout color, once.  Cells are blank
+ * where the glyph is, so a strip copy fully
+ * replaces whatever was in the cell
+ ********************************************/ 
+HUB75_TEMPLATE
+void HUB75::buildReadoutCache()
 {
-    for (uint16_t thisCol = 0; thisCol < LED_COLS; ++ thisCol)
+    std::memset(readoutCache, 0, sizeof(readoutCache));
+
+    for (uint8_t color = 0; color < RC_COUNT; ++color)
     {
         pixel pxl;
+        pxl.makePixel(readoutPalette[color][0], readoutPalette[color][1], readoutPalette[color][2]);
 
-        // make sure clock is low
-        gpio_put(LED_CLK, false);   
+        for (uint8_t glyph = 0; glyph < READOUT_GLYPHS; ++glyph)
+        {
+            const uint8_t* g = bmFont5x7.glyphs + ((READOUT_CHARS[glyph] - BM_FONT_FIRST) * bmFont5x7.width);
 
-        // upper row
-        pxl.pixelFromBuff(frameBuffer[currentRow][thisCol]);
+            for (uint8_t col = 0; col < bmFont5x7.width && col < READOUT_CELL_W; ++col)
+            {
+                for (uint8_t row = 0; row < READOUT_CELL_H; ++row)
+                {
+                    if (!(g[col] & (1 << row)))
+                    {
+                        continue;
+                    }
 
-        if (pxl.getRed())       gpio_put(LED_R0, true);
-        else                    gpio_put(LED_R0, false);
+                    for (uint8_t plane = 0; plane < SCAN_PLANES; ++plane)
+                    {
+                        readoutCache[color][glyph][row][plane][col] = planeBits<SCAN_PLANES>(pxl, plane);
+                    }
+                }
+            }
+        }
+    }
+}
 
-        if (pxl.getGrn())       gpio_put(LED_G0, true);
-        else                    gpio_put(LED_G0, false);
+/*********************************************
+ * initReadout()
+ ******************************************** 
+ * set up a readout field and blank it.  Fails
+ * if any of it would be off the panel or it
+ * would straddle the two halves
+ ********************************************/ 
+HUB75_TEMPLATE
+bool HUB75::initReadout(readout_t& r, int16_t x, int16_t y, uint8_t cells, readout_color_t color)
+{
+    if (x < 0 || x + (cells * READOUT_CELL_W) > LED_COLS ||
+        y < 0 || y + READOUT_CELL_H > LED_ROWS ||
+        (y % SCAN_ROWS) + READOUT_CELL_H > SCAN_ROWS || cells > READOUT_MAX_CELLS)
+    {
+        log->errWrite(FMT("hub75::%s() - bad field at %d,%d\n", __FUNCTION__, x, y));
+        r.cells = 0;
+        return (false);
+    }
 
-        if (pxl.getBlu())       gpio_put(LED_B0, true);
-        else                    gpio_put(LED_B0, false);
+    r.x = x;
+    r.y = y;
+    r.cells = cells;
+    r.color = color;
 
-        // lower row
-        pxl.pixelFromBuff(frameBuffer[currentRow + (LED_ROWS / 2)][thisCol]);
+    for (uint8_t cell = 0; cell < cells; ++cell)
+    {
+        r.shown[cell] = ' ';
+        drawReadoutCell(r, cell, ' ');
+    }
 
-        if (pxl.getRed())       gpio_put(LED_R1, true);
-        else                    gpio_put(LED_R1, false);
+    return (true);
+}
+
+/*********************************************
+ * drawReadoutCell()
+ ******************************************** 
+ * copy one cached strip into the canvas.  Only
+ * the half of each row pair the field sits in
+ * gets touched.  initReadout() already made
+ * sure the whole field is on the panel
+ ********************************************/ 
+HUB75_TEMPLATE
+void HUB75::drawReadoutCell(const readout_t& r, uint8_t cell, char c)
+{
+    const char* found = std::strchr(READOUT_CHARS, c);
+    uint8_t glyph = (found && c) ? (uint8_t)(found - READOUT_CHARS) : READOUT_GLYPHS - 1;
 
-        if (pxl.getGrn())       gpio_put(LED_G1, true);
-        else                    gpio_put(LED_G1, false);
+    uint8_t shift = (r.y >= SCAN_ROWS) ? HALF_SHIFT : 0;
+    uint8_t keep = (uint8_t)~(HALF_MASK << shift);
+    uint16_t firstRow = r.y % SCAN_ROWS;
+    int16_t x = r.x + (cell * READOUT_CELL_W);
 
-        if (pxl.getBlu())       gpio_put(LED_B1, true);
-        else                    gpio_put(LED_B1, false);
+    for (uint8_t row = 0; row < READOUT_CELL_H; ++row)
+    {
+        for (uint8_t plane = 0; plane < SCAN_PLANES; ++plane)
+        {
+            const uint8_t* strip = readoutCache[r.color][glyph][row][plane];
+            uint8_t* cols = canvas.rows[firstRow + row][plane].cols;
 
-        // assert the clock and delay
-        gpio_put(LED_CLK, true);
-        sleep_us(DLAY);
+            for (uint8_t col = 0; col < READOUT_CELL_W; ++col)
+            {
+                cols[x + col] = (uint8_t)((cols[x + col] & keep) | (strip[col] << shift));
+            }
+        }
     }
-    
-    // final drop of clock + delay
-    gpio_put(LED_CLK, false);
-    sleep_us(DLAY);
 
-    // set the address lines
-    gpio_put(LED_A0, (currentRow & 0x01));
-    gpio_put(LED_A1, (currentRow & 0x02));
-    gpio_put(LED_A2, (currentRow & 0x04));
+    dirtyRows |= (((1 << READOUT_CELL_H) - 1) << r.y);
+}
 
-    // blank the display
-    gpio_put(LED_OE, true);
-    sleep_us(DLAY);
+/*********************************************
+ * drawReadout()
+ ******************************************** 
+ * put new text in a readout, right-aligned.
+ * Cells that already show the right thing are
+ * skipped; a color change redraws them all
+ ********************************************/ 
+HUB75_TEMPLATE
+void HUB75::drawReadout(readout_t& r, const std::string& text, readout_color_t color)
+{
+    if (!onDrawCore())
+    {
+        return;
+    }
+
+    uint32_t start = time_us_32();
+
+    bool recolor = (color != r.color);
+    r.color = color;
+
+    size_t len = text.length();
+    for (uint8_t cell = 0; cell < r.cells; ++cell)
+    {
+        // right-align; pad on the left with blanks
+        size_t pad = r.cells - cell;
+        char c = (pad <= len) ? text[len - pad] : ' ';
+
+        if (recolor || r.shown[cell] != c)
+        {
+            drawReadoutCell(r, cell, c);
+            r.shown[cell] = c;
+        }
+    }
+
+    readoutUs = time_us_32() - start;
+}
+
+/*********************************************
+ * benchReadout()
+ ******************************************** 
+ * time a full readout from the cache against 
+ * the same thing drawn cold with drawString(), 
+ * and a one-digit change.  Done once at init,
+ * before anything is on the panel
+ ********************************************/ 
+HUB75_TEMPLATE
+void HUB75::benchReadout()
+{
+    readout_t r;
+    pixel pxl;
+    pxl.makePixel(PXL_GRN);
+
+    uint32_t start = time_us_32();
+    drawString(0, 0, "88.8F", pxl);
+    uint32_t coldUs = time_us_32() - start;
+
+    initReadout(r, 0, 0, 5, RC_NORMAL);
+    drawReadout(r, "88.8F", RC_COOL);
+    uint32_t fullUs = readoutUs;
+    drawReadout(r, "88.9F", RC_COOL);
+    uint32_t digitUs = readoutUs;
 
-    // latch the data (from shift register to actual output buffer on board)
-    gpio_put(LED_LATCH, true);
-    sleep_us(DLAY);
+    DBG_WRITE(log, FMT("hub75::%s() - readout cold %dus, cached %dus, one digit %dus\n", __FUNCTION__,
+            coldUs, fullUs, digitUs));
 
-    // allow display to display the new line
-    gpio_put(LED_LATCH, false);
-    gpio_put(LED_OE, false);
+    this->clear();
+}
+
+/*********************************************
+ * scanningFrame()
+ ******************************************** 
+ * which frame the DMA is reading right now, 
+ * going by the data channel's read address.
+ * The frames sit end to end, so the address
+ * alone can't tell the end of one from the
+ * start of the next, and between frames the 
+ * data channel sits finished on the old frame
+ * while the control channel loads the next.
+ * So the read address only counts if the
+ * transfer count around it shows the channel
+ * partway through a frame, with words left and
+ * not restarted; then it's inside the frame 
+ * being read.  Anything else is the gap
+ * between frames, a few DMA cycles, and gets
+ * read again.  SCAN_FRAMES if the scan hasn't
+ * started
+ ********************************************/ 
+HUB75_TEMPLATE
+uint8_t HUB75::scanningFrame()
+{
+    uint32_t before;
+    uint32_t after;
+    uintptr_t rd;
 
-    // increment row for next update
-    ++currentRow;
-    currentRow %= (LED_ROWS / 2);
+    do
+    {
+        before = dma_hw->ch[dataChan].transfer_count;
+        rd = (uintptr_t)dma_hw->ch[dataChan].read_addr;
+        after = dma_hw->ch[dataChan].transfer_count;
+    } while (!after || after > before);
 
-    // if we wrapped around to the top, copy the shadow buffer to 
-    // framebuffer for no flickery crap
-    if (!currentRow)
+    for (uint8_t ii = 0; ii < SCAN_FRAMES; ++ii)
     {
-        std::memcpy((void*)frameBuffer, (void*)shadowBuffer, FRAME_BUFFER_SIZE);
+        uintptr_t start = (uintptr_t)&frames[ii];
+        if (rd >= start && rd < start + sizeof(scan_frame_t))
+        {
+            return (ii);
+        }
     }
-}
\ No newline at end of file
+
+    return (SCAN_FRAMES);
+}
+
+/*********************************************
+ * onDrawCore()
+ ******************************************** 
+ * true on the core that ran init().  Anywhere
+ * else it counts the call in wrongCore, says so
+ * the first time, and the caller does nothing.
+ * One SIO register read, so it's cheap enough
+ * for every pixel
+ ********************************************/ 
+HUB75_TEMPLATE
+bool HUB75::onDrawCore()
+{
+    if (get_core_num() == drawCore)
+    {
+        return (true);
+    }
+
+    if (!wrongCore++)
+    {
+        log->errWrite(FMT("hub75::%s() - drawing is on core %d, not %d\n", __FUNCTION__, drawCore, get_core_num()));
+    }
+
+    return (false);
+}
+
+/*********************************************
+ * update()
+ ******************************************** 
+ * Publish the canvas, if anything was drawn
+ * since last time.  Triple buffered, no locks:
+ *   - copy the changed row pairs of the canvas 
+ *     into the draw frame.  No one else ever 
+ *     touches that one
+ *   - point scanFrame at it.  The DMA picks it
+ *     up at the start of its next frame, so the
+ *     newest finished frame always wins
+ *   - the next draw frame is whichever of the
+ *     three is neither just published nor being
+ *     read by the DMA right now.  The DMA only
+ *     ever moves to scanFrame, so that one stays
+ *     free until the next publish.  A frame the
+ *     control channel has already picked up
+ *     shows as the one being read, see 
+ *     scanningFrame()
+ * Drawing and publishing share dirtyRows, 
+ * staleRows and the canvas with no lock, so 
+ * both belong to the core that ran init().
+ * A call from the other core is dropped, see
+ * onDrawCore()
+ ********************************************/ 
+HUB75_TEMPLATE
+void HUB75::update()
+{
+    if (!onDrawCore())
+    {
+        return;
+    }
+
+    updateRefresh();
+
+    // nothing new, nothing to copy
+    if (!dirtyRows)
+    {
+        return;
+    }
+
+    uint32_t start = time_us_32();
+
+    // every frame is now behind on the dirty row pairs
+    uint32_t pairs = ROW_PAIRS(dirtyRows);
+    dirtyRows = 0;
+    for (uint8_t ii = 0; ii < SCAN_FRAMES; ++ii)
+    {
+        staleRows[ii] |= pairs;
+    }
+
+    // bring the draw frame up to date, one row pair (all 
+    // planes) at a time
+    scan_frame_t& frame = frames[drawFrame];
+    for (uint16_t row = 0; row < SCAN_ROWS; ++row)
+    {
+        if (staleRows[drawFrame] & (1 << row))
+        {
+            std::memcpy(frame.rows[row], canvas.rows[row], sizeof(frame.rows[row]));
+            ++rowsRepacked;
+        }
+    }
+    staleRows[drawFrame] = 0;
+
+    uint8_t published = drawFrame;
+    __dmb();
+    scanFrame = &frames[published];
+    __dmb();
+
+    uint8_t busy = scanningFrame();
+    drawFrame = (published + 1) % SCAN_FRAMES;
+    if (drawFrame == busy)
+    {
+        drawFrame = (drawFrame + 1) % SCAN_FRAMES;
+    }
+
+    publishUs = time_us_32() - start;
+}
+
+/*********************************************
+ * isrFrameDone()
+ ******************************************** 
+ * DMA IRQ 0 (shared), fires each time the data
+ * control channel restarts the scan
+ ********************************************/ 
+static void isrFrameDone()
+{
+    if (dma_channel_get_irq0_status(frameIrqChan))
+    {
+        dma_channel_acknowledge_irq0(frameIrqChan);
+        ++frameCount;
+    }
+}
+
+// constexpr members still need a definition somewhere
+HUB75_TEMPLATE constexpr uint16_t HUB75::LED_ROWS;
+HUB75_TEMPLATE constexpr uint16_t HUB75::LED_COLS;
+HUB75_TEMPLATE constexpr uint16_t HUB75::SCAN_ROWS;
+HUB75_TEMPLATE constexpr uint8_t HUB75::SCAN_PLANES;
+
+// Every geometry that gets built.  The extras are here so
+// they keep compiling as the code changes; the linker drops
+// whatever isn't used, so they cost nothing in the image
+template class hub75<16, 32, 1, 8, 8>;     // this project, see panel_t
+template class hub75<16, 32, 2, 8, 8>;     // two of them chained
+template class hub75<32, 64, 1, 16, 8>;    // 32x64, 1/16 scan
+template class hub75<16, 32, 1, 8, 4>;     // fastest refresh, but gamma squashes the low colors
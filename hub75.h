@@ -5,9 +5,13 @@
  * December 2021, M.Brugman
  * 
  *******************************************************/
+#ifndef HUB75_H_
+#define HUB75_H_
 
 #include "pico/stdlib.h"
 #include "pico/multicore.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
 
 #include "project.h"
 #include "./ipc/mlogger.h"
@@ -18,24 +22,26 @@
 // pixels are stuffed into a 16-bit integer, as defined below
 typedef uint16_t pixel_buff_t;
 
-#define LED_ROWS            16                          // rows in the display
-#define LED_COLS            32                          // columns in each row
-#define COLOR_DEPTH         4                           // color depth in bits
+#define COLOR_DEPTH         4                           // color depth in bits, as drawn
 #define MAX_COLOR           ((1 << COLOR_DEPTH) - 1)    // maximum color value
 #define DEPTH_MASK          0x000f                      // color bitmask of one nibble
 #define RED_MASK            0x000f                      // low byte, low nibble for red color value
 #define GRN_MASK            0x00f0                      // low byte, high nibble for green value
 #define BLU_MASK            0x0f00                      // high byte, low nibble for blue...
 #define COLOR_MASK          (RED_MASK | GRN_MASK | BLU_MASK)
-#define FRAME_BUFFER_SIZE   (size_t)(LED_ROWS * LED_COLS * sizeof(pixel_buff_t))
+#define SCAN_FRAMES         3                           // triple buffered; scanning, next, drawing
+#define BRIGHTNESS_MIN      5                           // percent; any lower and it's just off
+#define BRIGHTNESS_MAX      100
+#define BRIGHTNESS_STEP     10                          // per key press
+#define BRIGHTNESS_SAVE_MS  5000                        // hold off the nvm save until it settles
 
 // basic color definitions
-#define PXL_BLK             (0, 0, 0)
+#define PXL_BLK             0, 0, 0
 #define PXL_RED             MAX_COLOR, 0, 0
 #define PXL_GRN             0, MAX_COLOR, 0
 #define PXL_BLU             0, 0, MAX_COLOR
 #define PXL_YEL             MAX_COLOR, MAX_COLOR, 0
-#define PXL_CYA             0, (MAX_COLOR, MAX_COLOR
+#define PXL_CYA             0, MAX_COLOR, MAX_COLOR
 #define PXL_PUR             MAX_COLOR, 0, MAX_COLOR
 #define PXL_WHT             MAX_COLOR, MAX_COLOR, MAX_COLOR
 
@@ -66,27 +72,216 @@ private:
     uint8_t blu;
 };
 
-// Class to handle an LED Matrix using the Hub75 protocol
-// in this case, it's a fixed 16 by 32 array
+// Live readouts (temperature, setpoint) are fixed-width
+// fields in the 5x7 font, drawn from a cache of glyph
+// strips that are already split into planes.  Only these
+// characters are cached; anything else shows as a blank
+#define READOUT_CHARS       "0123456789.-FC "
+#define READOUT_GLYPHS      (sizeof(READOUT_CHARS) - 1)
+#define READOUT_CELL_W      6                           // 5 glyph columns and a gap
+#define READOUT_CELL_H      7
+#define READOUT_MAX_CELLS   8
+
+enum readout_color_t
+{
+    RC_NORMAL = 0,          // green
+    RC_WARM,                // red
+    RC_COOL,                // blue
+    RC_SETPOINT,            // yellow
+    RC_COUNT
+};
+
+// one readout field on the panel.  It has to sit in one
+// half of the panel (rows 0-7 or 8-15 on a 16 row panel) so
+// the cached strips line up with the row pairs
+struct readout_t
+{
+    int16_t x;
+    int16_t y;
+    uint8_t cells;
+    readout_color_t color;
+    char shown[READOUT_MAX_CELLS];      // what's on the panel now
+};
+
+// Where the scan lives and how to read it, without needing
+// to know the template parameters.  Core 1 uses this to dump
+// what the panel is showing over the net (see pull.py --frame).
+// The frame is rows[scan][planes], each row a column count
+// word then a byte per column
+struct scan_view_t
+{
+    uint16_t rows;
+    uint16_t cols;
+    uint16_t scan;
+    uint8_t planes;
+    uint8_t addrPins;               // row control word: address bits
+    uint8_t onBits;                 // then on-time, then blanked time
+    uint8_t addrBit[4];             // control word bit for A, B, C, D
+    uint32_t pioHz;                 // PIO clock
+    uint16_t shiftCycles;           // PIO clocks to shift one row in
+    uint16_t latchCycles;           // PIO clocks blanked for each latch
+    const void* const volatile* frame;  // the frame being scanned
+    const uint32_t* rowCtrl;        // row control words, [scan][planes]
+};
+
+// Class to handle LED Matrix panels using the Hub75 protocol.
+// The geometry is all template parameters so every buffer
+// and loop is sized at compile time:
+//
+//  Rows  - rows on the panel
+//  Cols  - columns on one panel
+//  Chain - panels chained together; they're driven as one
+//          panel that's (Cols * Chain) wide, the first column
+//          shifted out is column 0
+//  Scan  - row addresses, the panel lights row n and row
+//          (n + Scan) together (1/8 scan on 16 rows is 8)
+//  Depth - bit planes scanned out.  Colors are COLOR_DEPTH
+//          bits when drawn and gamma corrected onto this
+//          many planes
+//
+// The scan is done by PIO state machines fed by DMA, the CPU
+// only builds a frame and hands it over.  Color depth is done
+// with binary code modulation; bit plane n of each row is
+// lit for (base time << n).  The code lives in hub75.cpp, 
+// with explicit instantiations at the bottom for each 
+// geometry that gets built
+template <uint8_t Rows, uint8_t Cols, uint8_t Chain, uint8_t Scan, uint8_t Depth>
 class hub75
 {
 public:
+    static constexpr uint16_t LED_ROWS = Rows;
+    static constexpr uint16_t LED_COLS = Cols * Chain;  // columns shifted out per row
+    static constexpr uint16_t SCAN_ROWS = Scan;         // row pairs, upper and lower half shift together
+    static constexpr uint8_t SCAN_PLANES = Depth;
+
+    static_assert(Rows == Scan * 2, "only panels that light one row in each half at a time");
+    static_assert((Scan & (Scan - 1)) == 0 && Scan <= 16, "row address is A/B/C/D, scan has to be 2 to 16");
+    static_assert(Rows <= 32, "dirty row bitmap is one word");
+    static_assert((LED_COLS % sizeof(uint32_t)) == 0, "DMA moves whole words, columns must be a multiple of 4");
+    static_assert(Depth >= COLOR_DEPTH && Depth <= 8, "need at least as many planes as color bits, at most 8");
+    static_assert(Scan >= READOUT_CELL_H, "readouts have to fit in one half of the panel");
+
+    // One row pair the way the PIO wants to see it: a word
+    // with the number of columns (minus one), then a byte per
+    // column with R0 G0 B0 R1 G1 B1 in bits 0-5, the same
+    // order as the GPIO pins.  This is also the drawing format;
+    // colors get split into planes when they're drawn, not
+    // when they're scanned
+    struct scan_row_t
+    {
+        uint32_t colCount;
+        uint8_t  cols[LED_COLS];
+    };
+
+    // a full frame that the DMA streams into the PIO.  Each row
+    // pair is shifted out once per bit plane (binary code
+    // modulation), LSB plane first
+    struct scan_frame_t
+    {
+        scan_row_t rows[SCAN_ROWS][SCAN_PLANES];
+    };
+
     hub75() {}
     ~hub75() {}
 
     void init();
     void clear();
     void fillColor(pixel& pxl);
+    void setPixel(uint16_t x, uint16_t y, pixel& pxl);
+    void setPixel(uint16_t x, uint16_t y, pixel_buff_t p);
+
+    // text.  x and y are the top left of the first glyph and
+    // can be off the panel, whatever doesn't fit is clipped.
+    // Spacing is proportional.  Both return the x where the 
+    // next glyph would go
+    int16_t drawChar(int16_t x, int16_t y, char c, pixel& pxl, const bm_font_t& font = bmFont5x7);
+    int16_t drawString(int16_t x, int16_t y, const std::string& s, pixel& pxl, const bm_font_t& font = bmFont5x7);
+    static int16_t stringWidth(const std::string& s, const bm_font_t& font = bmFont5x7);
+
+    // cached readouts.  The text is right-aligned in the field,
+    // and only the cells that changed get rewritten
+    bool initReadout(readout_t& r, int16_t x, int16_t y, uint8_t cells, readout_color_t color);
+    void drawReadout(readout_t& r, const std::string& text, readout_color_t color);
+    uint32_t getReadoutUs()             { return (readoutUs); }
 
     void update();
+    uint32_t getPublishUs()             { return (publishUs); }
+    uint32_t getWrongCore()             { return (wrongCore); }
+    uint32_t getRowsPerSec()            { return (rowsPerSec); }
+
+    uint32_t getRefreshHz()             { return (refreshHz); }
+    static uint32_t calcRefreshHz(uint8_t depth);
+
+    // global brightness in percent.  This only scales the
+    // OE on-time of each row, nothing gets repacked
+    void setBrightness(uint8_t pct);
+    uint8_t getBrightness()             { return (brightness); }
+
+    const scan_view_t* getScanView()    { return (&view); }
 
 private:
-    uint16_t currentRow;
-    uint16_t currentCol;
+    void initPIO();
+    void initDMA();
+    void updateRefresh();
+    void blitColumn(int16_t x, uint32_t rows, const uint8_t* planes);
+    static const uint8_t* glyphSpan(char c, const bm_font_t& font, uint8_t& width);
+    void buildReadoutCache();
+    void drawReadoutCell(const readout_t& r, uint8_t cell, char c);
+    void benchReadout();
+    uint8_t scanningFrame();
+    bool onDrawCore();
 
     logger* log;
     nvm* data;
 
-    pixel_buff_t frameBuffer[LED_ROWS][LED_COLS * sizeof(pixel_buff_t)];
-    pixel_buff_t shadowBuffer[LED_ROWS][LED_COLS * sizeof(pixel_buff_t)];
+    PIO pio;
+    uint dataSm;
+    uint rowSm;
+    uint dataChan;
+    uint dataCtrlChan;
+    uint rowChan;
+    uint rowCtrlChan;
+
+    // the DMA control channels read these to restart
+    // each frame, so a new frame is picked up on the
+    // next frame boundary just by changing the pointer.
+    // That one word store is the whole page flip
+    const scan_frame_t* volatile scanFrame;
+    const uint32_t* rowCtrlPtr;
+
+    uint8_t drawFrame;
+    scan_frame_t frames[SCAN_FRAMES];
+    uint32_t rowCtrl[SCAN_ROWS * SCAN_PLANES];
+    uint8_t brightness;
+    scan_view_t view;
+
+    // drawing happens here, already packed.  Every drawing
+    // primitive sets the bit for each display row it touches
+    // in dirtyRows.  On publish those get folded into the 
+    // row pairs each frame is behind on, and only the row
+    // pairs the draw frame is behind on get copied.
+    // None of it is shared between cores, so drawing and
+    // publishing both belong to the core that ran init()
+    scan_frame_t canvas;
+    uint drawCore;
+    uint32_t wrongCore;
+    uint32_t dirtyRows;
+    uint32_t staleRows[SCAN_FRAMES];
+    uint32_t publishUs;
+    uint32_t rowsRepacked;
+    uint32_t lastRowsRepacked;
+    uint32_t rowsPerSec;
+
+    // [color][glyph][row][plane][column], upper-half bit position
+    uint8_t readoutCache[RC_COUNT][READOUT_GLYPHS][READOUT_CELL_H][SCAN_PLANES][READOUT_CELL_W];
+    uint32_t readoutUs;
+
+    uint32_t refreshHz;
+    uint32_t lastFrameCount;
+    absolute_time_t refreshTime;
 };
+
+// the panel on this project; one 16x32, 1/8 scan
+typedef hub75<16, 32, 1, 8, 8> panel_t;
+
+#endif // HUB75_H_
@@ -0,0 +1,78 @@
+/********************************************************
+ * histogram.h
+ ********************************************************
+ * Cheap power-of-two histogram for timings; adding a
+ * sample is a count-leading-zeros and two increments,
+ * cheap enough to leave in everywhere.  Bucket 0 is 0,
+ * bucket n is 2^(n-1) to 2^n - 1, and the last bucket
+ * takes everything past that.  Units are whatever the
+ * caller puts in.
+ *
+ * Plain data, no constructor; clear it with reset() or
+ * memset() along with whatever it lives in.  Only one
+ * core should add to any one of them
+ *
+ *******************************************************/
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+#include <cstring>
+
+#include "pico/stdlib.h"
+
+#define HIST_BUCKETS        12      // last one is 1024 and up
+
+class histogram
+{
+public:
+    void reset()                                { std::memset(this, 0, sizeof(*this)); }
+
+    void add(uint32_t v)
+    {
+        uint8_t b = v ? (uint8_t)(32 - __builtin_clz(v)) : 0;
+        if (b >= HIST_BUCKETS)
+        {
+            b = HIST_BUCKETS - 1;
+        }
+
+        ++bins[b];
+        ++samples;
+        if (v > maxVal)
+        {
+            maxVal = v;
+        }
+    }
+
+    uint32_t count() const                      { return (samples); }
+    uint32_t max() const                        { return (maxVal); }
+    uint32_t bin(uint8_t b) const               { return ((b < HIST_BUCKETS) ? bins[b] : 0); }
+
+    // lowest value that lands in bucket b
+    static uint32_t binFloor(uint8_t b)         { return (b ? (1UL << (b - 1)) : 0); }
+
+    // upper edge of the bucket the pct'th percentile
+    // falls in; rough, but that's what buckets are
+    uint32_t percentile(uint8_t pct) const
+    {
+        uint32_t want = (uint32_t)(((uint64_t)samples * pct + 99) / 100);
+        uint32_t seen = 0;
+
+        for (uint8_t b = 0; b < HIST_BUCKETS - 1; ++b)
+        {
+            seen += bins[b];
+            if (seen >= want)
+            {
+                return (binFloor(b + 1));
+            }
+        }
+
+        return (maxVal);
+    }
+
+private:
+    uint32_t bins[HIST_BUCKETS];
+    uint32_t samples;
+    uint32_t maxVal;
+};
+
+#endif // HISTOGRAM_H_
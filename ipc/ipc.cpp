@@ -11,101 +11,541 @@
  * 
  *******************************************************/
 
+#include <cstring>
+#include <type_traits>
+
 #include "ipc.h"
-#include "pico/mutex.h"
+#include "hardware/sync.h"
 #include "../utils/stringFormat.h"
 #include "mlogger.h"
+#include "spsc.h"
+
+// one generation counter per US_* bit
+#define IC_FIELDS           6
+#define FIELD(bit)          __builtin_ctz(bit)
+
+// the big fields; counted separately since the scan table
+// is most of the struct
+#define BULK_FIELDS         (US_IP_ADDR | US_MAC_ADDR | US_SCAN_DATA)
+
+#define CMD_QUEUE_SIZE      8               // so up to 7 commands in flight
+
+static_assert((1 << (IC_FIELDS - 1)) == US_SCAN_VIEW, "IC_FIELDS has to cover every US_* bit");
+static_assert(std::is_trivially_copyable<inter_core_t>::value, "inter_core_t has to stay off the heap");
+
+// for the writes per second, one per US_* bit
+static const char* fieldNames[IC_FIELDS] = 
+{
+    "core1Ready", "ipAddress", "macAddress", "scanResult", "brightness", "scanView"
+};
 
-// the data structure is copied here, probably unnecessary, but
-// provides reliable data integrity
+// The shared copy.  It's guarded by a seqlock: a writer
+// bumps seq to odd, writes, bumps it to even again.
+// Readers never block; they copy and try again if seq moved
+// underneath them.  Writers are kept apart by a hardware 
+// spinlock that is only held for the writes.
+// Every field has a generation that moves when it's written,
+// so each core only copies what changed since it last looked
 static inter_core_t icData;
-static mutex_t mtx;
+static spin_lock_t* writeLock = NULL;
+static volatile uint32_t seq = 0;
+static volatile uint32_t gen[IC_FIELDS];
+static uint32_t seen[2][IC_FIELDS];
+static ipc_stats_t stats[2];
+static uint32_t lastGen[IC_FIELDS];         // generations at the last stats dump
+static uint32_t statsSince;                 // and when that was
 static logger* log = NULL;
 
+// core 0 to core 1, and back
+static spscQueue<ipc_request_t, CMD_QUEUE_SIZE> requests;
+static spscQueue<ipc_response_t, CMD_QUEUE_SIZE> responses;
+static uint16_t nextId = 1;
+static uint16_t inFlight = 0;               // core 0 only; posted and not answered
+static ipc_latency_t latency[IS_CMD_COUNT];
+
+// set by the other core right before it does a __sev()
+static volatile bool doorbell[2] = { false, false };
+static idle_stats_t idle[2];
+static uint32_t idleSince[2];
+
 /*******************************************************
  * copyIPC()
  *******************************************************
- * copy one structure to another.  Using some STL 
- * strings and std::vectors, so don't do a std::memcpy()
+ * copy one structure to another.  It's all inline
+ * now, so this is just an assignment
  ******************************************************/
-void copyIPC(const inter_core_t src, inter_core_t& dst)
+void copyIPC(const inter_core_t& src, inter_core_t& dst)
 {
-    dst.core1Ready      = src.core1Ready;
-    dst.wifiConnected   = src.wifiConnected;
-    dst.clockReady      = src.clockReady;
-    dst.temperatue      = src.temperatue;
-    dst.tempCount       = src.tempCount;
-    dst.ipAddress       = src.ipAddress;
-    dst.macAddress      = src.macAddress;
-    dst.scanResult      = src.scanResult;
-    dst.cmd             = src.cmd;
-    dst.ack             = src.ack;
+    dst = src;
 }
 
 /*******************************************************
  * initIPC()
  *******************************************************
- * initialize the IPC chingus, including init'ing the
- * mutex
+ * initialize the IPC chingus, including claiming the
+ * writers' spinlock.  Call it before core 1 starts
  ******************************************************/
 bool initIPC(void)
 {
+    std::memset(&icData, 0, sizeof(icData));
     icData.core1Ready = false;
-    icData.wifiConnected = false;
-    icData.clockReady = false;
-    icData.temperatue = 0.0;
-    icData.tempCount = 0;
-    icData.cmd = IS_NO_CMD;
-    icData.ack = IS_NO_CMD;
+    icData.brightCount = 0;
+    icData.brightness = 0;
+    icData.scanView = NULL;
+
+    // everything starts one generation ahead of both
+    // cores so the first update copies it all out
+    for (uint8_t ii = 0; ii < IC_FIELDS; ++ii)
+    {
+        gen[ii] = 1;
+        lastGen[ii] = 1;
+        seen[0][ii] = 0;
+        seen[1][ii] = 0;
+    }
 
-    mutex_init(&mtx);
+    std::memset(stats, 0, sizeof(stats));
+    std::memset(latency, 0, sizeof(latency));
+    std::memset(idle, 0, sizeof(idle));
+    idleSince[0] = idleSince[1] = time_us_32();
+    statsSince = idleSince[0];
+
+    writeLock = spin_lock_instance(spin_lock_claim_unused(true));
 
     log = logger::getInstance();
 
-    return (mutex_is_initialized(&mtx));
+    return (writeLock != NULL);
+}
+
+/*******************************************************
+ * writeFields()
+ *******************************************************
+ * copy the flagged fields in.  Returns with this core's
+ * seen generations up to date for what it wrote, since
+ * its own copy already has it.  The lock wait and hold
+ * times are kept while it's still held, so nothing else
+ * writes them
+ ******************************************************/
+static void writeFields(uint16_t t, const inter_core_t& d, uint32_t* mine, ipc_stats_t& st)
+{
+    bool busy = is_spin_locked(writeLock);
+    uint32_t start = time_us_32();
+    uint32_t save = spin_lock_blocking(writeLock);
+    uint32_t locked = time_us_32();
+
+    seq = seq + 1;
+    __dmb();
+
+    if (t & US_CORE1_READY)         icData.core1Ready = d.core1Ready;
+    if (t & US_SCAN_VIEW)           icData.scanView = d.scanView;
+    if (t & US_IP_ADDR)             icData.ipAddress = d.ipAddress;
+    if (t & US_MAC_ADDR)            icData.macAddress = d.macAddress;
+    if (t & US_SCAN_DATA)           icData.scanResult = d.scanResult;
+    if (t & US_BRIGHTNESS)
+    {
+        icData.brightness = d.brightness;
+        icData.brightCount = d.brightCount;
+    }
+
+    for (uint8_t ii = 0; ii < IC_FIELDS; ++ii)
+    {
+        if (t & (1 << ii))
+        {
+            gen[ii] = gen[ii] + 1;
+            mine[ii] = gen[ii];
+        }
+    }
+
+    __dmb();
+    seq = seq + 1;
+
+    if (busy)
+    {
+        ++st.contended;
+    }
+    st.lockWaitUs.add(locked - start);
+    st.lockHoldUs.add(time_us_32() - locked);
+    spin_unlock(writeLock, save);
+}
+
+/*******************************************************
+ * readFields()
+ *******************************************************
+ * copy out whatever changed since this core last read,
+ * under the seqlock, and read again if a write got in
+ * the way
+ ******************************************************/
+static void readFields(inter_core_t& d, uint32_t* mine, ipc_stats_t& st)
+{
+    uint32_t now[IC_FIELDS];
+    uint32_t start;
+    bool bulk = false;
+
+    while (true)
+    {
+        start = seq;
+        if (start & 1)
+        {
+            ++st.retries;
+            continue;
+        }
+        __dmb();
+
+        for (uint8_t ii = 0; ii < IC_FIELDS; ++ii)
+        {
+            now[ii] = gen[ii];
+        }
+
+        if (now[FIELD(US_CORE1_READY)] != mine[FIELD(US_CORE1_READY)])         d.core1Ready = icData.core1Ready;
+        if (now[FIELD(US_SCAN_VIEW)] != mine[FIELD(US_SCAN_VIEW)])             d.scanView = icData.scanView;
+        if (now[FIELD(US_IP_ADDR)] != mine[FIELD(US_IP_ADDR)])                 d.ipAddress = icData.ipAddress;
+        if (now[FIELD(US_MAC_ADDR)] != mine[FIELD(US_MAC_ADDR)])               d.macAddress = icData.macAddress;
+        if (now[FIELD(US_SCAN_DATA)] != mine[FIELD(US_SCAN_DATA)])             d.scanResult = icData.scanResult;
+        if (now[FIELD(US_BRIGHTNESS)] != mine[FIELD(US_BRIGHTNESS)])
+        {
+            d.brightness = icData.brightness;
+            d.brightCount = icData.brightCount;
+        }
+
+        __dmb();
+        if (seq == start)
+        {
+            break;
+        }
+        ++st.retries;
+    }
+
+    for (uint8_t ii = 0; ii < IC_FIELDS; ++ii)
+    {
+        if ((BULK_FIELDS & (1 << ii)) && now[ii] != mine[ii])
+        {
+            bulk = true;
+        }
+    }
+
+    if (bulk)
+    {
+        ++st.bulkCopies;
+    }
+
+    for (uint8_t ii = 0; ii < IC_FIELDS; ++ii)
+    {
+        mine[ii] = now[ii];
+    }
 }
 
 /*******************************************************
  * updateSharedData()
  *******************************************************
- * called by both cores, wrapped in a blocking mutex.
- * 
- * The first parameter is bitmask of which fields have
- * changed
+ * called by both cores.  The first parameter is bitmask
+ * of which fields have changed; those get written, then
+ * anything the other core changed gets copied back out
+ * into d.  Nothing gets copied that hasn't changed
  ******************************************************/
 bool updateSharedData(uint16_t t, inter_core_t& d)
 {
-    bool ret = false;
+    if (!writeLock)
+    {
+        return (false);
+    }
+
+    uint32_t start = time_us_32();
+    uint core = get_core_num();
+    ipc_stats_t& st = stats[core];
+
+    if (t)
+    {
+        writeFields(t, d, seen[core], st);
+        ringDoorbell(core ^ 0x01);
+    }
+
+    readFields(d, seen[core], st);
+
+    uint32_t elapsed = time_us_32() - start;
+    ++st.updates;
+    st.totalUs += elapsed;
+    if (elapsed > st.maxUs)
+    {
+        st.maxUs = elapsed;
+    }
+
+    return (true);
+}
+
+/*******************************************************
+ * getIPCStats()
+ *******************************************************
+ * what updateSharedData() has been costing one core
+ ******************************************************/
+void getIPCStats(uint core, ipc_stats_t& s)
+{
+    s = stats[core & 0x01];
+}
+
+/*******************************************************
+ * postRequest()
+ *******************************************************
+ * core 0 only.  Queue a command for core 1; returns the
+ * id the response will carry, or 0 if the queue is full
+ ******************************************************/
+uint16_t postRequest(inter_core_cmd_t cmd)
+{
+    ipc_request_t req;
+    req.id = nextId;
+    req.cmd = cmd;
+    req.sentUs = time_us_32();
+
+    // capping what's in flight means core 1 always has
+    // room to answer
+    if (inFlight >= CMD_QUEUE_SIZE - 1 || !requests.push(req))
+    {
+        log->warnWrite(FMT("%s::queue full, dropped %s\n", __FUNCTION__, cmd2text(cmd).c_str()));
+        return (0);
+    }
+
+    ++inFlight;
+    ringDoorbell(1);
+
+    // 0 means "no request", skip it on the wrap
+    if (!(++nextId))
+    {
+        nextId = 1;
+    }
+
+    return (req.id);
+}
+
+/*******************************************************
+ * getResponse()
+ *******************************************************
+ * core 0 only.  Take the next response if there is one
+ * and add its round trip to the command's latency
+ ******************************************************/
+bool getResponse(ipc_response_t& r)
+{
+    if (!responses.pop(r))
+    {
+        return (false);
+    }
+
+    r.latencyUs = time_us_32() - r.sentUs;
+    --inFlight;
+
+    if (r.cmd < IS_CMD_COUNT)
+    {
+        ipc_latency_t& l = latency[r.cmd];
+        ++l.count;
+        l.lastUs = r.latencyUs;
+        l.totalUs += r.latencyUs;
+        if (r.latencyUs > l.maxUs)
+        {
+            l.maxUs = r.latencyUs;
+        }
+    }
+
+    return (true);
+}
+
+/*******************************************************
+ * getRequest()
+ *******************************************************
+ * core 1 only.  Take the next command if there is one
+ ******************************************************/
+bool getRequest(ipc_request_t& r)
+{
+    return (requests.pop(r));
+}
+
+/*******************************************************
+ * postResponse()
+ *******************************************************
+ * core 1 only.  Answer a request.  Update the shared 
+ * data with any results first, so they're there when 
+ * core 0 sees this
+ ******************************************************/
+bool postResponse(const ipc_request_t& req, bool ok)
+{
+    ipc_response_t resp;
+    resp.id = req.id;
+    resp.cmd = req.cmd;
+    resp.ok = ok;
+    resp.sentUs = req.sentUs;
+    resp.latencyUs = 0;
+
+    // core 0 never has more in flight than this queue holds,
+    // so there is always room for the answer
+    bool ret = responses.push(resp);
+    ringDoorbell(0);
+
+    return (ret);
+}
 
-    if (mutex_is_initialized(&mtx))
+/*******************************************************
+ * getCmdLatency()
+ *******************************************************
+ * round trip times for one command.  Only core 0 
+ * writes these
+ ******************************************************/
+void getCmdLatency(inter_core_cmd_t cmd, ipc_latency_t& l)
+{
+    if (cmd < IS_CMD_COUNT)
     {
-        mutex_enter_blocking(&mtx);
+        l = latency[cmd];
+    }
+}
+
+/*******************************************************
+ * ringDoorbell()
+ *******************************************************
+ * wake a core that's sleeping in sleepUntil().  The 
+ * event from __sev() is latched, so this can't get lost
+ * between the other core checking its bell and going
+ * to sleep
+ ******************************************************/
+void ringDoorbell(uint core)
+{
+    doorbell[core & 0x01] = true;
+    __dmb();
+    __sev();
+}
+
+/*******************************************************
+ * sleepUntil()
+ *******************************************************
+ * what the main loops do between ticks instead of 
+ * spinning on the clock.  Sleeps in wfe until the 
+ * deadline or until the other core rings; returns true
+ * for the bell.  Other events (spinlocks, the alarm 
+ * used for the timeout) wake it up too, it just goes
+ * back to sleep.  The bell is only cleared when it's
+ * answered; one that rings after the deadline is kept
+ * for the next call
+ ******************************************************/
+bool sleepUntil(absolute_time_t deadline)
+{
+    uint core = get_core_num();
+    uint32_t start = time_us_32();
+    bool rung = false;
 
-        // copy the changed data in
-        if (t & US_CORE1_READY)         icData.core1Ready = d.core1Ready;
-        if (t & US_WIFI_CONNECTED)      icData.clockReady = d.wifiConnected;
-        if (t & US_CLOCK_READY)         icData.clockReady = d.clockReady;
-        if (t & US_IP_ADDR)             icData.ipAddress = d.ipAddress;
-        if (t & US_MAC_ADDR)            icData.macAddress = d.macAddress;
-        if (t & US_SCAN_DATA)           icData.scanResult = d.scanResult;
-        if (t & US_NEW_CMD)             icData.cmd = d.cmd;
-        if (t & US_ACK_CMD)             icData.ack = d.ack;
-        if (t & US_NEW_TMP_DATA)
+    while (!time_reached(deadline))
+    {
+        if (doorbell[core])
         {
-            icData.temperatue = d.temperatue;
-            icData.tempCount = d.tempCount;
+            doorbell[core] = false;
+            rung = true;
+            break;
         }
 
-        // now copy out from other core
-        copyIPC(icData, d);
-        ret = true;
+        best_effort_wfe_or_timeout(deadline);
+    }
+
+    idle[core].sleptUs += time_us_32() - start;
+    ++idle[core].wakes;
+    if (rung)
+    {
+        ++idle[core].doorbells;
+    }
+
+    return (rung);
+}
+
+/*******************************************************
+ * getIdleStats()
+ *******************************************************
+ * how one core's loop has been waiting, optionally 
+ * starting over.  This is a snapshot; a reset from the
+ * other core can lose a wake or two, fine for a rough
+ * number
+ ******************************************************/
+void getIdleStats(uint core, idle_stats_t& s, bool reset)
+{
+    core &= 0x01;
+    uint32_t now = time_us_32();
+
+    s = idle[core];
+    s.windowUs = now - idleSince[core];
+
+    if (reset)
+    {
+        idle[core].sleptUs = 0;
+        idle[core].wakes = 0;
+        idle[core].doorbells = 0;
+        idleSince[core] = now;
+    }
+}
+
+/*******************************************************
+ * ipcStats2text()
+ *******************************************************
+ * all of the IPC counters and histograms, one line per
+ * thing.  Writes per second and idle time are over the
+ * time since the last call, from either core
+ ******************************************************/
+const std::string ipcStats2text(void)
+{
+    std::string ret;
+    uint32_t now = time_us_32();
+    uint32_t windowMs = (now - statsSince) / 1000;
+
+    for (uint core = 0; core < 2; ++core)
+    {
+        const ipc_stats_t& st = stats[core];
+        uint32_t avg = st.updates ? (uint32_t)(((uint64_t)st.totalUs * 100) / st.updates) : 0;
+        ret += FMT("IPC core %d: %d updates, avg %d.%02dus, max %dus, %d retries, %d bulk copies, %d contended\n", 
+                core, st.updates, avg / 100, avg % 100, st.maxUs, st.retries, st.bulkCopies, st.contended);
+        ret += "  lock wait us " + hist2text(st.lockWaitUs) + "\n";
+        ret += "  lock hold us " + hist2text(st.lockHoldUs) + "\n";
 
-        mutex_exit(&mtx);
+        idle_stats_t idle;
+        getIdleStats(core, idle, true);
+        uint32_t pct = idle.windowUs ? (uint32_t)(((uint64_t)idle.sleptUs * 100) / idle.windowUs) : 0;
+        ret += FMT("  idle %d%% over %dms, %d wakes, %d doorbells\n", 
+                pct, idle.windowUs / 1000, idle.wakes, idle.doorbells);
+    }
+
+    ret += FMT("IPC writes over %dms:", windowMs);
+    for (uint8_t ii = 0; ii < IC_FIELDS; ++ii)
+    {
+        uint32_t g = gen[ii];
+        uint32_t perMin = windowMs ? (uint32_t)(((uint64_t)(g - lastGen[ii]) * 60000) / windowMs) : 0;
+        ret += FMT(" %s %d (%d/min)", fieldNames[ii], g - lastGen[ii], perMin);
+        lastGen[ii] = g;
+    }
+    ret += "\n";
+    statsSince = now;
+
+    for (uint8_t cmd = IS_GET_IP; cmd < IS_CMD_COUNT; ++cmd)
+    {
+        const ipc_latency_t& l = latency[cmd];
+        if (l.count)
+        {
+            ret += FMT("IPC %s: %d done, last %dus, avg %dus, max %dus\n",
+                    cmd2text((inter_core_cmd_t)cmd).c_str(), l.count, l.lastUs, l.totalUs / l.count, l.maxUs);
+        }
     }
 
     return (ret);
 }
 
+/*******************************************************
+ * hist2text()
+ *******************************************************
+ * a histogram on one line: sample count, rough p50 and
+ * p99, the max, then the count in each bucket
+ ******************************************************/
+const std::string hist2text(const histogram& h)
+{
+    std::string ret = FMT("n %d, p50 <%d, p99 <%d, max %d [", 
+            h.count(), h.percentile(50), h.percentile(99), h.max());
+
+    for (uint8_t b = 0; b < HIST_BUCKETS; ++b)
+    {
+        ret += FMT("%s%d", b ? " " : "", h.bin(b));
+    }
+    ret += "]";
+
+    return (ret);
+}
+
 /*******************************************************
  * cmd2text()
  *******************************************************
@@ -120,6 +560,9 @@ const std::string cmd2text(inter_core_cmd_t c)
         case IS_GET_IP:             return("Get IP Addr");  break;
         case IS_GET_MAC:            return("Get Mac Addr"); break;
         case IS_DO_SCAN:            return("Scan Network"); break;
+        case IS_NTP_SYNC:           return("NTP Sync");     break;
+        case IS_RELOAD_CONFIG:      return("Reload Config"); break;
+        case IS_CMD_COUNT:          break;
     }
 
     return ("WTF?");
@@ -133,31 +576,35 @@ const std::string cmd2text(inter_core_cmd_t c)
  ******************************************************/
 void dumpStruct(const inter_core_t& d, const std::string w)
 {
-    log->dbgWrite(stringFormat("%s::%s\n", __FUNCTION__, w.c_str()));
-    log->dbgWrite(stringFormat("  core1Ready: %s\n", d.core1Ready ? "true" : "false"));
-    log->dbgWrite(stringFormat("  wifiConnected: %s\n", d.wifiConnected ? "true" : "false"));
-    log->dbgWrite(stringFormat("  clockReady: %s\n", d.clockReady ? "true" : "false"));
-    log->dbgWrite(stringFormat("  ipAddress: %s\n", d.ipAddress.c_str()));
-    log->dbgWrite(stringFormat("  macAddress: %s\n", d.macAddress.c_str()));
-    log->dbgWrite(stringFormat("  temperature: %2.1\n", d.temperatue));
-    log->dbgWrite(stringFormat("  temperature count %d\n", d.tempCount));
-    log->dbgWrite(stringFormat("  cmd: %s\n", cmd2text(d.cmd).c_str()));
-    log->dbgWrite(stringFormat("  ack: %s\n", cmd2text(d.ack).c_str()));
+    DBG_WRITE(log, FMT("%s::%s\n", __FUNCTION__, w.c_str()));
+    DBG_WRITE(log, FMT("  core1Ready: %s\n", d.core1Ready ? "true" : "false"));
+    DBG_WRITE(log, FMT("  ipAddress: %s\n", pilznet::ip2text(d.ipAddress).c_str()));
+    DBG_WRITE(log, FMT("  macAddress: %s\n", pilznet::mac2text(d.macAddress).c_str()));
+    DBG_WRITE(log, FMT("  access points: %d of %d\n", d.scanResult.count, d.scanResult.found));
+    DBG_WRITE(log, FMT("  commands queued: %d, answers waiting: %d\n", requests.count(), responses.count()));
+    DBG_WRITE(log, FMT("  brightness: %d%% (count %d)\n", d.brightness, d.brightCount));
 }
 
 /*******************************************************
  * diffStruct()
  *******************************************************
  * convenience method to display the differences between
- * two structs
+ * two structs.  Compared as bytes, only turned into
+ * text for what actually changed
  ******************************************************/
 void diffStruct(const inter_core_t& a, const inter_core_t& b, int core)
 {
-    if (a.core1Ready != b.core1Ready)       log->dbgWrite(stringFormat("%d-->core1Ready from %s to %s\n", core, a.core1Ready? "true" : "false", b.core1Ready? "true" : "false"));
-    if (a.wifiConnected != b.wifiConnected) log->dbgWrite(stringFormat("%d-->wifiConnected from %s to %s\n", core, a.wifiConnected? "true" : "false", b.wifiConnected? "true" : "false"));
-    if (a.clockReady != b.clockReady)       log->dbgWrite(stringFormat("%d-->clockReady from %s to %s\n", core, a.clockReady? "true" : "false", b.clockReady? "true" : "false"));
-    if (a.ipAddress != b.ipAddress)         log->dbgWrite(stringFormat("%d-->ip addr from %s to %s\n", core, a.ipAddress.c_str(), b.ipAddress.c_str()));
-    if (a.macAddress != b.macAddress)       log->dbgWrite(stringFormat("%d-->mac addr from %s to %s\n", core, a.macAddress.c_str(), b.macAddress.c_str()));
-    if (a.cmd != b.cmd)                     log->dbgWrite(stringFormat("%d-->cmd from %s to %s\n", core, cmd2text(a.cmd).c_str(), cmd2text(b.cmd).c_str()));
-    if (a.ack != b.ack)                     log->dbgWrite(stringFormat("%d-->ack from %s to %s\n", core, cmd2text(a.ack).c_str(), cmd2text(b.ack).c_str()));
+    if (a.core1Ready != b.core1Ready)       DBG_WRITE(log, FMT("%d-->core1Ready from %s to %s\n", core, a.core1Ready? "true" : "false", b.core1Ready? "true" : "false"));
+    if (std::memcmp(&a.ipAddress, &b.ipAddress, sizeof(a.ipAddress)))
+    {
+        DBG_WRITE(log, FMT("%d-->ip addr from %s to %s\n", core, 
+                pilznet::ip2text(a.ipAddress).c_str(), pilznet::ip2text(b.ipAddress).c_str()));
+    }
+    if (std::memcmp(&a.macAddress, &b.macAddress, sizeof(a.macAddress)))
+    {
+        DBG_WRITE(log, FMT("%d-->mac addr from %s to %s\n", core, 
+                pilznet::mac2text(a.macAddress).c_str(), pilznet::mac2text(b.macAddress).c_str()));
+    }
+    if (a.scanResult.count != b.scanResult.count) DBG_WRITE(log, FMT("%d-->access points from %d to %d\n", core, a.scanResult.count, b.scanResult.count));
+    if (a.brightness != b.brightness)       DBG_WRITE(log, FMT("%d-->brightness from %d to %d\n", core, a.brightness, b.brightness));
 }
\ No newline at end of file
@@ -16,12 +16,13 @@
 
 #include <string>
 #include <ctime>
-#include <vector>
 
-#include "pico/mutex.h"
 #include "pico/multicore.h"
 
 #include "../pilznet/pilznet.h"     // for scan data results
+#include "histogram.h"
+
+struct scan_view_t;                 // display scan, see hub75.h
 
 // Commands that core 0 can send to core 1
 enum inter_core_cmd_t
@@ -29,40 +30,115 @@ enum inter_core_cmd_t
     IS_NO_CMD = 0,      // null command
     IS_GET_IP,          // get IP address from net
     IS_GET_MAC,         // get MAC address from net
-    IS_DO_SCAN          // do a network scan for Access Points
+    IS_DO_SCAN,         // do a network scan for Access Points
+    IS_NTP_SYNC,        // set the clock from NTP again
+    IS_RELOAD_CONFIG,   // pick up changed network config from nvm
+    IS_CMD_COUNT
+};
+
+// A command on its way to core 1.  Any number can be in
+// flight; the response comes back with the same id.  Bulky
+// results (addresses, scan) come through the shared data,
+// which core 1 updates before it responds
+struct ipc_request_t
+{
+    uint16_t            id;             // never 0
+    inter_core_cmd_t    cmd;
+    uint32_t            sentUs;         // when core 0 posted it
+};
+
+struct ipc_response_t
+{
+    uint16_t            id;             // from the request
+    inter_core_cmd_t    cmd;
+    bool                ok;             // false if it couldn't be done
+    uint32_t            sentUs;         // from the request
+    uint32_t            latencyUs;      // filled in when core 0 takes it
+};
+
+// round trip times for one command
+struct ipc_latency_t
+{
+    uint32_t            count;
+    uint32_t            lastUs;
+    uint32_t            maxUs;
+    uint32_t            totalUs;
 };
 
 // Bitmask of changed data
 #define US_NONE             (uint16_t)0x0000        // no changes
 #define US_CORE1_READY      (uint16_t)0x0001        // update core 1 ready
-#define US_WIFI_CONNECTED   (uint16_t)0x0002        // update wifi connected
-#define US_CLOCK_READY      (uint16_t)0x0004        // update clock ready
-#define US_IP_ADDR          (uint16_t)0x0008        // update IP address
-#define US_MAC_ADDR         (uint16_t)0x0010        // update MAC address
-#define US_SCAN_DATA        (uint16_t)0x0020        // new scan data
-#define US_NEW_TMP_DATA     (uint16_t)0x0040        // new temperature data
-#define US_NEW_CMD          (uint16_t)0x0080        // new command
-#define US_ACK_CMD          (uint16_t)0x0100        // new ack
-
-// The main struct to hold data between cores
+#define US_IP_ADDR          (uint16_t)0x0002        // update IP address
+#define US_MAC_ADDR         (uint16_t)0x0004        // update MAC address
+#define US_SCAN_DATA        (uint16_t)0x0008        // new scan data
+#define US_BRIGHTNESS       (uint16_t)0x0010        // display brightness asked for over the net
+#define US_SCAN_VIEW        (uint16_t)0x0020        // where the display scan lives
+
+// The main struct to hold data between cores.  Everything
+// in it is fixed size and inline, so it can be copied 
+// with a plain assignment and never touches the heap.
+// Temperature, pump and network status are published on
+// the telemetry bus instead, see telemetry.h
 struct inter_core_t
 {
     bool                core1Ready;     // Core 1 is running
-    bool                wifiConnected;  // wifi is connected
-    bool                clockReady;     // clock has been set
-    uint32_t            tempCount;      // incremented each time a temp is written
-    float               temperatue;     // current probe reading
-    std::string         ipAddress;      // current IP address
-    std::string         macAddress;     // current MAC address
+    ipv4_addr_t         ipAddress;      // current IP address
+    mac_addr_t          macAddress;     // current MAC address
     scan_data_t         scanResult;     // results of AP scan
-    inter_core_cmd_t    cmd;            // command request between cores
-    inter_core_cmd_t    ack;            // command ack
+    uint32_t            brightCount;    // incremented each time brightness is asked for
+    uint8_t             brightness;     // display brightness asked for, percent
+    const scan_view_t*  scanView;       // display scan, for frame dumps over the net
+};
+
+// what updateSharedData() costs, per core
+struct ipc_stats_t
+{
+    uint32_t updates;       // calls
+    uint32_t totalUs;       // time spent in them
+    uint32_t maxUs;         // longest one
+    uint32_t retries;       // seqlock reads that had to go again
+    uint32_t bulkCopies;    // times the addresses or scan table had to be copied
+    uint32_t contended;     // writes that found the other core holding the lock
+    histogram lockWaitUs;   // spinning for the writers' lock
+    histogram lockHoldUs;   // holding it
+};
+
+// how a core's main loop spent its time waiting for
+// its next tick
+struct idle_stats_t
+{
+    uint32_t windowUs;      // since the stats were last reset
+    uint32_t sleptUs;       // asleep in wfe
+    uint32_t wakes;         // times it went to sleep and came back
+    uint32_t doorbells;     // woken early by the other core
 };
 
 // global functions
 bool initIPC(void);
-void copyIPC(const inter_core_t src, inter_core_t& dst);
+void copyIPC(const inter_core_t& src, inter_core_t& dst);
 bool updateSharedData(uint16_t t, inter_core_t& d);
+void getIPCStats(uint core, ipc_stats_t& s);
+
+// command queues; core 0 posts requests and takes responses,
+// core 1 does the opposite.  None of these block
+uint16_t postRequest(inter_core_cmd_t cmd);
+bool getResponse(ipc_response_t& r);
+bool getRequest(ipc_request_t& r);
+bool postResponse(const ipc_request_t& req, bool ok);
+void getCmdLatency(inter_core_cmd_t cmd, ipc_latency_t& l);
+
+// doorbells.  Anything posted for the other core rings 
+// its bell; sleepUntil() sleeps until the deadline or the
+// bell, and says which it was
+void ringDoorbell(uint core);
+bool sleepUntil(absolute_time_t deadline);
+void getIdleStats(uint core, idle_stats_t& s, bool reset);
+
+// everything above as text, for the log and the UDP port.
+// Rates and idle time are since the last time it was asked
+const std::string ipcStats2text(void);
+const std::string hist2text(const histogram& h);
+const std::string cmd2text(inter_core_cmd_t c);
 void dumpStruct(const inter_core_t& d, const std::string w);
 void diffStruct(const inter_core_t& a, const inter_core_t& b, int core);
 
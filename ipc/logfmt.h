@@ -0,0 +1,169 @@
+/********************************************************
+ * logfmt.h
+ ********************************************************
+ * Formats for binary log records.  A binary log call
+ * doesn't format anything; it stores the format's id,
+ * the time and the raw arguments in the core's ring,
+ * and core 1 makes the text when it drains the ring.
+ * That takes vsnprintf() and the heap off the caller.
+ *
+ * Every format has to be in LOG_FORMATS so it has an
+ * id.  The argument count of each call is checked
+ * against its format when it's compiled.
+ *
+ * Arguments are packed one after the other: integers,
+ * bool and char as 32 bits, long long as 64,
+ * float/double as float, and the text of a const char*,
+ * up to LOG_STR_MAX of it.  The text is copied, so a
+ * buffer on the stack or a c_str() is fine.  No '*'
+ * widths, and no std::string itself.
+ *
+ * %T is a temp_t, hundredths of a degree, printed as
+ * degrees with one place; %.2T for two
+ *
+ *******************************************************/
+#ifndef LOGFMT_H_
+#define LOGFMT_H_
+
+#include <cstring>
+#include <cstddef>
+
+#include "pico/stdlib.h"
+
+// id, format
+#define LOG_FORMATS(X)                                                                  \
+    X(LF_NVM_ENTER,         "nvm::%s() - entering\n")                                   \
+    X(LF_NVM_CORE1,         "Cannot write flash from core 1!!\n")                       \
+    X(LF_NVM_CRIT_IN,       "NVM::entered critical section\n")                          \
+    X(LF_NVM_LOCKED,        "NVM::core 0 locked\n")                                     \
+    X(LF_NVM_NO_LOCKOUT,    "NVM::core 1 didn't pause, flash not touched\n")            \
+    X(LF_NVM_NO_RESUME,     "NVM::core 1 didn't answer the unlock\n")                   \
+    X(LF_NVM_GAVE_UP,       "NVM::gave up writing after %d tries\n")                    \
+    X(LF_NVM_ERASED,        "NVM::erased sector\n")                                     \
+    X(LF_NVM_UNLOCKED,      "NVM::unlocked core 1\n")                                   \
+    X(LF_NVM_CRIT_OUT,      "NVM::left critical section\n")                             \
+    X(LF_NVM_DONE,          "Done writing bytes to Flash in %ld us\n")                  \
+    X(LF_NVM_LEAVE,         "nvm::%s() - leaving\n")                                    \
+    X(LF_REEFER_READY,      "reefer leaving init state\n")                              \
+    X(LF_PUMP_ON,           "Pump on %T/%T\n")                                          \
+    X(LF_PUMP_OFF,          "Pump off %T/%T\n")                                         \
+    X(LF_PUMP_RUNTIME,      "Accumulated pump runtime now %d seconds\n")                \
+    X(LF_REEFER_STATUS,     "%T,%s\n")                                                  \
+    X(LF_REEFER_STATE,      "Reefer state from %s to %s\n")                             \
+    X(LF_BRIGHTNESS,        "%s::brightness %d%%\n")
+
+enum log_fmt_t
+{
+#define LF_ENUM(id, fmt)    id,
+    LOG_FORMATS(LF_ENUM)
+#undef LF_ENUM
+    LF_COUNT
+};
+
+// the format strings, by id
+#define LF_TEXT(id, fmt)    fmt,
+static constexpr const char* logFormats[] = { LOG_FORMATS(LF_TEXT) };
+#undef LF_TEXT
+
+#define LOG_MAX_ARGS        8
+#define LOG_STR_MAX         23          // most of one string kept
+
+// room for the most arguments at their biggest; a
+// string is its length byte and text, a number 8 at
+// most
+#define LOG_REC_DATA        (LOG_MAX_ARGS * (LOG_STR_MAX + 1))
+
+// how many arguments a format takes; %% doesn't count
+constexpr uint8_t logFmtArgs(const char* f)
+{
+    return ((!*f) ? 0 :
+            (*f != '%') ? logFmtArgs(f + 1) :
+            (f[1] == '%') ? logFmtArgs(f + 2) :
+            1 + logFmtArgs(f + 1));
+}
+
+// how each argument was stored, so it can be handed
+// back to snprintf() as the right type
+enum log_arg_tag_t
+{
+    LA_INT = 0,
+    LA_UINT,
+    LA_FLOAT,
+    LA_STR,                             // a length byte, then the text
+    LA_INT64,
+    LA_UINT64
+};
+
+// A binary record's body.  Only the arguments the
+// format takes get stored, packed into data
+struct log_fmt_rec_t
+{
+    uint8_t     fmt;                    // log_fmt_t
+    uint8_t     count;                  // arguments
+    uint8_t     used;                   // bytes of data
+    uint8_t     tags[LOG_MAX_ARGS];     // log_arg_tag_t
+    uint8_t     data[LOG_REC_DATA];
+};
+
+// store one argument
+inline void logPut(log_fmt_rec_t& r, uint8_t tag, const void* v, size_t len)
+{
+    r.tags[r.count++] = tag;
+    std::memcpy(&r.data[r.used], v, len);
+    r.used += len;
+}
+
+inline void logInt(log_fmt_rec_t& r, int32_t v)             { logPut(r, LA_INT, &v, sizeof(v)); }
+inline void logUint(log_fmt_rec_t& r, uint32_t v)           { logPut(r, LA_UINT, &v, sizeof(v)); }
+inline void logInt64(log_fmt_rec_t& r, int64_t v)           { logPut(r, LA_INT64, &v, sizeof(v)); }
+inline void logUint64(log_fmt_rec_t& r, uint64_t v)         { logPut(r, LA_UINT64, &v, sizeof(v)); }
+
+inline void logArg(log_fmt_rec_t& r, bool v)                { logInt(r, v); }
+inline void logArg(log_fmt_rec_t& r, char v)                { logInt(r, v); }
+inline void logArg(log_fmt_rec_t& r, signed char v)         { logInt(r, v); }
+inline void logArg(log_fmt_rec_t& r, unsigned char v)       { logUint(r, v); }
+inline void logArg(log_fmt_rec_t& r, short v)               { logInt(r, v); }
+inline void logArg(log_fmt_rec_t& r, unsigned short v)      { logUint(r, v); }
+inline void logArg(log_fmt_rec_t& r, int v)                 { logInt(r, v); }
+inline void logArg(log_fmt_rec_t& r, unsigned int v)        { logUint(r, v); }
+inline void logArg(log_fmt_rec_t& r, long v)                { if (sizeof(v) > 4) logInt64(r, v); else logInt(r, (int32_t)v); }
+inline void logArg(log_fmt_rec_t& r, unsigned long v)       { if (sizeof(v) > 4) logUint64(r, v); else logUint(r, (uint32_t)v); }
+inline void logArg(log_fmt_rec_t& r, long long v)           { logInt64(r, v); }
+inline void logArg(log_fmt_rec_t& r, unsigned long long v)  { logUint64(r, v); }
+inline void logArg(log_fmt_rec_t& r, float v)               { logPut(r, LA_FLOAT, &v, sizeof(v)); }
+inline void logArg(log_fmt_rec_t& r, double v)              { logArg(r, (float)v); }
+
+// the text, cut to LOG_STR_MAX
+inline void logArg(log_fmt_rec_t& r, const char* v)
+{
+    static_assert(LOG_REC_DATA < 256 && LOG_STR_MAX + 1 >= sizeof(uint64_t), "a record's arguments have to fit its data");
+
+    if (!v)
+    {
+        v = "(null)";
+    }
+
+    size_t len = strnlen(v, LOG_STR_MAX);
+
+    r.tags[r.count++] = LA_STR;
+    r.data[r.used++] = (uint8_t)len;
+    std::memcpy(&r.data[r.used], v, len);
+    r.used += len;
+}
+
+inline void logArgs(log_fmt_rec_t&)                         {}
+
+template <typename T, typename... Rest>
+inline void logArgs(log_fmt_rec_t& r, T v, Rest... rest)
+{
+    logArg(r, v);
+    logArgs(r, rest...);
+}
+
+// bytes of a record that actually get stored
+inline size_t logRecSize(const log_fmt_rec_t& r)
+{
+    return (offsetof(log_fmt_rec_t, data) + r.used);
+}
+
+#endif // LOGFMT_H_
@@ -1,8 +1,8 @@
 /********************************************************
  * mlogger.cpp
  ********************************************************
- * common logger, circular buffer with mutexes to handle
- * multicore use
+ * common logger, a ring per core feeding a circular
+ * buffer that core 1 owns.  See the comment in mlogger.h
  * December 2021, M.Brugman
  * 
  *******************************************************/
@@ -13,10 +13,169 @@
 #include "../project.h"
 #include "../utils/stringFormat.h"
 #include "pico/multicore.h"
-#include "../sys/walltime.h"
+#include "hardware/sync.h"
+#include "hardware/structs/systick.h"
+#include "tusb.h"
+#include "../sys/timestamp.h"
+#include "ipc.h"                // for hist2text()
+#include "../utils/temperature.h"
 
 logger* logger::instance = NULL;
 
+// a line header with this length means the line starts
+// over at the front of the ring
+#define LINE_WRAP           0xffff
+
+/*********************************************
+ * cycles()
+ *********************************************
+ * the calling core's SysTick, which counts 
+ * down at the CPU clock.  Each core has its
+ * own, started here the first time.  Good for
+ * timing things shorter than 0.13 seconds
+ ********************************************/
+uint32_t logger::cycles()
+{
+    if (!(systick_hw->csr & 0x01))
+    {
+        systick_hw->rvr = 0x00ffffff;
+        systick_hw->cvr = 0;
+        systick_hw->csr = 0x05;         // enabled, CPU clock, no interrupt
+    }
+
+    return (systick_hw->cvr);
+}
+
+/*********************************************
+ * fmt2text()
+ *********************************************
+ * make the text for a binary record, one
+ * conversion at a time so each argument can
+ * go to snprintf() as the type it was stored
+ * as.  Length modifiers are dropped, and ll
+ * put back for what was stored as 64 bits.
+ * %T is ours, not snprintf()'s
+ ********************************************/
+static size_t fmt2text(const log_fmt_rec_t& r, char* out, size_t size)
+{
+    const char* f = (r.fmt < LF_COUNT) ? logFormats[r.fmt] : "bad log format %d\n";
+    size_t len = 0;
+    uint8_t arg = 0;
+    size_t at = 0;                  // into r.data
+
+    while (*f && len < size - 1)
+    {
+        if (*f != '%')
+        {
+            out[len++] = *f++;
+            continue;
+        }
+
+        if (f[1] == '%')
+        {
+            out[len++] = '%';
+            f += 2;
+            continue;
+        }
+
+        // copy the spec without its length modifiers
+        char spec[16];
+        uint8_t sl = 0;
+        spec[sl++] = *f++;
+        while (*f && std::strchr("-+ #0123456789.hlLqjzt", *f))
+        {
+            if (!std::strchr("hlLqjzt", *f) && sl < sizeof(spec) - 4)
+            {
+                spec[sl++] = *f;
+            }
+            ++f;
+        }
+        if (!*f)
+        {
+            break;
+        }
+
+        // the argument, unpacked
+        uint8_t tag = (arg < r.count) ? r.tags[arg] : (uint8_t)LA_INT;
+        size_t need = (tag == LA_STR) ? 1 : (tag == LA_INT64 || tag == LA_UINT64) ? 8 : 4;
+        if (arg >= r.count || at + need > r.used)
+        {
+            tag = LA_INT;
+            need = 0;
+        }
+        ++arg;
+
+        uint32_t v = 0;
+        uint64_t v64 = 0;
+        char str[LOG_STR_MAX + 1];
+        if (tag == LA_STR)
+        {
+            size_t sn = r.data[at];
+            if (at + 1 + sn > r.used)
+            {
+                sn = r.used - at - 1;
+            }
+            std::memcpy(str, &r.data[at + 1], sn);
+            str[sn] = '\0';
+            need += sn;
+        }
+        else if (need == 8)
+        {
+            std::memcpy(&v64, &r.data[at], need);
+            spec[sl++] = 'l';
+            spec[sl++] = 'l';
+        }
+        else
+        {
+            std::memcpy(&v, &r.data[at], need);
+        }
+        at += need;
+
+        spec[sl++] = *f++;
+        spec[sl] = '\0';
+
+        int n = 0;
+
+        // a temperature, in degrees
+        if (spec[sl - 1] == 'T')
+        {
+            const char* dot = std::strchr(spec, '.');
+            uint8_t places = (dot && dot[1] >= '0' && dot[1] <= '2') ? dot[1] - '0' : 1;
+            n = temp2text((need == 8) ? (temp_t)v64 : (temp_t)v, places, out + len, size - len);
+        }
+        else
+        {
+            switch (tag)
+            {
+                case LA_INT:    n = snprintf(out + len, size - len, spec, (int)v);                  break;
+                case LA_UINT:   n = snprintf(out + len, size - len, spec, (unsigned int)v);         break;
+                case LA_STR:    n = snprintf(out + len, size - len, spec, str);                     break;
+                case LA_INT64:  n = snprintf(out + len, size - len, spec, (long long)v64);          break;
+                case LA_UINT64: n = snprintf(out + len, size - len, spec, (unsigned long long)v64); break;
+                case LA_FLOAT:
+                {
+                    float fv;
+                    std::memcpy(&fv, &v, sizeof(fv));
+                    n = snprintf(out + len, size - len, spec, (double)fv);
+                }   break;
+            }
+        }
+
+        if (n > 0)
+        {
+            len += n;
+        }
+    }
+
+    if (len > size - 1)
+    {
+        len = size - 1;
+    }
+    out[len] = '\0';
+
+    return (len);
+}
+
 /********************************************************
  * getInstance
  ********************************************************
@@ -51,10 +210,17 @@ bool logger::initBuffer()
     head = 0;
     tail = 0;
     used = 0;
+    seq = 0;
     capacity = LOGGER_BUFFER_SIZE;
 
-    // init the mutex
-    mutex_init(&dbgMtx);
+    std::memset(rings, 0, sizeof(rings));
+    fmtCycles.reset();
+    prefixCycles.reset();
+    echoSeq = 0;
+    std::memset(&echoStats, 0, sizeof(echoStats));
+    threshold = LOG_MIN_LEVEL;
+    sink = NULL;
+    sinkCtx = NULL;
 
     return (true);
 }
@@ -100,98 +266,363 @@ bool logger::isFull()
 }
 
 /*********************************************
- * addChar()
+ * addChars()
  *********************************************
- * add a single character and return the
- * number of characters added; that is, 1.
+ * copy text into the log buffer and return
+ * the number of characters added.  Never 
+ * ending buffer... if it's full, the oldest
+ * text gets overwritten.
  * 
- * Not callable from outside, this is just the
- * local implementation to add a char
+ * Core 1 only, from drain()
+ ********************************************/
+size_t logger::addChars(const char* c, size_t len)
+{
+    seq += len;
+
+    // only the end of something bigger than the
+    // whole buffer can fit anyway
+    if (len > capacity - 1)
+    {
+        c += len - (capacity - 1);
+        len = capacity - 1;
+    }
+
+    size_t room = this->available() - 1;
+    if (len > room)
+    {
+        tail = (tail + (len - room)) % capacity;
+    }
+
+    size_t first = capacity - head;
+    if (first > len)
+    {
+        first = len;
+    }
+
+    std::memcpy(&buff[head], c, first);
+    std::memcpy(buff, c + first, len - first);
+    head = (head + len) % capacity;
+
+    return (len);
+}
+
+/*********************************************
+ * ringPut()
+ *********************************************
+ * put one line in a core's ring, header and
+ * body, without waiting on anything.  mark,
+ * if there is one, goes on after the body.
+ * False if there's no room; the line is 
+ * dropped rather than holding up the caller
+ ********************************************/
+bool logger::ringPut(ring_t& r, uint8_t kind, char level, const void* body, size_t len,
+                     const char* mark, size_t markLen)
+{
+    const uint32_t hdrLen = sizeof(line_hdr_t);
+    uint32_t need = hdrLen + len + markLen;
+    uint32_t h = r.head;
+    uint32_t room = (r.tail + LOGGER_RING_SIZE - h - 1) % LOGGER_RING_SIZE;
+    uint32_t toEnd = LOGGER_RING_SIZE - h;
+    uint32_t at = h;
+
+    // a line doesn't wrap, it starts over at the front.
+    // If there's room for a header at the end, leave a
+    // marker there; if not, core 1 knows to skip it
+    if (need > toEnd)
+    {
+        if (toEnd + need > room)
+        {
+            return (false);
+        }
+
+        if (toEnd >= hdrLen)
+        {
+            line_hdr_t wrap;
+            wrap.timeLo = 0;
+            wrap.timeHi = 0;
+            wrap.len = LINE_WRAP;
+            wrap.kind = 0;
+            wrap.level = 0;
+            std::memcpy(&r.buff[h], &wrap, hdrLen);
+        }
+        at = 0;
+    }
+    else if (need > room)
+    {
+        return (false);
+    }
+
+    uint64_t now = time_us_64();
+    line_hdr_t hdr;
+    hdr.timeLo = (uint32_t)now;
+    hdr.timeHi = (uint32_t)(now >> 32);
+    hdr.len = (uint16_t)(len + markLen);
+    hdr.kind = kind;
+    hdr.level = level;
+
+    std::memcpy(&r.buff[at], &hdr, hdrLen);
+    std::memcpy(&r.buff[at + hdrLen], body, len);
+    if (markLen)
+    {
+        std::memcpy(&r.buff[at + hdrLen + len], mark, markLen);
+    }
+
+    // the line has to be there before core 1 can see it
+    __dmb();
+    r.head = (at + need) % LOGGER_RING_SIZE;
+
+    return (true);
+}
+
+/*********************************************
+ * ringPeek()
+ *********************************************
+ * core 1 only.  Look at the oldest line in a
+ * ring without taking it; pos is where its
+ * header is
  ********************************************/
-size_t logger::addChar(char c)
+bool logger::ringPeek(ring_t& r, line_hdr_t& h, uint32_t& pos)
 {
-    mutex_enter_blocking(&dbgMtx);
+    const uint32_t hdrLen = sizeof(line_hdr_t);
+    uint32_t t = r.tail;
+
+    if (t == r.head)
+    {
+        return (false);
+    }
+    __dmb();
 
-    // Never ending buffer... if it's full, just
-    // increment the tail by one to make room.
-    // this the newest byte will overwrite
-    // the oldest
-    if (this->isFull())
+    if (LOGGER_RING_SIZE - t < hdrLen)
     {
-        ++tail;
-        tail %= LOGGER_BUFFER_SIZE;
+        t = 0;
     }
 
-    // add and increment
-    buff[head] = c;
-    ++head;
-    head %= LOGGER_BUFFER_SIZE;  
-    mutex_exit(&dbgMtx);  
+    std::memcpy(&h, &r.buff[t], hdrLen);
+    if (h.len == LINE_WRAP)
+    {
+        t = 0;
+        std::memcpy(&h, &r.buff[t], hdrLen);
+    }
 
-    return (1);
+    pos = t;
+    return (true);
 }
 
 /*********************************************
- * dbgWrite()
+ * drain()
  *********************************************
- * add an STL string to the buffer and return
- * the number of bytes added
+ * core 1 only.  Move every line from both 
+ * rings into the log buffer, always taking
+ * the older of the two next so the log reads
+ * in time order.  This is where the prefix
+ * goes on and binary records become text.
+ * The time in the prefix is the time the 
+ * line was written, to the microsecond, 
+ * however long it sat in the ring
  ********************************************/
-size_t logger::write(const std::string& s)
+void logger::drain()
 {
-    size_t count = 0;
+    const uint32_t hdrLen = sizeof(line_hdr_t);
+    line_hdr_t h[2];
+    uint32_t pos[2];
+    bool have[2];
+    timestamp* ts = timestamp::getInstance();
+
+    ts->sync();
+
+    have[0] = ringPeek(rings[0], h[0], pos[0]);
+    have[1] = ringPeek(rings[1], h[1], pos[1]);
 
-// If debugging, echo all writes out the USB port
+    while (have[0] || have[1])
+    {
+        uint8_t pick;
+        if (!have[0])           pick = 1;
+        else if (!have[1])      pick = 0;
+        else                    pick = (lineTime(h[1]) < lineTime(h[0])) ? 1 : 0;
+
+        ring_t& r = rings[pick];
+        const uint8_t* body = &r.buff[pos[pick] + hdrLen];
+        char line[LOGGER_MAX_LINE + 48];
+        size_t len = 0;
+
+        if (h[pick].level)
+        {
+            uint32_t start = cycles();
+            line[len++] = '[';
+            line[len++] = h[pick].level;
+            line[len++] = '0' + pick;
+            line[len++] = ']';
+            line[len++] = ' ';
+            len += ts->format(lineTime(h[pick]), line + len);
+            line[len++] = ',';
+            prefixCycles.add((start - cycles()) & 0x00ffffff);
+        }
+
+        if (h[pick].kind == LINE_FMT)
+        {
+            uint32_t start = cycles();
+            log_fmt_rec_t rec;
+            std::memset(&rec, 0, sizeof(rec));
+            std::memcpy(&rec, body, (h[pick].len < sizeof(rec)) ? h[pick].len : sizeof(rec));
+            len += fmt2text(rec, line + len, sizeof(line) - len);
+            fmtCycles.add((start - cycles()) & 0x00ffffff);
+        }
+        else
+        {
+            std::memcpy(line + len, body, h[pick].len);
+            len += h[pick].len;
+        }
+
+        this->addChars(line, len);
+        if (sink)
+        {
+            sink(line, len, sinkCtx);
+        }
+
+        // done with the line, the other core can have it
+        __dmb();
+        r.tail = (pos[pick] + hdrLen + h[pick].len) % LOGGER_RING_SIZE;
+
+        have[pick] = ringPeek(r, h[pick], pos[pick]);
+    }
+}
+
+/*********************************************
+ * echo()
+ *********************************************
+ * core 1 only.  stdio sends a \n as \r\n, so
+ * the newlines count against the room too; 
+ * with that, stdio never has to wait for the
+ * host.  If the host isn't there, or isn't
+ * reading, the cursor just stays put, and the
+ * text it misses gets counted when read() 
+ * moves it past what was overwritten
+ ********************************************/
+void logger::echo()
+{
 #ifdef DEBUG
-    printf(s.c_str());
-#endif 
+    if (!tud_cdc_connected())
+    {
+        return;
+    }
 
-    // strings are just STL containers, so
-    // use the standard tools
-    std::string::const_iterator it = s.begin();
-    while (it != s.end())
+    uint32_t room = tud_cdc_write_available();
+    if (room > LOGGER_ECHO_MAX)
     {
-        count += this->addChar(*it);
-        ++it;
+        room = LOGGER_ECHO_MAX;
     }
 
-    return (count);
+    char text[LOGGER_ECHO_MAX];
+    uint32_t from = echoSeq;
+    size_t len = this->read(from, text, room);
+    if ((int32_t)(from - echoSeq) > 0)
+    {
+        echoStats.dropped += from - echoSeq;
+    }
+    echoSeq = from;
+
+    if (!len)
+    {
+        return;
+    }
+
+    // whole characters, \r's and all, up to the room
+    size_t n = 0;
+    uint32_t need = 0;
+    while (n < len)
+    {
+        uint32_t c = (text[n] == '\n') ? 2 : 1;
+        if (need + c > room)
+        {
+            break;
+        }
+        need += c;
+        ++n;
+    }
+
+    if (!n)
+    {
+        ++echoStats.full;
+        return;
+    }
+
+    printf("%.*s", (int)n, text);
+    echoSeq += n;
+    echoStats.bytes += n;
+#endif
 }
 
 /*********************************************
- * msgWrite()
+ * put()
  *********************************************
- * Add a string with a categorization header
- * and datetime string
+ * put a record in the calling core's ring,
+ * keeping count of what it cost.  Binary
+ * records are timed from start, before their
+ * arguments were packed.  A line that's too
+ * long keeps what fits with LOGGER_CUT on
+ * the end
  ********************************************/
-size_t logger::msgWrite(const std::string& ms)
+size_t logger::put(uint8_t kind, char level, const void* body, size_t len, uint32_t start)
 {
-    std::string s = stringFormat("[+%d] %s,%s", get_core_num(), walltime::logTimeString().c_str(), ms.c_str());
-    return (this->write(s));
+    const size_t markLen = sizeof(LOGGER_CUT) - 1;
+    const char* mark = NULL;
+
+    ring_t& r = rings[get_core_num()];
+    if (len > LOGGER_MAX_LINE)
+    {
+        len = LOGGER_MAX_LINE - markLen;
+        mark = LOGGER_CUT;
+        ++r.stats.cut;
+    }
+
+    if (kind != LINE_FMT)
+    {
+        start = cycles();
+    }
+    bool ok = this->ringPut(r, kind, level, body, len, mark, mark ? markLen : 0);
+    uint32_t elapsed = (start - cycles()) & 0x00ffffff;
+
+    logger_kind_stats_t& st = (kind == LINE_FMT) ? r.stats.fmt : r.stats.text;
+    st.totalCycles += elapsed;
+    st.writeCycles.add(elapsed);
+    if (!ok)
+    {
+        ++r.stats.dropped;
+        return (0);
+    }
+
+    len += mark ? markLen : 0;
+    ++st.lines;
+    st.bytes += sizeof(line_hdr_t) + len;
+
+    return (len);
 }
 
 /*********************************************
- * dbgWrite()
+ * write()
  *********************************************
- * Add a string with a categorization header
- * and datetime string
+ * add text to the calling core's ring and
+ * return the number of bytes added
  ********************************************/
-size_t logger::dbgWrite(const std::string& ms)
+size_t logger::write(std::string_view s)
 {
-    std::string s = stringFormat("[D%d] %s,%s", get_core_num(), walltime::logTimeString().c_str(), ms.c_str());
-    return (this->write(s));
+    return (this->put(LINE_TEXT, 0, s.data(), s.length(), 0));
 }
 
 /*********************************************
- * infoWrite()
+ * msgWrite()
  *********************************************
  * Add a string with a categorization header
  * and datetime string
  ********************************************/
-size_t logger::infoWrite(const std::string& is)
+size_t logger::msgWrite(std::string_view ms)
 {
-    std::string s = stringFormat("[+%d] %s,%s", get_core_num(), walltime::logTimeString().c_str(), is.c_str());
-    return (this->write(s));
+    if (!this->pass(LOG_INFO))
+    {
+        return (0);
+    }
+
+    return (this->put(LINE_TEXT, '+', ms.data(), ms.length(), 0));
 }
 
 /*********************************************
@@ -200,10 +631,14 @@ size_t logger::infoWrite(const std::string& is)
  * Add a string with a categorization header
  * and datetime string
  ********************************************/
-size_t logger::errWrite(const std::string& es)
+size_t logger::errWrite(std::string_view es)
 {
-    std::string s = stringFormat("[E%d] %s,%s", get_core_num(), walltime::logTimeString().c_str(), es.c_str());
-    return (this->write(s));
+    if (!this->pass(LOG_ERROR))
+    {
+        return (0);
+    }
+
+    return (this->put(LINE_TEXT, 'E', es.data(), es.length(), 0));
 }
 
 /*********************************************
@@ -212,10 +647,14 @@ size_t logger::errWrite(const std::string& es)
  * Add a string with a categorization header
  * and datetime string
  ********************************************/
-size_t logger::warnWrite(const std::string& ws)
+size_t logger::warnWrite(std::string_view ws)
 {
-    std::string s = stringFormat("[W%d] %s,%s", get_core_num(), walltime::logTimeString().c_str(), ws.c_str());
-    return (this->write(s));
+    if (!this->pass(LOG_WARN))
+    {
+        return (0);
+    }
+
+    return (this->put(LINE_TEXT, 'W', ws.data(), ws.length(), 0));
 }
 
 /*********************************************
@@ -227,75 +666,150 @@ size_t logger::warnWrite(const std::string& ws)
  ********************************************/
 size_t logger::hexWrite(int i)
 {
-    return (this->write(stringFormat("0x%04x", i)));
+    return (this->write(FMT("0x%04x", i)));
+}
+
+/*********************************************
+ * setLevel()
+ *********************************************
+ * lowest level that gets logged from now on,
+ * both cores.  LOG_LEVELS turns it all off
+ ********************************************/
+void logger::setLevel(uint8_t level)
+{
+#if LOG_MIN_LEVEL > LOG_DEBUG
+    if (level < LOG_MIN_LEVEL)  level = LOG_MIN_LEVEL;
+#endif
+    if (level > LOG_LEVELS)     level = LOG_LEVELS;
+
+    threshold = level;
 }
 
 /*********************************************
- * dbgPop()
+ * level2text()
  *********************************************
- * pull the oldest character out of the buffer.
- * Internal implementation method
+ * convenience method to display a level in
+ * human readable form
  ********************************************/
-void logger::dbgPop(char& c)
+const std::string logger::level2text(uint8_t level)
 {
-    if (head != tail)
+    switch (level)
     {
-        mutex_enter_blocking(&dbgMtx);
-        c = buff[tail];
-        ++tail;
-        tail %= LOGGER_BUFFER_SIZE;
-        mutex_exit(&dbgMtx);
+        case LOG_DEBUG:     return ("debug");     break;
+        case LOG_INFO:      return ("info");      break;
+        case LOG_WARN:      return ("warn");      break;
+        case LOG_ERROR:     return ("error");     break;
+        case LOG_LEVELS:    return ("off");       break;
     }
+
+    return ("WTF?");
 }
 
 /*********************************************
- * dbgPop()
+ * read()
  *********************************************
- * return zero or more bytes from the buffer
- * max is either caller's buffer size or
- * however many bytes are in the buffer, 
- * whichever is smaller.  Will set the 
- * 'len' parameter from size of caller's 
- * buffer to the number of bytes actually
- * loaded
+ * core 1 only, drains first.  Copy out up to
+ * len bytes of the log starting at sequence
+ * number from, without taking them, so any
+ * number of readers can follow along.  If the
+ * bytes at from have been overwritten, or 
+ * from isn't a number this log has got to
+ * (a reboot), from moves to the oldest byte
+ * still here.  Returns how many were copied
  ********************************************/
-void logger::dbgPop(char* c, size_t& len)
+size_t logger::read(uint32_t& from, char* c, size_t len)
 {
+    this->drain();
+
+    uint32_t first = this->firstSeq();
+    if ((int32_t)(from - first) < 0 || (int32_t)(seq - from) < 0)
+    {
+        from = first;
+    }
+
+    if (len > seq - from)
+    {
+        len = seq - from;
+    }
+
     if (c && len > 0)
     {
-        if (len > this->consumed())
+        size_t at = (tail + (from - first)) % capacity;
+        size_t part = capacity - at;
+        if (part > len)
         {
-            len = this->consumed();
+            part = len;
         }
 
-        for (size_t ii = 0; ii < len; ++ii)
-        {
-            this->dbgPop(c[ii]);
-        }
+        std::memcpy(c, &buff[at], part);
+        std::memcpy(c + part, buff, len - part);
     }
+
+    return (len);
+}
+
+/*********************************************
+ * getStats()
+ *********************************************
+ * what logging has been costing one core
+ ********************************************/
+void logger::getStats(uint core, logger_stats_t& s)
+{
+    s = rings[core & 0x01].stats;
 }
 
 /*********************************************
- * dbgPop()
+ * stats2text()
  *********************************************
- * return all of the contents of the buffer
- * as a std::string
+ * both cores' counters, text and binary
+ * lines apart so they can be compared, 
+ * each with its histogram in CPU cycles, 
+ * then logged/filtered for each level
  ********************************************/
-std::string logger::dbgPop()
+const std::string logger::stats2text()
 {
-    std::string ret;
+    std::string ret = FMT("Log level %s, compiled down to %s\n", 
+            level2text(threshold).c_str(), level2text(LOG_MIN_LEVEL).c_str());
 
-    size_t len = this->consumed();
-    if (len)
+    for (uint core = 0; core < 2; ++core)
     {
-        char c;
-        ret.resize(len + 1);
-        for (size_t ii = 0; ii < len; ++ii)
+        const logger_stats_t& st = rings[core].stats;
+        ret += FMT("Log core %d: %d dropped, %d cut, logged/filtered", core, st.dropped, st.cut);
+        for (uint8_t l = 0; l < LOG_LEVELS; ++l)
         {
-            dbgPop(c);
-            ret[ii] = c;
+            ret += FMT(" %s %d/%d", level2text(l).c_str(), st.logged[l], st.filtered[l]);
         }
+        ret += "\n";
+
+        for (uint8_t k = 0; k < 2; ++k)
+        {
+            const logger_kind_stats_t& ks = k ? st.fmt : st.text;
+            if (!ks.lines)
+            {
+                continue;
+            }
+
+            ret += FMT("  %s: %d lines, %d bytes, avg %d bytes, avg %d cycles\n", 
+                    k ? "binary" : "text", ks.lines, ks.bytes, ks.bytes / ks.lines, 
+                    ks.totalCycles / ks.writeCycles.count());
+            ret += "  cycles " + hist2text(ks.writeCycles) + "\n";
+        }
+    }
+
+    if (fmtCycles.count())
+    {
+        ret += "Log binary to text on core 1, cycles " + hist2text(fmtCycles) + "\n";
+    }
+
+    if (prefixCycles.count())
+    {
+        ret += "Log prefix on core 1, cycles " + hist2text(prefixCycles) + "\n";
     }
 
+#ifdef DEBUG
+    ret += FMT("Log USB echo: %d bytes, %d behind, %d dropped, %d times full\n",
+            echoStats.bytes, seq - echoSeq, echoStats.dropped, echoStats.full);
+#endif
+
     return (ret);
 }
@@ -1,58 +1,285 @@
 /********************************************************
  * mlogger.h
  ********************************************************
- * common logger, circular buffer with mutexes to handle
- * multicore use
+ * common logger, usable from both cores without locks.
+ * Each core writes whole lines into a ring of its own
+ * (one producer, one consumer, so no locking), stamped
+ * with the time.  Core 1 drains both rings into the
+ * log buffer in time order; that's a circular buffer
+ * that only core 1 touches, and where the newest text
+ * overwrites the oldest.
+ *
+ * The [D0] date time, prefix is added by core 1 when it
+ * drains, from the 64 bit microsecond time each line is
+ * stamped with (see sys/timestamp.h), and the *Fmt()
+ * calls don't format at all;
+ * they store a format id and the raw arguments (see
+ * logfmt.h) and core 1 makes the text.
+ *
+ * Levels: anything under LOG_MIN_LEVEL is gone at
+ * compile time, anything under the runtime threshold
+ * is dropped before it gets near a ring.  A call site
+ * with arguments that cost something to format checks
+ * isOn() first
  * December 2021, M.Brugman
- * 
+ *
  *******************************************************/
 #ifndef MLOGGER_H_
 #define MLOGGER_H_
 
 #include <string>
+#include <string_view>
 #include "pico/multicore.h"
 
+#include "../project.h"
+#include "histogram.h"
+#include "logfmt.h"
+
 // there's only 260K of RAM, be reasonable
-#define LOGGER_BUFFER_SIZE   2048
+#define LOGGER_BUFFER_SIZE   2048       // merged log, what gets pulled
+#define LOGGER_RING_SIZE     1024       // per core, until core 1 drains it
+#define LOGGER_MAX_LINE      256        // longer lines get cut off, and end with
+#define LOGGER_CUT           "[...]\n"  // this so it shows
+#define LOGGER_ECHO_MAX      256        // most echoed out USB per call
+
+// log levels, lowest first
+#define LOG_DEBUG           0
+#define LOG_INFO            1
+#define LOG_WARN            2
+#define LOG_ERROR           3
+#define LOG_LEVELS          4           // as a threshold, nothing at all
+
+// the lowest level that gets compiled in at all.  Release
+// builds lose every debug call, arguments and all
+#ifndef LOG_MIN_LEVEL
+#ifdef DEBUG
+#define LOG_MIN_LEVEL       LOG_DEBUG
+#else
+#define LOG_MIN_LEVEL       LOG_INFO
+#endif
+#endif
+
+// text lines at a level, as statements.  Under
+// LOG_MIN_LEVEL the text is never made; the call is
+// only there for the compiler to check, FMT() and all.
+//   DBG_WRITE(log, FMT("%s::pump %d\n", __FUNCTION__, n));
+#if LOG_MIN_LEVEL <= LOG_DEBUG
+#define DBG_WRITE(l, s)     ((void)(l)->dbgWrite(s))
+#else
+#define DBG_WRITE(l, s)     ((void)sizeof((l)->dbgWrite(s)))
+#endif
+
+#if LOG_MIN_LEVEL <= LOG_INFO
+#define INFO_WRITE(l, s)    ((void)(l)->infoWrite(s))
+#else
+#define INFO_WRITE(l, s)    ((void)sizeof((l)->infoWrite(s)))
+#endif
+
+// what one kind of log call has been costing one core
+struct logger_kind_stats_t
+{
+    uint32_t lines;         // lines written into the ring
+    uint32_t bytes;         // ring space they took, headers and all
+    uint32_t totalCycles;   // CPU cycles spent in the logger, drops too
+    histogram writeCycles;  // per call
+};
+
+struct logger_stats_t
+{
+    logger_kind_stats_t text;   // *Write() calls
+    logger_kind_stats_t fmt;    // *Fmt() calls
+    uint32_t dropped;           // lines that didn't fit, ring full
+    uint32_t cut;               // lines over LOGGER_MAX_LINE, cut off
+    uint32_t logged[LOG_LEVELS];    // calls at or over the threshold
+    uint32_t filtered[LOG_LEVELS];  // and under it, thrown away
+};
+
+// the USB echo, when DEBUG is defined
+struct logger_echo_stats_t
+{
+    uint32_t bytes;         // sent
+    uint32_t dropped;       // overwritten before the host took them
+    uint32_t full;          // calls that found no room at all
+};
+
+// gets every line as core 1 drains it, prefix and all
+typedef void (*log_sink_t)(const char* c, size_t len, void* ctx);
+
+// what's in a ring record
+#define LINE_TEXT           0
+#define LINE_FMT            1
+
 class logger
 {
 public:
     // singleton
     static logger* getInstance();
-    
-    bool initBuffer();      // none of these 4 
+
+    bool initBuffer();      // none of these 4
     size_t available();     // will probably be
     size_t consumed();      // called by outside,
     bool isFull();          // but WTF, hey.
 
-    // two methods to pull whatever is in the buffer
-    void dbgPop(char* c, size_t& len);  // pull up to len chars in buffer
-    std::string dbgPop();               // pull it all as a std::string
+    // core 1 only.  Move whatever both cores have written
+    // into the log buffer, oldest line first
+    void drain();
 
-    // generic write to buffer
-    size_t write(const std::string& s);
+    // core 1 only.  With DEBUG defined, send what's new in
+    // the log out the USB serial port, as much as there's
+    // room for right now and no more than LOGGER_ECHO_MAX.
+    // Never waits on the host; if it isn't reading, the log
+    // moves on without it and what it missed is counted
+    void echo();
+
+    // something else that wants every line, like the log
+    // in flash.  Runs on core 1; set it before core 1 starts
+    void setSink(log_sink_t s, void* ctx)       { sink = s; sinkCtx = ctx; }
+
+    // Every byte that goes into the log has a sequence
+    // number, counting up from 0 at boot.  Reading is by
+    // sequence number and takes nothing out; the oldest
+    // text only goes when newer text overwrites it.
+    // Core 1 only, read() drains first
+    size_t read(uint32_t& from, char* c, size_t len);
+    uint32_t firstSeq()                 { return (seq - this->consumed()); }
+    uint32_t nextSeq()                  { return (seq); }
+
+    // generic write to buffer.  Takes a std::string, a
+    // literal or an FMT() without copying any of them
+    size_t write(std::string_view s);
 
     // more specialized
-    size_t msgWrite(const std::string& ms);     // prefix with [+] date time
-    size_t dbgWrite(const std::string& ds);     // prefix with [D] date time
-    size_t infoWrite(const std::string& is);    // prefix with [I] date time
-    size_t errWrite(const std::string& es);     // prefix with [E] date time
-    size_t warnWrite(const std::string& ws);    // prefix with [W] date time      
+    size_t msgWrite(std::string_view ms);     // prefix with [+] date time
+    size_t errWrite(std::string_view es);     // prefix with [E] date time
+    size_t warnWrite(std::string_view ws);    // prefix with [W] date time
     size_t hexWrite(int i);                     // write in 0x00 hex format
 
+    // prefix with [D] and [+] date time.  Through
+    // DBG_WRITE() and INFO_WRITE(), so the text isn't
+    // made in a build that doesn't keep the level
+    size_t dbgWrite(std::string_view ds)        { return (this->pass(LOG_DEBUG) ? this->put(LINE_TEXT, 'D', ds.data(), ds.length(), 0) : 0); }
+    size_t infoWrite(std::string_view is)       { return (this->pass(LOG_INFO) ? this->put(LINE_TEXT, '+', is.data(), is.length(), 0) : 0); }
+    // binary versions of the above, same prefixes.  Nothing
+    // gets formatted here; like log->dbgFmt<LF_PUMP_ON>(t, sp)
+    template <log_fmt_t F, typename... Args>
+    size_t dbgFmt(Args... args)                 { return (this->pass(LOG_DEBUG) ? this->fmtWrite<F>('D', args...) : 0); }
+    template <log_fmt_t F, typename... Args>
+    size_t infoFmt(Args... args)                { return (this->pass(LOG_INFO) ? this->fmtWrite<F>('+', args...) : 0); }
+    template <log_fmt_t F, typename... Args>
+    size_t errFmt(Args... args)                 { return (this->pass(LOG_ERROR) ? this->fmtWrite<F>('E', args...) : 0); }
+    template <log_fmt_t F, typename... Args>
+    size_t warnFmt(Args... args)                { return (this->pass(LOG_WARN) ? this->fmtWrite<F>('W', args...) : 0); }
+
+    // would a line at this level get logged?  Constant
+    // false under LOG_MIN_LEVEL, so a block behind it
+    // compiles away
+    bool isOn(uint8_t level)
+    {
+#if LOG_MIN_LEVEL > LOG_DEBUG
+        if (level < LOG_MIN_LEVEL)
+        {
+            return (false);
+        }
+#endif
+        return (level >= threshold);
+    }
+
+    // runtime threshold, either core; never under LOG_MIN_LEVEL
+    void setLevel(uint8_t level);
+    uint8_t getLevel()                          { return (threshold); }
+    static const std::string level2text(uint8_t level);
+
+    void getStats(uint core, logger_stats_t& s);
+    const std::string stats2text();
+
+    // the calling core's SysTick, for timing short things
+    static uint32_t cycles();
+
 private:
+    // one core's lines on their way to core 1.  The
+    // owning core only moves head, core 1 only moves
+    // tail.  A line never wraps; if it won't fit before
+    // the end it starts over at the front
+    struct ring_t
+    {
+        uint8_t buff[LOGGER_RING_SIZE];
+        volatile uint32_t head;     // next byte to write
+        volatile uint32_t tail;     // next byte to read
+        logger_stats_t stats;       // owning core only
+    };
+
+    // each line in a ring starts with one of these
+    struct line_hdr_t
+    {
+        uint32_t timeLo;            // time_us_64() when written, in two
+        uint32_t timeHi;            // halves so the header packs to 12
+        uint16_t len;               // body following, or LINE_WRAP
+        uint8_t kind;               // LINE_TEXT or LINE_FMT
+        char level;                 // prefix letter, 0 for none
+    };
+
+    static uint64_t lineTime(const line_hdr_t& h)   { return (((uint64_t)h.timeHi << 32) | h.timeLo); }
+
+    template <log_fmt_t F, typename... Args>
+    size_t fmtWrite(char level, Args... args)
+    {
+        static_assert(sizeof...(Args) == logFmtArgs(logFormats[F]), "argument count doesn't match the format");
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "too many arguments for one log record");
+
+        uint32_t start = cycles();
+        log_fmt_rec_t r;
+        r.fmt = F;
+        r.count = 0;
+        r.used = 0;
+        logArgs(r, args...);
+
+        return (this->put(LINE_FMT, level, &r, logRecSize(r), start));
+    }
+
+    // isOn(), counting the call either way
+    bool pass(uint8_t level)
+    {
+#if LOG_MIN_LEVEL > LOG_DEBUG
+        if (level < LOG_MIN_LEVEL)
+        {
+            return (false);
+        }
+#endif
+
+        logger_stats_t& st = rings[get_core_num()].stats;
+        if (level < threshold)
+        {
+            ++st.filtered[level];
+            return (false);
+        }
+
+        ++st.logged[level];
+        return (true);
+    }
+
     bool isEmpty();
-    size_t addChar(char c);
-    void dbgPop(char& c);
+    size_t put(uint8_t kind, char level, const void* body, size_t len, uint32_t start);
+    size_t addChars(const char* c, size_t len);
+    bool ringPut(ring_t& r, uint8_t kind, char level, const void* body, size_t len,
+                 const char* mark = NULL, size_t markLen = 0);
+    bool ringPeek(ring_t& r, line_hdr_t& h, uint32_t& pos);
 
     char buff[LOGGER_BUFFER_SIZE];
     size_t head;
     size_t tail;
     size_t used;
     size_t capacity;
-    mutex_t dbgMtx;
+    uint32_t seq;               // sequence number of the next byte in
+    ring_t rings[2];
+    histogram fmtCycles;        // core 1 making text of binary lines
+    histogram prefixCycles;     // and the [D0] date time, prefix
+    uint32_t echoSeq;           // next byte out USB
+    logger_echo_stats_t echoStats;
+    volatile uint8_t threshold; // lowest level logged
+    log_sink_t sink;
+    void* sinkCtx;
 
     static logger* instance;
 };
 
-#endif // MLOGGER_H_
\ No newline at end of file
+#endif // MLOGGER_H_
@@ -0,0 +1,73 @@
+/********************************************************
+ * spsc.h
+ ********************************************************
+ * Lock-free single producer, single consumer ring queue.
+ * One core pushes, the other pops; neither ever waits
+ * on the other.  The producer only writes head, the
+ * consumer only writes tail, and a barrier between the
+ * slot and the index makes sure the other core never
+ * sees an index before the slot it covers.
+ *
+ * T has to be plain data, it gets copied in and out.
+ * Size has to be a power of two; one slot is always
+ * left empty to tell full from empty
+ *
+ *******************************************************/
+#ifndef SPSC_H_
+#define SPSC_H_
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+template <typename T, uint16_t Size>
+class spscQueue
+{
+public:
+    static_assert((Size & (Size - 1)) == 0 && Size >= 2, "queue size has to be a power of two");
+
+    spscQueue() : head(0), tail(0) {}
+    ~spscQueue() {}
+
+    // producer side; false if the queue is full
+    bool push(const T& item)
+    {
+        uint16_t h = head;
+        uint16_t next = (h + 1) & (Size - 1);
+        if (next == tail)
+        {
+            return (false);
+        }
+
+        slots[h] = item;
+        __dmb();
+        head = next;
+        return (true);
+    }
+
+    // consumer side; false if there's nothing there
+    bool pop(T& item)
+    {
+        uint16_t t = tail;
+        if (t == head)
+        {
+            return (false);
+        }
+
+        __dmb();
+        item = slots[t];
+        __dmb();
+        tail = (t + 1) & (Size - 1);
+        return (true);
+    }
+
+    // either side, a snapshot
+    uint16_t count() const                  { return ((head - tail) & (Size - 1)); }
+    bool isFull() const                     { return (count() == Size - 1); }
+
+private:
+    T slots[Size];
+    volatile uint16_t head;     // next slot to push into
+    volatile uint16_t tail;     // next slot to pop from
+};
+
+#endif // SPSC_H_
@@ -0,0 +1,413 @@
+/********************************************************
+ * telemetry.cpp
+ ********************************************************
+ * Publish/subscribe bus between the cores.  See the
+ * comment in telemetry.h
+ *
+ *******************************************************/
+#include <cstring>
+
+#include "telemetry.h"
+#include "ipc.h"                // for the doorbells
+#include "hardware/sync.h"
+#include "../utils/stringFormat.h"
+
+telemetry* telemetry::instance = NULL;
+
+// storage for one topic; the ring is a slot long even
+// for topics without history so it always has a size
+template <typename T, uint8_t Depth>
+struct topic_store_t
+{
+    T   latest;
+    T   ring[Depth ? Depth : 1];
+};
+
+#define TOPIC_STORE(id, type, depth)    static topic_store_t<type, depth> store_##id;
+TELEMETRY_TOPICS(TOPIC_STORE)
+#undef TOPIC_STORE
+
+// where each topic lives and how big it is
+struct topic_desc_t
+{
+    uint16_t    size;
+    uint8_t     depth;
+    uint8_t*    latest;
+    uint8_t*    ring;
+};
+
+#define TOPIC_DESC(id, type, depth)     { sizeof(type), depth, (uint8_t*)&store_##id.latest, (uint8_t*)store_##id.ring },
+static const topic_desc_t topics[TP_COUNT] =
+{
+    TELEMETRY_TOPICS(TOPIC_DESC)
+};
+#undef TOPIC_DESC
+
+// one callback on one core
+struct topic_sub_t
+{
+    topic_t     topic;
+    topic_cb_t  cb;
+    void*       ctx;
+};
+
+// Every topic has its own seqlock; seq is odd while it's
+// being written and seq / 2 is how many values have been
+// published.  Publishers, from either core, are kept apart
+// by one hardware spinlock held just for the copy in
+static spin_lock_t* pubLock = NULL;
+static volatile uint32_t seq[TP_COUNT];
+static volatile uint32_t pubUs[TP_COUNT];  // when each was last published
+static topic_stats_t stats[TP_COUNT];
+
+// subscriptions are only touched by their own core; the
+// masks are read by publishers to see who to tell
+static topic_sub_t subs[2][TELEMETRY_MAX_SUBS];
+static uint8_t subCount[2];
+static volatile uint32_t subMask[2];
+static volatile bool pending[2][TP_COUNT];
+
+/********************************************************
+ * getInstance
+ ********************************************************
+ * get the single instance of the class, instantiate
+ * if necessary.
+ *******************************************************/
+telemetry* telemetry::getInstance()
+{
+    if (!instance)
+    {
+        instance = new telemetry();
+    }
+
+    return (instance);
+}
+
+/*******************************************************
+ * init()
+ *******************************************************
+ * clear everything out and claim the publishers'
+ * spinlock.  Call it before core 1 starts
+ ******************************************************/
+bool telemetry::init()
+{
+    for (uint8_t ii = 0; ii < TP_COUNT; ++ii)
+    {
+        seq[ii] = 0;
+        pubUs[ii] = 0;
+        pending[0][ii] = false;
+        pending[1][ii] = false;
+    }
+
+    std::memset(stats, 0, sizeof(stats));
+    subCount[0] = subCount[1] = 0;
+    subMask[0] = subMask[1] = 0;
+
+    if (!pubLock)
+    {
+        pubLock = spin_lock_instance(spin_lock_claim_unused(true));
+    }
+
+    return (pubLock != NULL);
+}
+
+/*******************************************************
+ * publishRaw()
+ *******************************************************
+ * copy a value into the topic's slot, and its ring if
+ * it has one, then flag it for whoever subscribed
+ ******************************************************/
+void telemetry::publishRaw(topic_t t, const void* v)
+{
+    if (t >= TP_COUNT || !pubLock)
+    {
+        return;
+    }
+
+    const topic_desc_t& d = topics[t];
+    bool busy = is_spin_locked(pubLock);
+    uint32_t start = time_us_32();
+
+    uint32_t save = spin_lock_blocking(pubLock);
+    uint32_t locked = time_us_32();
+    uint32_t n = seq[t] >> 1;
+    seq[t] = seq[t] + 1;
+    __dmb();
+
+    std::memcpy(d.latest, v, d.size);
+    if (d.depth)
+    {
+        std::memcpy(d.ring + ((n & (d.depth - 1)) * d.size), v, d.size);
+    }
+
+    __dmb();
+    seq[t] = seq[t] + 1;
+    pubUs[t] = locked;
+
+    // stats are only written with the lock held
+    uint32_t elapsed = time_us_32() - start;
+    topic_stats_t& st = stats[t];
+    if (busy)
+    {
+        ++st.contended;
+    }
+    st.lockWaitUs.add(locked - start);
+    ++st.publishes;
+    st.totalUs += elapsed;
+    if (elapsed > st.maxUs)
+    {
+        st.maxUs = elapsed;
+    }
+    spin_unlock(pubLock, save);
+
+    // the subscriber clears its flag before it reads, so
+    // one that lands in between just gets read twice
+    uint me = get_core_num();
+    for (uint core = 0; core < 2; ++core)
+    {
+        if (subMask[core] & (1 << t))
+        {
+            pending[core][t] = true;
+            if (core != me)
+            {
+                ringDoorbell(core);
+            }
+        }
+    }
+}
+
+/*******************************************************
+ * readRaw()
+ *******************************************************
+ * copy out the latest value, again if a publish got
+ * in the way
+ ******************************************************/
+bool telemetry::readRaw(topic_t t, void* v, uint32_t* gen)
+{
+    if (t >= TP_COUNT)
+    {
+        return (false);
+    }
+
+    const topic_desc_t& d = topics[t];
+    uint32_t start;
+
+    while (true)
+    {
+        start = seq[t];
+        if (start & 1)
+        {
+            ++stats[t].retries;
+            continue;
+        }
+        __dmb();
+
+        std::memcpy(v, d.latest, d.size);
+
+        __dmb();
+        if (seq[t] == start)
+        {
+            break;
+        }
+        ++stats[t].retries;
+    }
+
+    if (gen)
+    {
+        *gen = start >> 1;
+    }
+
+    return (start != 0);
+}
+
+/*******************************************************
+ * historyRaw()
+ *******************************************************
+ * copy out up to max of the topic's last values,
+ * newest first
+ ******************************************************/
+uint8_t telemetry::historyRaw(topic_t t, void* v, uint8_t max)
+{
+    if (t >= TP_COUNT || !topics[t].depth)
+    {
+        return (0);
+    }
+
+    const topic_desc_t& d = topics[t];
+    uint8_t* out = (uint8_t*)v;
+    uint32_t start;
+    uint32_t count;
+
+    while (true)
+    {
+        start = seq[t];
+        if (start & 1)
+        {
+            ++stats[t].retries;
+            continue;
+        }
+        __dmb();
+
+        uint32_t n = start >> 1;
+        count = (n < d.depth) ? n : d.depth;
+        if (count > max)
+        {
+            count = max;
+        }
+
+        for (uint32_t ii = 0; ii < count; ++ii)
+        {
+            uint32_t slot = (n - 1 - ii) & (d.depth - 1);
+            std::memcpy(out + (ii * d.size), d.ring + (slot * d.size), d.size);
+        }
+
+        __dmb();
+        if (seq[t] == start)
+        {
+            break;
+        }
+        ++stats[t].retries;
+    }
+
+    return ((uint8_t)count);
+}
+
+/*******************************************************
+ * subscribe()
+ *******************************************************
+ * hang a callback on a topic for the calling core.
+ * It runs from that core's poll() after each publish,
+ * including ones made before the subscribe
+ ******************************************************/
+bool telemetry::subscribe(topic_t t, topic_cb_t cb, void* ctx)
+{
+    uint core = get_core_num();
+
+    if (t >= TP_COUNT || !cb || subCount[core] >= TELEMETRY_MAX_SUBS)
+    {
+        return (false);
+    }
+
+    topic_sub_t& s = subs[core][subCount[core]];
+    s.topic = t;
+    s.cb = cb;
+    s.ctx = ctx;
+    ++subCount[core];
+
+    subMask[core] = subMask[core] | (1 << t);
+    pending[core][t] = (seq[t] != 0);
+
+    return (true);
+}
+
+/*******************************************************
+ * poll()
+ *******************************************************
+ * call this from each core's loop.  Runs the callbacks
+ * for topics published since the last poll; a topic
+ * published several times in between only gets one
+ * call, the callback reads the latest value
+ ******************************************************/
+uint8_t telemetry::poll()
+{
+    uint core = get_core_num();
+    uint8_t ran = 0;
+
+    for (uint8_t t = 0; t < TP_COUNT; ++t)
+    {
+        if (!pending[core][t])
+        {
+            continue;
+        }
+
+        pending[core][t] = false;
+        __dmb();
+        stats[t].deliveryUs[core].add(time_us_32() - pubUs[t]);
+
+        for (uint8_t ii = 0; ii < subCount[core]; ++ii)
+        {
+            if (subs[core][ii].topic == t)
+            {
+                subs[core][ii].cb((topic_t)t, subs[core][ii].ctx);
+                ++stats[t].notifies;
+                ++ran;
+            }
+        }
+    }
+
+    return (ran);
+}
+
+/*******************************************************
+ * noteAge()
+ *******************************************************
+ * how old a value was when it got used
+ ******************************************************/
+void telemetry::noteAge(topic_t t, uint32_t sampleUs)
+{
+    if (t < TP_COUNT)
+    {
+        stats[t].ageMs.add((time_us_32() - sampleUs) / 1000);
+    }
+}
+
+/*******************************************************
+ * getStats()
+ *******************************************************
+ * what one topic has been costing.  A snapshot, good
+ * enough for a look at it
+ ******************************************************/
+void telemetry::getStats(topic_t t, topic_stats_t& s)
+{
+    if (t < TP_COUNT)
+    {
+        s = stats[t];
+    }
+}
+
+/*******************************************************
+ * stats2text()
+ *******************************************************
+ * every topic's counters, then whichever histograms
+ * have something in them
+ ******************************************************/
+const std::string telemetry::stats2text()
+{
+    std::string ret;
+
+    for (uint8_t t = 0; t < TP_COUNT; ++t)
+    {
+        const topic_stats_t& st = stats[t];
+        uint32_t avg = st.publishes ? (uint32_t)(((uint64_t)st.totalUs * 100) / st.publishes) : 0;
+        ret += FMT("Topic %s: %d published, avg %d.%02dus, max %dus, %d retries, %d notified, %d contended\n", 
+                this->topic2text((topic_t)t).c_str(), st.publishes, avg / 100, avg % 100, 
+                st.maxUs, st.retries, st.notifies, st.contended);
+
+        if (st.lockWaitUs.count())      ret += "  lock wait us " + hist2text(st.lockWaitUs) + "\n";
+        if (st.deliveryUs[0].count())   ret += "  to core 0 us " + hist2text(st.deliveryUs[0]) + "\n";
+        if (st.deliveryUs[1].count())   ret += "  to core 1 us " + hist2text(st.deliveryUs[1]) + "\n";
+        if (st.ageMs.count())           ret += "  age ms " + hist2text(st.ageMs) + "\n";
+    }
+
+    return (ret);
+}
+
+/*******************************************************
+ * topic2text()
+ *******************************************************
+ * convenience method to display a topic in human
+ * readable form
+ ******************************************************/
+const std::string telemetry::topic2text(topic_t t)
+{
+    switch (t)
+    {
+        case TP_TEMPERATURE:        return ("temperature");     break;
+        case TP_PUMP:               return ("pump");            break;
+        case TP_NET_STATUS:         return ("net status");      break;
+        case TP_CONFIG:             return ("config");          break;
+        case TP_COUNT:              break;
+    }
+
+    return ("WTF?");
+}
@@ -0,0 +1,174 @@
+/********************************************************
+ * telemetry.h
+ ********************************************************
+ * Publish/subscribe bus between the cores.  Topics are
+ * fixed at compile time in TELEMETRY_TOPICS below; each
+ * one has a payload type, a latest-value slot and, if
+ * asked for, a ring of its last few values.
+ *
+ * Publishing copies the value in under the topic's own
+ * seqlock, so readers on either core never wait and only
+ * the one topic gets copied.  A core that subscribed to
+ * the topic gets it flagged, and the other core gets its
+ * doorbell rung; the callbacks run from that core's own
+ * poll(), never from the publisher.
+ *
+ * Adding shared data is a line in TELEMETRY_TOPICS and a
+ * payload struct, nothing in inter_core_t or ipc.cpp.
+ *
+ *******************************************************/
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <string>
+#include <type_traits>
+
+#include "pico/stdlib.h"
+
+#include "../pilznet/pilznet.h"     // for ipv4_addr_t
+#include "histogram.h"
+#include "../utils/temperature.h"
+
+// callbacks a core can hang on topics, all told
+#define TELEMETRY_MAX_SUBS  8
+
+// latest probe reading, published by core 1
+struct tp_temperature_t
+{
+    temp_t      centiF;         // probe reading, hundredths of a degree F
+    uint32_t    count;          // readings taken so far
+    uint32_t    readUs;         // time_us_32() when it was read
+};
+
+// refrigeration pump, published by core 0 when the
+// reefer state machine moves
+struct tp_pump_t
+{
+    bool        running;        // pump output on
+    uint8_t     state;          // reefer_state_t
+    uint32_t    runtimeSeconds; // of the current/last chill
+};
+
+// network, published by core 1 on connect and clock sync
+struct tp_net_status_t
+{
+    bool        wifiConnected;  // wifi is connected
+    bool        clockReady;     // clock has been set
+    ipv4_addr_t ipAddress;      // current IP address
+};
+
+// settings in nvm changed, published by core 0
+#define CFG_SETPOINT        0x01
+#define CFG_BRIGHTNESS      0x02
+#define CFG_NETWORK         0x04        // ssid, password, timezone
+#define CFG_ALL             0xff
+
+struct tp_config_t
+{
+    uint32_t    what;           // CFG_* bits
+};
+
+// The topics: id, payload type, history depth.  Depth is
+// 0 for only the latest value, otherwise a power of two
+// no bigger than TOPIC_HISTORY_MAX
+#define TOPIC_HISTORY_MAX   16
+#define TELEMETRY_TOPICS(X)                         \
+    X(TP_TEMPERATURE,   tp_temperature_t,   16)     \
+    X(TP_PUMP,          tp_pump_t,          8)      \
+    X(TP_NET_STATUS,    tp_net_status_t,    0)      \
+    X(TP_CONFIG,        tp_config_t,        0)
+
+enum topic_t
+{
+#define TOPIC_ENUM(id, type, depth)     id,
+    TELEMETRY_TOPICS(TOPIC_ENUM)
+#undef TOPIC_ENUM
+    TP_COUNT
+};
+
+// topic id to payload type, so publish() and read() are
+// checked at compile time
+template <topic_t T> struct topic_info;
+
+#define TOPIC_INFO(id, type, depth)                                                         \
+    template <> struct topic_info<id>                                                       \
+    {                                                                                       \
+        typedef type value_t;                                                               \
+        static const uint8_t HISTORY = depth;                                               \
+        static_assert(std::is_trivially_copyable<type>::value, #type " has to be plain data"); \
+        static_assert((depth & (depth - 1)) == 0, #id " history has to be a power of two");  \
+        static_assert(depth <= TOPIC_HISTORY_MAX, #id " history is too deep");             \
+    };
+TELEMETRY_TOPICS(TOPIC_INFO)
+#undef TOPIC_INFO
+
+// called from poll() on the core that subscribed
+typedef void (*topic_cb_t)(topic_t t, void* ctx);
+
+// what one topic has been costing
+struct topic_stats_t
+{
+    uint32_t publishes;     // values published
+    uint32_t totalUs;       // time spent publishing them
+    uint32_t maxUs;         // longest publish
+    uint32_t retries;       // reads that had to go again
+    uint32_t notifies;      // callbacks run, both cores
+    uint32_t contended;     // publishes that found the lock held
+    histogram lockWaitUs;   // spinning for the publishers' lock
+    histogram deliveryUs[2];// publish to callback, per subscribing core
+    histogram ageMs;        // sample to use, see noteAge()
+};
+
+class telemetry
+{
+public:
+    // singleton
+    static telemetry* getInstance();
+
+    // call before core 1 starts
+    bool init();
+
+    // copy a value in, flag it for subscribers
+    template <topic_t T>
+    void publish(const typename topic_info<T>::value_t& v)      { publishRaw(T, &v); }
+
+    // latest value; false if nothing has been published yet.
+    // gen, if given, is the number of values published
+    template <topic_t T>
+    bool read(typename topic_info<T>::value_t& v, uint32_t* gen = NULL)
+                                                                { return (readRaw(T, &v, gen)); }
+
+    // up to max of the last values, newest first; returns
+    // how many it got
+    template <topic_t T>
+    uint8_t history(typename topic_info<T>::value_t* v, uint8_t max)
+                                                                { return (historyRaw(T, v, max)); }
+
+    // for the calling core.  Registered at startup, there's
+    // no unsubscribe
+    bool subscribe(topic_t t, topic_cb_t cb, void* ctx = NULL);
+
+    // run the calling core's callbacks for anything that
+    // was published since it last looked; returns how many
+    uint8_t poll();
+
+    // the consumer of a topic says when it used a value
+    // taken at sampleUs (time_us_32()), to see how stale
+    // the data is by the time it matters.  One core only
+    void noteAge(topic_t t, uint32_t sampleUs);
+
+    void getStats(topic_t t, topic_stats_t& s);
+    const std::string stats2text();
+    const std::string topic2text(topic_t t);
+
+private:
+    telemetry() {}
+
+    void publishRaw(topic_t t, const void* v);
+    bool readRaw(topic_t t, void* v, uint32_t* gen);
+    uint8_t historyRaw(topic_t t, void* v, uint8_t max);
+
+    static telemetry* instance;
+};
+
+#endif // TELEMETRY_H_
@@ -24,6 +24,7 @@
 #include <cstring>
 #include <string>
 #include <ctime>
+#include <climits>
 #include <vector>
 
 #include "project.h"
@@ -32,14 +33,23 @@
 #include "hub75.h"
 #include "./sys/ir.h"
 #include "./ipc/ipc.h"
+#include "./ipc/telemetry.h"
 #include "./ipc/mlogger.h"
 #include "./sys/walltime.h"
 #include "./utils/stringFormat.h"
+#include "./utils/temperature.h"
 #include "./sys/nvm.h"
+#include "./sys/flashlog.h"
+#include "./ds1820/ds1820.h"
 
 static inter_core_t ipcCore0Data;   // for sharing data between cores
 static uint32_t msTick = 0;         // tick counter
 static nvm* data = NULL;            // non-vol data storage handler
+static panel_t display;             // LED matrix; too big for the stack
+static uint32_t brightSaveMs = 0;   // when to save brightness to nvm, 0 if saved
+static telemetry* bus = NULL;       // published data between cores
+static tp_temperature_t probeTemp;  // latest off the bus
+static flashlog* flog = NULL;       // the log, kept in flash
 
 /********************************************
  * heartBeatLED()
@@ -67,6 +77,253 @@ void heartBeatLED()
     else                            startTime = to_ms_since_boot(get_absolute_time());
 }
 
+/********************************************
+ * temperatureIn()
+ ********************************************
+ * telemetry callback; core 1 read the probe
+********************************************/
+void temperatureIn(topic_t t, void* ctx)
+{
+    bus->read<TP_TEMPERATURE>(probeTemp);
+}
+
+/********************************************
+ * netStatusIn()
+ ********************************************
+ * telemetry callback; log what changed on
+ * the network side
+********************************************/
+void netStatusIn(topic_t t, void* ctx)
+{
+    static tp_net_status_t last = { false, false, { { 0, 0, 0, 0 } } };
+    static logger* log = logger::getInstance();
+    tp_net_status_t ns;
+
+    if (!bus->read<TP_NET_STATUS>(ns))
+    {
+        return;
+    }
+
+    if (ns.wifiConnected != last.wifiConnected)     DBG_WRITE(log, FMT("%s::wifi %s\n", __FUNCTION__, ns.wifiConnected ? "connected" : "disconnected"));
+    if (ns.clockReady != last.clockReady)           DBG_WRITE(log, FMT("%s::clock %s\n", __FUNCTION__, ns.clockReady ? "set" : "not set"));
+    if (std::memcmp(&ns.ipAddress, &last.ipAddress, sizeof(ns.ipAddress)))
+    {
+        DBG_WRITE(log, FMT("%s::IP addr %s\n", __FUNCTION__, pilznet::ip2text(ns.ipAddress).c_str()));
+    }
+
+    last = ns;
+}
+
+/********************************************
+ * configChanged()
+ ********************************************
+ * let core 1 know settings in nvm moved
+********************************************/
+void configChanged(uint32_t what)
+{
+    tp_config_t cfg;
+    cfg.what = what;
+    bus->publish<TP_CONFIG>(cfg);
+}
+
+/********************************************
+ * logLines()
+ ********************************************
+ * put a block of text in the log a line at
+ * a time, so every line gets its prefix
+********************************************/
+void logLines(const std::string& text)
+{
+    logger* log = logger::getInstance();
+    size_t pos = 0;
+
+    while (pos < text.length())
+    {
+        size_t eol = text.find('\n', pos);
+        if (eol == std::string::npos)
+        {
+            eol = text.length() - 1;
+        }
+
+        DBG_WRITE(log, text.substr(pos, eol - pos + 1));
+        pos = eol + 1;
+    }
+}
+
+/********************************************
+ * changeBrightness()
+ ********************************************
+ * set the display brightness and hold off the
+ * nvm save until it stops changing, so a few
+ * key presses in a row only cost one write
+********************************************/
+void changeBrightness(int16_t pct)
+{
+    if (pct < BRIGHTNESS_MIN)       pct = BRIGHTNESS_MIN;
+    if (pct > BRIGHTNESS_MAX)       pct = BRIGHTNESS_MAX;
+
+    display.setBrightness((uint8_t)pct);
+    data->setBrightness((uint8_t)pct);
+    brightSaveMs = msTick + BRIGHTNESS_SAVE_MS;
+
+    logger::getInstance()->dbgFmt<LF_BRIGHTNESS>(__FUNCTION__, pct);
+}
+
+/********************************************
+ * serviceBrightness()
+ ********************************************
+ * pick up brightness asked for over the net
+ * (core 1 passes it along) and do the held
+ * off nvm save
+********************************************/
+void serviceBrightness()
+{
+    static uint32_t lastCount = 0;
+
+    if (ipcCore0Data.brightCount != lastCount)
+    {
+        lastCount = ipcCore0Data.brightCount;
+        changeBrightness(ipcCore0Data.brightness);
+    }
+
+    if (brightSaveMs && (int32_t)(msTick - brightSaveMs) >= 0)
+    {
+        brightSaveMs = 0;
+        data->write();
+        configChanged(CFG_BRIGHTNESS);
+    }
+}
+
+/********************************************
+ * showReadouts()
+ ********************************************
+ * Keep the temperature and setpoint on the 
+ * panel.  Text is only rebuilt when a value
+ * moves a tenth of a degree; the display
+ * only rewrites the digits that changed
+********************************************/
+void showReadouts(bool pumpRunning)
+{
+    static bool first = true;
+    static readout_t tempField;
+    static readout_t spField;
+    static int32_t lastTemp = INT32_MIN;
+    static int32_t lastSp = INT32_MIN;
+    static bool lastPump = false;
+
+    if (first)
+    {
+        display.initReadout(tempField, 0, 0, 5, RC_NORMAL);
+        display.initReadout(spField, 0, 8, 5, RC_SETPOINT);
+        first = false;
+    }
+
+    int32_t temp = probeTemp.centiF / 10;
+    if (temp != lastTemp || pumpRunning != lastPump)
+    {
+        readout_color_t color = pumpRunning ? RC_COOL : RC_NORMAL;
+
+        if (probeTemp.centiF <= BAD_TEMPERATURE_VALUE || probeTemp.centiF >= TEMP_F(1000))
+        {
+            display.drawReadout(tempField, "--.-F", color);
+        }
+        else
+        {
+            char t[TEMP_TEXT];
+            temp2text(probeTemp.centiF, 1, t, sizeof(t));
+            display.drawReadout(tempField, FMT("%4sF", t), color);
+        }
+
+        lastTemp = temp;
+        lastPump = pumpRunning;
+    }
+
+    int32_t sp = data->getSetpoint() / 10;
+    if (sp != lastSp)
+    {
+        char t[TEMP_TEXT];
+        temp2text(data->getSetpoint(), 1, t, sizeof(t));
+        display.drawReadout(spField, FMT("%4sF", t), RC_SETPOINT);
+        lastSp = sp;
+    }
+}
+
+/********************************************
+ * serviceResponses()
+ ********************************************
+ * answers from core 1 for commands issued by
+ * I/R.  Any number can be in flight, they're
+ * matched up by id.  Results are already in
+ * the shared data by the time an answer shows
+********************************************/
+void serviceResponses()
+{
+    static logger* log = logger::getInstance();
+    ipc_response_t resp;
+
+    if (!getResponse(resp))
+    {
+        return;
+    }
+
+    updateSharedData(US_NONE, ipcCore0Data);
+
+    if (!resp.ok)
+    {
+        log->warnWrite(FMT("%s::#%d %s failed in %dus\n", __FUNCTION__, resp.id, 
+                cmd2text(resp.cmd).c_str(), resp.latencyUs));
+        return;
+    }
+
+    switch (resp.cmd)
+    {
+        case IS_GET_IP:
+        {
+            DBG_WRITE(log, FMT("%s::#%d Got IP Addr %s in %dus\n", __FUNCTION__, resp.id, 
+                    pilznet::ip2text(ipcCore0Data.ipAddress).c_str(), resp.latencyUs));
+        }  break;
+
+        case IS_GET_MAC:
+        {
+            DBG_WRITE(log, FMT("%s::#%d Got MAC Addr %s in %dus\n", __FUNCTION__, resp.id, 
+                    pilznet::mac2text(ipcCore0Data.macAddress).c_str(), resp.latencyUs));
+        }  break;
+
+        case IS_DO_SCAN:
+        {
+            DBG_WRITE(log, FMT("%s::#%d Scan done in %dus:\n", __FUNCTION__, resp.id, resp.latencyUs));
+
+            // 5 lines an access point, don't format them for nothing
+            if (!log->isOn(LOG_DEBUG))
+            {
+                break;
+            }
+
+            const scan_data_t& scan = ipcCore0Data.scanResult;
+            DBG_WRITE(log, FMT(" Found %d access points:\n", scan.found));
+            for (uint8_t ii = 0; ii < scan.count; ++ii)
+            {
+                const ap_data_t& ap = scan.apData[ii];
+                DBG_WRITE(log, FMT("  Name: %s\n", ap.ssid));
+                DBG_WRITE(log, FMT("    BSSID: %s\n", pilznet::mac2text(ap.bssid).c_str()));
+                DBG_WRITE(log, FMT("    Strength: %ddbm\n", ap.strength));
+                DBG_WRITE(log, FMT("    Channel: %d\n", ap.channel));
+                DBG_WRITE(log, FMT("    Encryption: %s\n", pilznet::encryption2text(ap.encryption).c_str()));
+            }
+            if (scan.found > scan.count)
+            {
+                DBG_WRITE(log, FMT("  (%d more not kept)\n", scan.found - scan.count));
+            }
+        }  break;
+
+        default:
+        {
+            DBG_WRITE(log, FMT("%s::#%d %s done in %dus\n", __FUNCTION__, resp.id, 
+                    cmd2text(resp.cmd).c_str(), resp.latencyUs));
+        }
+    }
+}
+
 /********************************************
  * ledIRTest()
  ********************************************
@@ -74,10 +331,8 @@ void heartBeatLED()
 ********************************************/
 bool ledIRTest()
 {
-    static bool inProgress = false;
     static ir infra(PIN_IR);
     static uint8_t value = 0;
-    static uint32_t startTime = 0;
     static logger* log = logger::getInstance();
 
     // was there a code received?
@@ -91,49 +346,31 @@ bool ledIRTest()
             {
                 case KEY_0:
                 {
-                    log->dbgWrite(stringFormat("%s::seconds since boot: %d\n", __FUNCTION__, to_ms_since_boot(get_absolute_time()) / 1000));
+                    DBG_WRITE(log, FMT("%s::seconds since boot: %d\n", __FUNCTION__, to_ms_since_boot(get_absolute_time()) / 1000));
                 }  break;
 
                 case KEY_1:
                 {
-                    log->dbgWrite(stringFormat("%s::%s %s\n", __FUNCTION__,
+                    DBG_WRITE(log, FMT("%s::%s %s\n", __FUNCTION__,
                         walltime::timeString().c_str(), walltime::dateString().c_str()));
                 }  break;
 
                 case KEY_2:
                 {
-                    if (!inProgress)
-                    {
-                        log->dbgWrite(stringFormat("%s::Asking for IP Address\n", __FUNCTION__));
-                        startTime = msTick;
-                        inProgress = true;
-                        ipcCore0Data.cmd = IS_GET_IP;
-                        updateSharedData(US_NEW_CMD, ipcCore0Data);
-                    }
+                    uint16_t id = postRequest(IS_GET_IP);
+                    DBG_WRITE(log, FMT("%s::Asking for IP Address, #%d\n", __FUNCTION__, id));
                 }  break;
 
                 case KEY_3:
                 {
-                    if (!inProgress)
-                    {
-                        log->dbgWrite(stringFormat("%s::Asking for MAC Address\n", __FUNCTION__));
-                        startTime = msTick;
-                        inProgress = true;
-                        ipcCore0Data.cmd = IS_GET_MAC;
-                        updateSharedData(US_NEW_CMD, ipcCore0Data);
-                    }
+                    uint16_t id = postRequest(IS_GET_MAC);
+                    DBG_WRITE(log, FMT("%s::Asking for MAC Address, #%d\n", __FUNCTION__, id));
                 }  break;
 
                 case KEY_4:
                 {
-                    if (!inProgress)
-                    {
-                        log->dbgWrite(stringFormat("%s::Asking for net scan\n", __FUNCTION__));
-                        startTime = msTick;
-                        inProgress = true;
-                        ipcCore0Data.cmd = IS_DO_SCAN;
-                        updateSharedData(US_NEW_CMD, ipcCore0Data);
-                    }
+                    uint16_t id = postRequest(IS_DO_SCAN);
+                    DBG_WRITE(log, FMT("%s::Asking for net scan, #%d\n", __FUNCTION__, id));
                 }  break;
 
                 case KEY_5:
@@ -143,88 +380,108 @@ bool ledIRTest()
 
                 case KEY_6:
                 {
-                    log->dbgWrite("Read NVM\n");
+                    DBG_WRITE(log, "Read NVM\n");
                     data->load();
                     data->dump2String();
+                    configChanged(CFG_ALL);
                 }  break;
 
                 case KEY_7:
                 {
-                    log->dbgWrite("Write NVM\n");
+                    DBG_WRITE(log, "Write NVM\n");
                     data->write();
                 }  break;
 
                 case KEY_8:
                 {
-                    log->dbgWrite("Set NVM defaults\n");
+                    DBG_WRITE(log, "Set NVM defaults\n");
                     data->setDefaults();
                     data->write();
+                    configChanged(CFG_ALL);
                 }  break;
 
                 case KEY_9:
                 {
-                    log->dbgWrite(stringFormat("Current temp %0.2f\n", ipcCore0Data.temperatue));
+                    tp_temperature_t temps[TOPIC_HISTORY_MAX];
+                    uint8_t n = bus->history<TP_TEMPERATURE>(temps, TOPIC_HISTORY_MAX);
+
+                    char t[TEMP_TEXT];
+                    temp2text(probeTemp.centiF, 2, t, sizeof(t));
+                    DBG_WRITE(log, FMT("Current temp %s, %d readings\n", t, probeTemp.count));
+                    for (uint8_t ii = 0; ii < n; ++ii)
+                    {
+                        temp2text(temps[ii].centiF, 2, t, sizeof(t));
+                        DBG_WRITE(log, FMT("  #%d %s, %dms ago\n", temps[ii].count, t, 
+                                (time_us_32() - temps[ii].readUs) / 1000));
+                    }
+
+                    tp_pump_t pumps[TOPIC_HISTORY_MAX];
+                    n = bus->history<TP_PUMP>(pumps, TOPIC_HISTORY_MAX);
+                    for (uint8_t ii = 0; ii < n; ++ii)
+                    {
+                        DBG_WRITE(log, FMT("  pump %s, state %d, ran %ds\n", pumps[ii].running ? "on" : "off", 
+                                pumps[ii].state, pumps[ii].runtimeSeconds));
+                    }
                 }  break;
 
                 case KEY_UP:
                 {
-                    data->setSetpoint(99.0);
-                    log->dbgWrite("setpoint to 99.0\n");
+                    data->setSetpoint(TEMP_F(99));
+                    configChanged(CFG_SETPOINT);
+                    DBG_WRITE(log, "setpoint to 99.0\n");
                 }  break;
 
                 case KEY_DOWN:
                 {
-                    data->setSetpoint(32.0);
-                    log->dbgWrite("setpoint to 32.0\n");
+                    data->setSetpoint(TEMP_F(32));
+                    configChanged(CFG_SETPOINT);
+                    DBG_WRITE(log, "setpoint to 32.0\n");
+                }  break;
+
+                case KEY_LEFT:
+                {
+                    uint16_t id = postRequest(IS_NTP_SYNC);
+                    DBG_WRITE(log, FMT("%s::Asking for NTP sync, #%d\n", __FUNCTION__, id));
+                }  break;
+
+                case KEY_RIGHT:
+                {
+                    uint16_t id = postRequest(IS_RELOAD_CONFIG);
+                    DBG_WRITE(log, FMT("%s::Asking for config reload, #%d\n", __FUNCTION__, id));
+                }  break;
+
+                case KEY_VOLUP:
+                {
+                    changeBrightness(display.getBrightness() + BRIGHTNESS_STEP);
+                }  break;
+
+                case KEY_VOLDN:
+                {
+                    changeBrightness(display.getBrightness() - BRIGHTNESS_STEP);
                 }  break;
 
                 case KEY_OK:
                 {
                     dumpStruct(ipcCore0Data, "Core 0");
+                    DBG_WRITE(log, FMT("%s::Display refresh %dHz, publish %dus, %d rows/s, readout %dus\n", __FUNCTION__, 
+                            display.getRefreshHz(), display.getPublishUs(), display.getRowsPerSec(), display.getReadoutUs()));
+
+                    logLines(ipcStats2text());
+                    logLines(bus->stats2text());
+                    logLines(log->stats2text());
+                    logLines(flog->stats2text());
+#ifdef DEBUG
+                    logLines(reefer::bench());
+#endif
                 }
             }
         }
         else
         {
-            log->warnWrite(stringFormat("%s::Unknown: 0x%02xn", __FUNCTION__, cmd));
+            log->warnWrite(FMT("%s::Unknown: 0x%02xn", __FUNCTION__, cmd));
         }
     }
 
-    // test code - handle response from core 1 for commands issued by I/R
-    if (inProgress && ipcCore0Data.cmd == IS_NO_CMD)
-    {
-        inProgress = false;
-        uint32_t elapsed = msTick - startTime;
-
-        if (ipcCore0Data.ack == IS_GET_IP)
-        {
-            log->dbgWrite(stringFormat("%s::Got IP Addr %s in %dms\n", __FUNCTION__, ipcCore0Data.ipAddress.c_str(), elapsed));
-        }
-        else if (ipcCore0Data.ack == IS_GET_MAC)
-        {
-            log->dbgWrite(stringFormat("%s::Got MAC Addr %s in %dms\n", __FUNCTION__, ipcCore0Data.macAddress.c_str(), elapsed));
-        }
-        else if (ipcCore0Data.ack == IS_DO_SCAN)
-        {
-            log->dbgWrite(stringFormat("%s::Scan done in %dms:\n", __FUNCTION__, elapsed));
-
-            log->dbgWrite(stringFormat(" Found %d access points:\n", ipcCore0Data.scanResult.count));
-            std::vector<ap_data_t>::const_iterator cit = ipcCore0Data.scanResult.apData.begin();
-            while (cit != ipcCore0Data.scanResult.apData.end())
-            {
-                log->dbgWrite(stringFormat("  Name: %s\n", cit->ssid.c_str()));
-                log->dbgWrite(stringFormat("    BSSID: %s\n", cit->bssid.c_str()));
-                log->dbgWrite(stringFormat("    Strength: %ddbm\n", cit->strength));
-                log->dbgWrite(stringFormat("    Channel: %d\n", cit->channel));
-                log->dbgWrite(stringFormat("    Encryption: %s\n", cit->encryption.c_str()));
-                ++cit;
-            }
-        }
-
-        ipcCore0Data.ack = IS_NO_CMD;
-        updateSharedData(US_ACK_CMD, ipcCore0Data);
-    }
-
     return (true);
 }
 
@@ -246,9 +503,9 @@ int main()
     logger* log = logger::getInstance();
 
     // log separator
-    log->dbgWrite("*********\n");
-    log->dbgWrite("* start *\n");
-    log->dbgWrite("*********\n");
+    DBG_WRITE(log, "*********\n");
+    DBG_WRITE(log, "* start *\n");
+    DBG_WRITE(log, "*********\n");
 
     // get the global singleton persisted data handler.  
     data = nvm::getInstance();
@@ -262,13 +519,28 @@ int main()
     // reset type
     if (watchdog_enable_caused_reboot())
     {
-        log->dbgWrite("Rebooted by watchdog!\n");
+        DBG_WRITE(log, "Rebooted by watchdog!\n");
     }
     else
     {
-        log->dbgWrite("Cold boot\n");
+        DBG_WRITE(log, "Cold boot\n");
     }
 
+    // the log in flash picks up where it left off, before
+    // core 1 starts draining into it
+    flog = flashlog::getInstance();
+    flog->init(watchdog_enable_caused_reboot() ? "watchdog" : "cold boot");
+    log->setSink(flashlog::sink, flog);
+    DBG_WRITE(log, FMT("Boot %d\n", flog->getBoot()));
+
+    // the telemetry bus, before core 1 can publish on it.
+    // Subscribe to what this core needs
+    bus = telemetry::getInstance();
+    bus->init();
+    std::memset(&probeTemp, 0, sizeof(probeTemp));
+    bus->subscribe(TP_TEMPERATURE, temperatureIn);
+    bus->subscribe(TP_NET_STATUS, netStatusIn);
+
     // start up core 1.  Core 0 (this core) is going to handle 
     // more time-critical stuffs; anything that may block will
     // be on core 1.  The interprocess comms handler (IPC) is
@@ -276,23 +548,26 @@ int main()
     // SDK.
     if (initIPC())
     {
-        log->dbgWrite("IPC init'd\n");
+        DBG_WRITE(log, "IPC init'd\n");
         multicore_launch_core1(core1Main);
-        log->dbgWrite("Core1 launched\n");
+        DBG_WRITE(log, "Core1 launched\n");
         data->setCore1Ready(true);
     }
-    log->dbgWrite("Multicore init'd\n");
+    DBG_WRITE(log, "Multicore init'd\n");
 
     // instantiate the refregeration pump object
     reefer chill;
     chill.init();
     bool pumpRunning = false;
-    log->dbgWrite("Chill init'd\n");
+    DBG_WRITE(log, "Chill init'd\n");
 
-    // instantiate the display panel
-    hub75 display;
+    // start up the display panel
     display.init();
-    log->dbgWrite("Display init'd\n");
+    DBG_WRITE(log, "Display init'd\n");
+
+    // let core 1 know where the scan is so it can be dumped
+    ipcCore0Data.scanView = display.getScanView();
+    updateSharedData(US_SCAN_VIEW, ipcCore0Data);
 
     // start getting the timing stuffs
     msTick = to_ms_since_boot(get_absolute_time());
@@ -307,16 +582,23 @@ int main()
     { 
         switch (tick)
         {
-            // Task 1 - heartbeat and minor stuffs
+            // Task 1 - heartbeat and minor stuffs.  The flash
+            // log goes here, away from reefer control; it's one
+            // page (~1ms) or one erase (~45ms) at the most
             case 0:
             {
                 heartBeatLED();
+                flog->service();
             }  break;
             
             // Task 2 - I/R and display UI
             case 1:
             {
                 ledIRTest();
+                serviceResponses();
+                serviceBrightness();
+                showReadouts(pumpRunning);
+                display.update();
             }  break;
             
             // task 3 - reefer control
@@ -325,7 +607,11 @@ int main()
             {
                 static reefer_state_t lastState = RS_IDLE;
 
-                chill.update(ipcCore0Data.temperatue);
+                if (probeTemp.count)
+                {
+                    bus->noteAge(TP_TEMPERATURE, probeTemp.readUs);
+                }
+                chill.update(probeTemp.centiF);
                 pumpRunning = chill.isPumpRunning();
 
                 // drop a line in the log to indicate state change
@@ -338,9 +624,14 @@ int main()
                         data->write();
                     }
 
-                    log->dbgWrite(stringFormat("Reefer state from %s to %s\n",
-                        chill.getStateName(lastState).c_str(),
-                        chill.getStateName(chill.getReeferState()).c_str()));
+                    log->dbgFmt<LF_REEFER_STATE>(chill.getStateName(lastState),
+                        chill.getStateName(chill.getReeferState()));
+
+                    tp_pump_t pump;
+                    pump.running = pumpRunning;
+                    pump.state = (uint8_t)chill.getReeferState();
+                    pump.runtimeSeconds = chill.getPumpRuntimeSeconds();
+                    bus->publish<TP_PUMP>(pump);
                 }
 
                 lastState = chill.getReeferState();
@@ -354,14 +645,16 @@ int main()
             }  break;
         }
 
-        display.update();
-
-        // tight part of service loop
-        while(msTick == lastMs)
+        // sleep until the next ms tick.  If core 1 answers a
+        // command or publishes something in the meantime, deal
+        // with it right away
+        bus->poll();
+        while (sleepUntil(from_us_since_boot((uint64_t)(lastMs + 1) * 1000)))
         {
-            // wait for next ms tick
-            msTick = to_ms_since_boot(get_absolute_time());
+            serviceResponses();
+            bus->poll();
         }
+        msTick = to_ms_since_boot(get_absolute_time());
 
         lastMs = msTick;
         
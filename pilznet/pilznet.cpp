@@ -6,6 +6,8 @@
  * December 2021, M.Brugman
  * 
  *******************************************************/
+#include <cstring>
+
 #include "pilznet.h"
 #include "pico/bootrom.h"
 
@@ -13,6 +15,11 @@
 #include "../af/Wifi.h"
 #include "../utils/stringFormat.h"
 #include "../ipc/mlogger.h"
+#include "../sys/flashlog.h"
+#include "../sys/timestamp.h"
+#include "../ipc/ipc.h"
+#include "../ipc/telemetry.h"
+#include "../hub75.h"
 #include "hardware/watchdog.h"
 
 static WiFiClass wifi;          // From Arduino libraries - General Wifi
@@ -30,8 +37,11 @@ void pilznet::init()
     wifi.setPins(PIN_MOSI, PIN_MISO, PIN_CLOCK, PIN_CS, PIN_READY, PIN_RESET, PIN_GPIO0);
     this->connected = false;
     this->clockValid = false;
-    this->macAddr = std::string("00:00:00:00:00:00:");
-    this->ipAddr = std::string("0.0.0.0");
+    std::memset(&this->macAddr, 0, sizeof(this->macAddr));
+    std::memset(&this->ipAddr, 0, sizeof(this->ipAddr));
+    this->brightCount = 0;
+    this->brightness = 0;
+    this->scanView = NULL;
 
     log = logger::getInstance();
 }
@@ -43,7 +53,7 @@ void pilznet::init()
  ******************************************************/
 bool pilznet::connect(const std::string& ap, const std::string& pw)
 {
-    log->dbgWrite(stringFormat("%s(%s)\n", __FUNCTION__, ap.c_str()));
+    DBG_WRITE(log, FMT("%s(%s)\n", __FUNCTION__, ap.c_str()));
     uint8_t timeout = 0;
     this->connected = false;
 
@@ -52,7 +62,7 @@ bool pilznet::connect(const std::string& ap, const std::string& pw)
     {
         if ((++timeout) > 10)
         {
-            log->errWrite(stringFormat("Timed out waiting for module to wake up\n"));
+            log->errWrite(FMT("Timed out waiting for module to wake up\n"));
             return (false);
         }
         sleep_ms(1000);
@@ -60,7 +70,7 @@ bool pilznet::connect(const std::string& ap, const std::string& pw)
 
     // do the connect
     int conResult = wifi.begin(ap.c_str(), pw.c_str());
-    log->dbgWrite(stringFormat("%s::Connection result %s\n", __FUNCTION__, this->status2text(conResult).c_str()));
+    DBG_WRITE(log, FMT("%s::Connection result %s\n", __FUNCTION__, this->status2text(conResult).c_str()));
 
     if (conResult == WL_CONNECTED)
     {
@@ -71,10 +81,12 @@ bool pilznet::connect(const std::string& ap, const std::string& pw)
     }
 
     // Save the IP and MAC addresses
-    this->ipAddr = wifi.localIP().ipToString();
-    uint8_t mac[6];
-    WiFi.macAddress(mac);
-    this->macAddr = mac2text(mac);
+    IPAddress ip = wifi.localIP();
+    for (uint8_t ii = 0; ii < sizeof(this->ipAddr.b); ++ii)
+    {
+        this->ipAddr.b[ii] = ip[ii];
+    }
+    WiFi.macAddress(this->macAddr.b);
 
     return (this->connected);
 }
@@ -100,21 +112,97 @@ bool pilznet::update(void)
         char cmd = (char)udp.read();
         switch (cmd)
         {
-            // request for log buffer, send it back
+            // log, from a sequence number as ascii digits, 
+            // like "x1234"; just "x" is everything there is
             case 'x':
             {
-                std::string dbgBuffer = log->dbgPop();
-                if (dbgBuffer.length())
+                uint32_t from = 0;
+                bool asked = false;
+                int c = udp.read();
+                while (c >= '0' && c <= '9')
+                {
+                    from = (from * 10) + (c - '0');
+                    asked = true;
+                    c = udp.read();
+                }
+
+                this->sendLog(from, asked);
+            }  break;
+
+            // set the display brightness; percent follows
+            // as ascii digits, like "b40"
+            case 'b':
+            {
+                int pct = 0;
+                int c = udp.read();
+                while (c >= '0' && c <= '9')
+                {
+                    pct = (pct * 10) + (c - '0');
+                    c = udp.read();
+                }
+
+                if (pct > 0 && pct <= 100)
+                {
+                    this->brightness = (uint8_t)pct;
+                    ++this->brightCount;
+                }
+                else
+                {
+                    log->warnWrite(FMT("Bad brightness %d on listening port\n", pct));
+                }
+            }  break;
+
+            // dump what the display is scanning
+            case 'f':
+            {
+                this->sendFrame();
+            }  break;
+
+            // IPC, telemetry and logger counters, as text, and
+            // what a log line's timestamp costs
+            case 's':
+            {
+                this->sendText(ipcStats2text());
+                this->sendText(telemetry::getInstance()->stats2text());
+                this->sendText(log->stats2text());
+                this->sendText(timestamp::getInstance()->bench());
+                this->sendText(flashlog::getInstance()->stats2text());
+            }  break;
+
+            // log level; "l0" debug up to "l3" errors only, 
+            // "l4" nothing.  Sends back what it is now
+            case 'l':
+            {
+                int c = udp.read();
+                if (c >= '0' && c <= '9')
                 {
-                    udp.beginPacket(udp.remoteIP(), udp.remotePort());
-                    udp.write((uint8_t*)dbgBuffer.c_str(), dbgBuffer.length());
-                    udp.endPacket();
+                    log->setLevel((uint8_t)(c - '0'));
                 }
+
+                this->sendText(FMT("Log level %s\n", logger::level2text(log->getLevel()).c_str()));
             }  break;
 
-            // request for rebooten 
+            // the log kept in flash, oldest first
+            case 'p':
+            {
+                this->sendFlashLog();
+            }  break;
+
+            // request for rebooten.  Get the log into flash
+            // first, it's what's wanted afterwards
             case 'n':
             {
+                log->warnWrite("Rebooting on request\n");
+                log->drain();
+
+                flashlog* flog = flashlog::getInstance();
+                flog->requestFlush();
+                absolute_time_t giveUp = make_timeout_time_ms(1000);
+                while (flog->flushPending() && !time_reached(giveUp))
+                {
+                    sleep_ms(5);
+                }
+
                 watchdog_enable(1, 0);
                 while(true);
             }  break;
@@ -127,7 +215,7 @@ bool pilznet::update(void)
             
             default:
             {
-                log->warnWrite(stringFormat("Saw a '%c' on listening port\n", cmd));
+                log->warnWrite(FMT("Saw a '%c' on listening port\n", cmd));
             }
         }
         retVal = true;
@@ -136,6 +224,210 @@ bool pilznet::update(void)
     return (retVal);
 }
 
+/*******************************************************
+ * sendFrame()
+ *******************************************************
+ * Send the frame the display is scanning, as the PIO
+ * sees it, so pull.py can rebuild the picture and the
+ * timing.  One 'F' packet with the geometry and the
+ * row control words, then one 'R' packet per row pair
+ * with every plane of it.  Little-endian, like us.
+ * 
+ * The frame isn't locked, core 0 can publish a new one
+ * partway through.  Good enough for a look at it
+ ******************************************************/
+void pilznet::sendFrame(void)
+{
+    if (!this->scanView)
+    {
+        log->warnWrite("No display to dump yet\n");
+        return;
+    }
+
+    const scan_view_t& v = *this->scanView;
+    uint16_t ctrlWords = v.scan * v.planes;
+    uint8_t pkt[32 + (16 * 8 * sizeof(uint32_t))];
+
+    if (ctrlWords > 16 * 8 || (size_t)(v.planes * v.cols) + 2 > sizeof(pkt))
+    {
+        log->errWrite("Display scan too big to dump\n");
+        return;
+    }
+
+    size_t len = 0;
+    pkt[len++] = 'F';
+    pkt[len++] = v.planes;
+    std::memcpy(&pkt[len], &v.rows, sizeof(v.rows));                len += sizeof(v.rows);
+    std::memcpy(&pkt[len], &v.cols, sizeof(v.cols));                len += sizeof(v.cols);
+    std::memcpy(&pkt[len], &v.scan, sizeof(v.scan));                len += sizeof(v.scan);
+    pkt[len++] = v.addrPins;
+    pkt[len++] = v.onBits;
+    std::memcpy(&pkt[len], v.addrBit, sizeof(v.addrBit));           len += sizeof(v.addrBit);
+    std::memcpy(&pkt[len], &v.pioHz, sizeof(v.pioHz));              len += sizeof(v.pioHz);
+    std::memcpy(&pkt[len], &v.shiftCycles, sizeof(v.shiftCycles));  len += sizeof(v.shiftCycles);
+    std::memcpy(&pkt[len], &v.latchCycles, sizeof(v.latchCycles));  len += sizeof(v.latchCycles);
+    std::memcpy(&pkt[len], v.rowCtrl, ctrlWords * sizeof(uint32_t)); len += ctrlWords * sizeof(uint32_t);
+
+    udp.beginPacket(udp.remoteIP(), udp.remotePort());
+    udp.write(pkt, len);
+    udp.endPacket();
+
+    // each row is the column count word and then the columns
+    const uint8_t* frame = (const uint8_t*)(*v.frame);
+    size_t rowBytes = sizeof(uint32_t) + v.cols;
+
+    for (uint16_t row = 0; row < v.scan; ++row)
+    {
+        len = 0;
+        pkt[len++] = 'R';
+        pkt[len++] = (uint8_t)row;
+
+        for (uint8_t plane = 0; plane < v.planes; ++plane)
+        {
+            const uint8_t* cols = frame + (((row * v.planes) + plane) * rowBytes) + sizeof(uint32_t);
+            std::memcpy(&pkt[len], cols, v.cols);
+            len += v.cols;
+        }
+
+        udp.beginPacket(udp.remoteIP(), udp.remotePort());
+        udp.write(pkt, len);
+        udp.endPacket();
+    }
+}
+
+/*******************************************************
+ * sendText()
+ *******************************************************
+ * Send a block of text back to whoever asked, split
+ * on line ends into packets that fit UDP_TEXT_MAX
+ ******************************************************/
+void pilznet::sendText(const std::string& text)
+{
+    size_t pos = 0;
+
+    while (pos < text.length())
+    {
+        size_t len = text.length() - pos;
+        if (len > UDP_TEXT_MAX)
+        {
+            len = UDP_TEXT_MAX;
+            size_t eol = text.rfind('\n', pos + len - 1);
+            if (eol != std::string::npos && eol >= pos)
+            {
+                len = eol - pos + 1;
+            }
+        }
+
+        udp.beginPacket(udp.remoteIP(), udp.remotePort());
+        udp.write((const uint8_t*)text.c_str() + pos, len);
+        udp.endPacket();
+        pos += len;
+    }
+}
+
+/*******************************************************
+ * sendLog()
+ *******************************************************
+ * send back the log from sequence number from, or all
+ * of it if a number wasn't asked for.  Nothing gets
+ * taken out, so any number of clients can follow and
+ * ask again for whatever they lost.  Each packet is
+ *
+ *   'L'
+ *   uint32_t seq       of the first byte in this packet
+ *   uint32_t end       seq this reply runs up to
+ *   uint32_t first     seq of the oldest byte still held
+ *   uint16_t len       of the text that follows
+ *
+ * little endian, then the text, cut at line ends where
+ * it can be.  seq past what was asked for means the
+ * text in between was overwritten; seq before it means
+ * pilz rebooted.  Nothing new gets one packet with no
+ * text, so the client still hears where things are.
+ * Losing a packet just means asking again from the
+ * last byte that did get there
+ ******************************************************/
+void pilznet::sendLog(uint32_t from, bool asked)
+{
+    uint8_t pkt[LOG_PKT_HDR + UDP_TEXT_MAX];
+
+    // what's waiting in the cores' rings first, or the
+    // first read() would bring in lines past end
+    log->drain();
+
+    if (!asked)
+    {
+        from = log->firstSeq();
+    }
+
+    // only what's there now, don't chase new lines forever
+    uint32_t end = log->nextSeq();
+
+    do
+    {
+        char* text = (char*)&pkt[LOG_PKT_HDR];
+        uint16_t len = (uint16_t)log->read(from, text, UDP_TEXT_MAX);
+        uint32_t first = log->firstSeq();
+
+        // each read() drains again; nothing newer than end
+        int32_t left = (int32_t)(end - from);
+        if (left < (int32_t)len)
+        {
+            len = (left > 0) ? (uint16_t)left : 0;
+        }
+
+        if (len == UDP_TEXT_MAX && from + len != end)
+        {
+            for (uint16_t eol = len; eol > 0; --eol)
+            {
+                if (text[eol - 1] == '\n')
+                {
+                    len = eol;
+                    break;
+                }
+            }
+        }
+
+        size_t at = 0;
+        pkt[at++] = 'L';
+        std::memcpy(&pkt[at], &from, sizeof(from));     at += sizeof(from);
+        std::memcpy(&pkt[at], &end, sizeof(end));       at += sizeof(end);
+        std::memcpy(&pkt[at], &first, sizeof(first));   at += sizeof(first);
+        std::memcpy(&pkt[at], &len, sizeof(len));       at += sizeof(len);
+
+        udp.beginPacket(udp.remoteIP(), udp.remotePort());
+        udp.write(pkt, LOG_PKT_HDR + len);
+        udp.endPacket();
+
+        from += len;
+    } while ((int32_t)(end - from) > 0);
+}
+
+/*******************************************************
+ * sendFlashLog()
+ *******************************************************
+ * everything in the flash log as text, a few pages to
+ * a packet
+ ******************************************************/
+void pilznet::sendFlashLog(void)
+{
+    flashlog* flog = flashlog::getInstance();
+    std::string text;
+    std::string page;
+
+    for (uint16_t n = 0; flog->pageText(n, page); ++n)
+    {
+        if (text.length() + page.length() > UDP_TEXT_MAX)
+        {
+            this->sendText(text);
+            text.clear();
+        }
+        text += page;
+    }
+
+    this->sendText(text);
+}
+
 /*******************************************************
  * doNTP()
  *******************************************************
@@ -165,31 +457,33 @@ bool pilznet::doNTP(const std::string& tz)
 const scan_data_t pilznet::scan()
 {
     scan_data_t ret;
+    ret.found = 0;
+    ret.count = 0;
 
     // the module tells us how many networks were seen, will
     // return -1 in error
-    ret.count = wifi.scanNetworks();
+    int8_t found = wifi.scanNetworks();
 
-    if (ret.count == -1)
+    if (found < 0)
     {
-        log->errWrite(stringFormat("Unable to get a network link\n"));
+        log->errWrite(FMT("Unable to get a network link\n"));
     }
     else
     {
-        // Binary SSID (AP MAC address)
-        uint8_t bssid[16];
+        ret.found = (uint8_t)found;
+        ret.count = (found > AP_SCAN_MAX) ? AP_SCAN_MAX : (uint8_t)found;
 
-        for (int ii = 0; ii < ret.count; ++ii)
+        for (uint8_t ii = 0; ii < ret.count; ++ii)
         {
-            ap_data_t d;
-            
-            // get the BSSID
-            wifi.BSSID(ii, bssid);
-            // convert to a string for easier handling
-            d.bssid = mac2text(bssid);
+            ap_data_t& d = ret.apData[ii];
+
+            // Binary SSID (AP MAC address); the module
+            // writes all six bytes
+            wifi.BSSID(ii, d.bssid.b);
 
             // human readable name of the network
-            d.ssid = wifi.SSID(ii);
+            std::strncpy(d.ssid, wifi.SSID(ii), AP_SSID_LEN - 1);
+            d.ssid[AP_SSID_LEN - 1] = '\0';
 
             // strength is DB (will be a negative number)
             d.strength = wifi.RSSI(ii);
@@ -197,16 +491,25 @@ const scan_data_t pilznet::scan()
             // channel
             d.channel = wifi.channel(ii);
 
-            // encryption type - decode
-            d.encryption = encryption2text(wifi.encryptionType(ii));
-
-            ret.apData.push_back(d);
+            // encryption type, decoded when it's displayed
+            d.encryption = wifi.encryptionType(ii);
         }
     }
 
     return (ret);
 }
 
+/*******************************************************
+ * ip2text()
+ *******************************************************
+ * Convenience method to return an IP address as a 
+ * human readable string
+ ******************************************************/
+const std::string pilznet::ip2text(const ipv4_addr_t& ip)
+{
+    return (FMT("%d.%d.%d.%d", ip.b[0], ip.b[1], ip.b[2], ip.b[3]));
+}
+
 /*******************************************************
  * encryption2text()
  *******************************************************
@@ -260,15 +563,8 @@ const std::string pilznet::status2text(int status)
  * Convenience method to return MAC address as a 
  * human readable string
  ******************************************************/
-const std::string pilznet::mac2text(uint8_t* mac)
+const std::string pilznet::mac2text(const mac_addr_t& mac)
 {
-    std::string ret;
-
-    if (mac)
-    {
-        ret = stringFormat("%02x:%02x:%02x:%02x:%02x:%02x",
-            mac[5], mac[4], mac[3], mac[2], mac[1], mac[0]);
-    }
-
-    return (ret);
+    return (FMT("%02x:%02x:%02x:%02x:%02x:%02x",
+        mac.b[5], mac.b[4], mac.b[3], mac.b[2], mac.b[1], mac.b[0]));
 }
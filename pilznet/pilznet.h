@@ -12,30 +12,50 @@
 #include "../sys/walltime.h"
 #include <string>
 #include <cinttypes>
-#include <vector>
 
 #include "pico/stdlib.h"
 
+struct scan_view_t;                 // display scan, see hub75.h
+
+#define UDP_TEXT_MAX        1024    // bytes of text in one reply packet
+#define LOG_PKT_HDR         15      // 'L', seq, next, first, length; see sendLog()
+#define AP_SSID_LEN         33      // 32 characters max, plus the terminator
+#define AP_SCAN_MAX         16      // access points kept from one scan
+
+// Addresses as the module hands them over.  Kept as bytes
+// so they can be copied around without the heap; turned
+// into text only when they get logged
+struct ipv4_addr_t
+{
+    uint8_t     b[4];       // first octet first
+};
+
+struct mac_addr_t
+{
+    uint8_t     b[6];       // as the module reports it, last octet first
+};
+
 // Structure to hold the results of an access point 
 // scan.  This is for one access point, there will
-// be a vector of them after the scan
+// be a table of them after the scan
 struct ap_data_t
 {
-    std::string bssid;
-    uint32_t    strength;   // signal strength in dbm
-    uint8_t    channel;     // channel
-    std::string encryption; // encryption type 
-    std::string ssid;       // broadcast ssid of ap
+    mac_addr_t  bssid;
+    int32_t     strength;   // signal strength in dbm
+    uint8_t     channel;    // channel
+    uint8_t     encryption; // encryption type, ENC_TYPE_*
+    char        ssid[AP_SSID_LEN]; // broadcast ssid of ap
 };
 
 // The full scan result - the number of networks and
-// the data for each AP.  (Is the number really necessary?
-// should just be able to use apData.size())
-// TODO - check that out
+// the data for each AP.  The module can see more than
+// the table holds; found is how many it saw, count is
+// how many made it into apData
 struct scan_data_t
 {
-    uint16_t                count;      // number of networks found
-    std::vector<ap_data_t>  apData;     // access point data
+    uint8_t     found;      // number of networks found
+    uint8_t     count;      // number of them in apData
+    ap_data_t   apData[AP_SCAN_MAX]; // access point data
 };
 
 class pilznet
@@ -54,22 +74,41 @@ public:
     // scan for all access points the Airlift module can see
     const scan_data_t scan(void);
 
-    const std::string getMac(void) const        { return (macAddr); }
-    const std::string getIP(void) const         { return (ipAddr); }
+    const mac_addr_t getMac(void) const         { return (macAddr); }
+    const ipv4_addr_t getIP(void) const         { return (ipAddr); }
 
     // Do an NTP time/date lookup
     bool doNTP(const std::string& tz);
     bool isClockValid(void) const               { return (clockValid); }
 
+    // display brightness asked for over the net; the count
+    // goes up by one for each request
+    uint32_t getBrightCount(void) const         { return (brightCount); }
+    uint8_t getBrightness(void) const           { return (brightness); }
+
+    // where the display scan is, for frame dumps
+    void setScanView(const scan_view_t* v)      { scanView = v; }
+
+    // human readable versions of the above, for logging
+    static const std::string ip2text(const ipv4_addr_t& ip);
+    static const std::string mac2text(const mac_addr_t& mac);
+    static const std::string encryption2text(int thisType);
+
 private:
     bool connected;
     bool clockValid;
-    std::string ipAddr;
-    std::string macAddr;
+    ipv4_addr_t ipAddr;
+    mac_addr_t macAddr;
+    uint32_t brightCount;
+    uint8_t brightness;
+    const scan_view_t* scanView;
     walltime wt;
 
-    const std::string encryption2text(int thisType);
-    const std::string mac2text(uint8_t* mac);
+    void sendFrame(void);
+    void sendText(const std::string& text);
+    void sendLog(uint32_t from, bool asked);
+    void sendFlashLog(void);
+
     const std::string status2text(int status); 
 };
 
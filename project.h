@@ -32,6 +32,7 @@
 #define LED_A0         22   //  Address line 0 (A)
 #define LED_A1         26   //  Address Line 1 (B)
 #define LED_A2         27   //  Address Line 3 (C)
+#define LED_A3         28   //  Address Line 4 (D), only on panels with more than 8 row addresses
 #define LED_CLK        13   //  Bit clock
 #define LED_LATCH      14   //  Row latch
 #define LED_OE         15   //  Output Enable (blanking)
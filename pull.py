@@ -5,22 +5,231 @@
 # comms are on a simple UDP socket.  Connect to UDP
 # port 1234 and send a single character to do stuff:
 #
-#  'x' - this will request the contents of the logger,
-#        pilz will return a long string of log data
+#  'x' - log text from a sequence number, as ascii 
+#        digits: "x1234".  Every byte logged since boot
+#        has a sequence number; just "x" gets all there
+#        is.  Nothing is taken out of the log, so more
+#        than one client can follow it.  Comes back as
+#        'L' packets, up to 1024 bytes of text each:
+#          'L', seq, end, first (uint32), len (uint16),
+#          little endian, then the text
+#        seq is the first byte in the packet, end is 
+#        where the reply stops, first is the oldest byte
+#        pilz still has.  seq past what was asked for 
+#        and past first means a packet got lost: ask 
+#        again.  Past what was asked, but what was asked
+#        is older than first: it was overwritten before
+#        anyone got it.  seq behind what was asked for: 
+#        pilz rebooted.  See pilznet::sendLog()
 #  'r' - reboot into UF2 bootloader mode
-#  'n' - simple application reboot
+#  'n' - simple application reboot, after what's been
+#        logged is written to flash
+#  'p' - the log kept in flash, oldest first, as text in
+#        as many packets as it takes.  Survives reboots;
+#        each boot starts with a "=== boot N" line
+#  'b' - set display brightness, percent follows as
+#        ascii digits; "b40" is 40%
+#  'f' - dump the frame the display is scanning.  Comes
+#        back as one 'F' packet (geometry and row control
+#        words) and an 'R' packet per row pair.  See
+#        pilznet::sendFrame()
+#  's' - IPC, telemetry and logger counters and
+#        histograms, as text, in as many packets as it
+#        takes.  Rates and idle time are since the last
+#        time anyone asked
+#  'l' - log level, a digit follows: "l0" is debug and
+#        up, "l3" errors only, "l4" nothing.  Without
+#        the digit it only asks.  Sends back the level
+#
+# --logger follows the log that way and notes any
+# gaps; --check does the same without the text and 
+# prints the tally every few seconds.
+#
+# With --frame, the dump gets played through a model of
+# the PIO (shift, latch, OE on and blanked time for each
+# bit plane) and written out as a PPM, along with the 
+# refresh rate and per-row on-time that works out to.
 ########################################################
 
 import socket
 import argparse
+import struct
+import sys
 import time
 
+########################################################
+# seqDiff()
+########################################################
+# a - b for sequence numbers, which wrap at 32 bits
+########################################################
+def seqDiff(a, b):
+    return ((a - b + 0x80000000) & 0xffffffff) - 0x80000000
+
+########################################################
+# pullLog()
+########################################################
+# ask for the log from cursor (None for all of it) and
+# put the packets together.  Returns the new cursor and
+# the text; tally counts what went wrong
+########################################################
+def pullLog(sck, host, cursor, tally):
+    req = 'x' if cursor is None else 'x%d' % cursor
+    sck.sendto(bytearray(req, 'utf-8'), (host, 1234))
+    text = ''
+
+    while True:
+        try:
+            pkt, addr = sck.recvfrom(2048)
+        except socket.timeout:
+            tally['timeouts'] += 1
+            break
+
+        if pkt[0:1] != b'L':
+            continue
+
+        (seq, end, first, n) = struct.unpack_from('<IIIH', pkt, 1)
+        body = pkt[15:15 + n].decode('utf-8', 'replace')
+        tally['packets'] += 1
+
+        if cursor is not None and seqDiff(seq, cursor) > 0:
+            if seqDiff(first, cursor) > 0:
+                tally['lost'] += seqDiff(seq, cursor)
+                text += '### lost %d bytes, overwritten\n' % seqDiff(seq, cursor)
+            else:
+                # a packet before this one got dropped; the
+                # rest of the reply is no good, ask again
+                tally['resent'] += 1
+                while True:
+                    try:
+                        sck.recvfrom(2048)
+                    except socket.timeout:
+                        break
+                break
+        elif cursor is not None and seqDiff(seq, cursor) < 0:
+            tally['reboots'] += 1
+            text += '### pilz rebooted\n'
+
+        text += body
+        tally['bytes'] += n
+        cursor = seq + n
+        if seqDiff(cursor, end) >= 0:
+            break
+
+    return cursor, text
+
+########################################################
+# pullFrame()
+########################################################
+# ask for a frame dump and put the packets back together
+########################################################
+def pullFrame(sck, host):
+    sck.sendto(bytearray('f', 'utf-8'), (host, 1234))
+
+    hdr, addr = sck.recvfrom(2048)
+    if hdr[0:1] != b'F':
+        raise Exception('expected a frame header')
+
+    f = {}
+    (f['planes'], f['rows'], f['cols'], f['scan'], f['addrPins'], f['onBits']) = struct.unpack_from('<BHHHBB', hdr, 1)
+    f['addrBit'] = struct.unpack_from('<4B', hdr, 10)
+    (f['pioHz'], f['shiftCycles'], f['latchCycles']) = struct.unpack_from('<IHH', hdr, 14)
+    f['rowCtrl'] = struct.unpack_from('<%dI' % (f['scan'] * f['planes']), hdr, 22)
+
+    f['data'] = {}
+    while len(f['data']) < f['scan']:
+        pkt, addr = sck.recvfrom(2048)
+        if pkt[0:1] == b'R':
+            f['data'][pkt[1]] = pkt[2:]
+
+    return f
+
+########################################################
+# renderFrame()
+########################################################
+# Walk the scan the way the PIO does.  For each row pair
+# and plane, the row is latched, lit for the on-time and
+# blanked for the rest; the next row is shifted in at 
+# the same time.  Light each LED got is the sum of the 
+# on-times of the planes it's set in.  Returns RGB rows
+# (linear, 0 to 1) and the timing stats
+########################################################
+def renderFrame(f):
+    planes = f['planes']
+    cols = f['cols']
+    onMask = (1 << f['onBits']) - 1
+    offShift = f['addrPins'] + f['onBits']
+
+    light = [[[0.0, 0.0, 0.0] for x in range(cols)] for y in range(f['rows'])]
+    weight = [0] * f['rows']
+    rowOn = [0] * f['scan']
+    frameCycles = 0
+
+    for row in range(f['scan']):
+        for plane in range(planes):
+            ctrl = f['rowCtrl'][(row * planes) + plane]
+            on = ((ctrl >> f['addrPins']) & onMask) + 1
+            off = (ctrl >> offShift) + 1
+
+            addr = 0
+            for bit in range(4):
+                if ctrl & (1 << f['addrBit'][bit]):
+                    addr |= (1 << bit)
+
+            # the next row shifts in while this one is lit
+            frameCycles += f['latchCycles'] + max(on + off, f['shiftCycles'])
+            rowOn[row] += on
+
+            data = f['data'][row][plane * cols:(plane + 1) * cols]
+            for half in range(2):
+                y = addr + (half * f['scan'])
+                weight[y] += on + off - 1
+                for x in range(cols):
+                    bits = data[x] >> (half * 3)
+                    for c in range(3):
+                        if bits & (1 << c):
+                            light[y][x][c] += on
+
+    img = [[[light[y][x][c] / weight[y] if weight[y] else 0.0 for c in range(3)] for x in range(cols)] for y in range(f['rows'])]
+
+    stats = {}
+    stats['refreshHz'] = f['pioHz'] / frameCycles
+    stats['rowOnUs'] = [(on * 1000000.0) / f['pioHz'] for on in rowOn]
+    stats['duty'] = sum(rowOn) / frameCycles
+    return img, stats
+
+########################################################
+# writePPM()
+########################################################
+# binary PPM, each LED a scale x scale block.  The LEDs
+# are linear, so encode for a 2.2 gamma screen to look 
+# about like the panel does to an eye
+########################################################
+def writePPM(name, img, scale):
+    rows = len(img)
+    cols = len(img[0])
+    with open(name, 'wb') as out:
+        out.write(bytearray('P6\n%d %d\n255\n' % (cols * scale, rows * scale), 'utf-8'))
+        for y in range(rows):
+            line = bytearray()
+            for x in range(cols):
+                pxl = bytearray([int(255 * (v ** (1 / 2.2)) + 0.5) for v in img[y][x]])
+                line += pxl * scale
+            out.write(line * scale)
+
 if __name__ == '__main__':
     parser = argparse.ArgumentParser()
     parser.add_argument('--host', dest='host', required=True, help='Set the IP address')
-    parser.add_argument('--logger', dest='logger', required=False, default=False, action='store_true', help='Pull log')
+    parser.add_argument('--logger', dest='logger', required=False, default=False, action='store_true', help='Follow the log')
+    parser.add_argument('--check', dest='check', required=False, default=False, action='store_true', help='Follow the log, only count gaps')
     parser.add_argument('--rebooten', dest='rebooten', required=False, default=False, action='store_true', help='Rebooten now!')
     parser.add_argument('--bootloader', dest='bootloader', required=False, default=False, action='store_true', help='Rebooten to bootloader')
+    parser.add_argument('--brightness', dest='brightness', required=False, type=int, help='Set display brightness, percent')
+    parser.add_argument('--frame', dest='frame', required=False, help='Dump the display to this PPM file')
+    parser.add_argument('--count', dest='count', required=False, type=int, default=1, help='Number of frames to dump, numbered when more than one')
+    parser.add_argument('--level', dest='level', required=False, type=int, help='Set the log level, 0 (debug) to 4 (off)')
+    parser.add_argument('--persisted', dest='persisted', required=False, default=False, action='store_true', help='Dump the log kept in flash')
+    parser.add_argument('--stats', dest='stats', required=False, default=False, action='store_true', help='Dump IPC counters')
+    parser.add_argument('--scale', dest='scale', required=False, type=int, default=8, help='PPM pixels per LED')
     args = parser.parse_args()
 
     sck = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
@@ -32,20 +241,63 @@ if __name__ == '__main__':
     elif args.bootloader == True:
         sck.sendto(bytearray('r', 'utf-8'), (args.host, 1234))
         print('Sending rebooten-to-bootloader request!')
-    elif args.logger == True:
+    elif args.brightness is not None:
+        sck.sendto(bytearray('b' + str(args.brightness), 'utf-8'), (args.host, 1234))
+        print('Sending brightness %d%%' % args.brightness)
+    elif args.frame is not None:
+        for ii in range(args.count):
+            f = pullFrame(sck, args.host)
+            img, stats = renderFrame(f)
+
+            name = args.frame
+            if args.count > 1:
+                name = name.replace('.ppm', '') + '_%03d.ppm' % ii
+            writePPM(name, img, args.scale)
+
+            print('%s: %dx%d, 1/%d scan, %d planes, refresh %.0fHz, %.1f%% lit' % (name, f['cols'], f['rows'], 
+                    f['scan'], f['planes'], stats['refreshHz'], stats['duty'] * 100))
+            print('  per-row on-time (us): ' + ' '.join(['%.1f' % t for t in stats['rowOnUs']]))
+            time.sleep(0.5)
+    elif args.level is not None:
+        sck.sendto(bytearray('l' + str(args.level), 'utf-8'), (args.host, 1234))
+        pkt, addr = sck.recvfrom(2048)
+        print(pkt.decode('utf-8'), end='')
+    elif args.persisted == True:
+        sck.sendto(bytearray('p', 'utf-8'), (args.host, 1234))
+        try:
+            while True:
+                data, addr = sck.recvfrom(2048)
+                print(data.decode('utf-8', 'replace'), end='')
+        except socket.timeout:
+            pass
+    elif args.stats == True:
+        sck.sendto(bytearray('s', 'utf-8'), (args.host, 1234))
+        try:
+            while True:
+                data, addr = sck.recvfrom(2048)
+                print(data.decode(), end='')
+        except socket.timeout:
+            pass
+    elif args.logger == True or args.check == True:
+        tally = {'packets': 0, 'bytes': 0, 'lost': 0, 'resent': 0, 'reboots': 0, 'timeouts': 0}
+        cursor = None
+        lastTally = time.time()
         print('Continual log pull:')
         while (1 == 1):
             try:
-                sck.sendto(bytearray("x", 'utf-8'),(args.host, 1234))
-                data, addr = sck.recvfrom(2048)
-                print (data.decode(), end='')
+                cursor, text = pullLog(sck, args.host, cursor, tally)
+                if args.logger == True:
+                    print(text, end='')
+                elif time.time() - lastTally > 5:
+                    print(tally)
+                    lastTally = time.time()
                 time.sleep(0.5)
 
             except KeyboardInterrupt:
-                print('\nExiting')
+                print('\nExiting, ' + str(tally))
                 exit()
 
             except Exception as err:
-                pass
+                print(err, file=sys.stderr)
     else:
         print('Pick a mode!')
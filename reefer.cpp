@@ -7,6 +7,8 @@
  * 
  *******************************************************/
 
+#include <cstdio>
+
 #include "reefer.h"
 #include "project.h"
 
@@ -36,7 +38,7 @@ void reefer::init()
     gpio_set_dir(PIN_PUMP, GPIO_OUT);
     gpio_put(PIN_PUMP, false);
 
-    lastTemp = 0.0;
+    lastTemp = 0;
     pumpRuntimeSeconds = 0;
     reeferState = RS_INIT;
 }
@@ -48,7 +50,7 @@ void reefer::init()
  * state machine.  One state transition per
  * call
  ********************************************/ 
-void reefer::update(float currentTemp)
+void reefer::update(temp_t currentTemp)
 {
     static uint32_t startTime = 0;
     switch (reeferState)
@@ -59,7 +61,7 @@ void reefer::update(float currentTemp)
         {
             if (time_reached(refTimestamp))
             {
-                log->dbgWrite("reefer leaving init state\n");
+                log->dbgFmt<LF_REEFER_READY>();
                 reeferState = RS_IDLE;
             }
         }  break;
@@ -73,7 +75,7 @@ void reefer::update(float currentTemp)
             if ((currentTemp + data->getHysteresis()) > data->getSetpoint())
             {
                 gpio_put(PIN_PUMP, true);
-                log->dbgWrite(stringFormat("Pump on %02.1f/%02.1f\n", currentTemp, data->getSetpoint()));
+                log->dbgFmt<LF_PUMP_ON>(currentTemp, data->getSetpoint());
 
                 // pump needs to run a minimum amount of time
                 refTimestamp = make_timeout_time_ms(CHILL_START_DELAY);
@@ -103,14 +105,14 @@ void reefer::update(float currentTemp)
             if ((currentTemp + data->getHysteresis()) < data->getSetpoint())
             {
                 gpio_put(PIN_PUMP, false);
-                log->dbgWrite(stringFormat("Pump off %02.1f/%02.1f\n", currentTemp, data->getSetpoint()));
+                log->dbgFmt<LF_PUMP_OFF>(currentTemp, data->getSetpoint());
 
                 // pump needs to be off a minimum amount of time
                 refTimestamp = make_timeout_time_ms(CHILL_END_DELAY);
 
                 // get accumulated runtime
                 pumpRuntimeSeconds = (to_ms_since_boot(get_absolute_time()) - startTime) / 1000;
-                log->dbgWrite(stringFormat("Accumulated pump runtime now %d seconds\n", pumpRuntimeSeconds));
+                log->dbgFmt<LF_PUMP_RUNTIME>(pumpRuntimeSeconds);
 
                 // oo to the next state
                 reeferState = RS_POST_CHILL;
@@ -135,9 +137,8 @@ void reefer::update(float currentTemp)
     {
         logWriteTime = make_timeout_time_ms(LOG_WRITE_DELAY);
 
-        log->infoWrite(stringFormat("%02.1f,%s\n", 
-                currentTemp, 
-                pumpRunning ? "running":"stopped"));
+        log->infoFmt<LF_REEFER_STATUS>(currentTemp, 
+                pumpRunning ? "running":"stopped");
     }
     
     lastTemp = currentTemp;
@@ -149,16 +150,82 @@ void reefer::update(float currentTemp)
  * Convenience method to return human readable
  * reefer state
  ********************************************/ 
-const std::string reefer::getStateName(reefer_state_t state)
+const char* reefer::getStateName(reefer_state_t state)
 {
     switch(state)
     {
-        case RS_INIT:           return (std::string("Init"));
-        case RS_IDLE:           return (std::string("Idle"));
-        case RS_CHILL_START:    return (std::string("Chill Starting"));
-        case RS_CHILLING:       return (std::string("Chilling"));
-        case RS_POST_CHILL:     return (std::string("Post Chill"));
+        case RS_INIT:           return ("Init");
+        case RS_IDLE:           return ("Idle");
+        case RS_CHILL_START:    return ("Chill Starting");
+        case RS_CHILLING:       return ("Chilling");
+        case RS_POST_CHILL:     return ("Post Chill");
     }
 
-    return (std::string("Undefined"));
-}
\ No newline at end of file
+    return ("Undefined");
+}
+
+#ifdef DEBUG
+/*********************************************
+ * bench()
+ ******************************************** 
+ * what temperatures cost the way they were,
+ * floats, against the way they are.  A tick
+ * is both of update()'s compares, a reading
+ * is the probe's raw value converted, text 
+ * is what the display shows.  Everything is 
+ * volatile so none of it folds away.  Mostly
+ * the float snprintf(), the whole thing is
+ * roughly 1-2ms of core 0; debug builds only
+ ********************************************/ 
+const std::string reefer::bench()
+{
+    const uint8_t runs = 32;
+    volatile int16_t raw = 0x0123;
+    volatile float fTemp = 64.9f;
+    volatile float fSp = 65.0f;
+    volatile float fHyst = 1.0f;
+    volatile temp_t tTemp = TEMP_F(64.9);
+    volatile temp_t tSp = TEMP_F(65);
+    volatile temp_t tHyst = TEMP_F(1);
+    volatile bool on;
+    char text[TEMP_TEXT];
+    uint32_t start;
+    uint32_t tick[2] = { 0, 0 };
+    uint32_t reading[2] = { 0, 0 };
+    uint32_t toText[2] = { 0, 0 };
+
+    for (uint8_t ii = 0; ii < runs; ++ii)
+    {
+        start = logger::cycles();
+        on = (fTemp + fHyst) > fSp;
+        on = (fTemp + fHyst) < fSp;
+        tick[0] += (start - logger::cycles()) & 0x00ffffff;
+
+        start = logger::cycles();
+        on = (tTemp + tHyst) > tSp;
+        on = (tTemp + tHyst) < tSp;
+        tick[1] += (start - logger::cycles()) & 0x00ffffff;
+
+        start = logger::cycles();
+        fTemp = (((float)raw / 16) * 1.8f) + 32.0f;
+        reading[0] += (start - logger::cycles()) & 0x00ffffff;
+
+        start = logger::cycles();
+        tTemp = tempFromRaw(raw);
+        reading[1] += (start - logger::cycles()) & 0x00ffffff;
+
+        start = logger::cycles();
+        snprintf(text, sizeof(text), "%4.1f", (double)fTemp);
+        toText[0] += (start - logger::cycles()) & 0x00ffffff;
+
+        start = logger::cycles();
+        temp2text(tTemp, 1, text, sizeof(text));
+        toText[1] += (start - logger::cycles()) & 0x00ffffff;
+    }
+    (void)on;
+
+    return (FMT("Temperature cycles, float/fixed: control tick %d/%d, reading %d/%d, text %d/%d\n",
+            tick[0] / runs, tick[1] / runs, reading[0] / runs, reading[1] / runs,
+            toText[0] / runs, toText[1] / runs));
+}
+#endif
@@ -12,6 +12,7 @@
 #include "project.h"
 #include "./ipc/mlogger.h"
 #include "./utils/stringFormat.h"
+#include "./utils/temperature.h"
 #include "./sys/nvm.h"
 
 // State definition for the reefer state machine
@@ -32,17 +33,23 @@ public:
     
     void init();
 
-    void update(float currentTemp);
+    void update(temp_t currentTemp);
 
     uint32_t getPumpRuntimeSeconds()                    { return(pumpRuntimeSeconds); }
     bool isPumpRunning()                                { return(pumpRunning); }
     reefer_state_t getReeferState()                     { return(reeferState); }
-    const std::string getStateName(reefer_state_t state);
+    const char* getStateName(reefer_state_t state);
+
+#ifdef DEBUG
+    // cycles per control tick and per reading, floats
+    // against fixed point, for the record
+    static const std::string bench();
+#endif
 
 private:
     bool pumpRunning;
     uint32_t pumpRuntimeSeconds;
-    float lastTemp;
+    temp_t lastTemp;
     reefer_state_t reeferState;
     absolute_time_t refTimestamp;
     absolute_time_t logWriteTime;
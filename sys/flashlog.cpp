@@ -0,0 +1,449 @@
+/********************************************************
+ * flashlog.cpp
+ ********************************************************
+ * The log, kept in flash.  See the comment in
+ * flashlog.h
+ *
+ *******************************************************/
+#include <cstring>
+#include <cstddef>
+
+#include "flashlog.h"
+#include "hardware/sync.h"
+#include "../ipc/ipc.h"             // for hist2text()
+#include "../utils/stringFormat.h"
+
+#define PAGES_PER_SECTOR    (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+#define PAGE_BOOT           0x01    // the page that marks a boot
+
+flashlog* flashlog::instance = NULL;
+
+// text on its way from core 1 to core 0.  Core 1 only
+// moves head, core 0 only moves tail; they count up
+// forever and get masked down to the buffer
+static char stageBuff[FLASHLOG_STAGE_SIZE];
+static volatile uint32_t stageHead;
+static volatile uint32_t stageTail;
+static volatile uint32_t flushTo;       // what a flush has to get to
+
+/*******************************************************
+ * crc32()
+ *******************************************************
+ * the usual one, a bit at a time.  A page is only
+ * 256 bytes and they don't get written often
+ ******************************************************/
+static uint32_t crc32(uint32_t crc, const uint8_t* d, size_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *d++;
+        for (uint8_t bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 0x01)));
+        }
+    }
+
+    return (~crc);
+}
+
+/********************************************************
+ * getInstance
+ ********************************************************
+ * get the single instance of the class, instantiate
+ * if necessary.
+ *******************************************************/
+flashlog* flashlog::getInstance()
+{
+    if (!instance)
+    {
+        instance = new flashlog();
+    }
+
+    return (instance);
+}
+
+/*******************************************************
+ * init()
+ *******************************************************
+ * look through every page for the newest good one,
+ * carry on after it and mark this boot
+ ******************************************************/
+void flashlog::init(const char* why)
+{
+    static_assert(sizeof(page_t) == FLASH_PAGE_SIZE, "a log page has to be one flash page");
+    static_assert((FLASHLOG_STAGE_SIZE & (FLASHLOG_STAGE_SIZE - 1)) == 0, "flash log staging has to be a power of two");
+
+    std::memset(&stats, 0, sizeof(stats));
+    stageHead = stageTail = flushTo = 0;
+    waiting = false;
+    flushReq = false;
+
+    head = FLASHLOG_PAGES;
+    seq = 0;
+    boot = 0;
+
+    for (uint16_t ii = 0; ii < FLASHLOG_PAGES; ++ii)
+    {
+        const page_t* p = this->page(ii);
+        if (!this->pageGood(p))
+        {
+            if (!this->pageBlank(ii))
+            {
+                ++stats.skipped;
+            }
+            continue;
+        }
+
+        if (head == FLASHLOG_PAGES || (int32_t)(p->seq - seq) > 0)
+        {
+            head = ii;
+            seq = p->seq;
+            boot = p->boot;
+        }
+    }
+
+    // the sector the newest page is in was erased before
+    // it was written, so carry on in it
+    if (head == FLASHLOG_PAGES)
+    {
+        next = 0;
+        erased = false;
+        seq = 0;
+    }
+    else
+    {
+        next = head;
+        erased = true;
+        ++seq;
+        this->advance();
+    }
+
+    ++boot;
+
+    std::string marker = FMT("=== boot %d, %s ===\n", boot, why);
+    this->writePage(PAGE_BOOT, marker.c_str(), marker.length());
+}
+
+/*******************************************************
+ * stage()
+ *******************************************************
+ * core 1.  Into the RAM ring, or counted and dropped
+ * if flash isn't keeping up
+ ******************************************************/
+void flashlog::stage(const char* c, size_t len)
+{
+    uint32_t h = stageHead;
+    if (len > FLASHLOG_STAGE_SIZE - (h - stageTail))
+    {
+        stats.dropped += len;
+        return;
+    }
+
+    uint32_t at = h & (FLASHLOG_STAGE_SIZE - 1);
+    uint32_t part = FLASHLOG_STAGE_SIZE - at;
+    if (part > len)
+    {
+        part = len;
+    }
+
+    std::memcpy(&stageBuff[at], c, part);
+    std::memcpy(stageBuff, c + part, len - part);
+
+    // the text has to be there before core 0 can see it
+    __dmb();
+    stageHead = h + len;
+}
+
+/*******************************************************
+ * sink()
+ *******************************************************
+ * for the logger to call from drain()
+ ******************************************************/
+void flashlog::sink(const char* c, size_t len, void* ctx)
+{
+    ((flashlog*)ctx)->stage(c, len);
+}
+
+/*******************************************************
+ * requestFlush()
+ *******************************************************
+ * everything staged so far goes to flash, part page
+ * or not
+ ******************************************************/
+void flashlog::requestFlush()
+{
+    flushTo = stageHead;
+    flushReq = true;
+}
+
+/*******************************************************
+ * service()
+ *******************************************************
+ * core 0.  A sector erase is 45ms or so and a page
+ * about 1ms, both with core 1 locked out, so it's one
+ * or the other per call and only when there's a
+ * reason to.  The erase is a known cost: every 16
+ * pages, core 0's loop loses 45ms with interrupts off
+ * on both cores, and there's no splitting it; 4K is
+ * the least flash can erase
+ ******************************************************/
+bool flashlog::service()
+{
+    uint32_t t = stageTail;
+    uint32_t avail = stageHead - t;
+
+    if (flushReq && (int32_t)(flushTo - t) <= 0)
+    {
+        flushReq = false;
+    }
+
+    if (!avail)
+    {
+        waiting = false;
+        return (false);
+    }
+
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    if (!waiting)
+    {
+        waitMs = now;
+        waiting = true;
+    }
+
+    if (avail < FLASHLOG_TEXT && !flushReq && (now - waitMs) < FLASHLOG_FLUSH_MS)
+    {
+        return (false);
+    }
+
+    // a new sector gets a call of its own
+    if (!erased)
+    {
+        this->eraseNext();
+        return (true);
+    }
+
+    char text[FLASHLOG_TEXT];
+    uint32_t len = (avail < FLASHLOG_TEXT) ? avail : FLASHLOG_TEXT;
+    uint32_t at = t & (FLASHLOG_STAGE_SIZE - 1);
+    uint32_t part = FLASHLOG_STAGE_SIZE - at;
+    if (part > len)
+    {
+        part = len;
+    }
+
+    __dmb();
+    std::memcpy(text, &stageBuff[at], part);
+    std::memcpy(text + part, stageBuff, len - part);
+
+    // if it didn't take, the text stays staged for
+    // the next page, or for this one again if core 1
+    // couldn't be paused
+    if (this->writePage(0, text, len))
+    {
+        __dmb();
+        stageTail = t + len;
+        stats.bytes += len;
+        waiting = false;
+    }
+
+    return (true);
+}
+
+/*******************************************************
+ * writePage()
+ *******************************************************
+ * program one page at next, erasing its sector first
+ * if that hasn't been done, and read it back.  False
+ * if it didn't come back right; that page is skipped.
+ * Also false if core 1 couldn't be paused, and then
+ * next stays where it is for another try
+ ******************************************************/
+bool flashlog::writePage(uint8_t flags, const char* text, size_t len)
+{
+    if (!erased && !this->eraseNext())
+    {
+        return (false);
+    }
+
+    if (len > FLASHLOG_TEXT)
+    {
+        len = FLASHLOG_TEXT;
+    }
+
+    // unused text stays erased, all 1's
+    page_t p;
+    std::memset(&p, 0xff, sizeof(p));
+    p.seq = seq;
+    p.boot = boot;
+    p.len = (uint8_t)len;
+    p.flags = flags;
+    std::memcpy(p.text, text, len);
+    p.crc = crc32(crc32(0, (const uint8_t*)&p, offsetof(page_t, crc)),
+            (const uint8_t*)p.text, sizeof(p.text));
+
+    uint32_t start = time_us_32();
+    if (!nvm::getInstance()->flashWrite(FLASHLOG_OFFSET + (next * FLASH_PAGE_SIZE), false, (const uint8_t*)&p, sizeof(p)))
+    {
+        ++stats.busy;
+        return (false);
+    }
+    stats.programUs.add(time_us_32() - start);
+    ++stats.pages;
+
+    const page_t* got = this->page(next);
+    bool ok = this->pageGood(got) && got->seq == seq;
+    if (ok)
+    {
+        head = next;
+        ++seq;
+    }
+    else
+    {
+        ++stats.skipped;
+    }
+
+    this->advance();
+
+    return (ok);
+}
+
+/*******************************************************
+ * eraseNext()
+ *******************************************************
+ * erase the sector next is in.  Whatever was oldest
+ * goes with it.  False if core 1 couldn't be paused;
+ * it's still to do
+ ******************************************************/
+bool flashlog::eraseNext()
+{
+    uint32_t start = time_us_32();
+    if (!nvm::getInstance()->flashWrite(FLASHLOG_OFFSET + ((next / PAGES_PER_SECTOR) * FLASH_SECTOR_SIZE), true, NULL, 0))
+    {
+        ++stats.busy;
+        return (false);
+    }
+    stats.eraseUs.add(time_us_32() - start);
+    ++stats.erases;
+    erased = true;
+
+    return (true);
+}
+
+/*******************************************************
+ * advance()
+ *******************************************************
+ * move next on to a page that can be written.  Into a
+ * new sector means it needs erasing; in this one, a
+ * page that isn't blank (half written before a crash)
+ * gets skipped
+ ******************************************************/
+void flashlog::advance()
+{
+    while (true)
+    {
+        next = (next + 1) % FLASHLOG_PAGES;
+        if ((next % PAGES_PER_SECTOR) == 0)
+        {
+            erased = false;
+            return;
+        }
+
+        if (this->pageBlank(next))
+        {
+            return;
+        }
+        ++stats.skipped;
+    }
+}
+
+/*******************************************************
+ * page()
+ *******************************************************
+ * a page, read straight out of flash
+ ******************************************************/
+const flashlog::page_t* flashlog::page(uint16_t idx)
+{
+    return ((const page_t*)(XIP_BASE + FLASHLOG_OFFSET + (idx * FLASH_PAGE_SIZE)));
+}
+
+/*******************************************************
+ * pageGood()
+ *******************************************************
+ * written all the way and not since mangled
+ ******************************************************/
+bool flashlog::pageGood(const page_t* p)
+{
+    if (p->seq == 0xffffffff || p->len > FLASHLOG_TEXT)
+    {
+        return (false);
+    }
+
+    uint32_t crc = crc32(crc32(0, (const uint8_t*)p, offsetof(page_t, crc)),
+            (const uint8_t*)p->text, sizeof(p->text));
+
+    return (crc == p->crc);
+}
+
+/*******************************************************
+ * pageBlank()
+ *******************************************************
+ * still erased, nothing has been written to it
+ ******************************************************/
+bool flashlog::pageBlank(uint16_t idx)
+{
+    const uint32_t* w = (const uint32_t*)this->page(idx);
+
+    for (uint16_t ii = 0; ii < FLASH_PAGE_SIZE / sizeof(uint32_t); ++ii)
+    {
+        if (w[ii] != 0xffffffff)
+        {
+            return (false);
+        }
+    }
+
+    return (true);
+}
+
+/*******************************************************
+ * pageText()
+ *******************************************************
+ * walks from the page after the newest, which is the
+ * oldest once the log has been all the way round
+ ******************************************************/
+bool flashlog::pageText(uint16_t n, std::string& text)
+{
+    if (n >= FLASHLOG_PAGES)
+    {
+        return (false);
+    }
+
+    uint16_t h = head;
+    uint16_t idx = (h == FLASHLOG_PAGES) ? n : (h + 1 + n) % FLASHLOG_PAGES;
+    const page_t* p = this->page(idx);
+
+    text.clear();
+    if (this->pageGood(p))
+    {
+        text.assign(p->text, p->len);
+    }
+
+    return (true);
+}
+
+/*******************************************************
+ * stats2text()
+ *******************************************************
+ * counters and where it's at, then the flash timings
+ ******************************************************/
+const std::string flashlog::stats2text()
+{
+    std::string ret = FMT("Flash log: boot %d, next page %d of %d, %d pages, %d erases, %d bytes, %d staged, %d dropped, %d skipped, %d busy\n",
+            boot, next, FLASHLOG_PAGES, stats.pages, stats.erases, stats.bytes,
+            stageHead - stageTail, stats.dropped, stats.skipped, stats.busy);
+
+    if (stats.programUs.count())    ret += "  page us " + hist2text(stats.programUs) + "\n";
+    if (stats.eraseUs.count())      ret += "  erase us " + hist2text(stats.eraseUs) + "\n";
+
+    return (ret);
+}
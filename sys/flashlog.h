@@ -0,0 +1,128 @@
+/********************************************************
+ * flashlog.h
+ ********************************************************
+ * The log, kept in flash so it's still there after a
+ * reboot.  Core 1 hands each line to stage() as it
+ * drains the logger; that's a RAM ring, core 1 in and
+ * core 0 out, so nothing waits.  Core 0 calls service()
+ * from its loop and writes a page at a time, through
+ * nvm::flashWrite() like everything else that writes
+ * flash.
+ *
+ * The flash part is FLASHLOG_SECTORS sectors right under
+ * the nvm sector, used round and round so every sector
+ * gets erased as often as every other.  Each page has a
+ * header with a sequence number and a CRC, so after a
+ * crash or power loss the newest good page says where
+ * to carry on, and a page that was half written is just
+ * skipped.  Every boot gets counted and marked with a
+ * page of its own.
+ *
+ *******************************************************/
+#ifndef FLASHLOG_H_
+#define FLASHLOG_H_
+
+#include <string>
+
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+
+#include "nvm.h"
+#include "../ipc/histogram.h"
+
+#define FLASHLOG_SECTORS    8           // 32K of flash, 128 pages
+#define FLASHLOG_STAGE_SIZE 2048        // RAM ring, power of two
+#define FLASHLOG_FLUSH_MS   30000       // longest a part page waits
+
+#define FLASHLOG_OFFSET     (uint32_t)(NVM_FLASH_OFFSET - (FLASHLOG_SECTORS * FLASH_SECTOR_SIZE))
+#define FLASHLOG_PAGES      ((FLASHLOG_SECTORS * FLASH_SECTOR_SIZE) / FLASH_PAGE_SIZE)
+#define FLASHLOG_TEXT       (FLASH_PAGE_SIZE - 12)  // text in one page
+
+// what keeping the log in flash costs
+struct flashlog_stats_t
+{
+    uint32_t pages;         // programmed
+    uint32_t erases;        // sectors erased
+    uint32_t bytes;         // text that made it to flash
+    uint32_t dropped;       // text that didn't fit in the RAM ring
+    uint32_t skipped;       // pages found bad, at boot or after writing
+    uint32_t busy;          // core 1 didn't pause in time, tried again later
+    histogram programUs;    // one page, lockout and all
+    histogram eraseUs;      // one sector
+};
+
+class flashlog
+{
+public:
+    // singleton
+    static flashlog* getInstance();
+
+    // core 0, once nvm is up and before core 1 starts.
+    // Finds where the log got to, counts this boot and
+    // writes its marker page, with why in it
+    void init(const char* why);
+
+    // core 1, a line on its way to flash.  sink() is
+    // the same thing, for logger::setSink()
+    void stage(const char* c, size_t len);
+    static void sink(const char* c, size_t len, void* ctx);
+
+    // core 0's loop.  At most one erase or one page per
+    // call, and only when there's a page worth of text,
+    // a part page has waited long enough, or a flush was
+    // asked for.  If core 1 can't be paused, the same
+    // erase or page is tried again next call.  True if
+    // it tried to write flash
+    bool service();
+
+    // either core; write out everything that's staged,
+    // even a part page.  Pending until it's done
+    void requestFlush();
+    bool flushPending()                 { return (flushReq); }
+
+    uint16_t getBoot()                  { return (boot); }
+
+    // text of the n'th page, oldest first.  False once
+    // n is past the newest; empty text for pages that
+    // aren't there or aren't any good.  Either core
+    bool pageText(uint16_t n, std::string& text);
+
+    void getStats(flashlog_stats_t& s)  { s = stats; }
+    const std::string stats2text();
+
+private:
+    // one page of the log in flash
+    struct page_t
+    {
+        uint32_t seq;               // pages written, ever; erased is all 1's
+        uint16_t boot;              // boot it was written in
+        uint8_t  len;               // text that follows
+        uint8_t  flags;             // PAGE_BOOT
+        uint32_t crc;               // of the rest of the page
+        char     text[FLASHLOG_TEXT];
+    };
+
+    flashlog() {}
+
+    const page_t* page(uint16_t idx);
+    bool pageGood(const page_t* p);
+    bool pageBlank(uint16_t idx);
+    bool eraseNext();
+    void advance();
+    bool writePage(uint8_t flags, const char* text, size_t len);
+
+    volatile uint16_t head;     // newest good page, FLASHLOG_PAGES for none
+    uint16_t next;              // where the next page goes
+    bool erased;                // next's sector is ready for it
+    uint32_t seq;               // for the next page
+    uint16_t boot;              // this boot's count
+    bool waiting;               // there's a part page
+    uint32_t waitMs;            // since when
+    volatile bool flushReq;
+
+    flashlog_stats_t stats;
+
+    static flashlog* instance;
+};
+
+#endif // FLASHLOG_H_
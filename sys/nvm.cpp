@@ -64,12 +64,15 @@
 #include "../ipc/ipc.h"
 #include "../utils/stringFormat.h"
 
-#define SIG (uint32_t)(0xabad1dea)              // signature to know we're valid
+#define SIG (uint32_t)(0xabad1deb)              // signature to know we're valid
+#define SIG_FLOAT (uint32_t)(0xabad1dea)        // same, from when temperatures were floats
 #define ENDSIG (uint32_t)(0x2bad1dea)           // ending signature
-#define END_OF_FLASH    (uint32_t)(0x001f0000)  // 2 meg of flash on board
+#define DEFAULT_BRIGHTNESS  (uint32_t)100       // percent
+#define LOCKOUT_US      (uint64_t)25            // longest core 1 gets to pause or resume
+#define WRITE_TRIES     10                      // for settings, before giving up
 
 // Offset is one sector from the end of the flash
-#define START_OFFSET    (uint32_t)(END_OF_FLASH - FLASH_SECTOR_SIZE)
+#define START_OFFSET    NVM_FLASH_OFFSET
 
 // Read location is offset from the start of the Execute-in-Place in memory map
 #define READ_LOCATION   (uint32_t)(XIP_BASE + START_OFFSET)
@@ -104,102 +107,117 @@ nvm* nvm::getInstance()
  *******************************************************/
 void nvm::write()
 {
-    log->dbgWrite(stringFormat("nvm::%s() - entering\n", __FUNCTION__));
-    if (get_core_num() == 1)
-    {
-        log->errWrite("Cannot call nvm::write() from core 1!!\n");
-        return;
-    }
+    log->dbgFmt<LF_NVM_ENTER>(__FUNCTION__);
 
-    // it is the last block in the flash chip
-    uint32_t loc = START_OFFSET;
+    // we write full pages, so pad it out
+    uint8_t data[(sizeof(nvmData) + FLASH_PAGE_SIZE - 1) & ~(FLASH_PAGE_SIZE - 1)];
+    std::memset(data, 0, sizeof(data));
+    std::memcpy(data, &nvmData, sizeof(nvmData));
 
-    // we write a full page at a crack
-    uint8_t data[FLASH_PAGE_SIZE];
+    // get the time now
+    absolute_time_t start = get_absolute_time();
 
-    // pointer to the start of the structure
-    uint8_t* ptr = (uint8_t*)&nvmData;
+    // erase the full sector before writing.  Core 1 can
+    // be too busy to pause, but it will have by the next
+    // try or two
+    uint8_t tries = 0;
+    while (!this->flashWrite(START_OFFSET, true, data, sizeof(data), true))
+    {
+        if (++tries >= WRITE_TRIES)
+        {
+            log->errFmt<LF_NVM_GAVE_UP>(tries);
+            return;
+        }
+    }
 
-    // total number of bytes to write
-    size_t bytesRemaining = sizeof(nvmData);
+    // no reading the clock for nothing in a release build
+    if (log->isOn(LOG_DEBUG))
+    {
+        log->dbgFmt<LF_NVM_DONE>(absolute_time_diff_us(start, get_absolute_time()));
+    }
+    log->dbgFmt<LF_NVM_LEAVE>(__FUNCTION__);
+}
 
-    // get the time now
-    absolute_time_t start = get_absolute_time();
+/********************************************************
+ * flashWrite()
+ ********************************************************
+ * erase a sector and/or program whole pages with core 1
+ * held off; this is the only way anything gets written
+ * to flash.  Core 0 only.  offset is from the start of
+ * flash, len a multiple of FLASH_PAGE_SIZE and 0 for an
+ * erase alone.  trace puts each step in the log; the 
+ * flash log can't have that, it would never catch up.
+ *
+ * Core 1 has stretches with interrupts off, and it only
+ * pauses from an interrupt.  If it doesn't pause in
+ * time, it could still be running from flash, so flash
+ * is left alone and this returns false.  Core 1 still
+ * pauses once it gets to the request, and then waits
+ * for the next call here to let it go (that call goes
+ * straight through), so whoever gets false has to try
+ * again soon.  An erase is around 45ms with interrupts
+ * off on both cores, a page about 1ms
+ *******************************************************/
+bool nvm::flashWrite(uint32_t offset, bool erase, const uint8_t* data, size_t len, bool trace)
+{
+    if (get_core_num() == 1)
+    {
+        log->errFmt<LF_NVM_CORE1>();
+        return (false);
+    }
 
     // do the work in a critical section so we don't 
     // get clobbered by an interrupt or other surprises
     critical_section_enter_blocking(&crit);
 
-#ifdef DEBUG
-    log->dbgWrite("NVM::entered critical section\n");
-#endif
+    if (trace)  log->dbgFmt<LF_NVM_CRIT_IN>();
 
     // ask core 1 to pause; it will go into a spinlock 
     // running from RAM.  Make sure to check if core 1 
     // has been init'd first, otherwise we could hang
     // here forever
-    if (core1Ready)
+    if (core1Ready && !multicore_lockout_start_timeout_us(LOCKOUT_US))
     {
-        multicore_lockout_start_timeout_us((uint64_t)25);
-    }
+        critical_section_exit(&crit);
 
-#ifdef DEBUG
-    log->dbgWrite("NVM::core 0 locked\n");
-#endif
-
-    // erase the full sector before writing
-    flash_range_erase(START_OFFSET, FLASH_SECTOR_SIZE);
+        if (trace)  log->errFmt<LF_NVM_NO_LOCKOUT>();
+        return (false);
+    }
 
-#ifdef DEBUG
-    log->dbgWrite("NVM::erased sector\n");
-#endif
+    if (trace)  log->dbgFmt<LF_NVM_LOCKED>();
 
-    while (bytesRemaining)
+    if (erase)
     {
-        // see how many bytes are remaining to be written.  if it's 
-        // more than a block size, then write the next block
-        size_t bytesToWrite = bytesRemaining;
-
-        if (bytesToWrite >= FLASH_PAGE_SIZE)
-        {
-            bytesToWrite = FLASH_PAGE_SIZE;
-        }
-
-        // clear the buffer and copy the data to it
-        std::memset(data, 0, FLASH_PAGE_SIZE);
-        std::memcpy(data, ptr, bytesToWrite);
+        flash_range_erase(offset, FLASH_SECTOR_SIZE);
 
-        // write the page to flash
-        flash_range_program(loc, data, FLASH_PAGE_SIZE);
-
-        // increment the starting address in the NVM structure
-        ptr += FLASH_BLOCK_SIZE;
+        if (trace)  log->dbgFmt<LF_NVM_ERASED>();
+    }
 
-        // decrement by the number of bytes 
-        bytesRemaining -= bytesToWrite;
+    if (len)
+    {
+        flash_range_program(offset, data, len);
     }
 
-    // tell core 1 it can start running from Flash again
-    // Make sure to check if core 1 
-    // has been init'd first, otherwise we could hang
-    // here forever
+    // tell core 1 it can start running from Flash again.
+    // The flash is done either way; if core 1 hasn't said
+    // so in time, it still has the message and gets to it
+    bool resumed = true;
     if (core1Ready)
     {
-        multicore_lockout_end_timeout_us((uint64_t)25);
+        resumed = multicore_lockout_end_timeout_us(LOCKOUT_US);
     }
 
-#ifdef DEBUG
-    log->dbgWrite("NVM::unlocked core 1\n");
-#endif
+    if (trace)  log->dbgFmt<LF_NVM_UNLOCKED>();
 
     critical_section_exit(&crit);
 
-#ifdef DEBUG
-    log->dbgWrite("NVM::left critical section\n");
-#endif
+    if (trace)  log->dbgFmt<LF_NVM_CRIT_OUT>();
+    if (!resumed)
+    {
+        log->warnFmt<LF_NVM_NO_RESUME>();
+    }
 
-    log->dbgWrite(stringFormat("Done writing bytes to Flash in %ld us\n", absolute_time_diff_us(start, get_absolute_time())));
-    log->dbgWrite(stringFormat("nvm::%s() - leaving\n", __FUNCTION__));
+    return (true);
 }
 
 /********************************************************
@@ -216,6 +234,33 @@ void nvm::load()
     // just a memcpy to get from Flash to RAM
     std::memcpy((void*)&nvmData, loc, sizeof(nvmData));
 
+    // before brightness was added, the end signature sat
+    // where brightness is now.  Move it up and give the 
+    // display its default, then the floats get converted
+    // below like any other old sector
+    if (nvmData.signature == SIG_FLOAT && nvmData.brightness == ENDSIG)
+    {
+        log->warnWrite("Adding brightness to NVM\n");
+        nvmData.brightness = DEFAULT_BRIGHTNESS;
+        nvmData.endSig = ENDSIG;
+    }
+
+    // temperatures used to be floats.  Convert them, once,
+    // rather than lose everything else
+    if (nvmData.signature == SIG_FLOAT && nvmData.endSig == ENDSIG)
+    {
+        float sp;
+        float h;
+        std::memcpy(&sp, &nvmData.setpoint, sizeof(sp));
+        std::memcpy(&h, &nvmData.hysteresis, sizeof(h));
+
+        log->warnWrite("Converting NVM temperatures to fixed point\n");
+        nvmData.setpoint = (temp_t)((sp * 100.0f) + ((sp < 0) ? -0.5f : 0.5f));
+        nvmData.hysteresis = (temp_t)((h * 100.0f) + ((h < 0) ? -0.5f : 0.5f));
+        nvmData.signature = SIG;
+        this->write();
+    }
+
     // is it good?
     if (nvmData.signature != SIG || nvmData.endSig != ENDSIG)
     {
@@ -234,11 +279,12 @@ void nvm::setDefaults()
 {
     nvmData.signature = SIG;
     nvmData.runtime = 0;
-    nvmData.setpoint = 65.0;
-    nvmData.hysteresis = 1.0;
+    nvmData.setpoint = TEMP_F(65);
+    nvmData.hysteresis = TEMP_F(1);
     strncpy(nvmData.ssid, WIFI_ACCESS_POINT_NAME, 63);
     strncpy(nvmData.pw, WIFI_PASSPHRASE, 63);
     strncpy(nvmData.tz, "CST6CDT", 31);
+    nvmData.brightness = DEFAULT_BRIGHTNESS;
     nvmData.endSig = ENDSIG;
 }
 
@@ -252,22 +298,27 @@ void nvm::setDefaults()
  *******************************************************/
 void nvm::dump2String()
 {
-    log->dbgWrite(stringFormat("\n  Signature - 0x%08x\n"
-                                 "    Runtime - %d seconds\n"
-                                 "   Setpoint - %02.1f deg F\n"
-                                 " Hysteresis - %02.1f deg F\n"
-                                 "       SSID - %s\n"
-                                 "         PW - %s\n"
-                                 "   Timezone - %s\n"
-                                 "    End Sig - 0x%08x\n",
-            nvmData.signature,
-            nvmData.runtime,
-            nvmData.setpoint,
-            nvmData.hysteresis,
-            nvmData.ssid,
-            nvmData.pw,
-            nvmData.tz,
-            nvmData.endSig));
+    if (!log->isOn(LOG_DEBUG))
+    {
+        return;
+    }
+
+    char sp[TEMP_TEXT];
+    char h[TEMP_TEXT];
+    temp2text(nvmData.setpoint, 1, sp, sizeof(sp));
+    temp2text(nvmData.hysteresis, 1, h, sizeof(h));
+
+    // a line each; with the strings at their longest, all
+    // of it won't fit one FMT()
+    DBG_WRITE(log, FMT("  Signature - 0x%08x\n", nvmData.signature));
+    DBG_WRITE(log, FMT("    Runtime - %d seconds\n", nvmData.runtime));
+    DBG_WRITE(log, FMT("   Setpoint - %s deg F\n", sp));
+    DBG_WRITE(log, FMT(" Hysteresis - %s deg F\n", h));
+    DBG_WRITE(log, FMT("       SSID - %s\n", nvmData.ssid));
+    DBG_WRITE(log, FMT("         PW - %s\n", nvmData.pw));
+    DBG_WRITE(log, FMT("   Timezone - %s\n", nvmData.tz));
+    DBG_WRITE(log, FMT(" Brightness - %d%%\n", nvmData.brightness));
+    DBG_WRITE(log, FMT("    End Sig - 0x%08x\n", nvmData.endSig));
 }
 
 /********************************************************
@@ -12,7 +12,15 @@
 #include <string>
 #include <cstring>
 #include "pico/multicore.h"
+#include "hardware/flash.h"
 #include "../ipc/mlogger.h"
+#include "../utils/temperature.h"
+
+#define NVM_END_OF_FLASH    (uint32_t)(0x001f0000)  // 2 meg of flash on board
+
+// nvm lives in the sector under that; the flash log in
+// the ones under nvm
+#define NVM_FLASH_OFFSET    (uint32_t)(NVM_END_OF_FLASH - FLASH_SECTOR_SIZE)
 
 class nvm
 {
@@ -25,13 +33,17 @@ public:
     void init();
     void setDefaults();
 
+    // erase and/or program flash with core 1 locked out
+    bool flashWrite(uint32_t offset, bool erase, const uint8_t* data, size_t len, bool trace = false);
+
     void setCore1Ready(bool ready)              { core1Ready = ready; }
 
     void setTZ(const std::string& t);
     void setSSID(const std::string& s);         
     void setPwd(const std::string& p);
-    void setSetpoint(float sp)                  { nvmData.setpoint = sp; }
-    void setHysteresis (float h)                { nvmData.hysteresis = h; }
+    void setSetpoint(temp_t sp)                 { nvmData.setpoint = sp; }
+    void setHysteresis (temp_t h)               { nvmData.hysteresis = h; }
+    void setBrightness(uint8_t b)               { nvmData.brightness = b; }
 
     void accumulateRuntime(uint32_t rt)         { nvmData.runtime += rt; }
 
@@ -41,8 +53,9 @@ public:
     const std::string getTZ()                   { return (nvmData.tz); }
     const std::string getSSID() const           { return (std::string(nvmData.ssid)); }
     const std::string getPwd() const            { return (std::string(nvmData.pw)); }
-    float getSetpoint() const                   { return (nvmData.setpoint); }
-    float getHysteresis() const                 { return (nvmData.hysteresis); }
+    temp_t getSetpoint() const                  { return (nvmData.setpoint); }
+    temp_t getHysteresis() const                { return (nvmData.hysteresis); }
+    uint8_t getBrightness() const               { return ((uint8_t)nvmData.brightness); }
 private:
     bool core1Ready;
 
@@ -50,15 +63,16 @@ private:
     {
         uint32_t signature;     // 0
         uint32_t runtime;       // 4
-        float setpoint;         // 8
-        float hysteresis;       // 12
+        temp_t setpoint;        // 8, hundredths of a degree F
+        temp_t hysteresis;      // 12
         
         char ssid[64];          // 16
         char pw[64];            // 80
         char tz[32];            // 144
+        uint32_t brightness;    // 176 display, percent
 
-        uint32_t endSig;        // 176
-    } nvmData;                  // 180 total bytes
+        uint32_t endSig;        // 180
+    } nvmData;                  // 184 total bytes
     
     static nvm* instance;
     nvm() {}
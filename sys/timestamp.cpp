@@ -0,0 +1,195 @@
+/********************************************************
+ * timestamp.cpp
+ ********************************************************
+ * Wall clock time for log lines.  See the comment in
+ * timestamp.h
+ *
+ *******************************************************/
+#include <cstring>
+#include <ctime>
+
+#include "timestamp.h"
+#include "walltime.h"
+#include "../ipc/mlogger.h"         // for logger::cycles()
+#include "../utils/stringFormat.h"
+
+timestamp* timestamp::instance = NULL;
+
+/*******************************************************
+ * dt2sec()
+ *******************************************************
+ * RTC date and time as seconds since 1970, without
+ * going near the time zone (the RTC is already local)
+ ******************************************************/
+static int64_t dt2sec(const datetime_t& t)
+{
+    int32_t y = t.year - ((t.month <= 2) ? 1 : 0);
+    int32_t era = ((y >= 0) ? y : y - 399) / 400;
+    uint32_t yoe = (uint32_t)(y - (era * 400));
+    uint32_t doy = ((153 * (t.month + ((t.month > 2) ? -3 : 9))) + 2) / 5 + t.day - 1;
+    uint32_t doe = (yoe * 365) + (yoe / 4) - (yoe / 100) + doy;
+    int64_t days = ((int64_t)era * 146097) + doe - 719468;
+
+    return ((days * 86400) + (t.hour * 3600) + (t.min * 60) + t.sec);
+}
+
+/********************************************************
+ * getInstance
+ ********************************************************
+ * get the single instance of the class, instantiate
+ * if necessary.
+ *******************************************************/
+timestamp* timestamp::getInstance()
+{
+    if (!instance)
+    {
+        instance = new timestamp();
+    }
+
+    return (instance);
+}
+
+/*******************************************************
+ * sync()
+ *******************************************************
+ * Until the RTC is seen ticking over, the anchor is
+ * wherever in the second it was read, up to a second
+ * off.  Once it has, it's good to the ms this gets
+ * called at, and it's left alone for a minute
+ ******************************************************/
+void timestamp::sync()
+{
+    uint64_t now = time_us_64();
+
+    if (valid && locked && (now - anchorUs) < TIMESTAMP_RESYNC_US)
+    {
+        return;
+    }
+
+    datetime_t dt;
+    if (!rtc_get_datetime(&dt))
+    {
+        valid = false;
+        return;
+    }
+
+    int64_t sec = dt2sec(dt);
+
+    if (!valid)
+    {
+        anchorSec = sec;
+        anchorUs = now;
+        valid = true;
+        locked = false;
+        cachedSec = -1;
+    }
+    else if (locked)
+    {
+        // time for a fresh one; keep this one until the
+        // next tick
+        locked = false;
+    }
+    else if (sec != lastSec)
+    {
+        anchorSec = sec;
+        anchorUs = now;
+        locked = true;
+        cachedSec = -1;
+        ++anchors;
+    }
+
+    lastSec = sec;
+}
+
+/*******************************************************
+ * format()
+ *******************************************************
+ * the date and time from the cache if it's the same
+ * second as last time, then the microseconds
+ ******************************************************/
+size_t timestamp::format(uint64_t us, char* out)
+{
+    if (!valid)
+    {
+        int n = snprintf(out, TIMESTAMP_TEXT, "up %lu.%06lu",
+                (unsigned long)(us / 1000000), (unsigned long)(us % 1000000));
+        return ((n > 0) ? (size_t)n : 0);
+    }
+
+    // lines from before the anchor are fine too
+    int64_t since = (int64_t)(us - anchorUs);
+    int64_t secs = since / 1000000;
+    int64_t frac = since % 1000000;
+    if (frac < 0)
+    {
+        frac += 1000000;
+        --secs;
+    }
+    int64_t sec = anchorSec + secs;
+
+    if (sec != cachedSec)
+    {
+        time_t t = (time_t)sec;
+        struct tm tm;
+        gmtime_r(&t, &tm);
+
+        int n = snprintf(cached, sizeof(cached), "%04d%02d%02d %02d:%02d:%02d",
+                tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                tm.tm_hour, tm.tm_min, tm.tm_sec);
+        cachedLen = (n > 0) ? (uint8_t)n : 0;
+        cachedSec = sec;
+    }
+
+    std::memcpy(out, cached, cachedLen);
+
+    char* p = out + cachedLen;
+    *p++ = '.';
+    uint32_t f = (uint32_t)frac;
+    for (int8_t ii = 5; ii >= 0; --ii)
+    {
+        p[ii] = '0' + (f % 10);
+        f /= 10;
+    }
+    p[6] = '\0';
+
+    return (cachedLen + 7);
+}
+
+/*******************************************************
+ * bench()
+ *******************************************************
+ * what a line's time costs: the old way, reading the
+ * RTC and FMT() every line, against this way
+ * in the same second and at a new second
+ ******************************************************/
+const std::string timestamp::bench()
+{
+    const uint8_t runs = 32;
+    char out[TIMESTAMP_TEXT];
+    uint32_t start;
+    uint32_t oldWay = 0;
+    uint32_t sameSec = 0;
+    uint32_t newSec = 0;
+
+    for (uint8_t ii = 0; ii < runs; ++ii)
+    {
+        start = logger::cycles();
+        std::string s = walltime::logTimeString();
+        oldWay += (start - logger::cycles()) & 0x00ffffff;
+
+        uint64_t now = time_us_64();
+        this->format(now, out);
+
+        start = logger::cycles();
+        this->format(now + 1, out);
+        sameSec += (start - logger::cycles()) & 0x00ffffff;
+
+        start = logger::cycles();
+        this->format(now + ((ii + 1) * 1000000ULL), out);
+        newSec += (start - logger::cycles()) & 0x00ffffff;
+    }
+
+    return (FMT("Timestamp: %s, %d anchors; cycles per line: RTC and format %d, cached %d, new second %d\n",
+            valid ? (locked ? "locked" : "not locked yet") : "clock not set", anchors,
+            oldWay / runs, sameSec / runs, newSec / runs));
+}
@@ -0,0 +1,69 @@
+/********************************************************
+ * timestamp.h
+ ********************************************************
+ * Wall clock time for log lines, to the microsecond.
+ * Lines carry time_us_64() from when they were written;
+ * this turns that into "20211205 13:04:05.123456".
+ *
+ * The RTC only has seconds, so it's read just often
+ * enough to catch the second ticking over.  That tick
+ * and the timer value it came at are the anchor, and
+ * every time after is worked out from the timer.  The
+ * date and time part only gets formatted once a second;
+ * the microseconds get tacked on.
+ *
+ * Core 1 only, it's for the logger's drain()
+ *
+ *******************************************************/
+#ifndef TIMESTAMP_H_
+#define TIMESTAMP_H_
+
+#include <string>
+
+#include "pico/stdlib.h"
+#include "hardware/rtc.h"
+
+#define TIMESTAMP_RESYNC_US     60000000    // look for a new anchor this often
+#define TIMESTAMP_TEXT          26          // "20211205 13:04:05.123456" and a null
+
+class timestamp
+{
+public:
+    // singleton
+    static timestamp* getInstance();
+
+    // watch the RTC for the second to tick over.  Call it
+    // often, every ms or so; mostly it does nothing
+    void sync();
+
+    // the clock was just set, find a new anchor
+    void resync()                       { valid = false; }
+
+    // text for a time_us_64() value, into out, which
+    // has to hold TIMESTAMP_TEXT; returns its length.
+    // Uptime if the clock isn't set
+    size_t format(uint64_t us, char* out);
+
+    // a quick run of the old way and this way, cycles
+    // per line
+    const std::string bench();
+
+private:
+    timestamp() : valid(false), locked(false), cachedSec(-1), anchors(0) {}
+
+    bool valid;             // the RTC is running and there's an anchor
+    bool locked;            // the anchor is at a second ticking over
+    int64_t anchorSec;      // RTC time as seconds since 1970
+    uint64_t anchorUs;      // time_us_64() at anchorSec
+    int64_t lastSec;        // the RTC, last time sync() looked
+
+    int64_t cachedSec;      // what cached is the text for
+    char cached[TIMESTAMP_TEXT];
+    uint8_t cachedLen;
+
+    uint32_t anchors;       // how many times it's re-anchored
+
+    static timestamp* instance;
+};
+
+#endif // TIMESTAMP_H_
@@ -17,6 +17,7 @@
 
 #include "pico/stdlib.h"
 #include "walltime.h"
+#include "timestamp.h"
 #include "../utils/stringFormat.h"
 
 #define LOCAL_PORT 2390
@@ -162,8 +163,9 @@ bool walltime::doNTP()
         pico.min = local->tm_min;
         pico.sec = local->tm_sec;
 
-        // set the Pico RTC
+        // set the Pico RTC, and log times start over from it
         timeValid = rtc_set_datetime(&pico);
+        timestamp::getInstance()->resync();
     }
 
     return (timeValid);
@@ -183,7 +185,7 @@ std::string walltime::timeString()
     // get the time from the RTC module
     if (rtc_get_datetime(&now))
     {
-        ret = stringFormat("%02d:%02d:%02d",
+        ret = FMT("%02d:%02d:%02d",
                 now.hour, now.min, now.sec);
     }
 
@@ -203,7 +205,7 @@ std::string walltime::dateString()
     
     if (rtc_get_datetime(&now))
     {        
-        ret = stringFormat("%d/%d/%d",
+        ret = FMT("%d/%d/%d",
                 now.month, now.day, now.year);
     }
 
@@ -224,7 +226,7 @@ std::string walltime::logTimeString()
     
     if (rtc_get_datetime(&now))
     {        
-        ret = stringFormat("%04d%02d%02d %02d:%02d:%02d",
+        ret = FMT("%04d%02d%02d %02d:%02d:%02d",
                 now.year, now.month, now.day,
                 now.hour, now.min, now.sec);
     }
@@ -0,0 +1,75 @@
+/********************************************************
+ * bench.cpp
+ ********************************************************
+ * The allocation count and cycles behind bench.h.
+ * Every new in a benchmark program comes through here
+ *
+ *******************************************************/
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "bench.h"
+
+static std::atomic<uint64_t> allocCount(0);
+static std::atomic<uint64_t> allocBytes(0);
+
+bench_allocs_t benchAllocs()
+{
+    bench_allocs_t a = { allocCount.load(), allocBytes.load() };
+    return (a);
+}
+
+/*******************************************************
+ * benchCycles()
+ *******************************************************
+ * the time stamp counter runs at a fixed rate, so it's
+ * timed against the clock once, over 20ms
+ ******************************************************/
+double benchCycles(double ns)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static double perNs = 0;
+
+    if (!perNs)
+    {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t ticks = __rdtsc();
+        std::chrono::duration<double, std::nano> took;
+        do
+        {
+            took = std::chrono::steady_clock::now() - start;
+        } while (took.count() < 20e6);
+
+        perNs = (double)(__rdtsc() - ticks) / took.count();
+    }
+
+    return (ns * perNs);
+#else
+    return (0);
+#endif
+}
+
+void* operator new(std::size_t size)
+{
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    allocBytes.fetch_add(size, std::memory_order_relaxed);
+
+    void* p = std::malloc(size ? size : 1);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+
+    return (p);
+}
+
+void* operator new[](std::size_t size)                  { return (operator new(size)); }
+void operator delete(void* p) noexcept                  { std::free(p); }
+void operator delete[](void* p) noexcept                { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept     { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept   { std::free(p); }
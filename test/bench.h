@@ -0,0 +1,80 @@
+/********************************************************
+ * bench.h
+ ********************************************************
+ * Timing for the host benchmarks.  A <name>_bench.cpp
+ * is TEST()s like any other file, so check.cpp runs it,
+ * but each one times the code against what it replaced
+ * and prints the numbers.  They're the host's, so they
+ * only mean anything side by side, old against new.
+ * bench.cpp counts every allocation too, and turns ns
+ * into the host's cycles
+ *
+ *******************************************************/
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#define BENCH_RUNS          5           // best of
+
+// allocations since the program started
+struct bench_allocs_t
+{
+    uint64_t count;
+    uint64_t bytes;
+};
+
+bench_allocs_t benchAllocs();
+
+// ns as cycles of the host's time stamp counter, 0 if
+// there isn't one
+double benchCycles(double ns);
+
+// keep the optimizer from throwing away a result
+template <typename T>
+inline void benchKeep(const T& v)
+{
+    asm volatile("" : : "g"(&v) : "memory");
+}
+
+// ns per call of fn(), calls at a time, best of
+// BENCH_RUNS
+template <typename F>
+double benchNs(uint32_t calls, F fn)
+{
+    double best = 0;
+
+    for (uint8_t run = 0; run < BENCH_RUNS; ++run)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t ii = 0; ii < calls; ++ii)
+        {
+            fn();
+        }
+        std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+
+        double ns = took.count() / calls;
+        if (!run || ns < best)
+        {
+            best = ns;
+        }
+    }
+
+    return (best);
+}
+
+// what one call of fn() allocates
+template <typename F>
+bench_allocs_t benchAllocsOf(F fn)
+{
+    bench_allocs_t before = benchAllocs();
+    fn();
+    bench_allocs_t after = benchAllocs();
+
+    bench_allocs_t a = { after.count - before.count, after.bytes - before.bytes };
+    return (a);
+}
+
+#endif // BENCH_H_
@@ -0,0 +1,79 @@
+/********************************************************
+ * check.cpp
+ ********************************************************
+ * The runner behind check.h
+ *
+ *******************************************************/
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+
+#include "check.h"
+
+struct test_t
+{
+    const char* name;
+    test_fn_t fn;
+};
+
+static uint32_t failures = 0;
+static std::string context;
+
+// filled in before main(), so it has to exist before
+// the first TEST() signs up
+static std::vector<test_t>& tests()
+{
+    static std::vector<test_t> t;
+    return (t);
+}
+
+testReg::testReg(const char* name, test_fn_t fn)
+{
+    tests().push_back({ name, fn });
+}
+
+/*******************************************************
+ * checkFailed()
+ *******************************************************
+ * say what and where, count it and carry on
+ ******************************************************/
+void checkFailed(const char* what, const std::string& detail, const char* file, int line)
+{
+    std::printf("  %s:%d: CHECK(%s) failed%s%s%s%s\n", file, line, what,
+            detail.empty() ? "" : ", ", detail.c_str(),
+            context.empty() ? "" : ", in ", context.c_str());
+    ++failures;
+}
+
+/*******************************************************
+ * checkContext()
+ *******************************************************
+ * see check.h
+ ******************************************************/
+void checkContext(const std::string& where)
+{
+    context = where;
+}
+
+int main()
+{
+    uint32_t failed = 0;
+
+    for (const test_t& t : tests())
+    {
+        uint32_t before = failures;
+        context.clear();
+        t.fn();
+
+        bool ok = (failures == before);
+        std::printf("%-40s %s\n", t.name, ok ? "ok" : "FAILED");
+        if (!ok)
+        {
+            ++failed;
+        }
+    }
+
+    std::printf("%zu tests, %u failed\n", tests().size(), failed);
+
+    return (failed ? 1 : 0);
+}
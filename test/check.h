@@ -0,0 +1,78 @@
+/********************************************************
+ * check.h
+ ********************************************************
+ * Just enough of a test harness for the host tests.
+ * A test file is TEST()s full of CHECK()s; main() in
+ * check.cpp runs every TEST() in the file, in order,
+ * and fails if any CHECK() did.  A failed CHECK()
+ * says where and carries on
+ *
+ *******************************************************/
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <string>
+#include <sstream>
+#include <type_traits>
+
+#define TEST(name)                                                      \
+    static void name();                                                 \
+    static const testReg name##Reg(#name, name);                        \
+    static void name()
+
+#define CHECK(c)            checkThat((c), #c, __FILE__, __LINE__)
+#define CHECK_EQ(a, b)      checkEq((a), (b), #a " == " #b, __FILE__, __LINE__)
+
+typedef void (*test_fn_t)();
+
+// a TEST() signing itself up, before main()
+struct testReg
+{
+    testReg(const char* name, test_fn_t fn);
+};
+
+void checkFailed(const char* what, const std::string& detail, const char* file, int line);
+
+// said with every failure after it, until the test ends;
+// which of several runs of the same checks it was
+void checkContext(const std::string& where);
+
+inline void checkThat(bool ok, const char* what, const char* file, int line)
+{
+    if (!ok)
+    {
+        checkFailed(what, "", file, line);
+    }
+}
+
+// a value the way a person would want to read it
+template <typename T>
+std::string checkShow(const T& v)
+{
+    std::ostringstream s;
+    if constexpr (std::is_integral<T>::value && sizeof(T) == 1)
+    {
+        s << (int)v;
+    }
+    else if constexpr (std::is_convertible<T, std::string>::value)
+    {
+        s << '"' << std::string(v) << '"';
+    }
+    else
+    {
+        s << v;
+    }
+
+    return (s.str());
+}
+
+template <typename A, typename B>
+void checkEq(const A& a, const B& b, const char* what, const char* file, int line)
+{
+    if (!(a == b))
+    {
+        checkFailed(what, checkShow(a) + " vs " + checkShow(b), file, line);
+    }
+}
+
+#endif // CHECK_H_
@@ -0,0 +1,529 @@
+/********************************************************
+ * flashlog_test.cpp
+ ********************************************************
+ * The log in flash, on the fake flash.  A page is
+ * seq(4) boot(2) len(1) flags(1) crc(4) then the text;
+ * the tests read it straight out of the array so the
+ * format is checked apart from the code that wrote it
+ *
+ *******************************************************/
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "host/fake.h"
+#include "sys/flashlog.h"
+#include "utils/stringFormat.h"
+
+/*******************************************************
+ * rawPage()
+ *******************************************************
+ * where page idx is in the fake flash
+ ******************************************************/
+static uint8_t* rawPage(uint16_t idx)
+{
+    return (fakeFlash + FLASHLOG_OFFSET + (idx * FLASH_PAGE_SIZE));
+}
+
+/*******************************************************
+ * field()
+ *******************************************************
+ * a little endian field out of a raw page
+ ******************************************************/
+static uint32_t field(const uint8_t* p, size_t at, size_t len)
+{
+    uint32_t v = 0;
+    std::memcpy(&v, p + at, len);
+
+    return (v);
+}
+
+/*******************************************************
+ * crc32()
+ *******************************************************
+ * plain CRC-32, the one zip uses
+ ******************************************************/
+static uint32_t crc32(uint32_t crc, const uint8_t* d, size_t len)
+{
+    crc = ~crc;
+    while (len--)
+    {
+        crc ^= *d++;
+        for (uint8_t bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : (crc >> 1);
+        }
+    }
+
+    return (~crc);
+}
+
+/*******************************************************
+ * rawGood()
+ *******************************************************
+ * a raw page that's written all the way, worked out
+ * here rather than by asking the log
+ ******************************************************/
+static bool rawGood(const uint8_t* p)
+{
+    return (field(p, 0, 4) != 0xffffffff && field(p, 6, 1) <= FLASHLOG_TEXT &&
+            field(p, 8, 4) == crc32(crc32(0, p, 8), p + 12, FLASHLOG_TEXT));
+}
+
+/*******************************************************
+ * startLog()
+ *******************************************************
+ * fresh hardware and nvm, then the flash log
+ ******************************************************/
+static flashlog* startLog(const char* why)
+{
+    fakeHardwareReset();
+    nvm::getInstance()->init();
+
+    flashlog* fl = flashlog::getInstance();
+    fl->init(why);
+
+    return (fl);
+}
+
+/*******************************************************
+ * flush()
+ *******************************************************
+ * everything staged out to flash, as core 0's loop
+ * would.  False if it never finished
+ ******************************************************/
+static bool flush(flashlog* fl)
+{
+    fl->requestFlush();
+    for (uint8_t ii = 0; ii < 16 && fl->flushPending(); ++ii)
+    {
+        fl->service();
+    }
+
+    return (!fl->flushPending());
+}
+
+/*******************************************************
+ * allText()
+ *******************************************************
+ * every page's text, oldest first.  The walk starts
+ * after the newest page, so until the log has been
+ * round there are blank pages first; those are left
+ * out
+ ******************************************************/
+static std::vector<std::string> allText(flashlog* fl)
+{
+    std::vector<std::string> ret;
+    std::string text;
+    for (uint16_t n = 0; fl->pageText(n, text); ++n)
+    {
+        if (!text.empty() || !ret.empty())
+        {
+            ret.push_back(text);
+        }
+    }
+
+    return (ret);
+}
+
+/*******************************************************
+ * nth()
+ *******************************************************
+ * one of allText()'s, without running off the end when
+ * there are fewer than there should be
+ ******************************************************/
+static std::string nth(const std::vector<std::string>& t, size_t n)
+{
+    return ((n < t.size()) ? t[n] : "(none)");
+}
+
+/*******************************************************
+ * bootPage
+ *******************************************************
+ * blank flash is boot 1, with a marker page in the
+ * first sector, laid out as documented and with a
+ * CRC-32 anything can check
+ ******************************************************/
+TEST(bootPage)
+{
+    flashlog* fl = startLog("power on");
+    CHECK_EQ(fl->getBoot(), 1);
+
+    flashlog_stats_t s;
+    fl->getStats(s);
+    CHECK_EQ(s.erases, 1u);
+    CHECK_EQ(s.pages, 1u);
+    CHECK_EQ(s.skipped, 0u);
+
+    const std::string marker = "=== boot 1, power on ===\n";
+    const uint8_t* p = rawPage(0);
+    CHECK_EQ(field(p, 0, 4), 0u);
+    CHECK_EQ(field(p, 4, 2), 1u);
+    CHECK_EQ(field(p, 6, 1), (uint32_t)marker.length());
+    CHECK_EQ(field(p, 7, 1), 1u);
+    CHECK(std::memcmp(p + 12, marker.c_str(), marker.length()) == 0);
+    CHECK_EQ(p[12 + marker.length()], 0xff);
+    CHECK_EQ(field(p, 8, 4), crc32(crc32(0, p, 8), p + 12, FLASHLOG_TEXT));
+
+    // and nothing else yet
+    std::vector<std::string> t = allText(fl);
+    CHECK_EQ(t.size(), 1u);
+    CHECK_EQ(nth(t, 0), marker);
+
+    std::string text;
+    CHECK(fl->pageText(0, text));
+    CHECK_EQ(text, "");
+    CHECK(fl->pageText(FLASHLOG_PAGES - 1, text));
+    CHECK_EQ(text, marker);
+    CHECK(!fl->pageText(FLASHLOG_PAGES, text));
+}
+
+/*******************************************************
+ * whenToWrite
+ *******************************************************
+ * a full page goes straight out, a part page waits for
+ * a flush or FLASHLOG_FLUSH_MS, and what doesn't fit in
+ * the RAM ring is dropped and counted
+ ******************************************************/
+TEST(whenToWrite)
+{
+    flashlog* fl = startLog("test");
+
+    std::string line = "0123456789abcdefghijklmnopqrstuvwxyz\n";
+    std::string staged;
+    while (staged.length() < FLASHLOG_TEXT + 20)
+    {
+        fl->stage(line.c_str(), line.length());
+        staged += line;
+    }
+
+    CHECK(fl->service());
+    CHECK(!fl->service());
+    std::vector<std::string> t = allText(fl);
+    CHECK_EQ(t.size(), 2u);
+    CHECK_EQ(nth(t, 1), staged.substr(0, FLASHLOG_TEXT));
+
+    // the rest waits
+    fakeTimeUs = (uint64_t)(FLASHLOG_FLUSH_MS - 1) * 1000;
+    CHECK(!fl->service());
+    fakeTimeUs = (uint64_t)FLASHLOG_FLUSH_MS * 1000;
+    CHECK(fl->service());
+    t = allText(fl);
+    CHECK_EQ(t.size(), 3u);
+    CHECK_EQ(nth(t, 2), staged.substr(FLASHLOG_TEXT));
+
+    // a flush doesn't wait
+    fl->stage("flushed\n", 8);
+    CHECK(!fl->service());
+    CHECK(flush(fl));
+    t = allText(fl);
+    CHECK_EQ(t.size(), 4u);
+    CHECK_EQ(nth(t, 3), "flushed\n");
+
+    // more than the ring holds, with nothing taking it out
+    for (uint32_t ii = 0; ii < FLASHLOG_STAGE_SIZE / line.length() + 1; ++ii)
+    {
+        fl->stage(line.c_str(), line.length());
+    }
+
+    flashlog_stats_t s;
+    fl->getStats(s);
+    CHECK_EQ(s.dropped, (uint32_t)line.length());
+    CHECK_EQ(s.bytes, (uint32_t)(staged.length() + 8));
+    CHECK_EQ(s.pages, 4u);
+    fakeTimeUs = 0;
+}
+
+/*******************************************************
+ * reboot
+ *******************************************************
+ * the next init carries on after the newest page in
+ * the same sector, with the boot counted up
+ ******************************************************/
+TEST(reboot)
+{
+    flashlog* fl = startLog("first");
+    fl->stage("before\n", 7);
+    CHECK(flush(fl));
+
+    fl->init("watchdog");
+    CHECK_EQ(fl->getBoot(), 2);
+
+    flashlog_stats_t s;
+    fl->getStats(s);
+    CHECK_EQ(s.erases, 0u);
+    CHECK_EQ(s.pages, 1u);
+
+    std::vector<std::string> t = allText(fl);
+    CHECK_EQ(t.size(), 3u);
+    CHECK_EQ(nth(t, 0), "=== boot 1, first ===\n");
+    CHECK_EQ(nth(t, 1), "before\n");
+    CHECK_EQ(nth(t, 2), "=== boot 2, watchdog ===\n");
+
+    const uint8_t* p = rawPage(2);
+    CHECK_EQ(field(p, 0, 4), 2u);
+    CHECK_EQ(field(p, 4, 2), 2u);
+}
+
+/*******************************************************
+ * badPages
+ *******************************************************
+ * a page that got mangled reads as empty and doesn't
+ * stop init finding the newest, and a half written
+ * one where the next page would go gets stepped over
+ ******************************************************/
+TEST(badPages)
+{
+    flashlog* fl = startLog("first");
+    fl->stage("one\n", 4);
+    CHECK(flush(fl));
+    fl->stage("two\n", 4);
+    CHECK(flush(fl));
+
+    rawPage(1)[13] ^= 0x01;
+    std::memset(rawPage(3), 0, 8);
+
+    fl->init("again");
+    CHECK_EQ(fl->getBoot(), 2);
+
+    flashlog_stats_t s;
+    fl->getStats(s);
+    CHECK(s.skipped >= 2);
+
+    std::vector<std::string> t = allText(fl);
+    CHECK_EQ(t.size(), 5u);
+    CHECK_EQ(nth(t, 0), "=== boot 1, first ===\n");
+    CHECK_EQ(nth(t, 1), "");
+    CHECK_EQ(nth(t, 2), "two\n");
+    CHECK_EQ(nth(t, 3), "");
+    CHECK_EQ(nth(t, 4), "=== boot 2, again ===\n");
+}
+
+/*******************************************************
+ * busyRetries
+ *******************************************************
+ * with core 1 not pausing, a page or an erase is tried
+ * again on the next call, in the same place, and no
+ * text is lost or written twice
+ ******************************************************/
+TEST(busyRetries)
+{
+    flashlog* fl = startLog("test");
+    nvm::getInstance()->setCore1Ready(true);
+
+    fl->stage("retried\n", 8);
+    fl->requestFlush();
+    fakeLockoutFails = 2;
+    CHECK(fl->service());
+    CHECK(fl->service());
+    CHECK(fl->flushPending());
+    CHECK(flush(fl));
+
+    flashlog_stats_t s;
+    fl->getStats(s);
+    CHECK_EQ(s.busy, 2u);
+    CHECK_EQ(s.pages, 2u);
+    CHECK_EQ(s.skipped, 0u);
+
+    std::vector<std::string> t = allText(fl);
+    CHECK_EQ(t.size(), 2u);
+    CHECK_EQ(nth(t, 1), "retried\n");
+
+    // fill the first sector, then the erase of the
+    // second has to wait too
+    for (uint16_t n = 2; n < FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE; ++n)
+    {
+        fl->stage("x\n", 2);
+        CHECK(flush(fl));
+    }
+    fl->stage("next sector\n", 12);
+    fl->requestFlush();
+    fakeLockoutFails = 1;
+    CHECK(fl->service());
+    CHECK(flush(fl));
+
+    fl->getStats(s);
+    CHECK_EQ(s.busy, 3u);
+    CHECK_EQ(s.erases, 2u);
+
+    t = allText(fl);
+    CHECK_EQ(t.size(), (size_t)(FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE) + 1);
+    CHECK_EQ(nth(t, t.size() - 1), "next sector\n");
+    nvm::getInstance()->setCore1Ready(false);
+}
+
+/*******************************************************
+ * roundAgain
+ *******************************************************
+ * past the end it starts over, a sector at a time, and
+ * the pages still come out oldest first with only the
+ * sector being written into missing
+ ******************************************************/
+TEST(roundAgain)
+{
+    flashlog* fl = startLog("test");
+
+    const uint16_t pages = FLASHLOG_PAGES + 20;
+    for (uint16_t n = 1; n < pages; ++n)
+    {
+        std::string line = FMT("page %d\n", n);
+        fl->stage(line.c_str(), line.length());
+        CHECK(flush(fl));
+    }
+
+    flashlog_stats_t s;
+    fl->getStats(s);
+    CHECK_EQ(s.pages, (uint32_t)pages);
+    CHECK_EQ(s.erases, (uint32_t)((pages + 15) / 16));
+
+    // what's left is in order and ends with the newest
+    std::vector<std::string> t = allText(fl);
+    int last = 0;
+    uint32_t kept = 0;
+    for (size_t ii = 0; ii < t.size(); ++ii)
+    {
+        if (t[ii].empty())
+        {
+            continue;
+        }
+
+        int n = std::atoi(t[ii].c_str() + 5);
+        CHECK(!last || n == last + 1);
+        last = n;
+        ++kept;
+    }
+    CHECK_EQ(last, pages - 1);
+    CHECK_EQ(kept, (uint32_t)(FLASHLOG_PAGES - 16 + (pages % 16)));
+
+    // and a reboot finds the newest, not the highest
+    // numbered page
+    fl->init("wrapped");
+    t = allText(fl);
+    CHECK_EQ(nth(t, t.size() - 1), "=== boot 2, wrapped ===\n");
+    CHECK_EQ(field(rawPage(pages % FLASHLOG_PAGES), 0, 4), (uint32_t)pages);
+}
+
+/*******************************************************
+ * powerCut
+ *******************************************************
+ * the power going partway through every program and
+ * erase of a boot, near enough the end that it goes
+ * round and erases the oldest sector.  Each time, the
+ * next boot has to keep every page that was good when
+ * the power went, skip the half written one, count
+ * itself after the newest boot that made it, and put
+ * its marker last.  Programs are cut at every byte of
+ * the header and every 16 of the text, erases at every
+ * page
+ ******************************************************/
+TEST(powerCut)
+{
+    const size_t logBytes = FLASHLOG_PAGES * FLASH_PAGE_SIZE;
+    const uint16_t perSector = FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE;
+
+    flashlog* fl = startLog("first");
+    for (uint16_t n = 1; n < FLASHLOG_PAGES - 4; ++n)
+    {
+        std::string line = FMT("old %d\n", n);
+        fl->stage(line.c_str(), line.length());
+        CHECK(flush(fl));
+    }
+    const std::vector<uint8_t> base(rawPage(0), rawPage(0) + logBytes);
+
+    uint32_t cuts = 0;
+    int32_t cut = 0;
+    while (true)
+    {
+        std::memcpy(rawPage(0), base.data(), logBytes);
+        fakeFlashCut = cut;
+        fakeFlashCutOp = 0;
+
+        // flushes after the power's gone don't finish
+        fl->init("second");
+        for (uint16_t n = 0; n < 6; ++n)
+        {
+            std::string line = FMT("new %d\n", n);
+            fl->stage(line.c_str(), line.length());
+            flush(fl);
+        }
+
+        const char op = fakeFlashCutOp;
+        if (!op)
+        {
+            break;
+        }
+        const uint32_t stopped = fakeFlashCutOffset;
+        checkContext(FMT("cut at %d, in the %s, at 0x%x", cut, (op == 'e') ? "erase" : "program", stopped));
+
+        // what was there when the power went, and the
+        // newest boot that got its pages written
+        const std::vector<uint8_t> was(rawPage(0), rawPage(0) + logBytes);
+        uint32_t newest = 0;
+        uint16_t newestBoot = 0;
+        for (uint16_t ii = 0; ii < FLASHLOG_PAGES; ++ii)
+        {
+            const uint8_t* p = &was[ii * FLASH_PAGE_SIZE];
+            if (rawGood(p) && (!newestBoot || (int32_t)(field(p, 0, 4) - newest) > 0))
+            {
+                newest = field(p, 0, 4);
+                newestBoot = (uint16_t)field(p, 4, 2);
+            }
+        }
+
+        fakeFlashCut = -1;
+        fakeFlashCutOp = 0;
+        fl->init("after the cut");
+        CHECK_EQ(fl->getBoot(), newestBoot + 1);
+
+        std::vector<std::string> t = allText(fl);
+        CHECK_EQ(nth(t, t.size() - 1), FMT("=== boot %d, after the cut ===\n", newestBoot + 1).c_str());
+
+        // where the marker went; if that took an erase,
+        // the oldest sector going with it is expected
+        flashlog_stats_t s;
+        fl->getStats(s);
+        uint16_t marker = FLASHLOG_PAGES;
+        for (uint16_t ii = 0; ii < FLASHLOG_PAGES; ++ii)
+        {
+            if (rawGood(rawPage(ii)) && field(rawPage(ii), 0, 4) == newest + 1)
+            {
+                marker = ii;
+            }
+        }
+        CHECK(marker < FLASHLOG_PAGES);
+
+        for (uint16_t ii = 0; ii < FLASHLOG_PAGES; ++ii)
+        {
+            if (ii == marker || (s.erases && ii / perSector == marker / perSector))
+            {
+                continue;
+            }
+
+            // good pages kept, and nothing else written
+            // over either, the half written one included
+            CHECK(std::memcmp(rawPage(ii), &was[ii * FLASH_PAGE_SIZE], FLASH_PAGE_SIZE) == 0);
+        }
+
+        // the marker only goes on the half written page
+        // once it's been erased
+        const uint32_t at = stopped % FLASH_PAGE_SIZE;
+        if (op == 'p')
+        {
+            uint16_t half = (uint16_t)((stopped - FLASHLOG_OFFSET) / FLASH_PAGE_SIZE);
+            const uint8_t* p = &was[half * FLASH_PAGE_SIZE];
+            bool blank = std::count(p, p + FLASH_PAGE_SIZE, 0xff) == FLASH_PAGE_SIZE;
+            bool erasedFirst = s.erases && half / perSector == marker / perSector;
+            CHECK(rawGood(p) || blank || erasedFirst || half != marker);
+        }
+
+        cut += (op == 'e') ? FLASH_PAGE_SIZE : (at < 12) ? 1 : std::min(16u, FLASH_PAGE_SIZE - at);
+        ++cuts;
+    }
+    checkContext("");
+
+    // the boot marker, 6 pages and an erase
+    CHECK_EQ(cuts, (uint32_t)((7 * (12 + (FLASH_PAGE_SIZE - 12 + 15) / 16)) + perSector));
+}
@@ -0,0 +1,70 @@
+/********************************************************
+ * fake.h
+ ********************************************************
+ * The knobs on the pretend hardware in host.cpp.  Time
+ * only moves when a test moves it or something waits
+ * for a timeout, each thread is a core, and flash is a
+ * 2M array that starts out erased
+ *
+ *******************************************************/
+#ifndef HOST_FAKE_H_
+#define HOST_FAKE_H_
+
+#include "pico/stdlib.h"
+#include "pico/util/datetime.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+
+#define FAKE_FLASH_SIZE     (2 * 1024 * 1024)
+
+// what time_us_64() says
+extern volatile uint64_t fakeTimeUs;
+
+// what get_core_num() says, per thread
+extern thread_local uint fakeCore;
+
+// the other core getting in between two instructions:
+// after fakeBarrierSkip more __dmb()s, the next one on
+// this thread calls fakeBarrierHook, once
+extern thread_local void (*fakeBarrierHook)();
+extern thread_local uint32_t fakeBarrierSkip;
+
+// how many lockout starts time out before one works
+extern uint32_t fakeLockoutFails;
+
+// flash; counts every erase and program
+extern uint32_t fakeErases;
+extern uint32_t fakePrograms;
+void fakeFlashReset();
+
+// the power going in the middle of a write: after
+// fakeFlashCut more bytes erased or programmed, in
+// order, flash stops changing.  -1 never.  Once it's
+// gone, fakeFlashCutOp is 'e' or 'p' for the erase or
+// program it went in, and fakeFlashCutOffset is where
+// in flash it stopped
+extern int32_t fakeFlashCut;
+extern char fakeFlashCutOp;
+extern uint32_t fakeFlashCutOffset;
+
+// what rtc_get_datetime() gives, false if it isn't set
+extern bool fakeRtcSet;
+extern datetime_t fakeRtc;
+
+// a DMA channel as it was last configured
+struct fake_dma_t
+{
+    bool claimed;
+    dma_channel_config config;
+    volatile void* write;
+    const volatile void* read;
+    uint count;
+};
+
+extern fake_dma_t fakeDma[NUM_DMA_CHANNELS];
+extern uint32_t fakeDmaStarted;     // channel mask, from dma_start_channel_mask()
+
+// as it was when the program started
+void fakeHardwareReset();
+
+#endif // HOST_FAKE_H_
@@ -0,0 +1,19 @@
+/********************************************************
+ * hardware/clocks.h
+ ********************************************************
+ * Host stand-in, sys clock at 125MHz
+ *
+ *******************************************************/
+#ifndef HOST_HARDWARE_CLOCKS_H_
+#define HOST_HARDWARE_CLOCKS_H_
+
+#include "pico/stdlib.h"
+
+enum clock_index
+{
+    clk_sys = 5
+};
+
+uint32_t clock_get_hz(enum clock_index clk);
+
+#endif // HOST_HARDWARE_CLOCKS_H_
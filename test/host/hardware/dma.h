@@ -0,0 +1,76 @@
+/********************************************************
+ * hardware/dma.h
+ ********************************************************
+ * Host stand-in.  Nothing moves on its own; configuring
+ * a channel fills in its registers and fakeDma[] so a
+ * test can check the chain and play the scan itself.
+ * The registers are 32 bits like the real ones, which
+ * is why the tests are built without PIE
+ *
+ *******************************************************/
+#ifndef HOST_HARDWARE_DMA_H_
+#define HOST_HARDWARE_DMA_H_
+
+#include "pico/stdlib.h"
+
+#define NUM_DMA_CHANNELS    12
+
+enum dma_channel_transfer_size
+{
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2
+};
+
+// the SDK packs these into the CTRL register
+struct dma_channel_config
+{
+    uint8_t size;               // dma_channel_transfer_size
+    bool readIncr;
+    bool writeIncr;
+    uint dreq;
+    uint chainTo;               // itself for none
+};
+
+struct dma_channel_hw_t
+{
+    volatile uint32_t read_addr;
+    volatile uint32_t write_addr;
+    volatile uint32_t transfer_count;
+    volatile uint32_t ctrl_trig;
+    volatile uint32_t al1_ctrl;
+    volatile uint32_t al1_read_addr;
+    volatile uint32_t al1_write_addr;
+    volatile uint32_t al1_transfer_count_trig;
+    volatile uint32_t al2_ctrl;
+    volatile uint32_t al2_transfer_count;
+    volatile uint32_t al2_read_addr;
+    volatile uint32_t al2_write_addr_trig;
+    volatile uint32_t al3_ctrl;
+    volatile uint32_t al3_write_addr;
+    volatile uint32_t al3_transfer_count;
+    volatile uint32_t al3_read_addr_trig;
+};
+
+struct dma_hw_t
+{
+    dma_channel_hw_t ch[NUM_DMA_CHANNELS];
+};
+
+extern dma_hw_t* dma_hw;
+
+int dma_claim_unused_channel(bool required);
+dma_channel_config dma_channel_get_default_config(uint channel);
+void channel_config_set_transfer_data_size(dma_channel_config* c, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config* c, bool incr);
+void channel_config_set_write_increment(dma_channel_config* c, bool incr);
+void channel_config_set_dreq(dma_channel_config* c, uint dreq);
+void channel_config_set_chain_to(dma_channel_config* c, uint chainTo);
+void dma_channel_configure(uint channel, const dma_channel_config* config, volatile void* write,
+                           const volatile void* read, uint count, bool trigger);
+void dma_channel_set_irq0_enabled(uint channel, bool enabled);
+bool dma_channel_get_irq0_status(uint channel);
+void dma_channel_acknowledge_irq0(uint channel);
+void dma_start_channel_mask(uint32_t mask);
+
+#endif // HOST_HARDWARE_DMA_H_
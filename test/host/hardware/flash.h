@@ -0,0 +1,19 @@
+/********************************************************
+ * hardware/flash.h
+ ********************************************************
+ * Host stand-in.  Erasing sets fakeFlash to all 1's,
+ * programming can only clear bits, like NOR flash
+ *
+ *******************************************************/
+#ifndef HOST_HARDWARE_FLASH_H_
+#define HOST_HARDWARE_FLASH_H_
+
+#include "pico/stdlib.h"
+
+#define FLASH_PAGE_SIZE     (1u << 8)
+#define FLASH_SECTOR_SIZE   (1u << 12)
+
+void flash_range_erase(uint32_t offset, size_t count);
+void flash_range_program(uint32_t offset, const uint8_t* data, size_t count);
+
+#endif // HOST_HARDWARE_FLASH_H_
@@ -0,0 +1,20 @@
+/********************************************************
+ * hardware/irq.h
+ ********************************************************
+ * Host stand-in; handlers are never called
+ *
+ *******************************************************/
+#ifndef HOST_HARDWARE_IRQ_H_
+#define HOST_HARDWARE_IRQ_H_
+
+#include "pico/stdlib.h"
+
+#define DMA_IRQ_0           11
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY  0x80
+
+typedef void (*irq_handler_t)(void);
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t priority);
+void irq_set_enabled(uint num, bool enabled);
+
+#endif // HOST_HARDWARE_IRQ_H_
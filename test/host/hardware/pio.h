@@ -0,0 +1,57 @@
+/********************************************************
+ * hardware/pio.h
+ ********************************************************
+ * Host stand-in.  State machines are handed out in
+ * order and never run; the TX FIFOs are just where the
+ * DMA says it's writing
+ *
+ *******************************************************/
+#ifndef HOST_HARDWARE_PIO_H_
+#define HOST_HARDWARE_PIO_H_
+
+#include "pico/stdlib.h"
+
+struct pio_hw_t
+{
+    volatile uint32_t txf[4];
+    uint8_t claimed;            // state machines, a bit each
+};
+
+typedef pio_hw_t* PIO;
+
+extern PIO pio0;
+extern PIO pio1;
+
+struct pio_program_t
+{
+    const uint16_t* instructions;
+    uint8_t length;
+    int8_t origin;
+};
+
+struct pio_sm_config
+{
+    uint outBase;
+    uint outCount;
+    uint sidesetBase;
+    uint16_t clkdivInt;
+};
+
+#define PIO_FIFO_JOIN_TX    1
+
+uint pio_add_program(PIO pio, const pio_program_t* program);
+int pio_claim_unused_sm(PIO pio, bool required);
+uint pio_get_dreq(PIO pio, uint sm, bool tx);
+void pio_gpio_init(PIO pio, uint pin);
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint base, uint count, bool out);
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t values, uint32_t mask);
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t dirs, uint32_t mask);
+void sm_config_set_out_pins(pio_sm_config* c, uint base, uint count);
+void sm_config_set_sideset_pins(pio_sm_config* c, uint base);
+void sm_config_set_out_shift(pio_sm_config* c, bool right, bool autopull, uint threshold);
+void sm_config_set_fifo_join(pio_sm_config* c, int join);
+void sm_config_set_clkdiv_int_frac(pio_sm_config* c, uint16_t div, uint8_t frac);
+void pio_sm_init(PIO pio, uint sm, uint offset, const pio_sm_config* c);
+void pio_enable_sm_mask_in_sync(PIO pio, uint32_t mask);
+
+#endif // HOST_HARDWARE_PIO_H_
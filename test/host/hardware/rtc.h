@@ -0,0 +1,15 @@
+/********************************************************
+ * hardware/rtc.h
+ ********************************************************
+ * Host stand-in, reads fakeRtc
+ *
+ *******************************************************/
+#ifndef HOST_HARDWARE_RTC_H_
+#define HOST_HARDWARE_RTC_H_
+
+#include "pico/stdlib.h"
+#include "pico/util/datetime.h"
+
+bool rtc_get_datetime(datetime_t* t);
+
+#endif // HOST_HARDWARE_RTC_H_
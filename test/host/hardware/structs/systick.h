@@ -0,0 +1,23 @@
+/********************************************************
+ * hardware/structs/systick.h
+ ********************************************************
+ * Host stand-in; it never counts
+ *
+ *******************************************************/
+#ifndef HOST_HARDWARE_SYSTICK_H_
+#define HOST_HARDWARE_SYSTICK_H_
+
+#include <cstdint>
+
+struct systick_hw_t
+{
+    volatile uint32_t csr;
+    volatile uint32_t rvr;
+    volatile uint32_t cvr;
+    volatile uint32_t calib;
+};
+
+extern systick_hw_t fakeSystick;
+#define systick_hw          (&fakeSystick)
+
+#endif // HOST_HARDWARE_SYSTICK_H_
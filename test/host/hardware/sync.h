@@ -0,0 +1,21 @@
+/********************************************************
+ * hardware/sync.h
+ ********************************************************
+ * Host stand-in.  Spinlocks are real ones, so the
+ * cores can be threads
+ *
+ *******************************************************/
+#ifndef HOST_HARDWARE_SYNC_H_
+#define HOST_HARDWARE_SYNC_H_
+
+#include "pico/stdlib.h"
+
+typedef volatile uint32_t spin_lock_t;
+
+int spin_lock_claim_unused(bool required);
+spin_lock_t* spin_lock_instance(uint num);
+uint32_t spin_lock_blocking(spin_lock_t* lock);
+void spin_unlock(spin_lock_t* lock, uint32_t saved);
+bool is_spin_locked(spin_lock_t* lock);
+
+#endif // HOST_HARDWARE_SYNC_H_
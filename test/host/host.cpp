@@ -0,0 +1,379 @@
+/********************************************************
+ * host.cpp
+ ********************************************************
+ * The pretend hardware behind the stand-in SDK headers
+ * in this directory.  See fake.h for the knobs
+ *
+ *******************************************************/
+#include <cstring>
+
+#include "fake.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#include "hardware/flash.h"
+#include "hardware/rtc.h"
+#include "hardware/clocks.h"
+#include "hardware/irq.h"
+#include "hardware/structs/systick.h"
+#include "hub75.pio.h"
+#include "tusb.h"
+
+#include "../../pilznet/pilznet.h"
+#include "../../sys/walltime.h"
+
+#define SPIN_LOCKS          32
+
+volatile uint64_t fakeTimeUs = 0;
+thread_local uint fakeCore = 0;
+thread_local void (*fakeBarrierHook)() = NULL;
+thread_local uint32_t fakeBarrierSkip = 0;
+uint32_t fakeLockoutFails = 0;
+
+uint8_t fakeFlash[FAKE_FLASH_SIZE];
+uint32_t fakeErases = 0;
+uint32_t fakePrograms = 0;
+int32_t fakeFlashCut = -1;
+char fakeFlashCutOp = 0;
+uint32_t fakeFlashCutOffset = 0;
+
+bool fakeRtcSet = false;
+datetime_t fakeRtc;
+
+fake_dma_t fakeDma[NUM_DMA_CHANNELS];
+uint32_t fakeDmaStarted = 0;
+
+systick_hw_t fakeSystick;
+
+static spin_lock_t spinLocks[SPIN_LOCKS];
+static uint32_t spinClaimed = 0;
+
+static dma_hw_t dmaRegs;
+dma_hw_t* dma_hw = &dmaRegs;
+
+static pio_hw_t pioRegs[2];
+PIO pio0 = &pioRegs[0];
+PIO pio1 = &pioRegs[1];
+
+static const uint16_t noInstructions[1] = { 0 };
+const pio_program_t hub75_data_program = { noInstructions, 1, -1 };
+const pio_program_t hub75_row_program = { noInstructions, 1, -1 };
+
+/*******************************************************
+ * fakeFlashReset()
+ *******************************************************
+ * all erased, nothing counted
+ ******************************************************/
+void fakeFlashReset()
+{
+    std::memset(fakeFlash, 0xff, sizeof(fakeFlash));
+    fakeErases = 0;
+    fakePrograms = 0;
+    fakeFlashCut = -1;
+    fakeFlashCutOp = 0;
+    fakeFlashCutOffset = 0;
+}
+
+/*******************************************************
+ * fakeHardwareReset()
+ *******************************************************
+ * back to power on, more or less
+ ******************************************************/
+void fakeHardwareReset()
+{
+    fakeTimeUs = 0;
+    fakeCore = 0;
+    fakeBarrierHook = NULL;
+    fakeBarrierSkip = 0;
+    fakeLockoutFails = 0;
+    fakeRtcSet = false;
+    std::memset(&fakeRtc, 0, sizeof(fakeRtc));
+    std::memset(fakeDma, 0, sizeof(fakeDma));
+    std::memset(&dmaRegs, 0, sizeof(dmaRegs));
+    fakeDmaStarted = 0;
+    std::memset(pioRegs, 0, sizeof(pioRegs));
+    std::memset((void*)spinLocks, 0, sizeof(spinLocks));
+    spinClaimed = 0;
+    fakeFlashReset();
+}
+
+// time
+absolute_time_t get_absolute_time()                     { return (fakeTimeUs); }
+absolute_time_t make_timeout_time_ms(uint32_t ms)       { return (fakeTimeUs + ((uint64_t)ms * 1000)); }
+uint32_t to_ms_since_boot(absolute_time_t t)            { return ((uint32_t)(t / 1000)); }
+uint64_t to_us_since_boot(absolute_time_t t)            { return (t); }
+bool time_reached(absolute_time_t t)                    { return (fakeTimeUs >= t); }
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) { return ((int64_t)(to - from)); }
+uint64_t time_us_64()                                   { return (fakeTimeUs); }
+uint32_t time_us_32()                                   { return ((uint32_t)fakeTimeUs); }
+
+// nothing else is going to send an event, so a wait
+// lasts until its timeout
+bool best_effort_wfe_or_timeout(absolute_time_t t)
+{
+    if (fakeTimeUs < t)
+    {
+        fakeTimeUs = t;
+    }
+
+    return (true);
+}
+
+// cores
+uint get_core_num()                                     { return (fakeCore); }
+void __sev()                                            {}
+void __wfe()                                            {}
+
+void __dmb()
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (fakeBarrierHook && !fakeBarrierSkip--)
+    {
+        void (*hook)() = fakeBarrierHook;
+        fakeBarrierHook = NULL;
+        hook();
+    }
+}
+
+bool multicore_lockout_start_timeout_us(uint64_t us)
+{
+    if (fakeLockoutFails)
+    {
+        --fakeLockoutFails;
+        return (false);
+    }
+
+    return (true);
+}
+
+bool multicore_lockout_end_timeout_us(uint64_t us)      { return (true); }
+
+void critical_section_init(critical_section_t* c)       { c->lock = 0; }
+
+void critical_section_enter_blocking(critical_section_t* c)
+{
+    while (__atomic_exchange_n(&c->lock, 1, __ATOMIC_ACQUIRE))
+    {
+    }
+}
+
+void critical_section_exit(critical_section_t* c)       { __atomic_store_n(&c->lock, 0, __ATOMIC_RELEASE); }
+
+// spinlocks
+int spin_lock_claim_unused(bool required)
+{
+    for (int ii = 0; ii < SPIN_LOCKS; ++ii)
+    {
+        if (!(spinClaimed & (1u << ii)))
+        {
+            spinClaimed |= (1u << ii);
+            return (ii);
+        }
+    }
+
+    return (-1);
+}
+
+spin_lock_t* spin_lock_instance(uint num)               { return ((num < SPIN_LOCKS) ? &spinLocks[num] : NULL); }
+bool is_spin_locked(spin_lock_t* lock)                  { return (__atomic_load_n(lock, __ATOMIC_RELAXED) != 0); }
+
+uint32_t spin_lock_blocking(spin_lock_t* lock)
+{
+    while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE))
+    {
+    }
+
+    return (0);
+}
+
+void spin_unlock(spin_lock_t* lock, uint32_t saved)     { __atomic_store_n(lock, 0, __ATOMIC_RELEASE); }
+
+/*******************************************************
+ * powerLeft()
+ *******************************************************
+ * how much of an erase or program gets done before
+ * fakeFlashCut runs out; none once it has
+ ******************************************************/
+static size_t powerLeft(char op, uint32_t offset, size_t count)
+{
+    if (fakeFlashCutOp)
+    {
+        return (0);
+    }
+
+    if (fakeFlashCut < 0 || (size_t)fakeFlashCut >= count)
+    {
+        if (fakeFlashCut >= 0)
+        {
+            fakeFlashCut -= (int32_t)count;
+        }
+        return (count);
+    }
+
+    size_t done = (size_t)fakeFlashCut;
+    fakeFlashCut = 0;
+    fakeFlashCutOp = op;
+    fakeFlashCutOffset = offset + (uint32_t)done;
+
+    return (done);
+}
+
+// flash, at an offset from the start of it like the SDK
+void flash_range_erase(uint32_t offset, size_t count)
+{
+    if (offset % FLASH_SECTOR_SIZE || count % FLASH_SECTOR_SIZE || offset + count > FAKE_FLASH_SIZE)
+    {
+        std::fprintf(stderr, "flash_range_erase(0x%08x, %zu) isn't whole sectors in flash\n", offset, count);
+        std::abort();
+    }
+
+    std::memset(&fakeFlash[offset], 0xff, powerLeft('e', offset, count));
+    ++fakeErases;
+}
+
+void flash_range_program(uint32_t offset, const uint8_t* data, size_t count)
+{
+    if (offset % FLASH_PAGE_SIZE || count % FLASH_PAGE_SIZE || offset + count > FAKE_FLASH_SIZE)
+    {
+        std::fprintf(stderr, "flash_range_program(0x%08x, %zu) isn't whole pages in flash\n", offset, count);
+        std::abort();
+    }
+
+    size_t done = powerLeft('p', offset, count);
+    for (size_t ii = 0; ii < done; ++ii)
+    {
+        fakeFlash[offset + ii] &= data[ii];
+    }
+    ++fakePrograms;
+}
+
+// RTC
+bool rtc_get_datetime(datetime_t* t)
+{
+    if (fakeRtcSet)
+    {
+        *t = fakeRtc;
+    }
+
+    return (fakeRtcSet);
+}
+
+// clocks and interrupts
+uint32_t clock_get_hz(enum clock_index clk)             { return (125000000); }
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t priority) {}
+void irq_set_enabled(uint num, bool enabled)            {}
+
+// DMA
+int dma_claim_unused_channel(bool required)
+{
+    for (int ii = 0; ii < NUM_DMA_CHANNELS; ++ii)
+    {
+        if (!fakeDma[ii].claimed)
+        {
+            fakeDma[ii].claimed = true;
+            return (ii);
+        }
+    }
+
+    return (-1);
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel)
+{
+    dma_channel_config c;
+    c.size = DMA_SIZE_32;
+    c.readIncr = true;
+    c.writeIncr = false;
+    c.dreq = 0x3f;
+    c.chainTo = channel;
+
+    return (c);
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config* c, enum dma_channel_transfer_size size) { c->size = size; }
+void channel_config_set_read_increment(dma_channel_config* c, bool incr)    { c->readIncr = incr; }
+void channel_config_set_write_increment(dma_channel_config* c, bool incr)   { c->writeIncr = incr; }
+void channel_config_set_dreq(dma_channel_config* c, uint dreq)              { c->dreq = dreq; }
+void channel_config_set_chain_to(dma_channel_config* c, uint chainTo)       { c->chainTo = chainTo; }
+
+void dma_channel_configure(uint channel, const dma_channel_config* config, volatile void* write,
+                           const volatile void* read, uint count, bool trigger)
+{
+    fake_dma_t& d = fakeDma[channel];
+    d.config = *config;
+    d.write = write;
+    d.read = read;
+    d.count = count;
+
+    dma_hw->ch[channel].read_addr = (uint32_t)(uintptr_t)read;
+    dma_hw->ch[channel].write_addr = (uint32_t)(uintptr_t)write;
+    dma_hw->ch[channel].transfer_count = count;
+
+    if (trigger)
+    {
+        fakeDmaStarted |= (1u << channel);
+    }
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled)   {}
+bool dma_channel_get_irq0_status(uint channel)          { return (false); }
+void dma_channel_acknowledge_irq0(uint channel)         {}
+void dma_start_channel_mask(uint32_t mask)              { fakeDmaStarted |= mask; }
+
+// PIO
+uint pio_add_program(PIO pio, const pio_program_t* program) { return (0); }
+
+int pio_claim_unused_sm(PIO pio, bool required)
+{
+    for (int ii = 0; ii < 4; ++ii)
+    {
+        if (!(pio->claimed & (1 << ii)))
+        {
+            pio->claimed |= (1 << ii);
+            return (ii);
+        }
+    }
+
+    return (-1);
+}
+
+uint pio_get_dreq(PIO pio, uint sm, bool tx)            { return (((pio == pio1) ? 8 : 0) + (tx ? 0 : 4) + sm); }
+void pio_gpio_init(PIO pio, uint pin)                   {}
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint base, uint count, bool out) {}
+void pio_sm_set_pins_with_mask(PIO pio, uint sm, uint32_t values, uint32_t mask) {}
+void pio_sm_set_pindirs_with_mask(PIO pio, uint sm, uint32_t dirs, uint32_t mask) {}
+void sm_config_set_out_pins(pio_sm_config* c, uint base, uint count)    { c->outBase = base; c->outCount = count; }
+void sm_config_set_sideset_pins(pio_sm_config* c, uint base)            { c->sidesetBase = base; }
+void sm_config_set_out_shift(pio_sm_config* c, bool right, bool autopull, uint threshold) {}
+void sm_config_set_fifo_join(pio_sm_config* c, int join) {}
+void sm_config_set_clkdiv_int_frac(pio_sm_config* c, uint16_t div, uint8_t frac) { c->clkdivInt = div; }
+void pio_sm_init(PIO pio, uint sm, uint offset, const pio_sm_config* c) {}
+void pio_enable_sm_mask_in_sync(PIO pio, uint32_t mask) {}
+
+pio_sm_config hub75_data_program_get_default_config(uint offset)    { pio_sm_config c; std::memset(&c, 0, sizeof(c)); return (c); }
+pio_sm_config hub75_row_program_get_default_config(uint offset)     { pio_sm_config c; std::memset(&c, 0, sizeof(c)); return (c); }
+
+// USB
+bool tud_cdc_connected()                                { return (false); }
+uint32_t tud_cdc_write_available()                      { return (0); }
+
+// the bits of the net and the clock the shared code
+// calls into
+const std::string pilznet::ip2text(const ipv4_addr_t& a)
+{
+    char text[16];
+    std::snprintf(text, sizeof(text), "%d.%d.%d.%d", a.b[0], a.b[1], a.b[2], a.b[3]);
+    return (text);
+}
+
+const std::string pilznet::mac2text(const mac_addr_t& m)
+{
+    char text[18];
+    std::snprintf(text, sizeof(text), "%02x:%02x:%02x:%02x:%02x:%02x", m.b[5], m.b[4], m.b[3], m.b[2], m.b[1], m.b[0]);
+    return (text);
+}
+
+std::string walltime::logTimeString()
+{
+    return ("");
+}
@@ -0,0 +1,18 @@
+/********************************************************
+ * hub75.pio.h
+ ********************************************************
+ * Host stand-in for what pioasm makes of ../../hub75.pio
+ *
+ *******************************************************/
+#ifndef HOST_HUB75_PIO_H_
+#define HOST_HUB75_PIO_H_
+
+#include "hardware/pio.h"
+
+extern const pio_program_t hub75_data_program;
+extern const pio_program_t hub75_row_program;
+
+pio_sm_config hub75_data_program_get_default_config(uint offset);
+pio_sm_config hub75_row_program_get_default_config(uint offset);
+
+#endif // HOST_HUB75_PIO_H_
@@ -0,0 +1,18 @@
+/********************************************************
+ * pico/multicore.h
+ ********************************************************
+ * Host stand-in.  The lockout starts fail while
+ * fakeLockoutFails says so
+ *
+ *******************************************************/
+#ifndef HOST_PICO_MULTICORE_H_
+#define HOST_PICO_MULTICORE_H_
+
+#include "pico/stdlib.h"
+#include "pico/mutex.h"
+#include "hardware/sync.h"
+
+bool multicore_lockout_start_timeout_us(uint64_t us);
+bool multicore_lockout_end_timeout_us(uint64_t us);
+
+#endif // HOST_PICO_MULTICORE_H_
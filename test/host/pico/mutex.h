@@ -0,0 +1,21 @@
+/********************************************************
+ * pico/mutex.h
+ ********************************************************
+ * Host stand-in, critical sections only
+ *
+ *******************************************************/
+#ifndef HOST_PICO_MUTEX_H_
+#define HOST_PICO_MUTEX_H_
+
+#include "pico/stdlib.h"
+
+struct critical_section_t
+{
+    volatile uint32_t lock;
+};
+
+void critical_section_init(critical_section_t* c);
+void critical_section_enter_blocking(critical_section_t* c);
+void critical_section_exit(critical_section_t* c);
+
+#endif // HOST_PICO_MUTEX_H_
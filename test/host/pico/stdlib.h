@@ -0,0 +1,44 @@
+/********************************************************
+ * pico/stdlib.h
+ ********************************************************
+ * Host stand-in for the Pico SDK, for the tests in
+ * ../  Only what the tree uses, and only as much of it
+ * as the tests need; the knobs that drive it are in
+ * fake.h
+ *
+ *******************************************************/
+#ifndef HOST_PICO_STDLIB_H_
+#define HOST_PICO_STDLIB_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+// time, from fakeTimeUs
+absolute_time_t get_absolute_time();
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+uint32_t to_ms_since_boot(absolute_time_t t);
+uint64_t to_us_since_boot(absolute_time_t t);
+bool time_reached(absolute_time_t t);
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+uint64_t time_us_64();
+uint32_t time_us_32();
+bool best_effort_wfe_or_timeout(absolute_time_t t);
+
+// flash is read through XIP, which here is fakeFlash
+extern uint8_t fakeFlash[];
+#define XIP_BASE            ((uintptr_t)fakeFlash)
+
+uint get_core_num();
+
+// the barrier is a real one; the tests run the cores
+// as threads
+void __dmb();
+void __sev();
+void __wfe();
+
+#endif // HOST_PICO_STDLIB_H_
@@ -0,0 +1,23 @@
+/********************************************************
+ * pico/util/datetime.h
+ ********************************************************
+ * Host stand-in
+ *
+ *******************************************************/
+#ifndef HOST_PICO_DATETIME_H_
+#define HOST_PICO_DATETIME_H_
+
+#include "pico/stdlib.h"
+
+struct datetime_t
+{
+    int16_t year;
+    int8_t month;
+    int8_t day;
+    int8_t dotw;
+    int8_t hour;
+    int8_t min;
+    int8_t sec;
+};
+
+#endif // HOST_PICO_DATETIME_H_
@@ -0,0 +1,15 @@
+/********************************************************
+ * tusb.h
+ ********************************************************
+ * Host stand-in; the USB host is never there
+ *
+ *******************************************************/
+#ifndef HOST_TUSB_H_
+#define HOST_TUSB_H_
+
+#include <cstdint>
+
+bool tud_cdc_connected();
+uint32_t tud_cdc_write_available();
+
+#endif // HOST_TUSB_H_
@@ -0,0 +1,174 @@
+/********************************************************
+ * hub75_bench.cpp
+ ********************************************************
+ * What a frame costs the CPU, with the framebuffer in
+ * 16 bit pixels as it was, against the canvas kept
+ * packed in scan order.
+ *
+ * The old layouts are copied here from before the
+ * change: the scan bit-banged a row pair at a time,
+ * unpacking two pixels and doing six gpio_put()s per
+ * column on every refresh, and later, split into bit
+ * planes, every pixel unpacked again on each publish.
+ * gpio_put() is the store to SIO it is on the board,
+ * and the sleep_us() between clock edges is left out.
+ * With the packed canvas the DMA does the scan, so a
+ * refresh costs nothing, and a publish is a copy of
+ * the row pairs that changed
+ *
+ *******************************************************/
+#include <cstdio>
+#include <cstring>
+
+#include "check.h"
+#include "bench.h"
+#include "host/fake.h"
+#include "../hub75.h"
+
+#define CALLS               2000
+
+// the panel's DMA registers are 32 bits, so it's static
+static panel_t panel;
+
+static pixel_buff_t oldBuffer[panel_t::LED_ROWS][panel_t::LED_COLS];
+static uint8_t oldPlanes[panel_t::SCAN_ROWS][COLOR_DEPTH][panel_t::LED_COLS];
+
+// SIO's set and clear registers
+static volatile uint32_t gpioSet;
+static volatile uint32_t gpioClr;
+
+static inline void oldGpioPut(uint pin, bool value)
+{
+    if (value)  gpioSet = (1u << pin);
+    else        gpioClr = (1u << pin);
+}
+
+/*******************************************************
+ * oldScan()
+ *******************************************************
+ * one frame of the bit-banged scan: every row pair's
+ * columns shifted out, then address, blank and latch
+ ******************************************************/
+static void oldScan()
+{
+    for (uint16_t row = 0; row < panel_t::SCAN_ROWS; ++row)
+    {
+        for (uint16_t col = 0; col < panel_t::LED_COLS; ++col)
+        {
+            pixel pxl;
+            oldGpioPut(LED_CLK, false);
+
+            pxl.pixelFromBuff(oldBuffer[row][col]);
+            oldGpioPut(LED_R0, pxl.getRed());
+            oldGpioPut(LED_G0, pxl.getGrn());
+            oldGpioPut(LED_B0, pxl.getBlu());
+
+            pxl.pixelFromBuff(oldBuffer[row + panel_t::SCAN_ROWS][col]);
+            oldGpioPut(LED_R1, pxl.getRed());
+            oldGpioPut(LED_G1, pxl.getGrn());
+            oldGpioPut(LED_B1, pxl.getBlu());
+
+            oldGpioPut(LED_CLK, true);
+        }
+
+        oldGpioPut(LED_CLK, false);
+        oldGpioPut(LED_A0, row & 0x01);
+        oldGpioPut(LED_A1, row & 0x02);
+        oldGpioPut(LED_A2, row & 0x04);
+        oldGpioPut(LED_OE, true);
+        oldGpioPut(LED_LATCH, true);
+        oldGpioPut(LED_LATCH, false);
+        oldGpioPut(LED_OE, false);
+    }
+}
+
+/*******************************************************
+ * oldPack()
+ *******************************************************
+ * one publish with the pixels kept 16 bits wide: every
+ * one unpacked and split into COLOR_DEPTH planes
+ ******************************************************/
+static void oldPack()
+{
+    for (uint16_t row = 0; row < panel_t::SCAN_ROWS; ++row)
+    {
+        for (uint16_t col = 0; col < panel_t::LED_COLS; ++col)
+        {
+            pixel upper;
+            pixel lower;
+
+            upper.pixelFromBuff(oldBuffer[row][col]);
+            lower.pixelFromBuff(oldBuffer[row + panel_t::SCAN_ROWS][col]);
+
+            for (uint8_t plane = 0; plane < COLOR_DEPTH; ++plane)
+            {
+                uint8_t bits = 0;
+
+                if (upper.getRed() & (1 << plane))      bits |= 0x01;
+                if (upper.getGrn() & (1 << plane))      bits |= 0x02;
+                if (upper.getBlu() & (1 << plane))      bits |= 0x04;
+                if (lower.getRed() & (1 << plane))      bits |= 0x08;
+                if (lower.getGrn() & (1 << plane))      bits |= 0x10;
+                if (lower.getBlu() & (1 << plane))      bits |= 0x20;
+
+                oldPlanes[row][plane][col] = bits;
+            }
+        }
+    }
+}
+
+/*******************************************************
+ * show()
+ *******************************************************
+ * one line of results
+ ******************************************************/
+static void show(const char* what, double ns)
+{
+    std::printf("  %-44s %9.1f ns %9.0f cycles\n", what, ns, benchCycles(ns));
+}
+
+/*******************************************************
+ * frame
+ *******************************************************
+ * the same picture every way: a pattern of every
+ * color, with the temperature readout changing once
+ * per publish in the last one
+ ******************************************************/
+TEST(frame)
+{
+    fakeHardwareReset();
+    nvm::getInstance()->init();
+    panel.init();
+
+    for (uint16_t y = 0; y < panel_t::LED_ROWS; ++y)
+    {
+        for (uint16_t x = 0; x < panel_t::LED_COLS; ++x)
+        {
+            pixel pxl;
+            pxl.makePixel(x % (MAX_COLOR + 1), y % (MAX_COLOR + 1), (x + y) % (MAX_COLOR + 1));
+            oldBuffer[y][x] = pxl.pixelToBuf();
+            panel.setPixel(x, y, pxl);
+        }
+    }
+    panel.update();
+
+    readout_t field;
+    CHECK(panel.initReadout(field, 0, 0, 5, RC_NORMAL));
+    const char* temps[] = { "38.5F", "38.6F" };
+    uint32_t n = 0;
+
+    std::printf("  per frame, 16x32 panel\n");
+    show("old, bit-banged scan, 1 plane, every refresh", benchNs(CALLS, oldScan));
+    show("old, pixels split on publish, 4 planes", benchNs(CALLS, oldPack));
+    show("new, scan by DMA, every refresh", 0);
+    show("new, publish with every row changed", benchNs(CALLS, []() { pixel pxl; pxl.makePixel(1, 2, 3); panel.fillColor(pxl); panel.update(); }));
+    show("new, publish with one readout changed", benchNs(CALLS, [&]() { panel.drawReadout(field, temps[++n & 1], RC_NORMAL); panel.update(); }));
+    benchKeep(oldPlanes);
+
+    // and the publishes did publish
+    const scan_view_t* v = panel.getScanView();
+    const void* shown = *v->frame;
+    panel.drawReadout(field, temps[++n & 1], RC_NORMAL);
+    panel.update();
+    CHECK(*v->frame != shown);
+}
@@ -0,0 +1,957 @@
+/********************************************************
+ * hub75_test.cpp
+ ********************************************************
+ * The display, in every geometry hub75.cpp builds,
+ * against the pretend PIO and DMA.  Nothing gets
+ * scanned by itself; the tests play the DMA's part,
+ * following the channels init() set up, and look at
+ * the words the state machines would get
+ *
+ *******************************************************/
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "check.h"
+#include "host/fake.h"
+#include "../hub75.h"
+
+// the DMA registers are 32 bits, so the panels have to
+// be static, not on the stack.  One of each geometry
+// hub75.cpp builds
+static panel_t panel;
+static hub75<16, 32, 2, 8, 8> chained;
+static hub75<32, 64, 1, 16, 8> big;
+static hub75<16, 32, 1, 8, 4> shallow;
+
+// the same checks on every one of them
+#define EVERY_PANEL(fn)                                                 \
+    fn(panel, "16x32");                                                 \
+    fn(chained, "16x32 chained x2");                                    \
+    fn(big, "32x64 1/16 scan");                                         \
+    fn(shallow, "16x32 4 planes")
+
+// the four channels, found by how they're wired up
+struct scan_chans_t
+{
+    int data;
+    int dataCtrl;
+    int row;
+    int rowCtrl;
+};
+
+/*******************************************************
+ * initPanel()
+ *******************************************************
+ * fresh hardware and nvm, then the panel.  Failures
+ * after this say which one
+ ******************************************************/
+template <typename P>
+static void initPanel(P& p, const char* name)
+{
+    checkContext(name);
+    fakeHardwareReset();
+    nvm::getInstance()->init();
+    p.init();
+}
+
+/*******************************************************
+ * findChans()
+ *******************************************************
+ * a channel feeding a state machine's TX FIFO, and the
+ * one it chains to, which restarts it
+ ******************************************************/
+static bool findChans(scan_chans_t& c)
+{
+    c.data = c.dataCtrl = c.row = c.rowCtrl = -1;
+
+    for (int ii = 0; ii < NUM_DMA_CHANNELS; ++ii)
+    {
+        if (!fakeDma[ii].claimed)
+        {
+            continue;
+        }
+
+        for (uint sm = 0; sm < 4; ++sm)
+        {
+            if (fakeDma[ii].write != &pio1->txf[sm])
+            {
+                continue;
+            }
+
+            // the data SM was claimed first
+            int& chan = sm ? c.row : c.data;
+            int& ctrl = sm ? c.rowCtrl : c.dataCtrl;
+            chan = ii;
+            ctrl = fakeDma[ii].config.chainTo;
+        }
+    }
+
+    return (c.data >= 0 && c.row >= 0 && c.dataCtrl != c.data && c.rowCtrl != c.row);
+}
+
+/*******************************************************
+ * restart()
+ *******************************************************
+ * what a control channel does at the end of a pass:
+ * one word from where it reads into the other one's
+ * read address, which starts it again
+ ******************************************************/
+static const uint32_t* restart(int chan, int ctrl)
+{
+    uint32_t addr = *(const volatile uint32_t*)fakeDma[ctrl].read;
+    dma_hw->ch[chan].read_addr = addr;
+    dma_hw->ch[chan].transfer_count = fakeDma[chan].count;
+
+    return ((const uint32_t*)(uintptr_t)addr);
+}
+
+/*******************************************************
+ * levelAt()
+ *******************************************************
+ * one color of one pixel, put back together from its
+ * planes, in a frame laid out the way the view says.
+ * color is 0-2 for R G B
+ ******************************************************/
+static uint32_t levelAt(const scan_view_t* v, const void* frame, uint16_t x, uint16_t y, uint8_t color)
+{
+    const uint8_t* f = (const uint8_t*)frame;
+    const size_t rowBytes = sizeof(uint32_t) + v->cols;
+    const uint16_t pair = y % v->scan;
+    const uint8_t bit = color + ((y >= v->scan) ? 3 : 0);
+    uint32_t level = 0;
+
+    for (uint8_t plane = 0; plane < v->planes; ++plane)
+    {
+        uint8_t col = f[(((pair * v->planes) + plane) * rowBytes) + sizeof(uint32_t) + x];
+        if (col & (1 << bit))
+        {
+            level |= (1 << plane);
+        }
+    }
+
+    return (level);
+}
+
+/*******************************************************
+ * published()
+ *******************************************************
+ * the frame the scan moves to next
+ ******************************************************/
+static const void* published(const scan_view_t* v)
+{
+    return (*v->frame);
+}
+
+/*******************************************************
+ * gammaLevel()
+ *******************************************************
+ * what a color value should come out as on planes
+ ******************************************************/
+static uint32_t gammaLevel(uint8_t value, uint8_t planes)
+{
+    if (!value)
+    {
+        return (0);
+    }
+
+    double l = std::round(((1 << planes) - 1) * std::pow((double)value / MAX_COLOR, 2.2));
+    return ((l < 1.0) ? 1 : (uint32_t)l);
+}
+
+/*******************************************************
+ * glyphAt()
+ *******************************************************
+ * what a glyph should light, worked out straight from
+ * the font: blank columns trimmed off either side,
+ * bit n of a column is row n.  Adds to want, which is
+ * the whole panel, and returns the columns it took
+ ******************************************************/
+template <typename P>
+static int16_t glyphAt(std::vector<bool>& want, int16_t x, int16_t y, char c, const bm_font_t& font)
+{
+    if (c < BM_FONT_FIRST || c > BM_FONT_LAST)
+    {
+        c = BM_FONT_MISSING;
+    }
+
+    const uint8_t* g = font.glyphs + ((c - BM_FONT_FIRST) * font.width);
+    uint8_t first = 0;
+    uint8_t last = font.width;
+    while (first < last && !g[first])       ++first;
+    while (last > first && !g[last - 1])    --last;
+
+    if (first == last)
+    {
+        return (font.spaceWidth);
+    }
+
+    for (uint8_t col = first; col < last; ++col)
+    {
+        for (uint8_t row = 0; row < 8; ++row)
+        {
+            int16_t px = x + col - first;
+            int16_t py = y + row;
+            if ((g[col] & (1 << row)) && px >= 0 && px < P::LED_COLS && py >= 0 && py < P::LED_ROWS)
+            {
+                want[(py * P::LED_COLS) + px] = true;
+            }
+        }
+    }
+
+    return (last - first);
+}
+
+/*******************************************************
+ * litMismatches()
+ *******************************************************
+ * pixels on the published frame that aren't lit, or
+ * not, in the pixel's color the way want says
+ ******************************************************/
+template <typename P>
+static uint32_t litMismatches(P& p, const std::vector<bool>& want, pixel& pxl)
+{
+    const scan_view_t* v = p.getScanView();
+    const void* f = published(v);
+    uint32_t bad = 0;
+
+    for (uint16_t y = 0; y < P::LED_ROWS; ++y)
+    {
+        for (uint16_t x = 0; x < P::LED_COLS; ++x)
+        {
+            bool on = want[(y * P::LED_COLS) + x];
+            bad += (levelAt(v, f, x, y, 0) != (on ? gammaLevel(pxl.getRed(), v->planes) : 0) ||
+                    levelAt(v, f, x, y, 1) != (on ? gammaLevel(pxl.getGrn(), v->planes) : 0) ||
+                    levelAt(v, f, x, y, 2) != (on ? gammaLevel(pxl.getBlu(), v->planes) : 0));
+        }
+    }
+
+    return (bad);
+}
+
+// what the model of the scan saw over one frame
+struct scan_model_t
+{
+    std::vector<uint32_t> light;    // PIO clocks lit, [y][x][color]
+    uint32_t frameCycles;           // PIO clocks for the whole frame
+    uint32_t rowWords;              // row pairs x planes played
+    uint32_t refreshHz;
+};
+
+/*******************************************************
+ * playScan()
+ *******************************************************
+ * pull.py's renderFrame(), fed from the DMA instead of
+ * a dump.  Both channels get restarted the way their
+ * control channels would, then each row control word
+ * is latched, lit for its on-time and blanked for the
+ * rest while the next row shifts in.  An LED's light
+ * is the on-times of the planes it's set in
+ ******************************************************/
+template <typename P>
+static void playScan(P& p, scan_model_t& m)
+{
+    const scan_view_t* v = p.getScanView();
+    m.light.assign(P::LED_ROWS * P::LED_COLS * 3, 0);
+    m.frameCycles = 0;
+    m.rowWords = 0;
+    m.refreshHz = 0;
+
+    scan_chans_t c;
+    if (!findChans(c))
+    {
+        return;
+    }
+
+    const uint32_t* data = restart(c.data, c.dataCtrl);
+    const uint32_t* end = data + fakeDma[c.data].count;
+    const uint32_t* ctrl = restart(c.row, c.rowCtrl);
+    const uint32_t onMask = (1 << v->onBits) - 1;
+
+    for (uint32_t ii = 0; ii < fakeDma[c.row].count && data < end; ++ii)
+    {
+        uint32_t word = ctrl[ii];
+        uint32_t on = ((word >> v->addrPins) & onMask) + 1;
+        uint32_t off = (word >> (v->addrPins + v->onBits)) + 1;
+        uint16_t addr = 0;
+        for (uint8_t bit = 0; bit < 4; ++bit)
+        {
+            if (word & (1 << v->addrBit[bit]))
+            {
+                addr |= (1 << bit);
+            }
+        }
+
+        m.frameCycles += v->latchCycles + std::max(on + off, (uint32_t)v->shiftCycles);
+        ++m.rowWords;
+
+        // the count the data SM loops on, then a byte
+        // per column, R0 G0 B0 R1 G1 B1
+        const uint8_t* cols = (const uint8_t*)(data + 1);
+        for (uint8_t half = 0; half < 2 && addr < v->scan; ++half)
+        {
+            uint16_t y = addr + (half * v->scan);
+            for (uint16_t x = 0; x < v->cols; ++x)
+            {
+                for (uint8_t color = 0; color < 3; ++color)
+                {
+                    if (cols[x] & (1 << (color + (half * 3))))
+                    {
+                        m.light[(((y * P::LED_COLS) + x) * 3) + color] += on;
+                    }
+                }
+            }
+        }
+        data += 1 + ((data[0] + 1) / sizeof(uint32_t));
+    }
+
+    m.refreshHz = m.frameCycles ? (v->pioHz / m.frameCycles) : 0;
+}
+
+/*******************************************************
+ * lightAt()
+ *******************************************************
+ * one color of one LED, out of the model
+ ******************************************************/
+template <typename P>
+static uint32_t lightAt(const scan_model_t& m, uint16_t x, uint16_t y, uint8_t color)
+{
+    return (m.light[(((y * P::LED_COLS) + x) * 3) + color]);
+}
+
+/*******************************************************
+ * scanChained
+ *******************************************************
+ * each state machine's channel chains to a control
+ * channel that writes its read address trigger, only
+ * the control channels get started, and the pointers
+ * they read are the ones the view gives out
+ ******************************************************/
+template <typename P>
+static void scanChainedOn(P& p, const char* name)
+{
+    initPanel(p, name);
+
+    scan_chans_t c;
+    CHECK(findChans(c));
+
+    const fake_dma_t& data = fakeDma[c.data];
+    CHECK_EQ(data.config.size, DMA_SIZE_32);
+    CHECK(data.config.readIncr && !data.config.writeIncr);
+    CHECK_EQ(data.config.dreq, pio_get_dreq(pio1, 0, true));
+    CHECK_EQ(data.count, sizeof(typename P::scan_frame_t) / sizeof(uint32_t));
+
+    const fake_dma_t& dataCtrl = fakeDma[c.dataCtrl];
+    CHECK(dataCtrl.write == &dma_hw->ch[c.data].al3_read_addr_trig);
+    CHECK_EQ(dataCtrl.count, 1u);
+    CHECK(!dataCtrl.config.readIncr && !dataCtrl.config.writeIncr);
+    CHECK(dataCtrl.read == (const volatile void*)p.getScanView()->frame);
+
+    const fake_dma_t& row = fakeDma[c.row];
+    CHECK_EQ(row.config.dreq, pio_get_dreq(pio1, 1, true));
+    CHECK_EQ(row.count, (uint)(P::SCAN_ROWS * P::SCAN_PLANES));
+
+    const fake_dma_t& rowCtrl = fakeDma[c.rowCtrl];
+    CHECK(rowCtrl.write == &dma_hw->ch[c.row].al3_read_addr_trig);
+    CHECK_EQ(*(const uint32_t* const*)rowCtrl.read, p.getScanView()->rowCtrl);
+
+    CHECK_EQ(fakeDmaStarted, (uint32_t)((1 << c.dataCtrl) | (1 << c.rowCtrl)));
+}
+
+TEST(scanChained)
+{
+    EVERY_PANEL(scanChainedOn);
+}
+
+/*******************************************************
+ * scanWords
+ *******************************************************
+ * one pass of the data channel is every row pair,
+ * every plane, each a column count for the SM's loop
+ * and then the columns, a byte each
+ ******************************************************/
+template <typename P>
+static void scanWordsOn(P& p, const char* name)
+{
+    initPanel(p, name);
+
+    scan_chans_t c;
+    CHECK(findChans(c));
+
+    const uint32_t* w = restart(c.data, c.dataCtrl);
+    const uint32_t* end = w + fakeDma[c.data].count;
+    CHECK(w != NULL);
+
+    const uint32_t colWords = P::LED_COLS / sizeof(uint32_t);
+    uint32_t rows = 0;
+    while (w < end)
+    {
+        CHECK_EQ(w[0], (uint32_t)(P::LED_COLS - 1));
+        w += 1 + colWords;
+        ++rows;
+    }
+
+    CHECK(w == end);
+    CHECK_EQ(rows, (uint32_t)(P::SCAN_ROWS * P::SCAN_PLANES));
+}
+
+TEST(scanWords)
+{
+    EVERY_PANEL(scanWordsOn);
+}
+
+/*******************************************************
+ * rowControl
+ *******************************************************
+ * the row SM gets a word per row pair per plane: the
+ * row address on A-D, then how long it's lit and how
+ * long it stays blanked, which add up to the plane's
+ * weight, LSB plane first
+ ******************************************************/
+template <typename P>
+static void rowControlOn(P& p, const char* name)
+{
+    initPanel(p, name);
+
+    scan_chans_t c;
+    CHECK(findChans(c));
+
+    const scan_view_t* v = p.getScanView();
+    const uint32_t* w = restart(c.row, c.rowCtrl);
+    CHECK(w == v->rowCtrl);
+
+    const uint32_t onMask = (1 << v->onBits) - 1;
+    for (uint16_t row = 0; row < v->scan; ++row)
+    {
+        uint32_t lastWeight = 0;
+        for (uint8_t plane = 0; plane < v->planes; ++plane)
+        {
+            uint32_t word = w[(row * v->planes) + plane];
+            uint32_t addr = 0;
+            for (uint8_t bit = 0; bit < 4; ++bit)
+            {
+                if (word & (1 << v->addrBit[bit]))
+                {
+                    addr |= (1 << bit);
+                }
+            }
+            CHECK_EQ(addr, (uint32_t)row);
+
+            uint32_t on = ((word >> v->addrPins) & onMask) + 1;
+            uint32_t off = word >> (v->addrPins + v->onBits);
+            uint32_t weight = on + off;
+            if (plane)
+            {
+                CHECK_EQ(weight, lastWeight * 2);
+            }
+            lastWeight = weight;
+        }
+    }
+}
+
+TEST(rowControl)
+{
+    EVERY_PANEL(rowControlOn);
+}
+
+/*******************************************************
+ * pixelPacking
+ *******************************************************
+ * a pixel goes onto the planes gamma corrected, in its
+ * own half of the column byte, and leaves the other
+ * half and its neighbours alone
+ ******************************************************/
+template <typename P>
+static void pixelPackingOn(P& p, const char* name)
+{
+    initPanel(p, name);
+    const scan_view_t* v = p.getScanView();
+
+    for (uint8_t value = 0; value <= MAX_COLOR; ++value)
+    {
+        pixel upper;
+        pixel lower;
+        upper.makePixel(value, MAX_COLOR - value, value / 2);
+        lower.makePixel(MAX_COLOR - value, value, 0);
+
+        p.clear();
+        p.setPixel(value, 2, upper);
+        p.setPixel(value, 2 + P::SCAN_ROWS, lower);
+        p.update();
+
+        const void* f = published(v);
+        CHECK_EQ(levelAt(v, f, value, 2, 0), gammaLevel(value, v->planes));
+        CHECK_EQ(levelAt(v, f, value, 2, 1), gammaLevel(MAX_COLOR - value, v->planes));
+        CHECK_EQ(levelAt(v, f, value, 2, 2), gammaLevel(value / 2, v->planes));
+        CHECK_EQ(levelAt(v, f, value, 2 + P::SCAN_ROWS, 0), gammaLevel(MAX_COLOR - value, v->planes));
+        CHECK_EQ(levelAt(v, f, value, 2 + P::SCAN_ROWS, 1), gammaLevel(value, v->planes));
+        CHECK_EQ(levelAt(v, f, value, 2 + P::SCAN_ROWS, 2), 0u);
+
+        for (uint8_t color = 0; color < 3; ++color)
+        {
+            CHECK_EQ(levelAt(v, f, value + 1, 2, color), 0u);
+            CHECK_EQ(levelAt(v, f, value, 3, color), 0u);
+        }
+    }
+}
+
+TEST(pixelPacking)
+{
+    EVERY_PANEL(pixelPackingOn);
+}
+
+/*******************************************************
+ * fillAndClip
+ *******************************************************
+ * a fill is every pixel, both halves; pixels off the
+ * panel don't land anywhere
+ ******************************************************/
+template <typename P>
+static void fillAndClipOn(P& p, const char* name)
+{
+    initPanel(p, name);
+    const scan_view_t* v = p.getScanView();
+
+    pixel pxl;
+    pxl.makePixel(PXL_PUR);
+    p.fillColor(pxl);
+    p.update();
+
+    const void* f = published(v);
+    uint32_t lit = 0;
+    for (uint16_t y = 0; y < P::LED_ROWS; ++y)
+    {
+        for (uint16_t x = 0; x < P::LED_COLS; ++x)
+        {
+            lit += (levelAt(v, f, x, y, 0) == gammaLevel(MAX_COLOR, v->planes) &&
+                    levelAt(v, f, x, y, 1) == 0 &&
+                    levelAt(v, f, x, y, 2) == gammaLevel(MAX_COLOR, v->planes));
+        }
+    }
+    CHECK_EQ(lit, (uint32_t)(P::LED_ROWS * P::LED_COLS));
+
+    p.clear();
+    pxl.makePixel(PXL_WHT);
+    p.setPixel(P::LED_COLS, 0, pxl);
+    p.setPixel(0, P::LED_ROWS, pxl);
+    p.update();
+
+    f = published(v);
+    for (uint16_t y = 0; y < P::LED_ROWS; ++y)
+    {
+        for (uint16_t x = 0; x < P::LED_COLS; ++x)
+        {
+            CHECK_EQ(levelAt(v, f, x, y, 0) | levelAt(v, f, x, y, 1) | levelAt(v, f, x, y, 2), 0u);
+        }
+    }
+}
+
+TEST(fillAndClip)
+{
+    EVERY_PANEL(fillAndClipOn);
+}
+
+/*******************************************************
+ * pixelBuff
+ *******************************************************
+ * a pixel in and out of its 16 bit form
+ ******************************************************/
+TEST(pixelBuff)
+{
+    pixel a;
+    a.makePixel(3, 9, 14);
+    pixel_buff_t b = a.pixelToBuf();
+    CHECK_EQ(b, (pixel_buff_t)(3 | (9 << 4) | (14 << 8)));
+
+    pixel c;
+    c.pixelFromBuff(b);
+    CHECK_EQ(c.getRed(), 3);
+    CHECK_EQ(c.getGrn(), 9);
+    CHECK_EQ(c.getBlu(), 14);
+
+    c.makePixel(0x1f, 0x20, 0xff);
+    CHECK_EQ(c.getRed(), 0x0f);
+    CHECK_EQ(c.getGrn(), 0);
+    CHECK_EQ(c.getBlu(), 0x0f);
+}
+
+/*******************************************************
+ * drawChars
+ *******************************************************
+ * glyphs land where the font says, trimmed, with one
+ * blank column after; a space is the font's space
+ * width and anything the font doesn't have is a '?'
+ ******************************************************/
+template <typename P>
+static void drawCharsOn(P& p, const char* name)
+{
+    initPanel(p, name);
+    pixel pxl;
+    pxl.makePixel(PXL_CYA);
+
+    const char* chars = "A1.- ?~\x01";
+    std::vector<bool> want(P::LED_ROWS * P::LED_COLS, false);
+    for (const char* c = chars; *c; ++c)
+    {
+        p.clear();
+        std::fill(want.begin(), want.end(), false);
+        int16_t width = glyphAt<P>(want, 3, 4, *c, bmFont5x7);
+
+        CHECK_EQ(p.drawChar(3, 4, *c, pxl), 3 + width + 1);
+        p.update();
+        CHECK_EQ(litMismatches(p, want, pxl), 0u);
+    }
+}
+
+TEST(drawChars)
+{
+    EVERY_PANEL(drawCharsOn);
+}
+
+/*******************************************************
+ * drawStrings
+ *******************************************************
+ * a string is its glyphs one after another, as wide
+ * as stringWidth() says, in either font
+ ******************************************************/
+template <typename P>
+static void drawStringsOn(P& p, const char* name)
+{
+    initPanel(p, name);
+    pixel pxl;
+    pxl.makePixel(PXL_YEL);
+
+    const bm_font_t* fonts[] = { &bmFont5x7, &bmFont3x5 };
+    const std::string text = "Hi 7.5C";
+    std::vector<bool> want(P::LED_ROWS * P::LED_COLS, false);
+
+    for (const bm_font_t* font : fonts)
+    {
+        p.clear();
+        std::fill(want.begin(), want.end(), false);
+
+        int16_t x = 1;
+        for (char c : text)
+        {
+            x += glyphAt<P>(want, x, 8, c, *font) + 1;
+        }
+
+        CHECK_EQ(P::stringWidth(text, *font), x - 2);
+        CHECK_EQ(p.drawString(1, 8, text, pxl, *font), x);
+        p.update();
+        CHECK_EQ(litMismatches(p, want, pxl), 0u);
+    }
+
+    CHECK_EQ(P::stringWidth(""), 0);
+}
+
+TEST(drawStrings)
+{
+    EVERY_PANEL(drawStringsOn);
+}
+
+/*******************************************************
+ * textClipping
+ *******************************************************
+ * text hanging off any edge is cut off there and
+ * doesn't wrap or land in the other half
+ ******************************************************/
+template <typename P>
+static void textClippingOn(P& p, const char* name)
+{
+    initPanel(p, name);
+    pixel pxl;
+    pxl.makePixel(PXL_WHT);
+
+    const int16_t spots[][2] =
+    {
+        { -2, 3 },
+        { P::LED_COLS - 2, 3 },
+        { 5, -3 },
+        { 5, P::SCAN_ROWS - 3 },
+        { 5, P::LED_ROWS - 3 },
+        { 5, P::LED_ROWS },
+        { 5, -8 },
+    };
+
+    std::vector<bool> want(P::LED_ROWS * P::LED_COLS, false);
+    for (const int16_t* spot : spots)
+    {
+        p.clear();
+        std::fill(want.begin(), want.end(), false);
+        glyphAt<P>(want, spot[0], spot[1], '8', bmFont5x7);
+
+        p.drawChar(spot[0], spot[1], '8', pxl);
+        p.update();
+        CHECK_EQ(litMismatches(p, want, pxl), 0u);
+    }
+
+    // stops once it's off the right edge
+    p.clear();
+    int16_t end = p.drawString(P::LED_COLS - 4, 0, "8888", pxl);
+    CHECK(end >= P::LED_COLS);
+    CHECK(end < P::LED_COLS + bmFont5x7.width + 1);
+}
+
+TEST(textClipping)
+{
+    EVERY_PANEL(textClippingOn);
+}
+
+/*******************************************************
+ * scanImage
+ *******************************************************
+ * every LED gets its own color; played through the
+ * model, each one's light is its gamma level over
+ * full, in the right place, and the whole frame
+ * takes what calcRefreshHz() says it does
+ ******************************************************/
+template <typename P>
+static void scanImageOn(P& p, const char* name)
+{
+    initPanel(p, name);
+
+    for (uint16_t y = 0; y < P::LED_ROWS; ++y)
+    {
+        for (uint16_t x = 0; x < P::LED_COLS; ++x)
+        {
+            pixel pxl;
+            pxl.makePixel(x % (MAX_COLOR + 1), y % (MAX_COLOR + 1), (x + y) % (MAX_COLOR + 1));
+            p.setPixel(x, y, pxl);
+        }
+    }
+    p.update();
+
+    scan_model_t m;
+    playScan(p, m);
+    CHECK_EQ(m.rowWords, (uint32_t)(P::SCAN_ROWS * P::SCAN_PLANES));
+    CHECK_EQ(m.refreshHz, P::calcRefreshHz(P::SCAN_PLANES));
+
+    // the LSB plane's on-time is the unit of light
+    const uint32_t full = gammaLevel(MAX_COLOR, P::SCAN_PLANES);
+    const uint32_t unit = lightAt<P>(m, MAX_COLOR, 0, 0) / full;
+    CHECK(unit > 0);
+
+    uint32_t bad = 0;
+    for (uint16_t y = 0; y < P::LED_ROWS; ++y)
+    {
+        for (uint16_t x = 0; x < P::LED_COLS; ++x)
+        {
+            bad += (lightAt<P>(m, x, y, 0) != unit * gammaLevel(x % (MAX_COLOR + 1), P::SCAN_PLANES) ||
+                    lightAt<P>(m, x, y, 1) != unit * gammaLevel(y % (MAX_COLOR + 1), P::SCAN_PLANES) ||
+                    lightAt<P>(m, x, y, 2) != unit * gammaLevel((x + y) % (MAX_COLOR + 1), P::SCAN_PLANES));
+        }
+    }
+    CHECK_EQ(bad, 0u);
+}
+
+TEST(scanImage)
+{
+    EVERY_PANEL(scanImageOn);
+}
+
+/*******************************************************
+ * scanBrightness
+ *******************************************************
+ * brightness takes light off every plane the same and
+ * leaves the refresh rate alone
+ ******************************************************/
+template <typename P>
+static void scanBrightnessOn(P& p, const char* name)
+{
+    initPanel(p, name);
+
+    pixel pxl;
+    pxl.makePixel(PXL_WHT);
+    p.fillColor(pxl);
+    p.update();
+
+    scan_model_t bright;
+    p.setBrightness(BRIGHTNESS_MAX);
+    playScan(p, bright);
+
+    scan_model_t half;
+    p.setBrightness(BRIGHTNESS_MAX / 2);
+    playScan(p, half);
+
+    CHECK_EQ(half.refreshHz, bright.refreshHz);
+    CHECK_EQ(half.frameCycles, bright.frameCycles);
+    CHECK_EQ(lightAt<P>(half, 3, P::LED_ROWS - 1, 1) * 2, lightAt<P>(bright, 3, P::LED_ROWS - 1, 1));
+
+    // and never quite off
+    scan_model_t dim;
+    p.setBrightness(0);
+    CHECK_EQ(p.getBrightness(), BRIGHTNESS_MIN);
+    playScan(p, dim);
+    CHECK(lightAt<P>(dim, 0, 0, 0) > 0);
+    CHECK(lightAt<P>(dim, 0, 0, 0) < lightAt<P>(half, 0, 0, 0));
+}
+
+TEST(scanBrightness)
+{
+    EVERY_PANEL(scanBrightnessOn);
+}
+
+/*******************************************************
+ * readoutCells
+ *******************************************************
+ * a readout is fixed width cells, right-aligned, each
+ * the font's glyph unstripped in the readout's color.
+ * Redrawing only changes what changed, a color change
+ * all of it, and a field that doesn't fit in one half
+ * of the panel is turned down
+ ******************************************************/
+template <typename P>
+static void readoutCellsOn(P& p, const char* name)
+{
+    // which of R G B each readout color lights
+    static const uint8_t colorsOf[RC_COUNT] = { 0x02, 0x01, 0x04, 0x03 };
+    initPanel(p, name);
+
+    readout_t r;
+    CHECK(!p.initReadout(r, 0, P::SCAN_ROWS - 3, 4, RC_NORMAL));
+    CHECK(!p.initReadout(r, P::LED_COLS - 10, 0, 2, RC_NORMAL));
+
+    const uint16_t ry = P::SCAN_ROWS;
+    CHECK(p.initReadout(r, 1, ry, 5, RC_NORMAL));
+
+    const char* texts[] = { "-1.5", "12.5F", "12.5C", "0" };
+    const readout_color_t colors[] = { RC_WARM, RC_WARM, RC_COOL, RC_SETPOINT };
+
+    for (uint8_t ii = 0; ii < 4; ++ii)
+    {
+        p.drawReadout(r, texts[ii], colors[ii]);
+        p.update();
+
+        scan_model_t m;
+        playScan(p, m);
+
+        // what each LED should be: right-aligned text,
+        // the glyph's columns as they are in the font
+        std::string text = texts[ii];
+        text.insert(0, 5 - text.length(), ' ');
+
+        uint32_t bad = 0;
+        uint32_t lit = 0;
+        for (uint16_t y = 0; y < P::LED_ROWS; ++y)
+        {
+            for (uint16_t x = 0; x < P::LED_COLS; ++x)
+            {
+                bool on = false;
+                int16_t cx = x - 1;
+                int16_t cy = y - ry;
+                if (cx >= 0 && cx < 5 * READOUT_CELL_W && cy >= 0 && cy < READOUT_CELL_H &&
+                    (cx % READOUT_CELL_W) < bmFont5x7.width)
+                {
+                    const uint8_t* g = bmFont5x7.glyphs + ((text[cx / READOUT_CELL_W] - BM_FONT_FIRST) * bmFont5x7.width);
+                    on = (g[cx % READOUT_CELL_W] & (1 << cy)) != 0;
+                }
+
+                for (uint8_t color = 0; color < 3; ++color)
+                {
+                    bool want = on && (colorsOf[colors[ii]] & (1 << color));
+                    bad += ((lightAt<P>(m, x, y, color) != 0) != want);
+                    lit += want;
+                }
+            }
+        }
+        CHECK(lit > 0);
+        CHECK_EQ(bad, 0u);
+    }
+}
+
+TEST(readoutCells)
+{
+    EVERY_PANEL(readoutCellsOn);
+}
+
+/*******************************************************
+ * scanNotOverwritten
+ *******************************************************
+ * with the DMA part way through a frame, update() has
+ * to leave that frame alone, whichever one it is and
+ * whether or not the scan has picked up the newest.
+ * Plays it through a run of draws, with the scan
+ * moving to the published frame every third one, so
+ * it sits on one frame across two publishes
+ ******************************************************/
+template <typename P>
+static void scanNotOverwrittenOn(P& p, const char* name)
+{
+    initPanel(p, name);
+
+    scan_chans_t c;
+    CHECK(findChans(c));
+    const scan_view_t* v = p.getScanView();
+    const size_t frameBytes = fakeDma[c.data].count * sizeof(uint32_t);
+    std::vector<uint8_t> before(frameBytes);
+    const uint32_t* scanning = NULL;
+
+    for (uint32_t ii = 0; ii < 24; ++ii)
+    {
+        // the scan restarts on whatever's published, and
+        // gets a third of the way through it
+        if (!(ii % 3))
+        {
+            scanning = restart(c.data, c.dataCtrl);
+        }
+        const uint32_t done = fakeDma[c.data].count / 3;
+        dma_hw->ch[c.data].read_addr = (uint32_t)(uintptr_t)(scanning + done);
+        dma_hw->ch[c.data].transfer_count = fakeDma[c.data].count - done;
+        std::memcpy(before.data(), scanning, frameBytes);
+
+        pixel pxl;
+        pxl.makePixel(ii % (MAX_COLOR + 1), MAX_COLOR, 0);
+        p.setPixel(ii % P::LED_COLS, ii % P::LED_ROWS, pxl);
+        p.update();
+
+        CHECK(std::memcmp(before.data(), scanning, frameBytes) == 0);
+        CHECK(*v->frame != (const void*)scanning);
+    }
+}
+
+TEST(scanNotOverwritten)
+{
+    EVERY_PANEL(scanNotOverwrittenOn);
+}
+
+/*******************************************************
+ * wrongCore
+ *******************************************************
+ * the canvas belongs to the core that ran init().
+ * Drawing or publishing from the other one is counted
+ * and dropped, so nothing it did shows up later
+ ******************************************************/
+template <typename P>
+static void wrongCoreOn(P& p, const char* name)
+{
+    initPanel(p, name);
+    p.update();
+
+    const scan_view_t* v = p.getScanView();
+    const void* shown = *v->frame;
+    pixel pxl;
+    pxl.makePixel(MAX_COLOR, 0, 0);
+
+    fakeCore = 1;
+    p.setPixel(0, 0, pxl);
+    p.fillColor(pxl);
+    p.update();
+    fakeCore = 0;
+    CHECK_EQ(p.getWrongCore(), 3u);
+    CHECK(*v->frame == shown);
+
+    p.update();
+    CHECK(*v->frame == shown);
+
+    p.setPixel(0, 0, pxl);
+    p.update();
+    CHECK(*v->frame != shown);
+    CHECK_EQ(p.getWrongCore(), 3u);
+}
+
+TEST(wrongCore)
+{
+    EVERY_PANEL(wrongCoreOn);
+}
@@ -0,0 +1,125 @@
+/********************************************************
+ * ipc_bench.cpp
+ ********************************************************
+ * What a tick of updateSharedData() costs, against the
+ * mutex and full copy it replaced.
+ *
+ * The old one is in oldShared.h.  Each case is what
+ * one tick of a core's loop does, or a tick of each
+ * core when one of them changed something
+ *
+ *******************************************************/
+#include <cstdio>
+#include <cstring>
+
+#include "check.h"
+#include "bench.h"
+#include "host/fake.h"
+#include "ipc/ipc.h"
+#include "oldShared.h"
+
+#define CALLS               20000
+#define SCAN_APS            8       // access points in a scan
+
+/*******************************************************
+ * show()
+ *******************************************************
+ * one line of results, old then new
+ ******************************************************/
+static void show(const char* what, double oldNs, bench_allocs_t oldA, double newNs, bench_allocs_t newA)
+{
+    std::printf("  %-30s old %7.1f ns %6.0f cycles %3llu allocs   new %7.1f ns %6.0f cycles %3llu allocs\n",
+            what, oldNs, benchCycles(oldNs), (unsigned long long)oldA.count,
+            newNs, benchCycles(newNs), (unsigned long long)newA.count);
+}
+
+/*******************************************************
+ * BENCH_TICK()
+ *******************************************************
+ * time both, and see what one of each allocates.  The
+ * new one mustn't
+ ******************************************************/
+#define BENCH_TICK(what, oldFn, newFn)                                          \
+    do                                                                          \
+    {                                                                           \
+        bench_allocs_t newA = benchAllocsOf(newFn);                             \
+        CHECK_EQ(newA.count, 0u);                                               \
+        show(what, benchNs(CALLS, oldFn), benchAllocsOf(oldFn), benchNs(CALLS, newFn), newA);  \
+    } while (0)
+
+/*******************************************************
+ * tick
+ *******************************************************
+ * a tick with nothing new, the brightness from the
+ * other core, and a scan table from the other core
+ ******************************************************/
+TEST(tick)
+{
+    fakeHardwareReset();
+    CHECK(initIPC());
+    oldSharedInit();
+
+    // both sides holding what core 1 would have put up
+    old_inter_core_t o0;
+    old_inter_core_t o1;
+    inter_core_t c0;
+    inter_core_t c1;
+    std::memset(&c0, 0, sizeof(c0));
+    std::memset(&c1, 0, sizeof(c1));
+
+    oldSharedFill(o1, SCAN_APS);
+    c1.ipAddress = { { 192, 168, 100, 120 } };
+    c1.scanResult.found = c1.scanResult.count = SCAN_APS;
+    for (uint8_t ii = 0; ii < SCAN_APS; ++ii)
+    {
+        std::strcpy(c1.scanResult.apData[ii].ssid, "brewery-network-5G");
+    }
+    oldData = o1;
+    oldCopyIPC(oldData, o0);
+    fakeCore = 1;
+    updateSharedData(US_IP_ADDR | US_SCAN_DATA, c1);
+    fakeCore = 0;
+    updateSharedData(US_NONE, c0);
+    CHECK_EQ(c0.scanResult.count, SCAN_APS);
+
+    std::printf("  per tick, %d access points in the scan table\n", SCAN_APS);
+    BENCH_TICK("nothing changed",
+            [&]() { oldUpdateSharedData(OLD_US_NONE, o0); },
+            [&]() { updateSharedData(US_NONE, c0); });
+
+    auto oldBright = [&]()
+    {
+        fakeCore = 1;
+        ++o1.brightCount;
+        oldUpdateSharedData(OLD_US_BRIGHTNESS, o1);
+        fakeCore = 0;
+        oldUpdateSharedData(OLD_US_NONE, o0);
+    };
+    auto newBright = [&]()
+    {
+        fakeCore = 1;
+        ++c1.brightCount;
+        updateSharedData(US_BRIGHTNESS, c1);
+        fakeCore = 0;
+        updateSharedData(US_NONE, c0);
+    };
+    BENCH_TICK("brightness, both cores", oldBright, newBright);
+    CHECK_EQ(c0.brightCount, c1.brightCount);
+
+    auto oldScan = [&]()
+    {
+        fakeCore = 1;
+        oldUpdateSharedData(OLD_US_SCAN_DATA, o1);
+        fakeCore = 0;
+        oldUpdateSharedData(OLD_US_NONE, o0);
+    };
+    auto newScan = [&]()
+    {
+        fakeCore = 1;
+        updateSharedData(US_SCAN_DATA, c1);
+        fakeCore = 0;
+        updateSharedData(US_NONE, c0);
+    };
+    BENCH_TICK("scan table, both cores", oldScan, newScan);
+    fakeCore = 0;
+}
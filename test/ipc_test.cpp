@@ -0,0 +1,349 @@
+/********************************************************
+ * ipc_test.cpp
+ ********************************************************
+ * The shared data between the cores.  The cores are
+ * threads here, each with its own fakeCore, and the
+ * writers' spinlock and barriers are real, so the
+ * seqlock gets a proper going over
+ *
+ *******************************************************/
+#include <cstring>
+#include <thread>
+#include <atomic>
+
+#include "check.h"
+#include "host/fake.h"
+#include "ipc/ipc.h"
+
+#define STRESS_WRITES       200000  // each, at least
+
+/*******************************************************
+ * fillScan()
+ *******************************************************
+ * a scan table that's n all the way through, so a
+ * copy that got torn shows
+ ******************************************************/
+static void fillScan(scan_data_t& s, uint8_t n)
+{
+    std::memset(&s, n, sizeof(s));
+}
+
+/*******************************************************
+ * scanWhole()
+ *******************************************************
+ * all one value, or all zero before the first write
+ ******************************************************/
+static bool scanWhole(const scan_data_t& s)
+{
+    const uint8_t* b = (const uint8_t*)&s;
+    for (size_t ii = 1; ii < sizeof(s); ++ii)
+    {
+        if (b[ii] != b[0])
+        {
+            return (false);
+        }
+    }
+
+    return (true);
+}
+
+/*******************************************************
+ * startIPC()
+ *******************************************************
+ * fresh hardware, then the IPC
+ ******************************************************/
+static bool startIPC()
+{
+    fakeHardwareReset();
+    return (initIPC());
+}
+
+/*******************************************************
+ * onlyChanges
+ *******************************************************
+ * a core gets what the other one wrote, not its own
+ * back, and the big fields are only copied when
+ * they've moved
+ ******************************************************/
+TEST(onlyChanges)
+{
+    CHECK(startIPC());
+
+    inter_core_t c0;
+    inter_core_t c1;
+    std::memset(&c0, 0, sizeof(c0));
+    std::memset(&c1, 0, sizeof(c1));
+    ipc_stats_t s;
+
+    // first time round, everything comes out
+    fakeCore = 0;
+    CHECK(updateSharedData(US_NONE, c0));
+    fakeCore = 1;
+    CHECK(updateSharedData(US_NONE, c1));
+    getIPCStats(1, s);
+    CHECK_EQ(s.bulkCopies, 1u);
+
+    // nothing moved, nothing copied
+    CHECK(updateSharedData(US_NONE, c1));
+    getIPCStats(1, s);
+    CHECK_EQ(s.bulkCopies, 1u);
+    CHECK_EQ(s.updates, 2u);
+
+    // core 1 puts up an address; core 0 gets it
+    c1.ipAddress = { { 192, 168, 1, 20 } };
+    c1.core1Ready = true;
+    CHECK(updateSharedData(US_IP_ADDR | US_CORE1_READY, c1));
+    getIPCStats(1, s);
+    CHECK_EQ(s.bulkCopies, 1u);
+
+    fakeCore = 0;
+    CHECK(updateSharedData(US_NONE, c0));
+    CHECK(c0.core1Ready);
+    CHECK_EQ(c0.ipAddress.b[3], 20);
+    getIPCStats(0, s);
+    CHECK_EQ(s.bulkCopies, 2u);
+
+    // core 0's own brightness doesn't come back over
+    // what it has since changed locally
+    c0.brightness = 40;
+    c0.brightCount = 3;
+    CHECK(updateSharedData(US_BRIGHTNESS, c0));
+    c0.brightness = 41;
+    CHECK(updateSharedData(US_NONE, c0));
+    CHECK_EQ(c0.brightness, 41);
+
+    fakeCore = 1;
+    CHECK(updateSharedData(US_NONE, c1));
+    CHECK_EQ(c1.brightness, 40);
+    CHECK_EQ(c1.brightCount, 3u);
+    getIPCStats(1, s);
+    CHECK_EQ(s.bulkCopies, 1u);
+    CHECK_EQ(s.retries, 0u);
+}
+
+// what core 1 writes from in the middle of core 0's read
+static inter_core_t other;
+
+/*******************************************************
+ * otherWrites()
+ *******************************************************
+ * core 1 putting up a new brightness, run from a
+ * barrier in core 0's read
+ ******************************************************/
+static void otherWrites()
+{
+    fakeCore = 1;
+    ++other.brightCount;
+    other.brightness = (uint8_t)other.brightCount;
+    updateSharedData(US_BRIGHTNESS, other);
+    fakeCore = 0;
+}
+
+/*******************************************************
+ * readRetries
+ *******************************************************
+ * a write that lands while core 0 is copying out, on
+ * either side of the copy, sends it round again, and
+ * it comes out with the new value
+ ******************************************************/
+TEST(readRetries)
+{
+    CHECK(startIPC());
+
+    inter_core_t c0;
+    std::memset(&c0, 0, sizeof(c0));
+    std::memset(&other, 0, sizeof(other));
+    ipc_stats_t s;
+
+    fakeCore = 0;
+    CHECK(updateSharedData(US_NONE, c0));
+
+    // the read's barriers are after it takes seq, then
+    // after the copy
+    for (uint32_t skip = 0; skip < 2; ++skip)
+    {
+        fakeBarrierHook = otherWrites;
+        fakeBarrierSkip = skip;
+        CHECK(updateSharedData(US_NONE, c0));
+        CHECK(fakeBarrierHook == NULL);
+        CHECK_EQ(c0.brightCount, other.brightCount);
+        CHECK_EQ(c0.brightness, other.brightness);
+
+        getIPCStats(0, s);
+        CHECK_EQ(s.retries, skip + 1);
+    }
+}
+
+/*******************************************************
+ * seqlockStress
+ *******************************************************
+ * both cores flat out, neither stopping until both
+ * have done their share, so they overlap even on a
+ * host with one CPU.  Core 1 writes the scan table,
+ * core 0 the brightness and its count, and each reads
+ * the other's.  Every copy has to be one whole write,
+ * never part of two, and the count never goes
+ * backwards
+ ******************************************************/
+TEST(seqlockStress)
+{
+    CHECK(startIPC());
+
+    std::atomic<uint32_t> torn0(0);
+    std::atomic<uint32_t> torn1(0);
+    std::atomic<uint32_t> back1(0);
+    std::atomic<bool> done0(false);
+    std::atomic<bool> done1(false);
+
+    std::thread core1([&]()
+    {
+        fakeCore = 1;
+        inter_core_t d;
+        std::memset(&d, 0, sizeof(d));
+        uint32_t lastCount = 0;
+        uint32_t n = 0;
+
+        while (!done0 || n < STRESS_WRITES)
+        {
+            ++n;
+            fillScan(d.scanResult, (uint8_t)n);
+            updateSharedData(US_SCAN_DATA, d);
+
+            if (d.brightness != (uint8_t)d.brightCount)     ++torn1;
+            if (d.brightCount < lastCount)                  ++back1;
+            lastCount = d.brightCount;
+
+            if (n == STRESS_WRITES)
+            {
+                done1 = true;
+            }
+        }
+        fillScan(d.scanResult, 0x5a);
+        updateSharedData(US_SCAN_DATA, d);
+    });
+
+    fakeCore = 0;
+    inter_core_t d;
+    std::memset(&d, 0, sizeof(d));
+    uint32_t n = 0;
+    while (!done1 || n < STRESS_WRITES)
+    {
+        ++n;
+        d.brightCount = n;
+        d.brightness = (uint8_t)n;
+        updateSharedData(US_BRIGHTNESS, d);
+
+        if (!scanWhole(d.scanResult))                       ++torn0;
+
+        if (n == STRESS_WRITES)
+        {
+            done0 = true;
+        }
+    }
+    core1.join();
+
+    CHECK_EQ(torn0.load(), 0u);
+    CHECK_EQ(torn1.load(), 0u);
+    CHECK_EQ(back1.load(), 0u);
+
+    // and once it's quiet, each gets the other's last
+    d.brightCount = ++n;
+    d.brightness = (uint8_t)n;
+    updateSharedData(US_BRIGHTNESS, d);
+    CHECK_EQ(d.scanResult.found, 0x5a);
+
+    fakeCore = 1;
+    inter_core_t last;
+    std::memset(&last, 0, sizeof(last));
+    updateSharedData(US_NONE, last);
+    CHECK_EQ(last.brightCount, n);
+    fakeCore = 0;
+}
+
+/*******************************************************
+ * commandRoundTrip
+ *******************************************************
+ * requests go over in order with their own ids, the
+ * answers come back with them and the round trip gets
+ * counted against the command.  Core 0 can't have
+ * more out than the response queue can take back
+ ******************************************************/
+TEST(commandRoundTrip)
+{
+    CHECK(startIPC());
+    fakeCore = 0;
+
+    uint16_t ids[8];
+    for (uint8_t ii = 0; ii < 7; ++ii)
+    {
+        fakeTimeUs = ii * 100;
+        ids[ii] = postRequest((ii % 2) ? IS_GET_IP : IS_NTP_SYNC);
+        CHECK(ids[ii] != 0);
+        CHECK(!ii || ids[ii] == ids[ii - 1] + 1);
+    }
+
+    // one more and it's turned away
+    CHECK_EQ(postRequest(IS_DO_SCAN), 0);
+
+    fakeCore = 1;
+    fakeTimeUs = 1000;
+    ipc_request_t req;
+    for (uint8_t ii = 0; ii < 7; ++ii)
+    {
+        CHECK(getRequest(req));
+        CHECK_EQ(req.id, ids[ii]);
+        CHECK_EQ(req.cmd, (ii % 2) ? IS_GET_IP : IS_NTP_SYNC);
+        CHECK(postResponse(req, ii != 3));
+    }
+    CHECK(!getRequest(req));
+
+    fakeCore = 0;
+    fakeTimeUs = 2000;
+    ipc_response_t resp;
+    for (uint8_t ii = 0; ii < 7; ++ii)
+    {
+        CHECK(getResponse(resp));
+        CHECK_EQ(resp.id, ids[ii]);
+        CHECK_EQ(resp.ok, ii != 3);
+        CHECK_EQ(resp.latencyUs, 2000u - (ii * 100));
+    }
+    CHECK(!getResponse(resp));
+
+    ipc_latency_t l;
+    getCmdLatency(IS_GET_IP, l);
+    CHECK_EQ(l.count, 3u);
+    CHECK_EQ(l.maxUs, 1900u);
+    CHECK_EQ(l.lastUs, 1500u);
+    CHECK_EQ(l.totalUs, 1900u + 1700u + 1500u);
+
+    // and now there's room again
+    CHECK(postRequest(IS_DO_SCAN) != 0);
+    fakeTimeUs = 0;
+}
+
+/*******************************************************
+ * lateDoorbell
+ *******************************************************
+ * a bell that rings once the deadline has gone isn't
+ * lost; the next sleep answers it straight away
+ ******************************************************/
+TEST(lateDoorbell)
+{
+    CHECK(startIPC());
+    fakeCore = 0;
+    fakeTimeUs = 1000;
+
+    ringDoorbell(0);
+    CHECK(!sleepUntil(500));
+    CHECK(sleepUntil(2000));
+    CHECK_EQ((uint64_t)fakeTimeUs, 1000u);
+
+    // and once it's answered, a sleep is the whole wait
+    CHECK(!sleepUntil(2000));
+    CHECK_EQ((uint64_t)fakeTimeUs, 2000u);
+
+    idle_stats_t s;
+    getIdleStats(0, s, false);
+    CHECK_EQ(s.doorbells, 1u);
+    fakeTimeUs = 0;
+}
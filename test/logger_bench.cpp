@@ -0,0 +1,283 @@
+/********************************************************
+ * logger_bench.cpp
+ ********************************************************
+ * Lines per second through the log, and how long a
+ * writer can be held up, with the per-core rings
+ * against the single buffer and mutex they replaced.
+ *
+ * The old logger is copied here from before the change:
+ * the prefix made with stringFormat() (a 1K string and
+ * vsnprintf(), but a fixed time text, so it's cheaper
+ * than it was), then the mutex taken and let go once
+ * per character going in and once per character coming
+ * out.  The SDK's mutex is a spinlock around an owner;
+ * here it also times any wait for it.  Each line goes
+ * all the way through: written on core 0, then read
+ * out on core 1 (dbgPop() for the old, drain() and
+ * read() for the new)
+ *
+ *******************************************************/
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "check.h"
+#include "bench.h"
+#include "host/fake.h"
+#include "hardware/sync.h"
+#include "ipc/mlogger.h"
+
+#define CALLS               5000
+#define CONTENDED_LINES     20000   // per core
+#define OLD_BUFFER_SIZE     2048
+
+static const char line[] = "reefer::pump on, probe 38.5F, setpoint 40.0F, ran 1234s ok\n";
+
+// the old logger
+static char oldBuff[OLD_BUFFER_SIZE];
+static volatile size_t oldHead;
+static volatile size_t oldTail;
+static spin_lock_t* oldSpin;
+static volatile int oldOwner;
+
+// time spent waiting on the old mutex
+static std::atomic<uint64_t> oldWaits;
+static std::atomic<uint64_t> oldWaitMaxNs;
+
+static bool oldMutexTry()
+{
+    uint32_t save = spin_lock_blocking(oldSpin);
+    bool got = (oldOwner < 0);
+    if (got)
+    {
+        oldOwner = (int)get_core_num();
+    }
+    spin_unlock(oldSpin, save);
+
+    return (got);
+}
+
+static void oldMutexEnter()
+{
+    if (oldMutexTry())
+    {
+        return;
+    }
+
+    // wfe on the board; here the holder may need this
+    // CPU to get anywhere
+    auto start = std::chrono::steady_clock::now();
+    while (!oldMutexTry())
+    {
+        std::this_thread::yield();
+    }
+    uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    ++oldWaits;
+    uint64_t was = oldWaitMaxNs.load();
+    while (ns > was && !oldWaitMaxNs.compare_exchange_weak(was, ns))
+    {
+    }
+}
+
+static void oldMutexExit()
+{
+    uint32_t save = spin_lock_blocking(oldSpin);
+    oldOwner = -1;
+    spin_unlock(oldSpin, save);
+}
+
+static size_t oldConsumed()
+{
+    return ((oldHead - oldTail + OLD_BUFFER_SIZE) % OLD_BUFFER_SIZE);
+}
+
+static void oldAddChar(char c)
+{
+    oldMutexEnter();
+    if (oldConsumed() == OLD_BUFFER_SIZE - 1)
+    {
+        oldTail = (oldTail + 1) % OLD_BUFFER_SIZE;
+    }
+    oldBuff[oldHead] = c;
+    oldHead = (oldHead + 1) % OLD_BUFFER_SIZE;
+    oldMutexExit();
+}
+
+static size_t oldDbgWrite(const std::string& ms)
+{
+    std::string s;
+    s.resize(1024);
+    int n = snprintf((char*)s.data(), s.size(), "[D%d] %s,%s", get_core_num(), "20211205 13:04:05.123456", ms.c_str());
+    s.resize(n);
+
+    for (char c : s)
+    {
+        oldAddChar(c);
+    }
+
+    return (s.length());
+}
+
+static size_t oldPop(char* c, size_t len)
+{
+    if (len > oldConsumed())
+    {
+        len = oldConsumed();
+    }
+
+    for (size_t ii = 0; ii < len; ++ii)
+    {
+        oldMutexEnter();
+        c[ii] = oldBuff[oldTail];
+        oldTail = (oldTail + 1) % OLD_BUFFER_SIZE;
+        oldMutexExit();
+    }
+
+    return (len);
+}
+
+/*******************************************************
+ * startBoth()
+ *******************************************************
+ * fresh hardware, both logs empty
+ ******************************************************/
+static logger* startBoth()
+{
+    fakeHardwareReset();
+    oldSpin = spin_lock_instance(spin_lock_claim_unused(true));
+    oldOwner = -1;
+    oldHead = oldTail = 0;
+    oldWaits = 0;
+    oldWaitMaxNs = 0;
+
+    logger* l = logger::getInstance();
+    l->initBuffer();
+
+    return (l);
+}
+
+/*******************************************************
+ * throughput
+ *******************************************************
+ * one line in on core 0 and out on core 1, one after
+ * the other, and the longest a single write took
+ ******************************************************/
+TEST(throughput)
+{
+    logger* l = startBoth();
+    const std::string oldLine = line;
+    uint32_t from = l->nextSeq();
+    char out[LOGGER_BUFFER_SIZE];
+    double oldMax = 0;
+    double newMax = 0;
+
+    auto oldFn = [&]()
+    {
+        fakeCore = 0;
+        auto start = std::chrono::steady_clock::now();
+        oldDbgWrite(oldLine);
+        std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+        oldMax = (took.count() > oldMax) ? took.count() : oldMax;
+
+        fakeCore = 1;
+        benchKeep(oldPop(out, sizeof(out)));
+    };
+    auto newFn = [&]()
+    {
+        fakeCore = 0;
+        auto start = std::chrono::steady_clock::now();
+        DBG_WRITE(l, line);
+        std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+        newMax = (took.count() > newMax) ? took.count() : newMax;
+
+        fakeCore = 1;
+        l->drain();
+        from += l->read(from, out, sizeof(out));
+    };
+
+    // the first line sets up the singletons it uses
+    oldFn();
+    newFn();
+    oldMax = newMax = 0;
+
+    bench_allocs_t oldA = benchAllocsOf(oldFn);
+    bench_allocs_t newA = benchAllocsOf(newFn);
+    CHECK_EQ(newA.count, 0u);
+    double oldNs = benchNs(CALLS, oldFn);
+    double newNs = benchNs(CALLS, newFn);
+
+    logger_stats_t s;
+    l->getStats(0, s);
+    CHECK_EQ(s.dropped, 0u);
+    fakeCore = 0;
+
+    std::printf("  a %d character line, written on core 0 and read on core 1\n", (int)std::strlen(line));
+    std::printf("    old %9.0f lines/s %7.1f ns %6.0f cycles, %llu allocs, longest write %7.1f ns\n",
+            1e9 / oldNs, oldNs, benchCycles(oldNs), (unsigned long long)oldA.count, oldMax);
+    std::printf("    new %9.0f lines/s %7.1f ns %6.0f cycles, %llu allocs, longest write %7.1f ns\n",
+            1e9 / newNs, newNs, benchCycles(newNs), (unsigned long long)newA.count, newMax);
+}
+
+/*******************************************************
+ * contended
+ *******************************************************
+ * both cores writing as fast as they can, each on a
+ * thread of its own, core 1 reading out after each of
+ * its lines.  The old one counts the times a core had
+ * to wait for the mutex and the longest wait; the new
+ * one has nothing to wait on, and a ring that's full
+ * drops the line instead.  With one CPU the threads
+ * only meet when one is switched out
+ ******************************************************/
+TEST(contended)
+{
+    logger* l = startBoth();
+    const std::string oldLine = line;
+
+    auto run = [&](auto write, auto readOut)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::thread core1([&]()
+        {
+            fakeCore = 1;
+            for (uint32_t ii = 0; ii < CONTENDED_LINES; ++ii)
+            {
+                write();
+                readOut();
+            }
+        });
+
+        fakeCore = 0;
+        for (uint32_t ii = 0; ii < CONTENDED_LINES; ++ii)
+        {
+            write();
+        }
+        core1.join();
+
+        std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+        return (took.count());
+    };
+
+    char out[LOGGER_BUFFER_SIZE];
+    double oldNs = run([&]() { oldDbgWrite(oldLine); }, [&]() { benchKeep(oldPop(out, sizeof(out))); });
+
+    uint32_t from = l->nextSeq();
+    double newNs = run([&]() { DBG_WRITE(l, line); }, [&]() { l->drain(); from += l->read(from, out, sizeof(out)); });
+
+    logger_stats_t s0;
+    logger_stats_t s1;
+    l->getStats(0, s0);
+    l->getStats(1, s1);
+    CHECK_EQ(s0.text.lines + s0.dropped, (uint32_t)CONTENDED_LINES);
+    CHECK_EQ(s1.text.lines + s1.dropped, (uint32_t)CONTENDED_LINES);
+
+    std::printf("  %d lines from each core at once\n", CONTENDED_LINES);
+    std::printf("    old %9.0f lines/s, %llu waits for the mutex, longest %.0f ns\n",
+            (2e9 * CONTENDED_LINES) / oldNs, (unsigned long long)oldWaits.load(), (double)oldWaitMaxNs.load());
+    std::printf("    new %9.0f lines/s kept, no lock to wait on, %u lines dropped with a ring full\n",
+            (1e9 * (s0.text.lines + s1.text.lines)) / newNs, s0.dropped + s1.dropped);
+}
@@ -0,0 +1,485 @@
+/********************************************************
+ * logger_test.cpp
+ ********************************************************
+ * The logger: a ring per core, drained into the log in
+ * time order.  The cores take turns on one thread by
+ * setting fakeCore, and time only moves when a test
+ * moves it.  The RTC isn't set, so the time in each
+ * prefix is uptime
+ *
+ *******************************************************/
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "check.h"
+#include "host/fake.h"
+#include "ipc/mlogger.h"
+
+// the argument counting is all at compile time
+static_assert(logFmtArgs("") == 0, "");
+static_assert(logFmtArgs("100%% sure\n") == 0, "");
+static_assert(logFmtArgs("%s::brightness %d%%\n") == 2, "");
+static_assert(logFmtArgs("%%%d%%") == 1, "");
+static_assert(logFmtArgs(logFormats[LF_PUMP_ON]) == 2, "");
+static_assert(logFmtArgs(logFormats[LF_NVM_DONE]) == 1, "");
+
+/*******************************************************
+ * startLog()
+ *******************************************************
+ * fresh hardware, an empty log
+ ******************************************************/
+static logger* startLog()
+{
+    fakeHardwareReset();
+
+    logger* l = logger::getInstance();
+    l->initBuffer();
+
+    return (l);
+}
+
+/*******************************************************
+ * logLines()
+ *******************************************************
+ * the log from 'from' on, a line at a time, and from
+ * moved past it
+ ******************************************************/
+static std::vector<std::string> logLines(logger* l, uint32_t& from)
+{
+    char text[LOGGER_BUFFER_SIZE];
+    size_t len = l->read(from, text, sizeof(text));
+    from += len;
+
+    std::vector<std::string> lines;
+    size_t start = 0;
+    for (size_t ii = 0; ii < len; ++ii)
+    {
+        if (text[ii] == '\n')
+        {
+            lines.push_back(std::string(text + start, ii + 1 - start));
+            start = ii + 1;
+        }
+    }
+    if (start < len)
+    {
+        lines.push_back(std::string(text + start, len - start));
+    }
+
+    return (lines);
+}
+
+/*******************************************************
+ * at()
+ *******************************************************
+ * a line written from a core at a time, both of which
+ * stay that way
+ ******************************************************/
+static void at(logger* l, uint core, uint64_t us, const char* text)
+{
+    fakeCore = core;
+    fakeTimeUs = us;
+    l->dbgWrite(text);
+}
+
+/*******************************************************
+ * mergedInOrder
+ *******************************************************
+ * lines from both cores come out oldest first however
+ * they were drained, each with its core and the time
+ * it was written, not the time it was drained
+ ******************************************************/
+TEST(mergedInOrder)
+{
+    logger* l = startLog();
+
+    at(l, 0, 1000010, "zero a\n");
+    at(l, 1, 1000020, "one a\n");
+    at(l, 1, 1000040, "one b\n");
+    at(l, 0, 1000030, "zero b\n");
+    at(l, 0, 2500000, "zero c\n");
+
+    fakeCore = 1;
+    fakeTimeUs = 9000000;
+    uint32_t from = 0;
+    std::vector<std::string> lines = logLines(l, from);
+
+    CHECK_EQ(lines.size(), 5u);
+    if (lines.size() == 5)
+    {
+        CHECK_EQ(lines[0], "[D0] up 1.000010,zero a\n");
+        CHECK_EQ(lines[1], "[D1] up 1.000020,one a\n");
+        CHECK_EQ(lines[2], "[D0] up 1.000030,zero b\n");
+        CHECK_EQ(lines[3], "[D1] up 1.000040,one b\n");
+        CHECK_EQ(lines[4], "[D0] up 2.500000,zero c\n");
+    }
+
+    // and a plain write() has no prefix at all
+    fakeCore = 0;
+    l->write("bare\n");
+    fakeCore = 1;
+    lines = logLines(l, from);
+    CHECK_EQ(lines.size(), 1u);
+    CHECK(lines.size() == 1 && lines[0] == "bare\n");
+    fakeCore = 0;
+}
+
+/*******************************************************
+ * longLineCut
+ *******************************************************
+ * a line over LOGGER_MAX_LINE keeps what fits, ends
+ * with LOGGER_CUT so it shows, and gets counted
+ ******************************************************/
+TEST(longLineCut)
+{
+    logger* l = startLog();
+    const std::string markText = LOGGER_CUT;
+
+    std::string longLine(LOGGER_MAX_LINE + 40, 'x');
+    longLine += "\n";
+    std::string fits(LOGGER_MAX_LINE - 1, 'y');
+    fits += "\n";
+
+    fakeCore = 0;
+    CHECK_EQ(l->write(longLine), (size_t)LOGGER_MAX_LINE);
+    CHECK_EQ(l->write(fits), (size_t)LOGGER_MAX_LINE);
+
+    logger_stats_t s;
+    l->getStats(0, s);
+    CHECK_EQ(s.cut, 1u);
+
+    fakeCore = 1;
+    uint32_t from = 0;
+    std::vector<std::string> lines = logLines(l, from);
+    CHECK_EQ(lines.size(), 2u);
+    if (lines.size() == 2)
+    {
+        CHECK_EQ(lines[0], std::string(LOGGER_MAX_LINE - markText.length(), 'x') + markText);
+        CHECK_EQ(lines[1], fits);
+    }
+    fakeCore = 0;
+}
+
+/*******************************************************
+ * ringFull
+ *******************************************************
+ * a core that gets ahead of the drain loses the lines
+ * that don't fit, counted, and never waits; the lines
+ * that did fit are all there, and once drained there's
+ * room again, across the ring's wrap
+ ******************************************************/
+TEST(ringFull)
+{
+    logger* l = startLog();
+    std::string line(100, 'r');
+    line += "\n";
+
+    fakeCore = 0;
+    uint32_t wrote = 0;
+    for (uint32_t ii = 0; ii < 20; ++ii)
+    {
+        wrote += (l->write(line) != 0);
+    }
+
+    logger_stats_t s;
+    l->getStats(0, s);
+    CHECK(wrote > 0);
+    CHECK(wrote < 20);
+    CHECK_EQ(s.dropped, 20 - wrote);
+    CHECK_EQ(s.text.lines, wrote);
+
+    // core 1's own ring didn't fill
+    logger_stats_t s1;
+    l->getStats(1, s1);
+    CHECK_EQ(s1.dropped, 0u);
+
+    fakeCore = 1;
+    uint32_t from = 0;
+    CHECK_EQ(logLines(l, from).size(), wrote);
+
+    // round and round the ring
+    fakeCore = 0;
+    for (uint32_t ii = 0; ii < 50; ++ii)
+    {
+        CHECK(l->write(line) != 0);
+        fakeCore = 1;
+        std::vector<std::string> lines = logLines(l, from);
+        CHECK(lines.size() == 1 && lines[0] == line);
+        fakeCore = 0;
+    }
+}
+
+// every line the sink was handed
+static std::string sunk;
+
+/*******************************************************
+ * sinkAll()
+ *******************************************************
+ * a sink that keeps it all
+ ******************************************************/
+static void sinkAll(const char* c, size_t len, void* ctx)
+{
+    sunk.append(c, len);
+    ++*(uint32_t*)ctx;
+}
+
+/*******************************************************
+ * sinkGetsLines
+ *******************************************************
+ * the sink gets each line whole, prefix and all, the
+ * same as goes in the log
+ ******************************************************/
+TEST(sinkGetsLines)
+{
+    logger* l = startLog();
+    uint32_t calls = 0;
+    sunk.clear();
+    l->setSink(sinkAll, &calls);
+
+    at(l, 0, 5, "to the sink\n");
+    at(l, 1, 7, "and again\n");
+
+    uint32_t from = 0;
+    std::vector<std::string> lines = logLines(l, from);
+    CHECK_EQ(calls, 2u);
+    CHECK_EQ(sunk, "[D0] up 0.000005,to the sink\n[D1] up 0.000007,and again\n");
+
+    l->setSink(NULL, NULL);
+    fakeCore = 0;
+}
+
+/*******************************************************
+ * bodyOf()
+ *******************************************************
+ * a line without its [D0] time, prefix
+ ******************************************************/
+static std::string bodyOf(const std::string& line)
+{
+    size_t comma = line.find(',');
+    return ((line[0] == '[' && comma != std::string::npos) ? line.substr(comma + 1) : line);
+}
+
+/*******************************************************
+ * binaryLines
+ *******************************************************
+ * a binary record comes out as the same text the
+ * format would have made: each argument as the type
+ * it was stored as, length modifiers and all, %%, and
+ * %T as degrees
+ ******************************************************/
+TEST(binaryLines)
+{
+    logger* l = startLog();
+    fakeCore = 0;
+
+    CHECK(l->dbgFmt<LF_PUMP_ON>(3850, 3600) > 0);
+    l->infoFmt<LF_REEFER_STATUS>(-155, "cooling");
+    l->warnFmt<LF_BRIGHTNESS>("hub75", 75);
+    l->errFmt<LF_NVM_GAVE_UP>(-3);
+    l->dbgFmt<LF_NVM_DONE>(123456789L);
+    l->dbgFmt<LF_NVM_ENTER>(__FUNCTION__);
+    l->dbgFmt<LF_REEFER_READY>();
+    l->dbgFmt<LF_PUMP_RUNTIME>(86400u);
+
+    logger_stats_t s;
+    l->getStats(0, s);
+    CHECK_EQ(s.fmt.lines, 8u);
+    CHECK_EQ(s.text.lines, 0u);
+
+    fakeCore = 1;
+    uint32_t from = 0;
+    std::vector<std::string> lines = logLines(l, from);
+    CHECK_EQ(lines.size(), 8u);
+    if (lines.size() == 8)
+    {
+        CHECK_EQ(lines[0].substr(0, 5), "[D0] ");
+        CHECK_EQ(bodyOf(lines[0]), "Pump on 38.5/36.0\n");
+        CHECK_EQ(lines[1].substr(0, 5), "[+0] ");
+        CHECK_EQ(bodyOf(lines[1]), "-1.6,cooling\n");
+        CHECK_EQ(lines[2].substr(0, 5), "[W0] ");
+        CHECK_EQ(bodyOf(lines[2]), "hub75::brightness 75%\n");
+        CHECK_EQ(bodyOf(lines[3]), "NVM::gave up writing after -3 tries\n");
+        CHECK_EQ(bodyOf(lines[4]), "Done writing bytes to Flash in 123456789 us\n");
+        CHECK_EQ(bodyOf(lines[5]), "nvm::binaryLines() - entering\n");
+        CHECK_EQ(bodyOf(lines[6]), "reefer leaving init state\n");
+        CHECK_EQ(bodyOf(lines[7]), "Accumulated pump runtime now 86400 seconds\n");
+    }
+    fakeCore = 0;
+}
+
+/*******************************************************
+ * recordSize
+ *******************************************************
+ * a record only stores the arguments it has, packed:
+ * 32 bits, 64 for a long long, a string's length and
+ * text.  That's all it takes of the ring past the line
+ * header
+ ******************************************************/
+TEST(recordSize)
+{
+    log_fmt_rec_t r;
+    r.count = r.used = 0;
+    logArgs(r, 1, "two", 3.0f, 4ll);
+    CHECK_EQ(r.count, 4);
+    CHECK_EQ(r.tags[0], LA_INT);
+    CHECK_EQ(r.tags[1], LA_STR);
+    CHECK_EQ(r.tags[2], LA_FLOAT);
+    CHECK_EQ(r.tags[3], LA_INT64);
+    CHECK_EQ(logRecSize(r), offsetof(log_fmt_rec_t, data) + 4 + (1 + 3) + 4 + 8);
+
+    // the most there can be still fits
+    std::string big(LOG_STR_MAX * 2, 's');
+    r.count = r.used = 0;
+    logArgs(r, big.c_str(), big.c_str(), big.c_str(), big.c_str(),
+            big.c_str(), big.c_str(), big.c_str(), big.c_str());
+    CHECK_EQ(logRecSize(r), sizeof(log_fmt_rec_t));
+
+    r.count = r.used = 0;
+    logArgs(r, 3850, 3600);
+
+    // an empty text line is just the header
+    logger* l = startLog();
+    fakeCore = 0;
+    l->dbgFmt<LF_PUMP_ON>(3850, 3600);
+    l->dbgWrite("");
+
+    logger_stats_t s;
+    l->getStats(0, s);
+    CHECK_EQ(s.fmt.bytes - s.text.bytes, (uint32_t)logRecSize(r));
+}
+
+/*******************************************************
+ * copiedArgs
+ *******************************************************
+ * a string's text goes into the record, so one that's
+ * gone by the time core 1 drains still comes out, cut
+ * to LOG_STR_MAX; and a 64 bit number comes out whole
+ ******************************************************/
+TEST(copiedArgs)
+{
+    logger* l = startLog();
+    fakeCore = 0;
+
+    {
+        char name[32];
+        std::strcpy(name, "stack");
+        std::string state = "string";
+        l->dbgFmt<LF_REEFER_STATE>(name, state.c_str());
+        std::memset(name, 'x', sizeof(name) - 1);
+        state = "something else altogether, and long";
+    }
+    std::string longName(40, 'n');
+    l->dbgFmt<LF_NVM_ENTER>(longName.c_str());
+    l->dbgFmt<LF_NVM_DONE>(5000000123LL);
+    l->dbgFmt<LF_NVM_ENTER>((const char*)NULL);
+
+    fakeCore = 1;
+    uint32_t from = 0;
+    std::vector<std::string> lines = logLines(l, from);
+    CHECK_EQ(lines.size(), 4u);
+    if (lines.size() == 4)
+    {
+        CHECK_EQ(bodyOf(lines[0]), "Reefer state from stack to string\n");
+        CHECK_EQ(bodyOf(lines[1]), "nvm::" + std::string(LOG_STR_MAX, 'n') + "() - entering\n");
+        CHECK_EQ(bodyOf(lines[2]), "Done writing bytes to Flash in 5000000123 us\n");
+        CHECK_EQ(bodyOf(lines[3]), "nvm::(null)() - entering\n");
+    }
+    fakeCore = 0;
+}
+
+/*******************************************************
+ * readBySeq
+ *******************************************************
+ * reading takes nothing out, so two readers can each
+ * go at their own pace, a bit at a time
+ ******************************************************/
+TEST(readBySeq)
+{
+    logger* l = startLog();
+    fakeCore = 0;
+    l->write("0123456789");
+    l->write("abcdef\n");
+
+    fakeCore = 1;
+    char text[8];
+    uint32_t a = 0;
+    uint32_t b = 0;
+
+    CHECK_EQ(l->read(a, text, 4), 4u);
+    CHECK_EQ(std::string(text, 4), "0123");
+    CHECK_EQ(a, 0u);
+    a += 4;
+
+    CHECK_EQ(l->read(b, text, 8), 8u);
+    CHECK_EQ(std::string(text, 8), "01234567");
+    b += 8;
+
+    CHECK_EQ(l->read(a, text, 8), 8u);
+    CHECK_EQ(std::string(text, 8), "456789ab");
+    a += 8;
+    CHECK_EQ(l->read(a, text, 8), 5u);
+    CHECK_EQ(std::string(text, 5), "cdef\n");
+    a += 5;
+    CHECK_EQ(l->read(a, text, 8), 0u);
+
+    CHECK_EQ(l->read(b, text, 8), 8u);
+    CHECK_EQ(std::string(text, 8), "89abcdef");
+
+    CHECK_EQ(l->firstSeq(), 0u);
+    CHECK_EQ(l->nextSeq(), 17u);
+    fakeCore = 0;
+}
+
+/*******************************************************
+ * readOverwritten
+ *******************************************************
+ * once newer text has overwritten where a reader was,
+ * it moves on to the oldest that's still there.  So
+ * does a reader from before a reboot, whose number
+ * is past anything this log has got to
+ ******************************************************/
+TEST(readOverwritten)
+{
+    logger* l = startLog();
+    std::string line(99, 'a');
+    line += "\n";
+
+    // five times what the log holds, a line per letter
+    uint32_t lines = (LOGGER_BUFFER_SIZE * 5) / line.length();
+    for (uint32_t ii = 0; ii < lines; ++ii)
+    {
+        line.assign(99, 'a' + (ii % 26));
+        line += "\n";
+        fakeCore = 0;
+        l->write(line);
+        fakeCore = 1;
+        l->drain();
+    }
+
+    uint32_t total = lines * line.length();
+    CHECK_EQ(l->nextSeq(), total);
+    CHECK_EQ(l->firstSeq(), total - (LOGGER_BUFFER_SIZE - 1));
+
+    // from the start of time: moved to the oldest, which
+    // is the tail end of some line
+    char text[LOGGER_BUFFER_SIZE];
+    uint32_t from = 0;
+    size_t len = l->read(from, text, sizeof(text));
+    CHECK_EQ(from, l->firstSeq());
+    CHECK_EQ(len, (size_t)(LOGGER_BUFFER_SIZE - 1));
+
+    // the last line is all there, in its letter
+    std::string last(text + len - line.length(), line.length());
+    CHECK_EQ(last, line);
+
+    // a number from the last boot, past this one's
+    uint32_t old = total + 5000;
+    CHECK_EQ(l->read(old, text, 10), 10u);
+    CHECK_EQ(old, l->firstSeq());
+
+    // and one that's just where it's got to reads nothing
+    uint32_t now = l->nextSeq();
+    CHECK_EQ(l->read(now, text, 10), 0u);
+    CHECK_EQ(now, total);
+    fakeCore = 0;
+}
@@ -0,0 +1,143 @@
+/********************************************************
+ * oldShared.h
+ ********************************************************
+ * updateSharedData() as it was before the seqlock and
+ * the telemetry bus, for the benchmarks to race: one
+ * struct with strings and a vector of access points,
+ * changed fields copied in and the whole lot copied
+ * back out, under a mutex.  The SDK's mutex is a
+ * spinlock around an owner, so that's what it gets
+ *
+ *******************************************************/
+#ifndef OLD_SHARED_H_
+#define OLD_SHARED_H_
+
+#include <string>
+#include <vector>
+
+#include "hardware/sync.h"
+#include "ipc/ipc.h"
+
+#define OLD_US_NONE         (uint16_t)0x0000
+#define OLD_US_SCAN_DATA    (uint16_t)0x0020
+#define OLD_US_NEW_TMP_DATA (uint16_t)0x0040
+#define OLD_US_BRIGHTNESS   (uint16_t)0x0200
+
+struct old_ap_data_t
+{
+    std::string bssid;
+    uint32_t    strength;
+    uint8_t     channel;
+    std::string encryption;
+    std::string ssid;
+};
+
+struct old_scan_data_t
+{
+    uint16_t                    count;
+    std::vector<old_ap_data_t>  apData;
+};
+
+struct old_inter_core_t
+{
+    bool                core1Ready;
+    bool                wifiConnected;
+    bool                clockReady;
+    uint32_t            tempCount;
+    float               temperatue;
+    std::string         ipAddress;
+    std::string         macAddress;
+    old_scan_data_t     scanResult;
+    inter_core_cmd_t    cmd;
+    inter_core_cmd_t    ack;
+    uint32_t            brightCount;
+    uint8_t             brightness;
+    const scan_view_t*  scanView;
+};
+
+inline old_inter_core_t oldData;
+inline spin_lock_t* oldSpin;
+inline volatile int oldOwner = -1;
+
+inline void oldSharedInit()
+{
+    oldSpin = spin_lock_instance(spin_lock_claim_unused(true));
+    oldOwner = -1;
+}
+
+inline void oldMutexEnter()
+{
+    while (true)
+    {
+        uint32_t save = spin_lock_blocking(oldSpin);
+        if (oldOwner < 0)
+        {
+            oldOwner = (int)get_core_num();
+            spin_unlock(oldSpin, save);
+            return;
+        }
+        spin_unlock(oldSpin, save);
+    }
+}
+
+inline void oldMutexExit()
+{
+    uint32_t save = spin_lock_blocking(oldSpin);
+    oldOwner = -1;
+    spin_unlock(oldSpin, save);
+}
+
+// what core 1 would have put up: the addresses, and
+// aps access points from a scan
+inline void oldSharedFill(old_inter_core_t& d, uint8_t aps)
+{
+    d.ipAddress = "192.168.100.120";
+    d.macAddress = "a4:cf:12:9a:33:0e";
+    d.scanResult.count = aps;
+    d.scanResult.apData.assign(aps, { "a4:cf:12:9a:33:0e", 60, 6, "WPA2", "brewery-network-5G" });
+}
+
+// the source by value, as it was
+inline void oldCopyIPC(const old_inter_core_t src, old_inter_core_t& dst)
+{
+    dst.core1Ready      = src.core1Ready;
+    dst.wifiConnected   = src.wifiConnected;
+    dst.clockReady      = src.clockReady;
+    dst.temperatue      = src.temperatue;
+    dst.tempCount       = src.tempCount;
+    dst.ipAddress       = src.ipAddress;
+    dst.macAddress      = src.macAddress;
+    dst.scanResult      = src.scanResult;
+    dst.cmd             = src.cmd;
+    dst.ack             = src.ack;
+    dst.brightCount     = src.brightCount;
+    dst.brightness      = src.brightness;
+    dst.scanView        = src.scanView;
+}
+
+// the changed fields in, then everything out; only the
+// fields the benchmarks change
+inline bool oldUpdateSharedData(uint16_t t, old_inter_core_t& d)
+{
+    oldMutexEnter();
+
+    if (t & OLD_US_SCAN_DATA)       oldData.scanResult = d.scanResult;
+    if (t & OLD_US_NEW_TMP_DATA)
+    {
+        oldData.temperatue = d.temperatue;
+        oldData.tempCount = d.tempCount;
+    }
+    if (t & OLD_US_BRIGHTNESS)
+    {
+        oldData.brightness = d.brightness;
+        oldData.brightCount = d.brightCount;
+    }
+
+    oldCopyIPC(oldData, d);
+
+    oldMutexExit();
+
+    return (true);
+}
+
+#endif // OLD_SHARED_H_
@@ -0,0 +1,172 @@
+/********************************************************
+ * spsc_test.cpp
+ ********************************************************
+ * The single producer, single consumer queue, one
+ * thread at a time and then with a thread on each end
+ *
+ *******************************************************/
+#include <thread>
+
+#include "check.h"
+#include "host/fake.h"
+#include "ipc/spsc.h"
+
+#define STREAM_ITEMS        500000
+
+// a bit more than a word, so a copy can be half done
+struct item_t
+{
+    uint32_t n;
+    uint32_t check;             // ~n
+};
+
+static spscQueue<item_t, 8> q;
+static bool seenEmpty;
+static bool seenFull;
+
+/*******************************************************
+ * fillOrder
+ *******************************************************
+ * holds one less than its size, gives them back in
+ * the order they went in, and keeps doing it as the
+ * indexes wrap
+ ******************************************************/
+TEST(fillOrder)
+{
+    spscQueue<uint32_t, 4> small;
+    uint32_t v = 0;
+
+    CHECK_EQ(small.count(), 0);
+    CHECK(!small.pop(v));
+
+    uint32_t in = 0;
+    uint32_t out = 0;
+    for (uint32_t round = 0; round < 10; ++round)
+    {
+        while (small.push(in))
+        {
+            ++in;
+        }
+        CHECK(small.isFull());
+        CHECK_EQ(small.count(), 3);
+
+        // take a different number out each time so
+        // the indexes end up all over
+        for (uint32_t ii = 0; ii <= round % 3; ++ii)
+        {
+            CHECK(small.pop(v));
+            CHECK_EQ(v, out);
+            ++out;
+        }
+        CHECK(!small.isFull());
+    }
+
+    while (small.pop(v))
+    {
+        CHECK_EQ(v, out);
+        ++out;
+    }
+    CHECK_EQ(out, in);
+    CHECK_EQ(small.count(), 0);
+}
+
+/*******************************************************
+ * popDuringPush()
+ *******************************************************
+ * the consumer, run from the barrier between the slot
+ * and head in push()
+ ******************************************************/
+static void popDuringPush()
+{
+    item_t i;
+    seenEmpty = !q.pop(i);
+}
+
+/*******************************************************
+ * pushDuringPop()
+ *******************************************************
+ * the producer, run from the barrier between copying
+ * the slot out and moving tail in pop()
+ ******************************************************/
+static void pushDuringPop()
+{
+    item_t i = { 99, ~99u };
+    seenFull = !q.push(i);
+}
+
+/*******************************************************
+ * halfDone
+ *******************************************************
+ * the other side can't see a push until the slot's
+ * there, and can't reuse a slot until it's been
+ * copied out
+ ******************************************************/
+TEST(halfDone)
+{
+    item_t i = { 1, ~1u };
+
+    fakeBarrierHook = popDuringPush;
+    fakeBarrierSkip = 0;
+    CHECK(q.push(i));
+    CHECK(seenEmpty);
+    CHECK_EQ(q.count(), 1);
+
+    while (q.push(i))
+    {
+    }
+
+    // pop() has a barrier before the copy and one after
+    fakeBarrierHook = pushDuringPop;
+    fakeBarrierSkip = 1;
+    CHECK(q.pop(i));
+    CHECK(seenFull);
+    CHECK_EQ(q.count(), 6);
+
+    while (q.pop(i))
+    {
+    }
+}
+
+/*******************************************************
+ * stream
+ *******************************************************
+ * a thread on each end, flat out.  Everything comes
+ * out once, whole, in order
+ ******************************************************/
+TEST(stream)
+{
+    std::thread producer([]()
+    {
+        fakeCore = 0;
+        for (uint32_t n = 0; n < STREAM_ITEMS; ++n)
+        {
+            item_t i = { n, ~n };
+            while (!q.push(i))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    fakeCore = 1;
+    uint32_t next = 0;
+    uint32_t bad = 0;
+    while (next < STREAM_ITEMS)
+    {
+        item_t i;
+        if (!q.pop(i))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        bad += (i.n != next || i.check != ~next);
+        ++next;
+    }
+    producer.join();
+    fakeCore = 0;
+
+    item_t i;
+    CHECK(!q.pop(i));
+    CHECK_EQ(bad, 0u);
+}
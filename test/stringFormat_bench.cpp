@@ -0,0 +1,112 @@
+/********************************************************
+ * stringFormat_bench.cpp
+ ********************************************************
+ * FMT() against the stringFormat() it replaced: ns per
+ * call and what each call allocates, on a few formats
+ * like the ones the code uses
+ *
+ *******************************************************/
+#include <cstdio>
+#include <cstdarg>
+#include <string>
+
+#include "check.h"
+#include "bench.h"
+#include "utils/stringFormat.h"
+
+#define CALLS               20000
+
+/*******************************************************
+ * oldStringFormat()
+ *******************************************************
+ * stringFormat() as it was before FMT(), minus the
+ * comments: vsnprintf() into a 1K std::string, bigger
+ * and again if that wasn't enough
+ ******************************************************/
+static std::string oldStringFormat(const std::string& fmt, ...)
+{
+    int size = 1024;
+    std::string str;
+    va_list ap;
+    size_t retries = 0;
+
+    while (true)
+    {
+        str.resize(size);
+        va_start(ap, fmt);
+        ssize_t n = vsnprintf((char *)str.data(), size, fmt.c_str(), ap);
+        va_end(ap);
+
+        if (n > -1 && n < size)
+        {
+            str.resize(n);
+            return (str);
+        }
+
+        if (n > -1)
+        {
+            size = n + 1;
+        }
+        else
+        {
+            if (++retries < 5)
+            {
+                size *= 2;
+            }
+            else
+            {
+                return std::string("");
+            }
+        }
+    }
+    return (str);
+}
+
+/*******************************************************
+ * show()
+ *******************************************************
+ * one line of results, old then new
+ ******************************************************/
+static void show(const char* what, double oldNs, bench_allocs_t oldA, double newNs, bench_allocs_t newA)
+{
+    std::printf("  %-22s old %7.1f ns, %llu allocs %5llu bytes   new %7.1f ns, %llu allocs %5llu bytes\n",
+            what, oldNs, (unsigned long long)oldA.count, (unsigned long long)oldA.bytes,
+            newNs, (unsigned long long)newA.count, (unsigned long long)newA.bytes);
+}
+
+/*******************************************************
+ * BENCH_FMT()
+ *******************************************************
+ * time both on the same format and arguments, after
+ * checking they give the same text.  FMT() must never
+ * allocate
+ ******************************************************/
+#define BENCH_FMT(what, f, ...)                                                 \
+    do                                                                          \
+    {                                                                           \
+        checkContext(what);                                                     \
+        CHECK_EQ(oldStringFormat(f, ##__VA_ARGS__), std::string(FMT(f, ##__VA_ARGS__)));  \
+        auto oldFn = [&]() { std::string s = oldStringFormat(f, ##__VA_ARGS__); benchKeep(s); };   \
+        auto newFn = [&]() { auto t = FMT(f, ##__VA_ARGS__); benchKeep(t); };   \
+        bench_allocs_t newA = benchAllocsOf(newFn);                             \
+        CHECK_EQ(newA.count, 0u);                                               \
+        show(what, benchNs(CALLS, oldFn), benchAllocsOf(oldFn), benchNs(CALLS, newFn), newA);  \
+    } while (0)
+
+/*******************************************************
+ * formats
+ *******************************************************
+ * a log line, a register, two temperatures and a line
+ * with a long string in it
+ ******************************************************/
+TEST(formats)
+{
+    const std::string name = "reefer";
+    const std::string longText(120, 'x');
+
+    BENCH_FMT("log line", "%s::pump %s, %d\n", name.c_str(), "on", 42);
+    BENCH_FMT("0x%04x", "0x%04x", 0xbeefu);
+    BENCH_FMT("two %.1f", "%.1f F, %.1f F\n", 38.55, 40.25);
+    BENCH_FMT("120 char %s", "text: %s\n", longText.c_str());
+    checkContext("");
+}
@@ -0,0 +1,330 @@
+/********************************************************
+ * stringFormat_test.cpp
+ ********************************************************
+ * FMT() and FMT_INTO().  What gets past the compile
+ * time check, then the text against what snprintf()
+ * makes of the same format, and cutting off to fit
+ *
+ *******************************************************/
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <string>
+#include <string_view>
+
+#include "check.h"
+#include "utils/stringFormat.h"
+
+enum fmt_test_t { FT_ZERO, FT_ONE, FT_TWO };
+
+// the check is a constant, so it can be tested when
+// this compiles
+static_assert(FMT_OK("no conversions"), "plain text");
+static_assert(FMT_OK("100%%"), "%% takes nothing");
+static_assert(!FMT_OK("100%%", 1), "one too many");
+static_assert(!FMT_OK("%d %d", 1), "one too few");
+static_assert(FMT_OK("%d %u %x %c", 1, 2u, -3, 'c'), "integers print with any of them");
+static_assert(FMT_OK("%lu %lld %hhx", 1ul, 2ll, (uint8_t)3), "length modifiers are ignored");
+static_assert(FMT_OK("%d", FT_TWO), "an enum is an integer");
+static_assert(!FMT_OK("%d", 1.5), "not a double");
+static_assert(!FMT_OK("%f", 1), "not an integer");
+static_assert(FMT_OK("%8.3f %e", 1.5, 2.5f), "floats");
+static_assert(FMT_OK("%s %s %s", "c", std::string(), std::string_view()), "anything string like");
+static_assert(!FMT_OK("%s", 'c'), "not a char");
+static_assert(!FMT_OK("%s", 1), "not an integer");
+static_assert(FMT_OK("%p %p", (const void*)0, "c"), "pointers");
+static_assert(!FMT_OK("%*d", 8, 1), "no * widths");
+static_assert(!FMT_OK("%n", (int*)0), "no %n");
+
+/*******************************************************
+ * LIKE_PRINTF()
+ *******************************************************
+ * FMT()'s text has to be what snprintf() gives
+ ******************************************************/
+#define LIKE_PRINTF(f, ...)                                     \
+    do                                                          \
+    {                                                           \
+        char want[FMT_TEXT_SIZE];                               \
+        snprintf(want, sizeof(want), f, ##__VA_ARGS__);         \
+        checkContext(f);                                        \
+        CHECK_EQ(std::string(FMT(f, ##__VA_ARGS__)), std::string(want));   \
+    } while (0)
+
+/*******************************************************
+ * integers
+ *******************************************************
+ * flags, widths and precision, and the 32 bit
+ * wrap-around printf() has for anything narrower
+ * than 64 bits.  A 0 flag with a precision gets a
+ * warning from the compiler here, so that one's left
+ * to fuzz
+ ******************************************************/
+TEST(integers)
+{
+    LIKE_PRINTF("%d|%i|%u", -42, 42, 42u);
+    LIKE_PRINTF("[%5d][%-5d][%05d][%+d][% d]", -7, -7, -7, 7, 7);
+    LIKE_PRINTF("[%.3d][%8.3d][%.0d][%5.0d]", 7, -7, 0, 0);
+    LIKE_PRINTF("%x %X %o", 0xbeefu, 0xbeefu, 8u);
+    LIKE_PRINTF("%#x %#X %#o %#o %#x", 255u, 255u, 8u, 0u, 0u);
+    LIKE_PRINTF("%08x|%-8x|%#010x", 0x1234u, 0x1234u, 0x1234u);
+    LIKE_PRINTF("%x %u", -1, -1);
+    LIKE_PRINTF("%d", 0xffffffffu);
+    LIKE_PRINTF("%lld %llu %llx", LLONG_MIN, ULLONG_MAX, 0x123456789abcdefull);
+    LIKE_PRINTF("%d %d", INT_MIN, INT_MAX);
+    LIKE_PRINTF("%hhu %hd %ld", (unsigned char)200, (short)-3, 100000l);
+    LIKE_PRINTF("[%c][%3c][%-3c]", 'a', 'b', 'c');
+    LIKE_PRINTF("%d%%", 50);
+
+    CHECK_EQ(std::string(FMT("%d %d", FT_ONE, true)), "1 1");
+}
+
+/*******************************************************
+ * strings
+ *******************************************************
+ * all three kinds, cut by precision and padded by
+ * width; a view doesn't need its null, and a null
+ * pointer is (null)
+ ******************************************************/
+TEST(strings)
+{
+    std::string s = "pilsner";
+    std::string_view v = std::string_view(s).substr(1, 3);
+    const char* none = NULL;
+
+    LIKE_PRINTF("[%s][%8s][%-8s][%.3s][%6.2s]", "lager", "lager", "lager", "lager", "lager");
+    CHECK_EQ(std::string(FMT("%s|%s", s, v)), "pilsner|ils");
+    CHECK_EQ(std::string(FMT("[%5s]", v)), "[  ils]");
+    CHECK_EQ(std::string(FMT("%s", none)), "(null)");
+    CHECK_EQ(std::string(FMT("%s", "")), "");
+
+    // FMT()'s text goes where a string or a view does
+    auto t = FMT("%s %d", "batch", 12);
+    std::string_view tv = t;
+    std::string ts = t;
+    CHECK_EQ(t.length(), 8u);
+    CHECK_EQ(std::string(t.c_str()), "batch 12");
+    CHECK(tv == "batch 12");
+    CHECK_EQ(ts, "batch 12");
+}
+
+/*******************************************************
+ * floatsAndPointers
+ *******************************************************
+ * these go to snprintf(), so they're the same by
+ * definition, but the length modifiers come out
+ * first and the text lands in the right place
+ ******************************************************/
+TEST(floatsAndPointers)
+{
+    int x = 0;
+
+    LIKE_PRINTF("%.2f|%8.3f|%-8.1f|%e|%g", 3.14159, -2.5, 1.25, 12345.678, 0.0001);
+    LIKE_PRINTF("%.1f F", 38.55f);
+    LIKE_PRINTF("at %p", (const void*)&x);
+    CHECK_EQ(std::string(FMT("%.2Lf", 1.5)), "1.50");
+}
+
+/*******************************************************
+ * cutOff
+ *******************************************************
+ * too much text stops at the buffer, null and all,
+ * wherever in a conversion it runs out, and nothing
+ * past the buffer gets touched
+ ******************************************************/
+TEST(cutOff)
+{
+    std::string big(FMT_TEXT_SIZE + 40, 'x');
+    auto t = FMT("%s", big);
+    CHECK_EQ(t.length(), (size_t)FMT_TEXT_SIZE - 1);
+    CHECK_EQ(t.text[FMT_TEXT_SIZE - 1], '\0');
+
+    t = FMT("%300d|", 1);
+    CHECK_EQ(t.length(), (size_t)FMT_TEXT_SIZE - 1);
+    CHECK_EQ(t.text[FMT_TEXT_SIZE - 2], ' ');
+
+    t = FMT("%s%.3f", big.substr(0, FMT_TEXT_SIZE - 3), 1.5);
+    CHECK_EQ(t.length(), (size_t)FMT_TEXT_SIZE - 1);
+    CHECK_EQ(std::string(t.text + FMT_TEXT_SIZE - 3), "1.");
+
+    // into a small buffer with a guard after it
+    char buff[12];
+    std::memset(buff, '#', sizeof(buff));
+    CHECK_EQ(FMT_INTO(buff, 8, "%d-%s", 12345, "abcdef"), 7u);
+    CHECK_EQ(std::string(buff), "12345-a");
+    CHECK_EQ(buff[8], '#');
+
+    CHECK_EQ(FMT_INTO(buff, 4, "%d", 123456), 3u);
+    CHECK_EQ(std::string(buff), "123");
+    CHECK_EQ(FMT_INTO(buff, 4, "%#x", 0xabcu), 3u);
+    CHECK_EQ(std::string(buff), "0xa");
+    CHECK_EQ(FMT_INTO(buff, 1, "%d", 5), 0u);
+    CHECK_EQ(buff[0], '\0');
+
+    buff[0] = '#';
+    CHECK_EQ(FMT_INTO(buff, 0, "%d", 5), 0u);
+    CHECK_EQ(buff[0], '#');
+}
+
+/*******************************************************
+ * fuzzRand()
+ *******************************************************
+ * xorshift32, 0 to n - 1.  Seeded the same every run,
+ * so a failure comes back
+ ******************************************************/
+static uint32_t fuzzState = 2463534242u;
+
+static uint32_t fuzzRand(uint32_t n)
+{
+    fuzzState ^= fuzzState << 13;
+    fuzzState ^= fuzzState >> 17;
+    fuzzState ^= fuzzState << 5;
+
+    return (fuzzState % n);
+}
+
+/*******************************************************
+ * fuzzText()
+ *******************************************************
+ * up to len characters, with a %% now and then
+ ******************************************************/
+static std::string fuzzText(uint32_t len)
+{
+    static const char chars[] = "abcXYZ019 -.:";
+    std::string ret;
+
+    for (uint32_t n = fuzzRand(len + 1); n; --n)
+    {
+        if (!fuzzRand(8))
+        {
+            ret += "%%";
+            continue;
+        }
+        ret += chars[fuzzRand(sizeof(chars) - 1)];
+    }
+
+    return (ret);
+}
+
+/*******************************************************
+ * fuzzInt()
+ *******************************************************
+ * the edges now and then, otherwise any number of bits
+ ******************************************************/
+static int64_t fuzzInt()
+{
+    static const int64_t edges[] = { 0, 1, -1, INT_MIN, INT_MAX, LLONG_MIN, LLONG_MAX, 0xffffffffll };
+    if (!fuzzRand(4))
+    {
+        return (edges[fuzzRand(sizeof(edges) / sizeof(edges[0]))]);
+    }
+
+    uint64_t v = ((uint64_t)fuzzRand(0xffffffffu) << 32) | fuzzRand(0xffffffffu);
+    v >>= fuzzRand(64);
+
+    return (fuzzRand(2) ? (int64_t)v : -(int64_t)v);
+}
+
+/*******************************************************
+ * fuzz
+ *******************************************************
+ * made up formats, one conversion with text either side
+ * and whatever flags, width and precision printf()
+ * defines for it, into buffers of 0 to 48.  The format
+ * isn't a literal, so this goes to fmtFormat() the way
+ * FMT_INTO() hands it over.  The length, the null and
+ * the text have to be what snprintf() gives for the
+ * same size, and nothing past size gets touched
+ ******************************************************/
+TEST(fuzz)
+{
+    static const char convs[] = "diuxXocsfeg";
+    const size_t guard = 16;
+    uint32_t bad = 0;
+
+    for (uint32_t run = 0; run < 50000 && bad < 10; ++run)
+    {
+        char conv = convs[fuzzRand(sizeof(convs) - 1)];
+        const char* flags = (conv == 'd' || conv == 'i') ? "-+ 0" :
+                            (conv == 'u') ? "-0" :
+                            (conv == 'c' || conv == 's') ? "-" :
+                            (std::strchr("xXo", conv)) ? "-0#" : "-+ 0#";
+        bool integer = std::strchr("diuxXo", conv);
+        bool wide = integer && fuzzRand(2);
+
+        std::string f = fuzzText(6) + "%";
+        for (const char* fl = flags; *fl; ++fl)
+        {
+            if (!fuzzRand(4))
+            {
+                f += *fl;
+            }
+        }
+        if (fuzzRand(2))
+        {
+            f += std::to_string(1 + fuzzRand(24));
+        }
+        if (conv != 'c' && !fuzzRand(3))
+        {
+            f += "." + (fuzzRand(4) ? std::to_string(fuzzRand(13)) : std::string());
+        }
+        f += wide ? "ll" : "";
+        f += conv;
+        f += fuzzText(6);
+
+        // the same argument both ways
+        int64_t i = fuzzInt();
+        std::string str = fuzzText(30);
+        double d = (double)fuzzInt() / (double)(1 + fuzzRand(100000));
+        fmt_arg_t a;
+
+        size_t size = fuzzRand(49);
+        char want[48 + guard];
+        switch (conv)
+        {
+            case 'c':
+                a = fmtArg((int)(' ' + fuzzRand(95)));
+                snprintf(want, size, f.c_str(), (int)a.i);
+                break;
+            case 's':
+                a = fmtArg(str);
+                snprintf(want, size, f.c_str(), str.c_str());
+                break;
+            case 'f': case 'e': case 'g':
+                a = fmtArg(d);
+                snprintf(want, size, f.c_str(), d);
+                break;
+            default:
+                if (conv == 'd' || conv == 'i')
+                {
+                    a = wide ? fmtArg((long long)i) : fmtArg((int)i);
+                    wide ? snprintf(want, size, f.c_str(), (long long)i) : snprintf(want, size, f.c_str(), (int)i);
+                }
+                else
+                {
+                    a = wide ? fmtArg((unsigned long long)i) : fmtArg((unsigned)i);
+                    wide ? snprintf(want, size, f.c_str(), (unsigned long long)i) : snprintf(want, size, f.c_str(), (unsigned)i);
+                }
+                break;
+        }
+
+        char got[48 + guard];
+        std::memset(got, '#', sizeof(got));
+        size_t len = fmtFormat(got, size, f.c_str(), &a, 1);
+
+        size_t wantLen = size ? std::strlen(want) : 0;
+        bool ok = (len == wantLen) &&
+                  (!size || (got[len] == '\0' && std::memcmp(got, want, len) == 0)) &&
+                  std::count(got + size, got + sizeof(got), '#') == (long)(sizeof(got) - size);
+        if (!ok)
+        {
+            checkContext(FMT("run %d, \"%s\" into %d", run, f, size).c_str());
+            CHECK_EQ(len, wantLen);
+            CHECK_EQ(std::string(got, std::min(len, size)), std::string(want, wantLen));
+            CHECK(!size || got[std::min(len, size - 1)] == '\0');
+            CHECK_EQ(std::count(got + size, got + sizeof(got), '#'), (long)(sizeof(got) - size));
+            ++bad;
+        }
+    }
+    checkContext("");
+}
@@ -0,0 +1,129 @@
+/********************************************************
+ * telemetry_bench.cpp
+ ********************************************************
+ * A temperature from core 1 to core 0 on the bus,
+ * against the mutex and full copy of the shared struct
+ * it used to go through (oldShared.h).  The old way,
+ * both cores copy everything out on every tick whether
+ * it moved or not, so that's what each case times
+ *
+ *******************************************************/
+#include <cstdio>
+#include <cstring>
+
+#include "check.h"
+#include "bench.h"
+#include "host/fake.h"
+#include "ipc/telemetry.h"
+#include "oldShared.h"
+
+#define CALLS               20000
+#define SCAN_APS            8       // access points in the old struct
+
+static uint32_t heard;
+
+/*******************************************************
+ * heardIt()
+ *******************************************************
+ * core 0's callback, reading what it was told about
+ ******************************************************/
+static void heardIt(topic_t, void* ctx)
+{
+    tp_temperature_t v;
+    if (((telemetry*)ctx)->read<TP_TEMPERATURE>(v))
+    {
+        heard = v.count;
+    }
+}
+
+/*******************************************************
+ * show()
+ *******************************************************
+ * one line of results, old then new
+ ******************************************************/
+static void show(const char* what, double oldNs, bench_allocs_t oldA, double newNs, bench_allocs_t newA)
+{
+    std::printf("  %-30s old %7.1f ns %6.0f cycles %3llu allocs   new %7.1f ns %6.0f cycles %3llu allocs\n",
+            what, oldNs, benchCycles(oldNs), (unsigned long long)oldA.count,
+            newNs, benchCycles(newNs), (unsigned long long)newA.count);
+}
+
+/*******************************************************
+ * BENCH_UPDATE()
+ *******************************************************
+ * time both, and see what one of each allocates.  The
+ * bus mustn't
+ ******************************************************/
+#define BENCH_UPDATE(what, oldFn, newFn)                                        \
+    do                                                                          \
+    {                                                                           \
+        bench_allocs_t newA = benchAllocsOf(newFn);                             \
+        CHECK_EQ(newA.count, 0u);                                               \
+        show(what, benchNs(CALLS, oldFn), benchAllocsOf(oldFn), benchNs(CALLS, newFn), newA);  \
+    } while (0)
+
+/*******************************************************
+ * temperature
+ *******************************************************
+ * a reading published and read back on the other
+ * core, the same thing through a subscription, and a
+ * tick with nothing new
+ ******************************************************/
+TEST(temperature)
+{
+    fakeHardwareReset();
+    oldSharedInit();
+    telemetry* bus = telemetry::getInstance();
+    CHECK(bus->init());
+
+    old_inter_core_t o0;
+    old_inter_core_t o1;
+    oldSharedFill(oldData, SCAN_APS);
+    oldCopyIPC(oldData, o0);
+    oldCopyIPC(oldData, o1);
+
+    tp_temperature_t t;
+    tp_temperature_t got;
+    std::memset(&t, 0, sizeof(t));
+    t.centiF = 3855;
+
+    std::printf("  per update, the old struct with %d access points\n", SCAN_APS);
+    auto oldTemp = [&]()
+    {
+        fakeCore = 1;
+        ++o1.tempCount;
+        oldUpdateSharedData(OLD_US_NEW_TMP_DATA, o1);
+        fakeCore = 0;
+        oldUpdateSharedData(OLD_US_NONE, o0);
+    };
+    auto newTemp = [&]()
+    {
+        fakeCore = 1;
+        ++t.count;
+        bus->publish<TP_TEMPERATURE>(t);
+        fakeCore = 0;
+        bus->read<TP_TEMPERATURE>(got);
+    };
+    BENCH_UPDATE("publish and read", oldTemp, newTemp);
+    CHECK_EQ(got.count, t.count);
+    CHECK_EQ(o0.tempCount, o1.tempCount);
+
+    // core 0 only hears about it
+    fakeCore = 0;
+    CHECK(bus->subscribe(TP_TEMPERATURE, heardIt, bus));
+    auto newSub = [&]()
+    {
+        fakeCore = 1;
+        ++t.count;
+        bus->publish<TP_TEMPERATURE>(t);
+        fakeCore = 0;
+        bus->poll();
+    };
+    BENCH_UPDATE("publish, subscriber polls", oldTemp, newSub);
+    CHECK_EQ(heard, t.count);
+
+    BENCH_UPDATE("a tick with nothing new",
+            [&]() { oldUpdateSharedData(OLD_US_NONE, o0); },
+            [&]() { bus->poll(); });
+    fakeCore = 0;
+}
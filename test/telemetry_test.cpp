@@ -0,0 +1,241 @@
+/********************************************************
+ * telemetry_test.cpp
+ ********************************************************
+ * The publish/subscribe bus.  The cores take turns on
+ * one thread by setting fakeCore; the barrier hook gets
+ * a publish in the middle of a read
+ *
+ *******************************************************/
+#include <cstring>
+
+#include "check.h"
+#include "host/fake.h"
+#include "ipc/telemetry.h"
+
+// what the callbacks saw
+struct heard_t
+{
+    uint32_t calls;
+    uint core;
+    topic_t topic;
+};
+
+static heard_t heard[2];
+
+/*******************************************************
+ * heardIt()
+ *******************************************************
+ * a callback; ctx is where to count it
+ ******************************************************/
+static void heardIt(topic_t t, void* ctx)
+{
+    heard_t* h = (heard_t*)ctx;
+    ++h->calls;
+    h->core = get_core_num();
+    h->topic = t;
+}
+
+/*******************************************************
+ * startBus()
+ *******************************************************
+ * fresh hardware and a fresh bus
+ ******************************************************/
+static telemetry* startBus()
+{
+    fakeHardwareReset();
+    std::memset(heard, 0, sizeof(heard));
+
+    telemetry* bus = telemetry::getInstance();
+    CHECK(bus->init());
+
+    return (bus);
+}
+
+/*******************************************************
+ * temp()
+ *******************************************************
+ * a reading to publish
+ ******************************************************/
+static tp_temperature_t temp(temp_t centiF, uint32_t count)
+{
+    tp_temperature_t t;
+    std::memset(&t, 0, sizeof(t));
+    t.centiF = centiF;
+    t.count = count;
+    t.readUs = time_us_32();
+
+    return (t);
+}
+
+/*******************************************************
+ * latest
+ *******************************************************
+ * nothing until something's published, then the last
+ * one and how many there have been
+ ******************************************************/
+TEST(latest)
+{
+    telemetry* bus = startBus();
+
+    tp_temperature_t t;
+    uint32_t gen = 99;
+    CHECK(!bus->read<TP_TEMPERATURE>(t, &gen));
+    CHECK_EQ(gen, 0u);
+
+    fakeCore = 1;
+    bus->publish<TP_TEMPERATURE>(temp(3850, 1));
+    bus->publish<TP_TEMPERATURE>(temp(3860, 2));
+
+    fakeCore = 0;
+    CHECK(bus->read<TP_TEMPERATURE>(t, &gen));
+    CHECK_EQ(gen, 2u);
+    CHECK_EQ(t.centiF, 3860);
+    CHECK_EQ(t.count, 2u);
+
+    // other topics don't see it
+    tp_pump_t p;
+    CHECK(!bus->read<TP_PUMP>(p));
+
+    topic_stats_t s;
+    bus->getStats(TP_TEMPERATURE, s);
+    CHECK_EQ(s.publishes, 2u);
+    CHECK_EQ(s.retries, 0u);
+}
+
+/*******************************************************
+ * history
+ *******************************************************
+ * newest first, no more than asked for or the topic
+ * keeps, and nothing for a topic that keeps none
+ ******************************************************/
+TEST(history)
+{
+    telemetry* bus = startBus();
+
+    tp_temperature_t t[TOPIC_HISTORY_MAX + 4];
+    CHECK_EQ(bus->history<TP_TEMPERATURE>(t, 4), 0);
+
+    for (uint32_t n = 1; n <= 3; ++n)
+    {
+        bus->publish<TP_TEMPERATURE>(temp(n * 10, n));
+    }
+    CHECK_EQ(bus->history<TP_TEMPERATURE>(t, TOPIC_HISTORY_MAX + 4), 3);
+    CHECK_EQ(t[0].count, 3u);
+    CHECK_EQ(t[2].count, 1u);
+
+    // round the ring a couple of times
+    for (uint32_t n = 4; n <= 40; ++n)
+    {
+        bus->publish<TP_TEMPERATURE>(temp(n * 10, n));
+    }
+    CHECK_EQ(bus->history<TP_TEMPERATURE>(t, TOPIC_HISTORY_MAX + 4), 16);
+    for (uint8_t ii = 0; ii < 16; ++ii)
+    {
+        CHECK_EQ(t[ii].count, 40u - ii);
+        CHECK_EQ(t[ii].centiF, (temp_t)((40 - ii) * 10));
+    }
+    CHECK_EQ(bus->history<TP_TEMPERATURE>(t, 5), 5);
+    CHECK_EQ(t[4].count, 36u);
+
+    tp_net_status_t net;
+    std::memset(&net, 0, sizeof(net));
+    bus->publish<TP_NET_STATUS>(net);
+    CHECK_EQ(bus->history<TP_NET_STATUS>(&net, 1), 0);
+}
+
+/*******************************************************
+ * subscribers
+ *******************************************************
+ * a callback runs from its own core's poll(), once
+ * however many publishes there were, and a subscribe
+ * after a publish still hears about it
+ ******************************************************/
+TEST(subscribers)
+{
+    telemetry* bus = startBus();
+
+    fakeCore = 0;
+    CHECK(bus->subscribe(TP_TEMPERATURE, heardIt, &heard[0]));
+    CHECK(!bus->subscribe(TP_COUNT, heardIt, &heard[0]));
+    CHECK(!bus->subscribe(TP_PUMP, NULL));
+    CHECK_EQ(bus->poll(), 0);
+
+    fakeCore = 1;
+    fakeTimeUs = 1000;
+    bus->publish<TP_TEMPERATURE>(temp(3800, 1));
+    bus->publish<TP_TEMPERATURE>(temp(3810, 2));
+    CHECK_EQ(bus->poll(), 0);
+    CHECK_EQ(heard[0].calls, 0u);
+
+    fakeCore = 0;
+    fakeTimeUs = 1250;
+    CHECK_EQ(bus->poll(), 1);
+    CHECK_EQ(heard[0].calls, 1u);
+    CHECK_EQ(heard[0].core, 0u);
+    CHECK_EQ(heard[0].topic, TP_TEMPERATURE);
+    CHECK_EQ(bus->poll(), 0);
+
+    topic_stats_t s;
+    bus->getStats(TP_TEMPERATURE, s);
+    CHECK_EQ(s.notifies, 1u);
+    CHECK_EQ(s.deliveryUs[0].count(), 1u);
+    CHECK_EQ(s.deliveryUs[0].max(), 250u);
+
+    // the pump was published before core 1 cared
+    fakeCore = 0;
+    tp_pump_t p;
+    std::memset(&p, 0, sizeof(p));
+    p.running = true;
+    bus->publish<TP_PUMP>(p);
+
+    fakeCore = 1;
+    CHECK(bus->subscribe(TP_PUMP, heardIt, &heard[1]));
+    CHECK_EQ(bus->poll(), 1);
+    CHECK_EQ(heard[1].topic, TP_PUMP);
+    CHECK_EQ(heard[1].core, 1u);
+
+    // and a core can publish to itself
+    bus->publish<TP_PUMP>(p);
+    CHECK_EQ(bus->poll(), 1);
+    CHECK_EQ(heard[1].calls, 2u);
+    CHECK_EQ(heard[0].calls, 1u);
+    fakeCore = 0;
+    fakeTimeUs = 0;
+}
+
+/*******************************************************
+ * publishDuringRead()
+ *******************************************************
+ * core 1 with a new reading, from the barrier after
+ * core 0's read has copied the old one out
+ ******************************************************/
+static void publishDuringRead()
+{
+    fakeCore = 1;
+    telemetry::getInstance()->publish<TP_TEMPERATURE>(temp(4000, 7));
+    fakeCore = 0;
+}
+
+/*******************************************************
+ * readRetries
+ *******************************************************
+ * a publish in the middle of a read sends it round
+ * again, and it comes out with the new value
+ ******************************************************/
+TEST(readRetries)
+{
+    telemetry* bus = startBus();
+    bus->publish<TP_TEMPERATURE>(temp(3900, 6));
+
+    tp_temperature_t t;
+    uint32_t gen = 0;
+    fakeBarrierHook = publishDuringRead;
+    fakeBarrierSkip = 1;
+    CHECK(bus->read<TP_TEMPERATURE>(t, &gen));
+    CHECK_EQ(t.count, 7u);
+    CHECK_EQ(gen, 2u);
+
+    topic_stats_t s;
+    bus->getStats(TP_TEMPERATURE, s);
+    CHECK_EQ(s.retries, 1u);
+}
@@ -0,0 +1,133 @@
+/********************************************************
+ * temperature_test.cpp
+ ********************************************************
+ * Fixed point temperatures: the probe's reading to
+ * hundredths F, and hundredths F to text
+ *
+ *******************************************************/
+#include <climits>
+#include <string>
+
+#include "check.h"
+#include "utils/temperature.h"
+#include "utils/stringFormat.h"
+
+/*******************************************************
+ * text()
+ *******************************************************
+ * temp2text() as a string, checking the length it gave
+ ******************************************************/
+static std::string text(temp_t t, uint8_t places)
+{
+    char out[TEMP_TEXT];
+    size_t len = temp2text(t, places, out, sizeof(out));
+    std::string ret = out;
+    CHECK_EQ(len, ret.length());
+
+    return (ret);
+}
+
+/*******************************************************
+ * fromProbe
+ *******************************************************
+ * the readings in the DS18B20 data sheet's table, and
+ * every reading the probe can give is within a
+ * hundredth of what it is in floating point
+ ******************************************************/
+TEST(fromProbe)
+{
+    struct
+    {
+        uint16_t raw;
+        temp_t want;
+    } const sheet[] =
+    {
+        { 0x07d0, 25700 },      // +125C
+        { 0x0550, 18500 },      // +85C
+        { 0x0191, 7711 },       // +25.0625C, 77.1125F
+        { 0x00a2, 5022 },       // +10.125C, 50.225F
+        { 0x0008, 3290 },       // +0.5C
+        { 0x0000, 3200 },       // 0C
+        { 0xfff8, 3110 },       // -0.5C
+        { 0xff5e, 1378 },       // -10.125C, 13.775F
+        { 0xfe6f, -1311 },      // -25.0625C, -13.1125F
+        { 0xfc90, -6700 },      // -55C
+    };
+
+    for (auto& s : sheet)
+    {
+        checkContext(FMT("raw 0x%04x", s.raw));
+        CHECK_EQ(tempFromRaw((int16_t)s.raw), s.want);
+    }
+    checkContext("");
+
+    uint32_t off = 0;
+    for (int32_t raw = -55 * 16; raw <= 125 * 16; ++raw)
+    {
+        double exact = (raw * 11.25) + 3200;
+        double got = tempFromRaw((int16_t)raw);
+        off += (got - exact >= 1 || exact - got >= 1);
+    }
+    CHECK_EQ(off, 0u);
+}
+
+/*******************************************************
+ * places
+ *******************************************************
+ * 0, 1 or 2 places, rounded half away from zero; any
+ * more is 2
+ ******************************************************/
+TEST(places)
+{
+    CHECK_EQ(text(6550, 0), "66");
+    CHECK_EQ(text(6549, 0), "65");
+    CHECK_EQ(text(6550, 1), "65.5");
+    CHECK_EQ(text(6545, 1), "65.5");
+    CHECK_EQ(text(6544, 1), "65.4");
+    CHECK_EQ(text(6550, 2), "65.50");
+    CHECK_EQ(text(6507, 2), "65.07");
+    CHECK_EQ(text(999, 1), "10.0");
+    CHECK_EQ(text(995, 0), "10");
+    CHECK_EQ(text(0, 0), "0");
+    CHECK_EQ(text(0, 1), "0.0");
+    CHECK_EQ(text(0, 2), "0.00");
+    CHECK_EQ(text(TEMP_F(212), 1), "212.0");
+    CHECK_EQ(text(6507, 5), "65.07");
+}
+
+/*******************************************************
+ * negatives
+ *******************************************************
+ * the sign survives a whole part of 0, and goes away
+ * if it rounds to nothing
+ ******************************************************/
+TEST(negatives)
+{
+    CHECK_EQ(text(-155, 1), "-1.6");
+    CHECK_EQ(text(-150, 0), "-2");
+    CHECK_EQ(text(-149, 0), "-1");
+    CHECK_EQ(text(-50, 1), "-0.5");
+    CHECK_EQ(text(-5, 1), "-0.1");
+    CHECK_EQ(text(-4, 1), "0.0");
+    CHECK_EQ(text(-49, 0), "0");
+    CHECK_EQ(text(-1, 2), "-0.01");
+    CHECK_EQ(text(TEMP_F(-0.5), 1), "-0.5");
+    CHECK_EQ(text(-1311, 2), "-13.11");
+}
+
+/*******************************************************
+ * fits
+ *******************************************************
+ * the widest there is fits TEMP_TEXT, and a buffer too
+ * small gets what fits
+ ******************************************************/
+TEST(fits)
+{
+    CHECK_EQ(text(INT32_MIN, 2), "-21474836.48");
+    CHECK_EQ(text(INT32_MAX, 2), "21474836.47");
+    CHECK_EQ(text(INT32_MIN, 0), "-21474836");
+
+    char out[4];
+    CHECK_EQ(temp2text(6550, 1, out, sizeof(out)), 3u);
+    CHECK_EQ(std::string(out), "65.");
+}
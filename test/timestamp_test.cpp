@@ -0,0 +1,182 @@
+/********************************************************
+ * timestamp_test.cpp
+ ********************************************************
+ * Log line times.  The RTC is fakeRtc and only moves
+ * when a test sets it, the timer is fakeTimeUs, so the
+ * second ticking over lands exactly where a test wants
+ *
+ *******************************************************/
+#include <string>
+
+#include "check.h"
+#include "host/fake.h"
+#include "sys/timestamp.h"
+
+/*******************************************************
+ * setRtc()
+ *******************************************************
+ * what the RTC says from now on
+ ******************************************************/
+static void setRtc(int16_t year, int8_t month, int8_t day, int8_t hour, int8_t min, int8_t sec)
+{
+    fakeRtcSet = true;
+    fakeRtc.year = year;
+    fakeRtc.month = month;
+    fakeRtc.day = day;
+    fakeRtc.hour = hour;
+    fakeRtc.min = min;
+    fakeRtc.sec = sec;
+}
+
+/*******************************************************
+ * text()
+ *******************************************************
+ * format() as a string, checking the length it gave
+ ******************************************************/
+static std::string text(uint64_t us)
+{
+    char out[TIMESTAMP_TEXT];
+    size_t len = timestamp::getInstance()->format(us, out);
+    std::string ret = out;
+    CHECK_EQ(len, ret.length());
+
+    return (ret);
+}
+
+/*******************************************************
+ * startClock()
+ *******************************************************
+ * fresh hardware, and a timestamp that has to find
+ * its anchor again
+ ******************************************************/
+static timestamp* startClock()
+{
+    fakeHardwareReset();
+
+    timestamp* ts = timestamp::getInstance();
+    ts->resync();
+
+    return (ts);
+}
+
+/*******************************************************
+ * uptime
+ *******************************************************
+ * with the clock not set, time since boot
+ ******************************************************/
+TEST(uptime)
+{
+    timestamp* ts = startClock();
+    ts->sync();
+
+    CHECK_EQ(text(0), "up 0.000000");
+    CHECK_EQ(text(1234567), "up 1.234567");
+    CHECK_EQ(text(86400000001ULL), "up 86400.000001");
+}
+
+/*******************************************************
+ * anchored
+ *******************************************************
+ * the first read of the RTC is only good to the
+ * second; once it ticks over, that's the anchor and
+ * the microseconds are counted from it, either side
+ ******************************************************/
+TEST(anchored)
+{
+    timestamp* ts = startClock();
+
+    setRtc(2021, 12, 5, 13, 4, 5);
+    fakeTimeUs = 5300000;
+    ts->sync();
+    CHECK_EQ(text(5300000), "20211205 13:04:05.000000");
+    CHECK_EQ(text(5550000), "20211205 13:04:05.250000");
+
+    // same second, nothing moves
+    fakeTimeUs = 5900000;
+    ts->sync();
+    CHECK_EQ(text(5900000), "20211205 13:04:05.600000");
+
+    fakeTimeUs = 6100000;
+    setRtc(2021, 12, 5, 13, 4, 6);
+    ts->sync();
+    CHECK_EQ(text(6100000), "20211205 13:04:06.000000");
+    CHECK_EQ(text(6100000 + 1234567), "20211205 13:04:07.234567");
+    CHECK_EQ(text(6099999), "20211205 13:04:05.999999");
+    CHECK_EQ(text(5300000), "20211205 13:04:05.200000");
+
+    // locked, the RTC isn't even looked at for a while
+    fakeTimeUs = 30000000;
+    setRtc(2021, 12, 5, 13, 5, 0);
+    ts->sync();
+    CHECK_EQ(text(6100000), "20211205 13:04:06.000000");
+    fakeTimeUs = 0;
+}
+
+/*******************************************************
+ * resynced
+ *******************************************************
+ * a minute on, it looks for the next tick and anchors
+ * there; resync() after the clock's set starts again
+ * from the new time
+ ******************************************************/
+TEST(resynced)
+{
+    timestamp* ts = startClock();
+
+    setRtc(2021, 12, 5, 13, 4, 5);
+    fakeTimeUs = 1000000;
+    ts->sync();
+    fakeTimeUs = 1500000;
+    setRtc(2021, 12, 5, 13, 4, 6);
+    ts->sync();
+
+    // the timer runs a bit fast against the RTC; the
+    // old anchor stays until the next tick
+    fakeTimeUs = 1500000 + TIMESTAMP_RESYNC_US;
+    setRtc(2021, 12, 5, 13, 5, 5);
+    ts->sync();
+    CHECK_EQ(text(fakeTimeUs), "20211205 13:05:06.000000");
+
+    fakeTimeUs += 400000;
+    setRtc(2021, 12, 5, 13, 5, 6);
+    ts->sync();
+    CHECK_EQ(text(fakeTimeUs), "20211205 13:05:06.000000");
+    CHECK_EQ(text(fakeTimeUs + 10), "20211205 13:05:06.000010");
+
+    // the clock gets set
+    setRtc(2022, 3, 1, 8, 0, 0);
+    ts->resync();
+    ts->sync();
+    CHECK_EQ(text(fakeTimeUs), "20220301 08:00:00.000000");
+    fakeTimeUs = 0;
+}
+
+/*******************************************************
+ * rollover
+ *******************************************************
+ * across midnight, a leap day and the end of the year,
+ * in and out of the cached second
+ ******************************************************/
+TEST(rollover)
+{
+    timestamp* ts = startClock();
+
+    setRtc(2024, 2, 28, 23, 59, 58);
+    ts->sync();
+    fakeTimeUs = 10;
+    setRtc(2024, 2, 28, 23, 59, 59);
+    ts->sync();
+
+    CHECK_EQ(text(10), "20240228 23:59:59.000000");
+    CHECK_EQ(text(1000009), "20240228 23:59:59.999999");
+    CHECK_EQ(text(1000010), "20240229 00:00:00.000000");
+    CHECK_EQ(text(10), "20240228 23:59:59.000000");
+    CHECK_EQ(text(86400000010ULL), "20240229 23:59:59.000000");
+    CHECK_EQ(text(86401000010ULL), "20240301 00:00:00.000000");
+
+    setRtc(2021, 12, 31, 23, 59, 59);
+    ts->resync();
+    ts->sync();
+    CHECK_EQ(text(fakeTimeUs + 1000000), "20220101 00:00:00.000000");
+    fakeTimeUs = 0;
+}
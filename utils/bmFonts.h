@@ -1,4 +1,33 @@
+/********************************************************
+ * bmFonts.h
+ ********************************************************
+ * Bitmap fonts for the LED matrix.  Glyphs are stored a
+ * column at a time, left to right, and bit 0 of each
+ * column byte is the top row.  That way a glyph gets
+ * drawn a whole column at a time.  Tables are constexpr
+ * so they stay in flash.
+ * December 2021, M.Brugman
+ * 
+ *******************************************************/
 #ifndef BM_FONTS_H
 #define BM_FONTS_H
 
+#include <cstdint>
+
+// both fonts cover printable ASCII
+#define BM_FONT_FIRST       ' '
+#define BM_FONT_LAST        '~'
+#define BM_FONT_MISSING     '?'     // drawn for anything outside that
+
+struct bm_font_t
+{
+    uint8_t width;              // columns per glyph
+    uint8_t height;             // rows per glyph
+    uint8_t spaceWidth;         // columns a space takes up
+    const uint8_t* glyphs;      // 'width' bytes per glyph, from BM_FONT_FIRST
+};
+
+extern const bm_font_t bmFont5x7;
+extern const bm_font_t bmFont3x5;
+
 #endif // BM_FONTS_H
\ No newline at end of file
@@ -1,81 +1,315 @@
 /********************************************************
- * stringFormat.h
+ * stringFormat.cpp
  ********************************************************
- * do safe snprintf() type formatting with std::strings
+ * snprintf() type formatting without the heap.  See the
+ * comment in stringFormat.h
  * December 2021, M.Brugman
- * 
+ *
  *******************************************************/
 #include <cstring>
-#include <cstdarg>
+#include <cstdio>
 #include "stringFormat.h"
 
-// Do formatting like snprintf() but for std::strings 
-// BIG NOTE:  YOU CANNOT PASS A STD::STRING as a token replacement; 
-// this uses vsnprintf() internally, which doesn't understand std::strings.
-//
-// Specifically DO NOT do something like this:
-//
-//  ......
-//  std::string someString;
-//  someString = "abcdef";
-//
-//  std::string result = stringFormat("Here's the result: %s\n", someString);
-//  .......
-//
-// This will not give you a result like "Here's the result: abcdef"
-// Instead, you'll probably have a runtime exception.  However, this
-// would be totes legit:
-//
-//  std::string result = stringFormat("Here's the result: %s\n", someString.c_str());
-//
-std::string stringFormat(const std::string& fmt, ...) 
+// one conversion, pulled apart
+struct fmt_spec_t
 {
-    // start with a std::string raw buffer of 1k
-    int size = 1024;
-    std::string str;
-    va_list ap;
-    size_t retries = 0;
+    bool left;              // '-'
+    bool plus;              // '+'
+    bool space;             // ' '
+    bool alt;               // '#'
+    bool zero;              // '0'
+    int width;
+    int prec;               // -1 for none
+    char conv;
+};
 
-    while (true) 
+// where the text is going.  Everything past what fits
+// is dropped, leaving room for the null
+struct fmt_out_t
+{
+    char* buff;
+    size_t size;
+    size_t len;
+
+    void put(char c)
+    {
+        if (len + 1 < size)
+        {
+            buff[len++] = c;
+        }
+    }
+
+    void put(const char* c, size_t n)
+    {
+        if (len + 1 >= size)
+        {
+            return;
+        }
+
+        if (n > size - 1 - len)
+        {
+            n = size - 1 - len;
+        }
+        std::memcpy(&buff[len], c, n);
+        len += n;
+    }
+
+    void pad(char c, int n)
+    {
+        while (n-- > 0)
+        {
+            this->put(c);
+        }
+    }
+};
+
+/*********************************************
+ * parseSpec()
+ *********************************************
+ * flags, width, precision and conversion of
+ * the spec at f, just past its '%'.  Length
+ * modifiers are skipped.  Returns where the
+ * text after it starts
+ ********************************************/
+static const char* parseSpec(const char* f, fmt_spec_t& sp)
+{
+    std::memset(&sp, 0, sizeof(sp));
+    sp.prec = -1;
+
+    for (;; ++f)
+    {
+        if (*f == '-')          sp.left = true;
+        else if (*f == '+')     sp.plus = true;
+        else if (*f == ' ')     sp.space = true;
+        else if (*f == '#')     sp.alt = true;
+        else if (*f == '0')     sp.zero = true;
+        else                    break;
+    }
+
+    while (*f >= '0' && *f <= '9')
+    {
+        sp.width = (sp.width * 10) + (*f++ - '0');
+    }
+
+    if (*f == '.')
+    {
+        ++f;
+        sp.prec = 0;
+        while (*f >= '0' && *f <= '9')
+        {
+            sp.prec = (sp.prec * 10) + (*f++ - '0');
+        }
+    }
+
+    while (*f && std::strchr("hlLqjzt", *f))
+    {
+        ++f;
+    }
+
+    sp.conv = *f;
+
+    return (*f ? f + 1 : f);
+}
+
+/*********************************************
+ * fmtString()
+ *********************************************
+ * precision cuts it off, width pads it
+ ********************************************/
+static void fmtString(fmt_out_t& o, const fmt_spec_t& sp, const char* c, size_t n)
+{
+    if (sp.prec >= 0 && n > (size_t)sp.prec)
+    {
+        n = sp.prec;
+    }
+
+    int pad = sp.width - (int)n;
+    if (!sp.left)   o.pad(' ', pad);
+    o.put(c, n);
+    if (sp.left)    o.pad(' ', pad);
+}
+
+/*********************************************
+ * fmtInteger()
+ *********************************************
+ * d, i, u, o, x, X and c the way printf()
+ * does them.  Anything narrower than 64 bits
+ * goes unsigned as 32 bits, so -1 with %x is
+ * ffffffff
+ ********************************************/
+static void fmtInteger(fmt_out_t& o, const fmt_spec_t& sp, const fmt_arg_t& a)
+{
+    if (sp.conv == 'c')
+    {
+        char c = (char)a.i;
+        fmtString(o, fmt_spec_t{ sp.left, false, false, false, false, sp.width, -1, 's' }, &c, 1);
+        return;
+    }
+
+    bool isSigned = (sp.conv == 'd' || sp.conv == 'i');
+    bool neg = false;
+    uint64_t v;
+
+    if (isSigned)
     {
-        str.resize(size);
-        va_start(ap, fmt);
+        int64_t s = (a.kind == FA_INT || a.wide) ? a.i : (int64_t)(int32_t)a.u;
+        neg = (s < 0);
+        v = neg ? (0 - (uint64_t)s) : (uint64_t)s;
+    }
+    else
+    {
+        v = (a.kind == FA_UINT || a.wide) ? a.u : (uint64_t)(uint32_t)a.i;
+    }
+
+    uint8_t base = (sp.conv == 'o') ? 8 : (sp.conv == 'x' || sp.conv == 'X') ? 16 : 10;
+    const char* digits = (sp.conv == 'X') ? "0123456789ABCDEF" : "0123456789abcdef";
+
+    // backwards from the end
+    char num[24];
+    int n = 0;
+    for (uint64_t x = v; x; x /= base)
+    {
+        num[sizeof(num) - 1 - n++] = digits[x % base];
+    }
+    if (!v && sp.prec != 0)
+    {
+        num[sizeof(num) - 1 - n++] = '0';
+    }
+
+    int zeros = (sp.prec > n) ? sp.prec - n : 0;
+    if (sp.alt && base == 8 && !zeros && (n == 0 || num[sizeof(num) - n] != '0'))
+    {
+        zeros = 1;
+    }
+
+    char prefix[2];
+    int pl = 0;
+    if (neg)                            prefix[pl++] = '-';
+    else if (isSigned && sp.plus)       prefix[pl++] = '+';
+    else if (isSigned && sp.space)      prefix[pl++] = ' ';
+    if (sp.alt && base == 16 && v)
+    {
+        prefix[pl++] = '0';
+        prefix[pl++] = sp.conv;
+    }
+
+    int pad = sp.width - (pl + zeros + n);
+    if (sp.zero && !sp.left && sp.prec < 0 && pad > 0)
+    {
+        zeros += pad;
+        pad = 0;
+    }
+
+    if (!sp.left)   o.pad(' ', pad);
+    o.put(prefix, pl);
+    o.pad('0', zeros);
+    o.put(&num[sizeof(num) - n], n);
+    if (sp.left)    o.pad(' ', pad);
+}
+
+/*********************************************
+ * fmtSnprintf()
+ *********************************************
+ * floats and pointers go to snprintf(), spec
+ * and all, straight into what's left
+ ********************************************/
+static void fmtSnprintf(fmt_out_t& o, const char* spec, size_t specLen, const fmt_arg_t& a)
+{
+    char sf[24];
+    if (specLen >= sizeof(sf) || o.len + 1 >= o.size)
+    {
+        return;
+    }
+
+    // without the length modifiers
+    size_t sl = 0;
+    for (size_t ii = 0; ii < specLen; ++ii)
+    {
+        if (!std::strchr("hlLqjzt", spec[ii]))
+        {
+            sf[sl++] = spec[ii];
+        }
+    }
+    sf[sl] = '\0';
+
+    size_t room = o.size - o.len;
+    int n = (a.kind == FA_FLOAT) ? snprintf(&o.buff[o.len], room, sf, a.d) :
+            (a.kind == FA_STR) ? snprintf(&o.buff[o.len], room, sf, (const void*)a.s.c) :
+            snprintf(&o.buff[o.len], room, sf, a.p);
+
+    if (n > 0)
+    {
+        o.len += ((size_t)n < room) ? n : room - 1;
+    }
+}
+
+/*********************************************
+ * fmtFormat()
+ *********************************************
+ * the literal text is copied across, each
+ * conversion takes the next argument.  The
+ * arguments were checked against the format
+ * when it was compiled; if one doesn't fit
+ * anyway, it just prints nothing
+ ********************************************/
+size_t fmtFormat(char* buff, size_t size, const char* f, const fmt_arg_t* args, size_t count)
+{
+    fmt_out_t o = { buff, size, 0 };
+    size_t arg = 0;
+
+    if (!size)
+    {
+        return (0);
+    }
+
+    while (*f)
+    {
+        const char* pct = std::strchr(f, '%');
+        if (!pct)
+        {
+            o.put(f, std::strlen(f));
+            break;
+        }
 
-        // try to format print into the raw buvver of the std::string
-        ssize_t n = vsnprintf((char *)str.data(), size, fmt.c_str(), ap);
-        va_end(ap);
+        o.put(f, pct - f);
+        if (pct[1] == '%')
+        {
+            o.put('%');
+            f = pct + 2;
+            continue;
+        }
 
-        // This means that the std::string was allocated big enough.  Trim
-        // the std::string's buffer down and head out
-        if (n > -1 && n < size) 
+        fmt_spec_t sp;
+        f = parseSpec(pct + 1, sp);
+        if (arg >= count)
         {
-            str.resize(n);
-            return (str);
+            continue;
         }
 
-        // A non-negative return value indicates more data would've been 
-        // written had there been enough buffer.  So set the buffer size
-        // to be one larger than the number needed and go try again.  Note that 
-        // the return value includes the trailing null
-        if (n > -1)
+        const fmt_arg_t& a = args[arg++];
+        if (!fmtFits(sp.conv, a.kind))
         {
-            size = n + 1;
+            continue;
         }
-        // a negative return value indicates an error occurred.  Double the 
-        // size of the buffer and try again.  Give up after some arbitrary
-        // number of tries
-        else
+
+        switch (sp.conv)
         {
-            if (++retries < 5)
-            {
-                size *= 2;
-            }
-            else
-            {
-                return std::string("");
-            }
-            
+            case 'd': case 'i': case 'u': case 'o':
+            case 'x': case 'X': case 'c':
+                fmtInteger(o, sp, a);
+                break;
+
+            case 's':
+                fmtString(o, sp, a.s.c, a.s.len);
+                break;
+
+            default:
+                fmtSnprintf(o, pct, f - pct, a);
+                break;
         }
     }
-    return (str);
-}
\ No newline at end of file
+
+    buff[o.len] = '\0';
+
+    return (o.len);
+}
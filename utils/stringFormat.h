@@ -1,15 +1,224 @@
 /********************************************************
  * stringFormat.h
  ********************************************************
- * do safe snprintf() type formatting with std::strings
+ * snprintf() type formatting without the heap.
+ *
+ *   DBG_WRITE(log, FMT("%s::pump %s, %d\n", __FUNCTION__, name, n));
+ *   size_t n = FMT_INTO(buff, sizeof(buff), "%02d:%02d", h, m);
+ *
+ * FMT() gives back a fmt_text_t, the text in a buffer of
+ * FMT_TEXT_SIZE on the stack, which goes anywhere a
+ * std::string_view or a std::string does.  FMT_INTO()
+ * writes into the caller's buffer and gives back the
+ * length.  Either way the text is cut off to fit and is
+ * always null terminated; nothing is ever allocated.
+ * Anything that could run past FMT_TEXT_SIZE, like a
+ * block of lines or a histogram, gets one FMT() per
+ * line or is put together as a std::string.
+ *
+ * The format has to be a literal, since it's checked
+ * against the arguments when it's compiled: the count,
+ * and that each one is something its conversion can
+ * print.  %s takes a const char*, a std::string or a
+ * std::string_view.  Length modifiers (%ld, %hhx...)
+ * are allowed and ignored, each argument is printed as
+ * the type it is.  No '*' widths, and no %n
  * December 2021, M.Brugman
- * 
+ *
  *******************************************************/
 #ifndef STRING_FORMAT_H_
 #define STRING_FORMAT_H_
 
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
 
-std::string stringFormat(const std::string& fmt, ...);
+#define FMT_TEXT_SIZE       256         // what FMT() can hold, null and all
 
-#endif // STRING_FORMAT_H_
\ No newline at end of file
+// a buffer for FMT() to fill
+#define FMT(f, ...)         fmtText<FMT_TEXT_SIZE, FMT_OK(f, ##__VA_ARGS__)>(f, ##__VA_ARGS__)
+
+// into buff, returns the length
+#define FMT_INTO(buff, size, f, ...)    fmtInto<FMT_OK(f, ##__VA_ARGS__)>(buff, size, f, ##__VA_ARGS__)
+
+// true if format f fits the arguments; a constant
+#define FMT_OK(f, ...)      fmtCheck(f, decltype(fmtTypes(__VA_ARGS__)){})
+
+// what an argument is, as far as formatting goes
+enum fmt_arg_kind_t
+{
+    FA_INT = 0,
+    FA_UINT,
+    FA_FLOAT,
+    FA_STR,
+    FA_PTR,
+    FA_BAD
+};
+
+// one argument, ready to be formatted.  wide is for
+// 64 bit integers; the rest print as 32 bits, like
+// they would with printf()
+struct fmt_arg_t
+{
+    uint8_t kind;
+    bool wide;
+    union
+    {
+        int64_t i;
+        uint64_t u;
+        double d;
+        const void* p;
+        struct
+        {
+            const char* c;
+            size_t len;
+        } s;
+    };
+};
+
+// FMT()'s text
+template <size_t N>
+struct fmt_text_t
+{
+    char text[N];
+    size_t len;
+
+    const char* c_str() const                   { return (text); }
+    size_t length() const                       { return (len); }
+    operator std::string_view() const           { return (std::string_view(text, len)); }
+    operator std::string() const                { return (std::string(text, len)); }
+};
+
+// the arguments' types, for checking them against the
+// format.  Never called, only used in decltype()
+template <typename... T>
+struct fmt_types_t {};
+
+template <typename... Args>
+fmt_types_t<typename std::decay<Args>::type...> fmtTypes(const Args&... args);
+
+template <typename T>
+constexpr uint8_t fmtKind()
+{
+    return ((std::is_same<T, const char*>::value || std::is_same<T, char*>::value ||
+             std::is_same<T, std::string>::value || std::is_same<T, std::string_view>::value) ? FA_STR :
+            std::is_floating_point<T>::value ? FA_FLOAT :
+            std::is_enum<T>::value ? FA_INT :
+            std::is_integral<T>::value ? (std::is_signed<T>::value ? FA_INT : FA_UINT) :
+            std::is_pointer<T>::value ? FA_PTR : FA_BAD);
+}
+
+// can a conversion print this kind of argument?
+constexpr bool fmtFits(char conv, uint8_t kind)
+{
+    switch (conv)
+    {
+        case 'd': case 'i': case 'u': case 'o':
+        case 'x': case 'X': case 'c':
+            return (kind == FA_INT || kind == FA_UINT);
+
+        case 'f': case 'F': case 'e': case 'E':
+        case 'g': case 'G': case 'a': case 'A':
+            return (kind == FA_FLOAT);
+
+        case 's':
+            return (kind == FA_STR);
+
+        case 'p':
+            return (kind == FA_PTR || kind == FA_STR);
+    }
+
+    return (false);
+}
+
+// walk the format, one conversion per argument in order
+template <typename... Args>
+constexpr bool fmtCheck(const char* f, fmt_types_t<Args...>)
+{
+    constexpr uint8_t kinds[] = { fmtKind<Args>()..., FA_BAD };
+    size_t arg = 0;
+
+    while (*f)
+    {
+        if (*f++ != '%')
+        {
+            continue;
+        }
+
+        if (*f == '%')
+        {
+            ++f;
+            continue;
+        }
+
+        while (*f && std::string_view("-+ #0123456789.hlLqjzt").find(*f) != std::string_view::npos)
+        {
+            ++f;
+        }
+
+        if (arg >= sizeof...(Args) || !fmtFits(*f, kinds[arg]))
+        {
+            return (false);
+        }
+        ++arg;
+        ++f;
+    }
+
+    return (arg == sizeof...(Args));
+}
+
+// each argument to a fmt_arg_t
+inline fmt_arg_t fmtInt(int64_t v, bool wide)       { fmt_arg_t a; a.kind = FA_INT;  a.wide = wide; a.i = v; return (a); }
+inline fmt_arg_t fmtUint(uint64_t v, bool wide)     { fmt_arg_t a; a.kind = FA_UINT; a.wide = wide; a.u = v; return (a); }
+
+inline fmt_arg_t fmtArg(bool v)                     { return (fmtInt(v, false)); }
+inline fmt_arg_t fmtArg(char v)                     { return (fmtInt(v, false)); }
+inline fmt_arg_t fmtArg(signed char v)              { return (fmtInt(v, false)); }
+inline fmt_arg_t fmtArg(unsigned char v)            { return (fmtUint(v, false)); }
+inline fmt_arg_t fmtArg(short v)                    { return (fmtInt(v, false)); }
+inline fmt_arg_t fmtArg(unsigned short v)           { return (fmtUint(v, false)); }
+inline fmt_arg_t fmtArg(int v)                      { return (fmtInt(v, false)); }
+inline fmt_arg_t fmtArg(unsigned int v)             { return (fmtUint(v, false)); }
+inline fmt_arg_t fmtArg(long v)                     { return (fmtInt(v, sizeof(v) > 4)); }
+inline fmt_arg_t fmtArg(unsigned long v)            { return (fmtUint(v, sizeof(v) > 4)); }
+inline fmt_arg_t fmtArg(long long v)                { return (fmtInt(v, true)); }
+inline fmt_arg_t fmtArg(unsigned long long v)       { return (fmtUint(v, true)); }
+inline fmt_arg_t fmtArg(double v)                   { fmt_arg_t a; a.kind = FA_FLOAT; a.wide = false; a.d = v; return (a); }
+inline fmt_arg_t fmtArg(std::string_view v)         { fmt_arg_t a; a.kind = FA_STR; a.wide = false; a.s.c = v.data(); a.s.len = v.length(); return (a); }
+inline fmt_arg_t fmtArg(const std::string& v)       { return (fmtArg(std::string_view(v))); }
+
+// a null pointer prints as (null), like newlib does
+inline fmt_arg_t fmtArg(const char* v)
+{
+    return (fmtArg(v ? std::string_view(v) : std::string_view("(null)")));
+}
+
+template <typename T>
+inline fmt_arg_t fmtArg(const T* v)                 { fmt_arg_t a; a.kind = FA_PTR; a.wide = false; a.p = v; return (a); }
+
+template <typename T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+inline fmt_arg_t fmtArg(T v)                        { return (fmtInt((int64_t)v, false)); }
+
+// does the work, for every FMT() and FMT_INTO()
+size_t fmtFormat(char* buff, size_t size, const char* f, const fmt_arg_t* args, size_t count);
+
+template <bool OK, typename... Args>
+size_t fmtInto(char* buff, size_t size, const char* f, const Args&... args)
+{
+    static_assert(OK, "format doesn't match its arguments");
+
+    const fmt_arg_t a[] = { fmtArg(args)..., fmtInt(0, false) };
+    return (fmtFormat(buff, size, f, a, sizeof...(Args)));
+}
+
+template <size_t N, bool OK, typename... Args>
+fmt_text_t<N> fmtText(const char* f, const Args&... args)
+{
+    fmt_text_t<N> t;
+    t.len = fmtInto<OK>(t.text, N, f, args...);
+    return (t);
+}
+
+#endif // STRING_FORMAT_H_
@@ -0,0 +1,41 @@
+/********************************************************
+ * temperature.cpp
+ ********************************************************
+ * fixed point temperatures.  See the comment in
+ * temperature.h
+ * December 2021, M.Brugman
+ *
+ *******************************************************/
+#include "temperature.h"
+#include "stringFormat.h"
+
+/*********************************************
+ * temp2text()
+ *********************************************
+ * round to the places asked for, half away
+ * from zero, then whole degrees and the
+ * fraction as two integers.  The sign goes on
+ * separately so -0.5 doesn't come out as 0.5
+ ********************************************/
+size_t temp2text(temp_t t, uint8_t places, char* out, size_t size)
+{
+    const char* sign = (t < 0) ? "-" : "";
+    uint32_t v = (t < 0) ? (0 - (uint32_t)t) : (uint32_t)t;
+
+    switch (places)
+    {
+        case 0:
+        {
+            v = (v + 50) / 100;
+            return (FMT_INTO(out, size, "%s%u", v ? sign : "", v));
+        }
+
+        case 1:
+        {
+            v = (v + 5) / 10;
+            return (FMT_INTO(out, size, "%s%u.%u", v ? sign : "", v / 10, v % 10));
+        }
+    }
+
+    return (FMT_INTO(out, size, "%s%u.%02u", v ? sign : "", v / 100, v % 100));
+}
@@ -0,0 +1,38 @@
+/********************************************************
+ * temperature.h
+ ********************************************************
+ * Temperatures are whole hundredths of a degree F in an
+ * int32_t, all the way from the probe to the display.
+ * The M0+ has no FPU, so every float add or compare is
+ * a library call; this way the control loop is integer
+ * compares and the text is integer formatting.
+ *
+ * The DS18B20 gives 1/16 degrees C, which is exactly
+ * 11.25 hundredths F, so the probe's reading converts
+ * with a multiply and a divide by 4, off by less than
+ * a hundredth
+ * December 2021, M.Brugman
+ *
+ *******************************************************/
+#ifndef TEMPERATURE_H_
+#define TEMPERATURE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+typedef int32_t temp_t;     // hundredths of a degree F
+
+// degrees F to temp_t, for constants; TEMP_F(65) or TEMP_F(0.5)
+#define TEMP_F(f)           ((temp_t)((f) * 100))
+
+// longest text temp2text() makes, null and all
+#define TEMP_TEXT           16
+
+// the probe's 1/16 degree C to hundredths F
+inline temp_t tempFromRaw(int16_t raw)      { return (((raw * 45) / 4) + TEMP_F(32)); }
+
+// as degrees F with 0, 1 or 2 places, rounded; "65.0",
+// "-0.5".  Returns the length
+size_t temp2text(temp_t t, uint8_t places, char* out, size_t size);
+
+#endif // TEMPERATURE_H_